@@ -0,0 +1,198 @@
+// Host benchmark of the I2C retry policy against a simulated faulty device:
+// i2c_retry.c --> simulated bus (simulated time, no thread)
+//
+// The device NACKs while it is busy (bursts of a random length), and sometimes
+// holds SDA low: every attempt then runs until the bus task timeout, until a bus
+// recovery releases it. The transaction latency distribution is compared with
+// the bound given by i2cr_worst_case_us().
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "i2c_retry.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Same values as the board
+#define ATTEMPT_US              230     // INTCAP pair read at 100 kHz
+#define TIMEOUT_US              50000   // I2CQ_TIMEOUT_MS
+#define RECOVERY_US             210     // I2C_RECOVERY_US
+
+#define DEFAULT_TRANSACTIONS    100000
+#define IDLE_US                 1000    // Between two transactions
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    double busy_rate;           // Per transaction, start of a NACK burst
+    uint32_t busy_max_us;       // Longest burst
+    double stuck_rate;          // Per transaction, SDA held low
+    double recovery_rate;       // A recovery releasing SDA
+
+    int64_t busy_until_us;
+    bool stuck;
+} device_t;
+
+typedef struct {
+    int64_t now_us;
+    uint32_t *latencies;
+    size_t count;
+} bench_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static double random_unit() {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+static void device_idle(device_t *device, int64_t now_us) {
+    if(random_unit() < device->busy_rate) {
+        device->busy_until_us = now_us + 1 + (int64_t)(random_unit() * device->busy_max_us);
+    }
+    if(random_unit() < device->stuck_rate) {
+        device->stuck = true;
+    }
+}
+
+// One attempt on the simulated bus, the clock is moved forward
+static i2cr_error_t device_attempt(device_t *device, int64_t *now_us, bool *success) {
+    if(device->stuck) {
+        *now_us += TIMEOUT_US;
+        *success = false;
+        return I2CR_ERROR_TIMEOUT;
+    }
+
+    // The address byte is NACKed at once
+    if(*now_us < device->busy_until_us) {
+        *now_us += ATTEMPT_US / 8;
+        *success = false;
+        return I2CR_ERROR_NACK;
+    }
+
+    *now_us += ATTEMPT_US;
+    *success = true;
+    return I2CR_ERROR_OTHER;
+}
+
+static void device_recover(device_t *device, int64_t *now_us) {
+    *now_us += RECOVERY_US;
+    if(random_unit() < device->recovery_rate) {
+        device->stuck = false;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(bench_t *bench, i2cr_t *retry, device_t *device) {
+    for(size_t i = 0; i < bench->count; i++) {
+        bench->now_us += IDLE_US;
+        device_idle(device, bench->now_us);
+
+        i2cr_attempt_t attempt;
+        bool success = false;
+        i2cr_begin(retry, &attempt, bench->now_us);
+
+        while(true) {
+            i2cr_error_t error = device_attempt(device, &bench->now_us, &success);
+            if(success) {
+                break;
+            }
+
+            uint32_t delay_us = 0;
+            i2cr_action_t action = i2cr_failed(retry, &attempt, error, bench->now_us, &delay_us);
+            if(action == I2CR_ACTION_RECOVER || action == I2CR_ACTION_RECOVER_GIVE_UP) {
+                device_recover(device, &bench->now_us);
+            }
+            if(action == I2CR_ACTION_GIVE_UP || action == I2CR_ACTION_RECOVER_GIVE_UP) {
+                break;
+            }
+
+            bench->now_us += delay_us;
+            i2cr_retry(&attempt, bench->now_us);
+        }
+
+        i2cr_end(retry, &attempt, success, bench->now_us);
+        bench->latencies[i] = (uint32_t)(bench->now_us - attempt.start_us);
+    }
+}
+
+static void print_results(bench_t *bench, const i2cr_t *retry) {
+    const i2cr_stats_t *stats = &retry->stats;
+    uint32_t bound_us = i2cr_worst_case_us(&retry->cfg, TIMEOUT_US, RECOVERY_US);
+
+    qsort(bench->latencies, bench->count, sizeof(uint32_t), compare_u32);
+
+    printf("Transactions: %u, retries: %u, recoveries: %u, give ups: %u\n",
+        stats->transactions, stats->retries, stats->recoveries, stats->give_ups);
+    printf("Errors: %u NACK, %u timeout, %u bus, %u other\n",
+        stats->errors[I2CR_ERROR_NACK], stats->errors[I2CR_ERROR_TIMEOUT],
+        stats->errors[I2CR_ERROR_BUS], stats->errors[I2CR_ERROR_OTHER]);
+    printf("Latency: median %uus, 99%% %uus, 99.9%% %uus, worst %uus\n",
+        bench->latencies[bench->count / 2],
+        bench->latencies[bench->count * 99 / 100],
+        bench->latencies[bench->count * 999 / 1000],
+        stats->worst_us);
+    printf("Bound: %uus %s\n", bound_us, stats->worst_us <= bound_us ? "OK" : "EXCEEDED");
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n transactions] [-b busy_rate] [-s stuck_rate] [-r recovery_rate] [-a attempts] [-B budget_us] [-S seed]\n", name);
+}
+
+int main(int argc, char **argv) {
+    i2cr_cfg_t cfg = I2CR_CFG_DEFAULT();
+    device_t device = {
+        .busy_rate = 0.01,
+        .busy_max_us = 5000,
+        .stuck_rate = 0.0005,
+        .recovery_rate = 0.9,
+    };
+    bench_t bench = {
+        .count = DEFAULT_TRANSACTIONS,
+    };
+    unsigned seed = 1;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:b:s:r:a:B:S:h")) != -1) {
+        switch(opt) {
+            case 'n': bench.count = strtoul(optarg, NULL, 10); break;
+            case 'b': device.busy_rate = atof(optarg); break;
+            case 's': device.stuck_rate = atof(optarg); break;
+            case 'r': device.recovery_rate = atof(optarg); break;
+            case 'a': cfg.max_attempts = atoi(optarg); break;
+            case 'B': cfg.budget_us = strtoul(optarg, NULL, 10); break;
+            case 'S': seed = strtoul(optarg, NULL, 10); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(bench.count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    srand(seed);
+    bench.latencies = calloc(bench.count, sizeof(uint32_t));
+    if(bench.latencies == NULL) {
+        fprintf(stderr, "Fail to allocate %zu latencies!\n", bench.count);
+        return 1;
+    }
+
+    i2cr_t retry;
+    i2cr_init(&retry, &cfg);
+    run(&bench, &retry, &device);
+    print_results(&bench, &retry);
+
+    free(bench.latencies);
+    return retry.stats.worst_us <= i2cr_worst_case_us(&cfg, TIMEOUT_US, RECOVERY_US) ? 0 : 2;
+}
@@ -0,0 +1,482 @@
+// Host benchmark of the jack matrix scan and the hook read on a simulated bus:
+// jack_matrix.c, expander_int.c --> gpio_expander.c --> i2c_queue.c --> i2c_driver.c
+//   --> driver/i2c.h shim --> i2c_sim.c --> mcp23016_sim.c
+//
+// The firmware modules run unchanged on the FreeRTOS shim, in simulated time: only
+// the bus transfers, the delays and the expander interrupt sampling take time.
+//
+// Expander 0x20: hook on GP0.0, INT wired to GPXI_INT_GPIO, columns 0..7 on GP1.
+// Expander 0x21: lines 0..15. Expander 0x22: columns 8..15 on GP0.
+// -D scans the shipped plugboard instead (JKMX_MAP_DEFAULT()): columns and lines on
+// 0x20 with the hook, so every drive of a plugged column also raises INT. A hook pin
+// sample or an INTCAP read whose hook bit is not the handset state is a hook glitch.
+// Contacts are plugged / unplugged and the handset is lifted / hung up at random
+// times. Latencies: plug to jack matrix event (end of the scan seeing it), hook to
+// INT falling edge and to the INTCAP read handled by the input task.
+// -t writes the I2C trace (i2c_trace.c) at the end, for scripts/i2c_trace_decode.py.
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+#include "shim.h"
+#include "i2c_sim.h"
+#include "mcp23016_sim.h"
+
+#include "expander_int.h"
+#include "gpio_expander.h"
+#include "i2c_driver.h"
+#include "i2c_queue.h"
+#include "i2c_trace.h"
+#include "jack_matrix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOOK_BIT                0x0001  // GP0.0 of GPIO_EXPANDER_ADDR, as phonetastic_app.c
+#define LINE_EXPANDER           1
+#define HIGH_COLUMN_EXPANDER    2
+#define START_NS                100000000LL     // Configuration done, first changes
+#define TAIL_NS                 200000000LL     // After the last change, until it is seen
+#define DEFAULT_DURATION_S      10
+#define DEFAULT_GAP_MS          250
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    int64_t time_ns;
+    uint8_t column;
+    uint8_t line;
+    bool on;                // Plugged, or handset lifted
+    int64_t seen_ns;        // Event, or INTCAP read handled, 0 until then
+    int64_t int_ns;         // Hook: INT edge
+} change_t;
+
+typedef struct {
+    change_t *changes;
+    size_t count;
+    size_t next;            // Next change to apply
+} schedule_t;
+
+typedef struct {
+    jkmx_map_t map;
+    mcp_sim_t devices[3];
+    uint16_t plugged[JKMX_MAX_COLUMNS];     // Lines of each column
+    bool off_hook;
+
+    schedule_t plugs;
+    schedule_t hooks;
+    uint32_t unexpected;    // Matrix events not matching a change
+    uint32_t hook_glitches; // Hook pin samples or INTCAP reads not matching the handset
+    uint32_t sda_holds;     // Left to inject
+    int64_t duration_ns;
+    int32_t warm_heap_commands;     // Links on the heap at START_NS, -1 before
+} bench_t;
+
+static bench_t _bench;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void build_map(jkmx_map_t *map, int columns, int lines) {
+    memset(map, 0, sizeof(jkmx_map_t));
+    map->column_count = columns;
+    map->line_count = lines;
+
+    for(int c = 0; c < columns; c++) {
+        map->columns[c] = c < 8
+            ? (jkmx_pin_t)JKMX_PIN(0, 1, c)
+            : (jkmx_pin_t)JKMX_PIN(HIGH_COLUMN_EXPANDER, 0, c - 8);
+    }
+    for(int l = 0; l < lines; l++) {
+        map->lines[l] = (jkmx_pin_t)JKMX_PIN(LINE_EXPANDER, l / 8, l % 8);
+    }
+}
+
+// Plugboard: a line is high while a column plugged on it is driven
+static uint16_t board_pins(mcp_sim_t *device, void *ctx) {
+    bench_t *bench = ctx;
+    int expander = (int)(device - bench->devices);
+    uint16_t levels = 0;
+
+    if(expander == 0 && bench->off_hook) {
+        levels |= HOOK_BIT;
+    }
+
+    for(int c = 0; c < bench->map.column_count; c++) {
+        const jkmx_pin_t *column = &bench->map.columns[c];
+        if((mcp_sim_outputs(&bench->devices[column->expander]) & (1u << column->bit)) == 0) {
+            continue;
+        }
+        for(int l = 0; l < bench->map.line_count; l++) {
+            const jkmx_pin_t *line = &bench->map.lines[l];
+            if((bench->plugged[c] & (1u << l)) && line->expander == expander) {
+                levels |= 1u << line->bit;
+            }
+        }
+    }
+
+    // A line on the hook pin would show a plugged contact as the handset
+    if(expander == 0 && ((levels & HOOK_BIT) != 0) != bench->off_hook) {
+        bench->hook_glitches++;
+    }
+    return levels;
+}
+
+// Handset state at time_ns, from the hook changes applied
+static bool off_hook_at(const bench_t *bench, int64_t time_ns) {
+    bool off_hook = false;
+
+    for(size_t i = 0; i < bench->hooks.next && bench->hooks.changes[i].time_ns <= time_ns; i++) {
+        off_hook = bench->hooks.changes[i].on;
+    }
+    return off_hook;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static double random_unit() {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+// Changes spread over the run, gap_ns on average
+static void plan(schedule_t *schedule, int64_t duration_ns, int64_t gap_ns) {
+    size_t capacity = duration_ns / (gap_ns / 2) + 1;
+
+    schedule->changes = calloc(capacity, sizeof(change_t));
+    schedule->count = 0;
+    schedule->next = 0;
+
+    for(int64_t t = START_NS + gap_ns * random_unit(); t < START_NS + duration_ns && schedule->count < capacity; ) {
+        schedule->changes[schedule->count++].time_ns = t;
+        t += gap_ns / 2 + (int64_t)(gap_ns * random_unit());
+    }
+}
+
+static void apply_plug(void *args) {
+    bench_t *bench = args;
+    change_t *change = &bench->plugs.changes[bench->plugs.next++];
+
+    bench->plugged[change->column] ^= 1u << change->line;
+    change->on = (bench->plugged[change->column] >> change->line) & 1;
+    mcp_sim_pins_changed();
+}
+
+static void apply_hook(void *args) {
+    bench_t *bench = args;
+    change_t *change = &bench->hooks.changes[bench->hooks.next++];
+
+    bench->off_hook = !bench->off_hook;
+    change->on = bench->off_hook;
+    mcp_sim_pins_changed();
+}
+
+static void hold_sda(void *args) {
+    bench_t *bench = args;
+    // Interrupted in the middle of a read, the next bits of the byte
+    mcp_sim_hold_sda(&bench->devices[bench->map.lines[0].expander], 1 + rand() % 8);
+}
+
+static void schedule_changes(bench_t *bench, int64_t gap_ns) {
+    plan(&bench->plugs, bench->duration_ns, gap_ns);
+    plan(&bench->hooks, bench->duration_ns, gap_ns);
+
+    for(size_t i = 0; i < bench->plugs.count; i++) {
+        change_t *change = &bench->plugs.changes[i];
+        change->column = rand() % bench->map.column_count;
+        change->line = rand() % bench->map.line_count;
+        shim_at(change->time_ns, apply_plug, bench);
+    }
+    for(size_t i = 0; i < bench->hooks.count; i++) {
+        shim_at(bench->hooks.changes[i].time_ns, apply_hook, bench);
+    }
+    for(uint32_t i = 0; i < bench->sda_holds; i++) {
+        shim_at(START_NS + (int64_t)(bench->duration_ns * random_unit()), hold_sda, bench);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Input task of expander_int.c
+static void on_port(uint16_t port, bool interrupt, int64_t time_us, void *ctx) {
+    bench_t *bench = ctx;
+    schedule_t *hooks = &bench->hooks;
+
+    if(!interrupt) {
+        return;
+    }
+
+    // INTCAP holds the port of the last INT edge, at the latest the one of this read:
+    // its hook bit must be the handset state at the edge timestamp or now
+    bool hook = (port & HOOK_BIT) != 0;
+    if(hook != off_hook_at(bench, time_us * 1000) && hook != off_hook_at(bench, shim_now_ns())) {
+        bench->hook_glitches++;
+    }
+    if(hooks->next == 0) {
+        return;
+    }
+
+    change_t *change = &hooks->changes[hooks->next - 1];
+    if(change->seen_ns == 0 && ((port & HOOK_BIT) != 0) == change->on) {
+        change->seen_ns = shim_now_ns();
+        change->int_ns = time_us * 1000;
+    }
+}
+
+static void on_event(bench_t *bench, const jkmx_event_t *event) {
+    schedule_t *plugs = &bench->plugs;
+
+    // First scans, contacts plugged from the start
+    if(event->timestamp_us * 1000 < START_NS) {
+        return;
+    }
+
+    // The latest change of the contact
+    for(size_t i = plugs->next; i-- > 0; ) {
+        change_t *change = &plugs->changes[i];
+        if(change->column != event->column || change->line != event->line) {
+            continue;
+        }
+        if(change->seen_ns == 0 && change->on == event->plugged) {
+            change->seen_ns = event->timestamp_us * 1000;
+            return;
+        }
+        break;
+    }
+    bench->unexpected++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int compare_i64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a;
+    int64_t y = *(const int64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Latencies of the changes seen, in us, sorted
+static size_t latencies(const schedule_t *schedule, bool interrupt, int64_t *values, size_t *missed) {
+    size_t count = 0;
+
+    *missed = 0;
+    for(size_t i = 0; i < schedule->next; i++) {
+        const change_t *change = &schedule->changes[i];
+        if(change->seen_ns == 0) {
+            (*missed)++;
+            continue;
+        }
+        values[count++] = ((interrupt ? change->int_ns : change->seen_ns) - change->time_ns) / 1000;
+    }
+    qsort(values, count, sizeof(int64_t), compare_i64);
+    return count;
+}
+
+static void print_latencies(const char *name, const schedule_t *schedule, bool interrupt) {
+    int64_t *values = calloc(schedule->next + 1, sizeof(int64_t));
+    size_t missed;
+    size_t count = latencies(schedule, interrupt, values, &missed);
+
+    if(count == 0) {
+        printf("%-18s none seen, %zu missed\n", name, missed);
+    } else {
+        printf("%-18s %5zu seen, %zu missed, median %lldus, 99%% %lldus, worst %lldus\n",
+            name, count, missed, (long long)values[count / 2],
+            (long long)values[count * 99 / 100], (long long)values[count - 1]);
+    }
+    free(values);
+}
+
+static size_t missed_changes(const schedule_t *schedule) {
+    size_t missed = 0;
+    for(size_t i = 0; i < schedule->next; i++) {
+        if(schedule->changes[i].seen_ns == 0) {
+            missed++;
+        }
+    }
+    return missed;
+}
+
+// The register path must not allocate once configured
+static uint32_t heap_after_warm_up(const bench_t *bench) {
+    i2c_stats_t links;
+
+    i2c_getStats(&links);
+    return bench->warm_heap_commands < 0 ? links.heap_commands : links.heap_commands - bench->warm_heap_commands;
+}
+
+static void print_results(bench_t *bench, const jkmx_cfg_t *cfg) {
+    i2cq_stats_t scan;
+    i2cq_stats_t expander;
+    i2cr_stats_t retry;
+    i2c_sim_stats_t bus;
+    i2c_stats_t links;
+    int64_t elapsed_us = shim_now_ns() / 1000;
+
+    i2cq_get_stats(I2CQ_CLIENT_SCAN, &scan);
+    i2cq_get_stats(I2CQ_CLIENT_EXPANDER, &expander);
+    i2cq_get_retry_stats(&retry);
+    i2c_sim_get_stats(&bus);
+    i2c_getStats(&links);
+
+    printf("Bus %u Hz, %ix%i matrix scanned every %ims, %.1fs simulated\n",
+        i2c_sim_get_frequency(), cfg->map.column_count, cfg->map.line_count,
+        cfg->scan_period_ms, elapsed_us / 1e6);
+    printf("Scan: estimated %uus, mean %lldus, worst %lldus, %u over the %ius budget\n",
+        jkmx_estimate_scan_us(&cfg->map, i2c_sim_get_frequency()),
+        scan.batches > 0 ? (long long)(scan.busy_us / scan.batches) : 0LL,
+        (long long)jkmx_get_max_scan_us(), jkmx_get_overruns(), cfg->scan_budget_us);
+    printf("Bus time: scan %.1f%%, expander %.1f%% (max wait %uus), %u commands, %u links on the heap (%u after warm-up)\n",
+        100.0 * scan.busy_us / elapsed_us, 100.0 * expander.busy_us / elapsed_us,
+        expander.max_wait_us, bus.commands, links.heap_commands, heap_after_warm_up(bench));
+
+    print_latencies("Plug -> event:", &bench->plugs, false);
+    print_latencies("Hook -> INT:", &bench->hooks, true);
+    print_latencies("Hook -> INTCAP:", &bench->hooks, false);
+    printf("Unexpected matrix events: %u, hook changes lost by the expander: %u, hook glitches: %u\n",
+        bench->unexpected, bench->devices[0].stats.lost_changes, bench->hook_glitches);
+
+    printf("Faults: %u NACK, %u timeout, %u recovery clocks; retries %u, recoveries %u, give ups %u\n",
+        bus.nacks, bus.timeouts, bus.recovery_clocks, retry.retries, retry.recoveries, retry.give_ups);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-D | -c columns -l lines] [-f bus_hz] [-p scan_period_ms] [-d duration_s] "
+        "[-g gap_ms] [-n nack_rate] [-s sda_holds] [-S seed] [-t trace_file [-e records_after_error]] [-v]\n", name);
+}
+
+int main(int argc, char **argv) {
+    bench_t *bench = &_bench;
+    jkmx_cfg_t cfg = JKMX_CFG_DEFAULT();
+    i2c_sim_cfg_t sim_cfg = I2C_SIM_CFG_DEFAULT();
+    int columns = JKMX_MAX_COLUMNS;
+    int lines = JKMX_MAX_LINES;
+    uint32_t freq_hz = 0;
+    int64_t gap_ms = DEFAULT_GAP_MS;
+    double nack_rate = 0;
+    unsigned seed = 1;
+    esp_log_level_t log_level = ESP_LOG_WARN;
+    i2ct_cfg_t trace_cfg = I2CT_CFG_DEFAULT();
+    const char *trace_path = NULL;
+    bool shipped_map = false;
+    int opt;
+
+    bench->duration_ns = DEFAULT_DURATION_S * 1000000000LL;
+    bench->warm_heap_commands = -1;
+    while((opt = getopt(argc, argv, "Dc:l:f:p:d:g:n:s:S:t:e:vh")) != -1) {
+        switch(opt) {
+            case 'D': shipped_map = true; break;
+            case 'c': columns = atoi(optarg); break;
+            case 'l': lines = atoi(optarg); break;
+            case 'f': freq_hz = strtoul(optarg, NULL, 10); break;
+            case 'p': cfg.scan_period_ms = atoi(optarg); break;
+            case 'd': bench->duration_ns = (int64_t)(atof(optarg) * 1e9); break;
+            case 'g': gap_ms = atoi(optarg); break;
+            case 'n': nack_rate = atof(optarg); break;
+            case 's': bench->sda_holds = strtoul(optarg, NULL, 10); break;
+            case 'S': seed = strtoul(optarg, NULL, 10); break;
+            case 't': trace_path = optarg; break;
+            case 'e': trace_cfg.stop_after_error = atoi(optarg); break;
+            case 'v': log_level++; break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(columns < 1 || columns > JKMX_MAX_COLUMNS || lines < 1 || lines > JKMX_MAX_LINES
+            || cfg.scan_period_ms < portTICK_PERIOD_MS || gap_ms < 2 || bench->duration_ns <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    srand(seed);
+    esp_log_level_set("*", log_level);
+    i2ct_set_cfg(&trace_cfg);
+    if(shipped_map) {
+        // As phonetastic_app.c: the hook pin is reserved
+        bench->map = (jkmx_map_t)JKMX_MAP_DEFAULT();
+        bench->map.reserved[0] |= HOOK_BIT;
+        // PHONE_PUZZLE_SOLUTION plugged from the start: C1L1, C2L2 and C3L3
+        for(int c = 0; c < bench->map.column_count; c++) {
+            bench->plugged[c] = 1u << c;
+        }
+    } else {
+        build_map(&bench->map, columns, lines);
+    }
+    cfg.map = bench->map;
+
+    sim_cfg.sda_gpio = I2C_MASTER_SDA_IO;
+    sim_cfg.scl_gpio = I2C_MASTER_SCL_IO;
+    sim_cfg.freq_hz = I2C_MASTER_FREQ_HZ;
+    i2c_sim_init(&sim_cfg);
+    mcp_sim_init(&bench->devices[0], JKMX_EXPANDER_ADDR(0), GPXI_INT_GPIO, board_pins, bench);
+    mcp_sim_init(&bench->devices[1], JKMX_EXPANDER_ADDR(1), GPIO_NUM_NC, board_pins, bench);
+    mcp_sim_init(&bench->devices[2], JKMX_EXPANDER_ADDR(2), GPIO_NUM_NC, board_pins, bench);
+    for(int i = 0; i < 3; i++) {
+        mcp_sim_set_nack_rate(&bench->devices[i], nack_rate, seed + i);
+    }
+
+    if(gpxp_initialize(true) != ESP_OK) {
+        fprintf(stderr, "Fail to initialize the GPIO expander!\n");
+        return 1;
+    }
+    if(freq_hz > 0 && i2c_setFrequency(freq_hz) != ESP_OK) {
+        fprintf(stderr, "Fail to set the bus to %u Hz!\n", freq_hz);
+        return 1;
+    }
+    if(jkmx_initialize(&cfg) != ESP_OK || gpxi_initialize(GPXI_INT_GPIO, on_port, bench) != ESP_OK) {
+        fprintf(stderr, "Fail to start the jack matrix scan or the input task!\n");
+        return 1;
+    }
+
+    // Retried scans may take longer, the budget is only checked on a clean bus
+    bool faults = nack_rate > 0 || bench->sda_holds > 0;
+    schedule_changes(bench, gap_ms * 1000000);
+    QueueHandle_t events = jkmx_get_event_queue();
+    while(shim_now_ns() < START_NS + bench->duration_ns + TAIL_NS) {
+        jkmx_event_t event;
+        if(bench->warm_heap_commands < 0 && shim_now_ns() >= START_NS) {
+            i2c_stats_t links;
+            i2c_getStats(&links);
+            bench->warm_heap_commands = links.heap_commands;
+        }
+        if(xQueueReceive(events, &event, 1) == pdTRUE) {
+            on_event(bench, &event);
+        }
+    }
+
+    print_results(bench, &cfg);
+    if(trace_path != NULL) {
+        FILE *out = fopen(trace_path, "w");
+        if(out == NULL) {
+            fprintf(stderr, "Fail to open %s!\n", trace_path);
+            return 1;
+        }
+        printf("Trace: %zu records in %s\n", i2c_dumpTrace(out), trace_path);
+        fclose(out);
+    }
+    // The tasks are still running
+    if(missed_changes(&bench->plugs) + missed_changes(&bench->hooks) > 0) {
+        exit(2);
+    }
+    if(bench->hook_glitches > 0) {
+        fprintf(stderr, "Hook bit changed by the matrix scan!\n");
+        exit(5);
+    }
+    if(heap_after_warm_up(bench) > 0) {
+        fprintf(stderr, "Command links allocated on the heap after the warm-up!\n");
+        exit(3);
+    }
+    if(!faults && jkmx_get_overruns() > 0) {
+        fprintf(stderr, "Scans over the %ius budget!\n", cfg.scan_budget_us);
+        exit(4);
+    }
+    exit(0);
+}
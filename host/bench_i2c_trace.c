@@ -0,0 +1,223 @@
+// Host benchmark of the I2C transaction tracer: i2c_trace.c
+//
+// Cost of the recording, per access of a pair write and of a chained 16 column scan,
+// then writer threads commit commands while the ring is dumped: every record read
+// back must be whole (its data is derived from its writer and its access index).
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2c_trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define DEFAULT_ITERATIONS      1000000
+#define DEFAULT_WRITERS         4
+#define MAX_WRITERS             16
+#define SCAN_COLUMNS            16
+#define DUMP_SIZE               (64 * 1024)
+
+typedef struct {
+    int id;
+    uint32_t iterations;
+} writer_t;
+
+static volatile bool _stop;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Same bytes as i2c_queue.c for a pair write
+static void build_write(i2ct_link_t *link, uint8_t address, uint8_t register_id, const uint8_t *data) {
+    uint8_t header[2] = { address << 1, register_id };
+
+    i2ct_link_start(link);
+    i2ct_link_write(link, header, 2);
+    i2ct_link_write(link, data, 2);
+}
+
+// Same bytes as i2c_queue.c for a pair read
+static void build_read(i2ct_link_t *link, uint8_t address, uint8_t register_id, const uint8_t *data) {
+    uint8_t header[2] = { address << 1, register_id };
+    uint8_t read = (address << 1) | 1;
+
+    i2ct_link_write(link, header, 2);
+    i2ct_link_restart(link);
+    i2ct_link_write(link, &read, 1);
+    i2ct_link_read(link, data, 2);
+}
+
+// Chained batch of jack_matrix.c: a column write then a line read, per column
+static void build_scan(i2ct_link_t *link, const uint8_t *data) {
+    uint8_t drive[2] = { 0x00, 0x01 };
+
+    build_write(link, 0x20, 0x02, drive);
+    for(int c = 1; c < SCAN_COLUMNS; c++) {
+        i2ct_link_restart(link);
+        build_read(link, 0x21, 0x00, data);
+        i2ct_link_restart(link);
+        uint8_t header[2] = { 0x20 << 1, 0x02 };
+        i2ct_link_write(link, header, 2);
+        i2ct_link_write(link, drive, 2);
+    }
+}
+
+static double cost_ns(bool scan, uint32_t iterations) {
+    static i2ct_link_t link;
+    uint8_t data[2] = { 0x12, 0x34 };
+    uint32_t accesses = 0;
+
+    int64_t start = now_ns();
+    for(uint32_t i = 0; i < iterations; i++) {
+        if(scan) {
+            build_scan(&link, data);
+        } else {
+            build_write(&link, 0x20, 0x02, data);
+        }
+        i2ct_link_commit(&link, i, i + 1, 0);
+        accesses += link.count;
+    }
+    return (double)(now_ns() - start) / accesses;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void *writer_task(void *args) {
+    writer_t *writer = args;
+    i2ct_link_t link;
+
+    for(uint32_t i = 0; i < writer->iterations && !_stop; i++) {
+        uint8_t count = 1 + i % 8;
+
+        i2ct_link_start(&link);
+        for(uint8_t a = 0; a < count; a++) {
+            uint8_t data[2] = { writer->id, a };
+            uint8_t header[2] = { 0x20 << 1, a };
+            if(a > 0) {
+                i2ct_link_restart(&link);
+            }
+            i2ct_link_write(&link, header, 2);
+            i2ct_link_write(&link, data, 2);
+        }
+        // Times carry the writer and the command, the result the count
+        i2ct_link_commit(&link, writer->id, i, count);
+    }
+    return NULL;
+}
+
+// A record is whole when every field matches the writer, the command and the access
+static uint32_t check_dump(char *dump, uint32_t *records) {
+    uint32_t errors = 0;
+    char *line = strtok(dump, "\n");
+
+    while(line != NULL) {
+        unsigned seq, writer, command, address, register_id, flags, index, count, len;
+        char rw;
+        char data[2 * I2CT_DATA_SIZE + 1];
+        int result;
+
+        if(strncmp(line, "i2ct,", 5) == 0) {
+            (*records)++;
+            if(sscanf(line, "i2ct,%u,%u,%u,0x%x,0x%x,%c,%u,%u,%u,%8[0-9a-f],%u,%d",
+                    &seq, &writer, &command, &address, &register_id, &rw, &flags,
+                    &index, &count, data, &len, &result) != 12) {
+                errors++;
+            } else {
+                char expected[2 * I2CT_DATA_SIZE + 1];
+                snprintf(expected, sizeof(expected), "%02x%02x", writer, index);
+                if(address != 0x20 || register_id != index || rw != 'w' || len != 2
+                        || count != (unsigned)result || count != 1 + command % 8 || index >= count
+                        || strcmp(data, expected) != 0) {
+                    errors++;
+                }
+            }
+        }
+        line = strtok(NULL, "\n");
+    }
+    return errors;
+}
+
+static uint32_t run_writers(int writer_count, uint32_t iterations, uint32_t *dumps, uint32_t *records) {
+    static char dump[DUMP_SIZE];
+    pthread_t threads[MAX_WRITERS];
+    writer_t writers[MAX_WRITERS];
+    uint32_t errors = 0;
+
+    i2ct_clear();
+    _stop = false;
+    for(int i = 0; i < writer_count; i++) {
+        writers[i].id = i;
+        writers[i].iterations = iterations;
+        pthread_create(&threads[i], NULL, writer_task, &writers[i]);
+    }
+
+    // Dumps while the writers run, a record being written is skipped
+    int64_t end = now_ns() + 1000000000;
+    while(now_ns() < end) {
+        FILE *out = fmemopen(dump, sizeof(dump), "w");
+        if(out == NULL) {
+            break;
+        }
+        i2ct_dump(out, 100000);
+        fclose(out);
+        errors += check_dump(dump, records);
+        (*dumps)++;
+    }
+
+    _stop = true;
+    for(int i = 0; i < writer_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    return errors;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n iterations] [-w writers]\n", name);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = DEFAULT_ITERATIONS;
+    int writer_count = DEFAULT_WRITERS;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:w:h")) != -1) {
+        switch(opt) {
+            case 'n': iterations = strtoul(optarg, NULL, 10); break;
+            case 'w': writer_count = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if(iterations == 0 || writer_count < 1 || writer_count > MAX_WRITERS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("Record cost: pair write %.1fns per access, %i column scan %.1fns per access\n",
+        cost_ns(false, iterations), SCAN_COLUMNS, cost_ns(true, iterations / SCAN_COLUMNS));
+
+    uint32_t dumps = 0;
+    uint32_t records = 0;
+    uint32_t errors = run_writers(writer_count, iterations, &dumps, &records);
+
+    i2ct_stats_t stats;
+    i2ct_get_stats(&stats);
+    printf("%i writers: %u commands, %u records written, %u dumps, %u records read back, %u torn\n",
+        writer_count, stats.commands, stats.records, dumps, records, errors);
+
+    return errors == 0 ? 0 : 2;
+}
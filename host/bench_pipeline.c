@@ -0,0 +1,456 @@
+// Host benchmark of the player audio path:
+// file reader --> MP3 decoder --> channel router --> null sink
+//
+// Each element runs in its own thread and is linked to the next one by a
+// ringbuffer of the size used on the board, like the ADF element tasks of player.c.
+// The channel formatting is the real pcm_router.c, the MP3 decoder is libmpg123
+// (the ADF decoder is only shipped for Xtensa).
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <mpg123.h>
+
+#include "pcm_router.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Same sizes as SD_READER_CFG_DEFAULT(), DEFAULT_MP3_DECODER_CONFIG()
+// and DEFAULT_CHANNEL_ROUTER_CONFIG() on the board
+#define READER_BUFFER_SIZE      (8 * 1024)
+#define READER_RINGBUFFER_SIZE  (2 * READER_BUFFER_SIZE)
+#define DECODER_RINGBUFFER_SIZE (2 * 1024)
+#define ROUTER_BUFFER_SIZE      (1024)
+#define ROUTER_RINGBUFFER_SIZE  (8 * 1024)
+#define SINK_BUFFER_SIZE        (1024)
+
+#define DEFAULT_ASSET           "assets/elevator-song.mp3"
+#define MAX_DECODED_FRAMES      (64 * 1024)
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t read_pos;
+    size_t fill;
+    size_t peak;            // Highest fill seen
+    bool done;              // The writer reached the end of stream
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} ringbuf_t;
+
+typedef struct {
+    const char *path;
+    pcm_route_t route;
+    bool realtime;          // Sink consumes at the sample rate, like i2s
+    int runs;
+
+    ringbuf_t reader_rb;
+    ringbuf_t decoder_rb;
+    ringbuf_t router_rb;
+
+    volatile int sample_rate;
+    volatile int channels;
+
+    uint32_t *decode_ns;    // Decode time of each MP3 frame
+    size_t decoded_frames;
+
+    int64_t start_ns;
+    int64_t first_sink_ns;  // First frames reaching the sink
+    int64_t last_sink_ns;
+    int64_t max_sink_gap_ns;
+    uint64_t sink_bytes;
+} bench_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void rb_init(ringbuf_t *rb, size_t size) {
+    memset(rb, 0, sizeof(ringbuf_t));
+    rb->data = malloc(size);
+    rb->size = size;
+    pthread_mutex_init(&rb->lock, NULL);
+    pthread_cond_init(&rb->changed, NULL);
+}
+
+static void rb_deinit(ringbuf_t *rb) {
+    free(rb->data);
+    pthread_mutex_destroy(&rb->lock);
+    pthread_cond_destroy(&rb->changed);
+}
+
+// Block until all the bytes are written
+static void rb_write(ringbuf_t *rb, const char *buffer, size_t len) {
+    pthread_mutex_lock(&rb->lock);
+    while(len > 0) {
+        while(rb->fill == rb->size) {
+            pthread_cond_wait(&rb->changed, &rb->lock);
+        }
+
+        size_t write_pos = (rb->read_pos + rb->fill) % rb->size;
+        size_t chunk = rb->size - rb->fill;
+        if(chunk > rb->size - write_pos) chunk = rb->size - write_pos;
+        if(chunk > len) chunk = len;
+
+        memcpy(rb->data + write_pos, buffer, chunk);
+        rb->fill += chunk;
+        if(rb->fill > rb->peak) {
+            rb->peak = rb->fill;
+        }
+        buffer += chunk;
+        len -= chunk;
+        pthread_cond_broadcast(&rb->changed);
+    }
+    pthread_mutex_unlock(&rb->lock);
+}
+
+static void rb_done(ringbuf_t *rb) {
+    pthread_mutex_lock(&rb->lock);
+    rb->done = true;
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+}
+
+// Like audio_element_input(): wait for some data, return 0 at the end of stream
+static size_t rb_read(ringbuf_t *rb, char *buffer, size_t len) {
+    pthread_mutex_lock(&rb->lock);
+    while(rb->fill == 0 && !rb->done) {
+        pthread_cond_wait(&rb->changed, &rb->lock);
+    }
+
+    size_t total = 0;
+    while(total < len && rb->fill > 0) {
+        size_t chunk = rb->size - rb->read_pos;
+        if(chunk > rb->fill) chunk = rb->fill;
+        if(chunk > len - total) chunk = len - total;
+
+        memcpy(buffer + total, rb->data + rb->read_pos, chunk);
+        rb->read_pos = (rb->read_pos + chunk) % rb->size;
+        rb->fill -= chunk;
+        total += chunk;
+    }
+    pthread_cond_broadcast(&rb->changed);
+    pthread_mutex_unlock(&rb->lock);
+
+    return total;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void *reader_task(void *args) {
+    bench_t *bench = (bench_t *)args;
+    char buffer[READER_BUFFER_SIZE];
+
+    FILE *file = fopen(bench->path, "rb");
+    if(file == NULL) {
+        fprintf(stderr, "Fail to open %s: %s\n", bench->path, strerror(errno));
+    } else {
+        // Unbuffered fixed size reads, like sd_reader.c
+        setvbuf(file, NULL, _IONBF, 0);
+
+        size_t rlen;
+        while((rlen = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            rb_write(&bench->reader_rb, buffer, rlen);
+        }
+        fclose(file);
+    }
+
+    rb_done(&bench->reader_rb);
+    return NULL;
+}
+
+static void decoder_set_formats(mpg123_handle *mh) {
+    const long *rates;
+    size_t rate_count;
+
+    // 16 bits signed like the ADF decoder, whatever the rate and channel count
+    mpg123_format_none(mh);
+    mpg123_rates(&rates, &rate_count);
+    for(size_t i = 0; i < rate_count; i++) {
+        mpg123_format(mh, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+    }
+}
+
+static void *decoder_task(void *args) {
+    bench_t *bench = (bench_t *)args;
+    char buffer[READER_BUFFER_SIZE];
+
+    mpg123_handle *mh = mpg123_new(NULL, NULL);
+    if(mh == NULL || mpg123_open_feed(mh) != MPG123_OK) {
+        fprintf(stderr, "Fail to init the MP3 decoder!\n");
+        goto end;
+    }
+    decoder_set_formats(mh);
+
+    bool input_done = false;
+    while(true) {
+        off_t frame_num;
+        unsigned char *audio;
+        size_t bytes;
+
+        int64_t start = now_ns();
+        int ret = mpg123_decode_frame(mh, &frame_num, &audio, &bytes);
+        int64_t duration = now_ns() - start;
+
+        if(ret == MPG123_NEED_MORE) {
+            if(input_done) {
+                break;
+            }
+
+            size_t rlen = rb_read(&bench->reader_rb, buffer, sizeof(buffer));
+            if(rlen == 0) {
+                input_done = true;
+            } else {
+                mpg123_feed(mh, (unsigned char *)buffer, rlen);
+            }
+            continue;
+        }
+
+        if(ret == MPG123_NEW_FORMAT) {
+            long rate;
+            int channels, encoding;
+            mpg123_getformat(mh, &rate, &channels, &encoding);
+            bench->sample_rate = (int)rate;
+            bench->channels = channels;
+            continue;
+        }
+
+        if(ret != MPG123_OK) {
+            if(ret == MPG123_DONE) {
+                break;
+            }
+            fprintf(stderr, "Decoder error: %s\n", mpg123_strerror(mh));
+            break;
+        }
+
+        if(bench->decoded_frames < MAX_DECODED_FRAMES) {
+            bench->decode_ns[bench->decoded_frames++] = (uint32_t)duration;
+        }
+        if(bytes > 0) {
+            rb_write(&bench->decoder_rb, (const char *)audio, bytes);
+        }
+    }
+
+    end:
+    if(mh != NULL) {
+        mpg123_delete(mh);
+    }
+    rb_done(&bench->decoder_rb);
+    return NULL;
+}
+
+// Same processing as channel_router.c: carry of incomplete frames, mono expanded in place
+static void *router_task(void *args) {
+    bench_t *bench = (bench_t *)args;
+    char buffer[ROUTER_BUFFER_SIZE];
+    char carry_bytes[PCM_STEREO_FRAME_BYTES];
+    int carry = 0;
+
+    while(true) {
+        int channels = bench->channels;
+        int max_in_len = (channels == 2) ? sizeof(buffer) : sizeof(buffer) / 2;
+
+        memcpy(buffer, carry_bytes, carry);
+        size_t r_size = rb_read(&bench->decoder_rb, buffer + carry, max_in_len - carry);
+        if(r_size == 0) {
+            break;
+        }
+
+        // The decoder reports its format before its first output
+        channels = bench->channels;
+        int frame_bytes = channels * PCM_SAMPLE_BYTES;
+        int available = carry + r_size;
+        int frame_count = available / frame_bytes;
+        int in_used = frame_count * frame_bytes;
+
+        carry = available - in_used;
+        memcpy(carry_bytes, buffer + in_used, carry);
+
+        if(channels == 1) {
+            pcmr_place_mono((int16_t *)buffer, frame_count, bench->route);
+        } else {
+            pcmr_route_stereo((int16_t *)buffer, frame_count, bench->route);
+        }
+
+        if(frame_count > 0) {
+            rb_write(&bench->router_rb, buffer, frame_count * PCM_STEREO_FRAME_BYTES);
+        }
+    }
+
+    rb_done(&bench->router_rb);
+    return NULL;
+}
+
+// Null sink: frames are only timestamped, paced like i2s in realtime mode
+static void *sink_task(void *args) {
+    bench_t *bench = (bench_t *)args;
+    char buffer[SINK_BUFFER_SIZE];
+
+    while(true) {
+        size_t r_size = rb_read(&bench->router_rb, buffer, sizeof(buffer));
+        if(r_size == 0) {
+            break;
+        }
+
+        int64_t now = now_ns();
+        if(bench->sink_bytes == 0) {
+            bench->first_sink_ns = now;
+        } else if(now - bench->last_sink_ns > bench->max_sink_gap_ns) {
+            bench->max_sink_gap_ns = now - bench->last_sink_ns;
+        }
+        bench->last_sink_ns = now;
+        bench->sink_bytes += r_size;
+
+        if(bench->realtime && bench->sample_rate > 0) {
+            int64_t play_ns = (int64_t)(r_size / PCM_STEREO_FRAME_BYTES) * 1000000000LL / bench->sample_rate;
+            struct timespec ts = { play_ns / 1000000000LL, play_ns % 1000000000LL };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_rb(const char *name, const ringbuf_t *rb) {
+    printf("  %-20s peak %6zu / %6zu bytes (%3zu%%)\n", name, rb->peak, rb->size, rb->peak * 100 / rb->size);
+}
+
+static int run(bench_t *bench) {
+    pthread_t reader, decoder, router, sink;
+
+    rb_init(&bench->reader_rb, READER_RINGBUFFER_SIZE);
+    rb_init(&bench->decoder_rb, DECODER_RINGBUFFER_SIZE);
+    rb_init(&bench->router_rb, ROUTER_RINGBUFFER_SIZE);
+    bench->decode_ns = calloc(MAX_DECODED_FRAMES, sizeof(uint32_t));
+    bench->decoded_frames = 0;
+    bench->sample_rate = 0;
+    bench->channels = 0;
+    bench->sink_bytes = 0;
+    bench->max_sink_gap_ns = 0;
+
+    bench->start_ns = now_ns();
+    pthread_create(&sink, NULL, sink_task, bench);
+    pthread_create(&router, NULL, router_task, bench);
+    pthread_create(&decoder, NULL, decoder_task, bench);
+    pthread_create(&reader, NULL, reader_task, bench);
+
+    pthread_join(reader, NULL);
+    pthread_join(decoder, NULL);
+    pthread_join(router, NULL);
+    pthread_join(sink, NULL);
+    int64_t wall_ns = now_ns() - bench->start_ns;
+
+    int ret = 1;
+    if(bench->decoded_frames == 0 || bench->sample_rate == 0) {
+        fprintf(stderr, "No audio decoded from %s!\n", bench->path);
+        goto end;
+    }
+
+    qsort(bench->decode_ns, bench->decoded_frames, sizeof(uint32_t), compare_u32);
+    uint64_t decode_sum = 0;
+    for(size_t i = 0; i < bench->decoded_frames; i++) {
+        decode_sum += bench->decode_ns[i];
+    }
+
+    double audio_s = (double)(bench->sink_bytes / PCM_STEREO_FRAME_BYTES) / bench->sample_rate;
+    double wall_s = wall_ns / 1e9;
+
+    printf("%s: %i Hz, %i ch, %.2f s of audio\n", bench->path, bench->sample_rate, bench->channels, audio_s);
+    printf("  decode per frame     %zu frames, min %.1f us, avg %.1f us, p99 %.1f us, max %.1f us\n",
+        bench->decoded_frames,
+        bench->decode_ns[0] / 1e3,
+        decode_sum / 1e3 / bench->decoded_frames,
+        bench->decode_ns[bench->decoded_frames * 99 / 100] / 1e3,
+        bench->decode_ns[bench->decoded_frames - 1] / 1e3);
+    print_rb("reader ringbuffer", &bench->reader_rb);
+    print_rb("decoder ringbuffer", &bench->decoder_rb);
+    print_rb("router ringbuffer", &bench->router_rb);
+    printf("  first sink frames    %.3f ms after start\n", (bench->first_sink_ns - bench->start_ns) / 1e6);
+    printf("  max sink gap         %.3f ms\n", bench->max_sink_gap_ns / 1e6);
+    printf("  throughput           %.3f s wall, %.1fx realtime, %.2f MB/s of PCM\n",
+        wall_s, audio_s / wall_s, bench->sink_bytes / wall_s / 1e6);
+    ret = 0;
+
+    end:
+    free(bench->decode_ns);
+    rb_deinit(&bench->reader_rb);
+    rb_deinit(&bench->decoder_rb);
+    rb_deinit(&bench->router_rb);
+    return ret;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [-r left|right|both] [-t] [-n runs] [file.mp3]\n"
+        "  -r  route of the channel router (default right, the handset)\n"
+        "  -t  realtime sink, consumes at the sample rate like i2s\n"
+        "  -n  number of runs (default 1)\n"
+        "  file defaults to " DEFAULT_ASSET "\n", name);
+}
+
+int main(int argc, char **argv) {
+    bench_t bench = {
+        .path = DEFAULT_ASSET,
+        .route = PCM_ROUTE_RIGHT,
+        .realtime = false,
+        .runs = 1,
+    };
+
+    int opt;
+    while((opt = getopt(argc, argv, "r:tn:h")) != -1) {
+        switch(opt) {
+            case 'r':
+                if(strcmp(optarg, "left") == 0) bench.route = PCM_ROUTE_LEFT;
+                else if(strcmp(optarg, "right") == 0) bench.route = PCM_ROUTE_RIGHT;
+                else if(strcmp(optarg, "both") == 0) bench.route = PCM_ROUTE_BOTH;
+                else { usage(argv[0]); return 2; }
+                break;
+            case 't':
+                bench.realtime = true;
+                break;
+            case 'n':
+                bench.runs = atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if(optind < argc) {
+        bench.path = argv[optind];
+    }
+
+    if(mpg123_init() != MPG123_OK) {
+        fprintf(stderr, "Fail to init libmpg123!\n");
+        return 1;
+    }
+
+    int ret = 0;
+    for(int i = 0; i < bench.runs && ret == 0; i++) {
+        ret = run(&bench);
+    }
+
+    mpg123_exit();
+    return ret;
+}
@@ -0,0 +1,490 @@
+// Simulated I2C master and GPIO pins, see i2c_sim.h.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+
+#include "shim.h"
+#include "i2c_sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    int level;
+    bool gpio_mode;             // SDA / SCL taken from the controller (bus recovery)
+    gpio_int_type_t intr_type;
+    gpio_isr_t handler;
+    void *handler_args;
+} pin_t;
+
+static i2c_sim_cfg_t _cfg = I2C_SIM_CFG_DEFAULT();
+static i2c_sim_device_t *_devices;
+static SemaphoreHandle_t _bus_lock;         // As the driver, one command at a time
+static i2c_sim_stats_t _stats;
+static int64_t _timeout_ns = 32000LL * 1000000000 / I2C_SIM_APB_HZ;
+static int64_t _bus_free_ns;                // STOP + bus free time
+static pin_t _pins[GPIO_NUM_MAX];
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int64_t max_ns(int64_t a, int64_t b) {
+    return a > b ? a : b;
+}
+
+static bool is_fast() {
+    return _cfg.freq_hz > 100000;
+}
+
+static int64_t period_ns() {
+    return 1000000000LL / _cfg.freq_hz;
+}
+
+static int64_t start_ns() {
+    return max_ns(I2C_SIM_HD_STA_NS(is_fast()), period_ns() / 2);
+}
+
+// SCL released, then a START
+static int64_t restart_ns() {
+    return period_ns() / 2 + max_ns(I2C_SIM_SU_STA_NS(is_fast()), period_ns() / 2) + start_ns();
+}
+
+// 8 bits and the ACK
+static int64_t byte_ns() {
+    return 9 * period_ns();
+}
+
+static int64_t stop_ns() {
+    return period_ns() / 2 + max_ns(I2C_SIM_SU_STO_NS(is_fast()), period_ns() / 2);
+}
+
+static i2c_sim_device_t *find_device(uint8_t address) {
+    for(i2c_sim_device_t *device = _devices; device != NULL; device = device->next) {
+        if(device->address == address) {
+            return device;
+        }
+    }
+    return NULL;
+}
+
+static bool sda_held() {
+    for(i2c_sim_device_t *device = _devices; device != NULL; device = device->next) {
+        if(device->holds_sda != NULL && device->holds_sda(device)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool scl_held() {
+    for(i2c_sim_device_t *device = _devices; device != NULL; device = device->next) {
+        if(device->holds_scl != NULL && device->holds_scl(device)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void end_transfer(i2c_sim_device_t **current) {
+    if(*current != NULL && (*current)->stop != NULL) {
+        (*current)->stop(*current);
+    }
+    *current = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// One command of the link on the bus, the clock moves with each byte
+typedef struct {
+    i2c_sim_device_t *current;  // Addressed device
+    bool started;
+    bool address_next;          // First byte after a START
+    int commands;               // Controller commands since the last register refill
+} transfer_t;
+
+static void controller_command(transfer_t *transfer) {
+    if(++transfer->commands > I2C_SIM_CMD_SLOTS) {
+        transfer->commands = 1;
+        shim_sleep_ns(_cfg.refill_ns);
+    }
+}
+
+static esp_err_t run_write(transfer_t *transfer, const i2c_sim_op_t *op) {
+    const uint8_t *data = op->data != NULL ? op->data : &op->byte;
+
+    controller_command(transfer);
+    for(size_t i = 0; i < op->len; i++) {
+        bool ack = false;
+
+        shim_sleep_ns(byte_ns());
+        _stats.bytes++;
+
+        if(transfer->address_next) {
+            transfer->address_next = false;
+            transfer->current = find_device(data[i] >> 1);
+            ack = transfer->current != NULL && transfer->current->start(transfer->current, data[i] & 1);
+            if(!ack) {
+                transfer->current = NULL;
+            }
+        } else if(transfer->current != NULL) {
+            ack = transfer->current->write(transfer->current, data[i]);
+        }
+
+        if(!ack) {
+            _stats.nacks++;
+            if(op->ack_check) {
+                return ESP_FAIL;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static void run_read(transfer_t *transfer, const i2c_sim_op_t *op) {
+    controller_command(transfer);
+    for(size_t i = 0; i < op->len; i++) {
+        bool last = i + 1 == op->len;
+        bool ack = op->ack_type == I2C_MASTER_ACK || (op->ack_type == I2C_MASTER_LAST_NACK && !last);
+
+        // The NACKed last byte is one more controller command
+        if(last && op->len > 1 && op->ack_type == I2C_MASTER_LAST_NACK) {
+            controller_command(transfer);
+        }
+
+        shim_sleep_ns(byte_ns());
+        _stats.bytes++;
+
+        // Nobody drives SDA, the pull-ups read as ones
+        op->data[i] = transfer->current != NULL ? transfer->current->read(transfer->current, ack) : 0xFF;
+    }
+}
+
+static esp_err_t run_link(const i2c_sim_link_t *link) {
+    transfer_t transfer = { 0 };
+    esp_err_t err = ESP_OK;
+
+    for(size_t i = 0; i < link->count && err == ESP_OK; i++) {
+        const i2c_sim_op_t *op = &link->ops[i];
+
+        switch(op->type) {
+            case I2C_SIM_OP_START:
+                controller_command(&transfer);
+                end_transfer(&transfer.current);
+                // A line held low: the controller waits for its timeout
+                if(sda_held() || scl_held()) {
+                    shim_sleep_ns(_timeout_ns);
+                    _stats.timeouts++;
+                    err = ESP_ERR_TIMEOUT;
+                    break;
+                }
+                if(!transfer.started) {
+                    int64_t now = shim_now_ns();
+                    if(now < _bus_free_ns) {
+                        shim_sleep_ns(_bus_free_ns - now);
+                    }
+                }
+                shim_sleep_ns(transfer.started ? restart_ns() : start_ns());
+                transfer.started = true;
+                transfer.address_next = true;
+                break;
+
+            case I2C_SIM_OP_WRITE:
+                err = run_write(&transfer, op);
+                break;
+
+            case I2C_SIM_OP_READ:
+                run_read(&transfer, op);
+                break;
+
+            case I2C_SIM_OP_STOP:
+                controller_command(&transfer);
+                end_transfer(&transfer.current);
+                shim_sleep_ns(stop_ns());
+                transfer.started = false;
+                _bus_free_ns = shim_now_ns() + I2C_SIM_BUF_NS(is_fast());
+                break;
+        }
+    }
+
+    // A NACK ends the command with a STOP
+    if(err == ESP_FAIL) {
+        end_transfer(&transfer.current);
+        shim_sleep_ns(stop_ns());
+        _bus_free_ns = shim_now_ns() + I2C_SIM_BUF_NS(is_fast());
+    }
+    return err;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2c_sim_init(const i2c_sim_cfg_t *cfg) {
+    _cfg = *cfg;
+    _devices = NULL;
+    memset(&_stats, 0, sizeof(_stats));
+    _bus_lock = xSemaphoreCreateMutex();
+    for(int i = 0; i < GPIO_NUM_MAX; i++) {
+        _pins[i].level = 1;     // Pull-ups
+    }
+}
+
+void i2c_sim_attach(i2c_sim_device_t *device) {
+    device->next = _devices;
+    _devices = device;
+}
+
+void i2c_sim_get_stats(i2c_sim_stats_t *stats) {
+    *stats = _stats;
+}
+
+uint32_t i2c_sim_get_frequency() {
+    return _cfg.freq_hz;
+}
+
+void i2c_sim_set_pin(gpio_num_t gpio, int level) {
+    if(gpio < 0 || gpio >= GPIO_NUM_MAX) {
+        return;
+    }
+
+    pin_t *pin = &_pins[gpio];
+    int previous = pin->level;
+    pin->level = level;
+
+    if(pin->handler == NULL || previous == level) {
+        return;
+    }
+    if(pin->intr_type == GPIO_INTR_ANYEDGE
+            || (pin->intr_type == GPIO_INTR_NEGEDGE && level == 0)
+            || (pin->intr_type == GPIO_INTR_POSEDGE && level == 1)) {
+        pin->handler(pin->handler_args);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config) {
+    if(port != I2C_NUM_0 || config->master.clk_speed == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    _cfg.sda_gpio = config->sda_io_num;
+    _cfg.scl_gpio = config->scl_io_num;
+    _cfg.freq_hz = config->master.clk_speed;
+    _pins[_cfg.sda_gpio].gpio_mode = false;
+    _pins[_cfg.scl_gpio].gpio_mode = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_buf_len, size_t tx_buf_len, int flags) {
+    (void)rx_buf_len;
+    (void)tx_buf_len;
+    (void)flags;
+    return port == I2C_NUM_0 && mode == I2C_MODE_MASTER ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port) {
+    return port == I2C_NUM_0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_reset_tx_fifo(i2c_port_t port) {
+    return port == I2C_NUM_0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_reset_rx_fifo(i2c_port_t port) {
+    return port == I2C_NUM_0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// Glitches are not simulated
+esp_err_t i2c_filter_enable(i2c_port_t port, uint8_t cycles) {
+    return port == I2C_NUM_0 && cycles <= 7 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_filter_disable(i2c_port_t port) {
+    return port == I2C_NUM_0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_set_timeout(i2c_port_t port, int timeout) {
+    if(port != I2C_NUM_0 || timeout <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _timeout_ns = (int64_t)timeout * 1000000000 / I2C_SIM_APB_HZ;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static esp_err_t add_op(i2c_cmd_handle_t cmd, const i2c_sim_op_t *op) {
+    i2c_sim_link_t *link = cmd;
+
+    if(link == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(link->count == link->capacity) {
+        if(link->is_static) {
+            return ESP_ERR_NO_MEM;
+        }
+        size_t capacity = link->capacity > 0 ? 2 * link->capacity : 8;
+        i2c_sim_op_t *ops = realloc(link->ops, capacity * sizeof(i2c_sim_op_t));
+        if(ops == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        link->ops = ops;
+        link->capacity = capacity;
+    }
+
+    link->ops[link->count++] = *op;
+    return ESP_OK;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void) {
+    return calloc(1, sizeof(i2c_sim_link_t));
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size) {
+    if(buffer == NULL || size < sizeof(i2c_sim_link_t) + sizeof(i2c_sim_op_t)) {
+        return NULL;
+    }
+
+    i2c_sim_link_t *link = (i2c_sim_link_t *)buffer;
+    link->ops = (i2c_sim_op_t *)(buffer + sizeof(i2c_sim_link_t));
+    link->count = 0;
+    link->capacity = (size - sizeof(i2c_sim_link_t)) / sizeof(i2c_sim_op_t);
+    link->is_static = true;
+    return link;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd) {
+    i2c_sim_link_t *link = cmd;
+    if(link != NULL && !link->is_static) {
+        free(link->ops);
+        free(link);
+    }
+}
+
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd) {
+    (void)cmd;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd) {
+    i2c_sim_op_t op = { .type = I2C_SIM_OP_START };
+    return add_op(cmd, &op);
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd) {
+    i2c_sim_op_t op = { .type = I2C_SIM_OP_STOP };
+    return add_op(cmd, &op);
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en) {
+    i2c_sim_op_t op = { .type = I2C_SIM_OP_WRITE, .ack_check = ack_en, .byte = data, .len = 1 };
+    return add_op(cmd, &op);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, bool ack_en) {
+    i2c_sim_op_t op = { .type = I2C_SIM_OP_WRITE, .ack_check = ack_en, .len = data_len, .data = data };
+    return data != NULL && data_len > 0 ? add_op(cmd, &op) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack) {
+    return i2c_master_read(cmd, data, 1, ack);
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack) {
+    i2c_sim_op_t op = { .type = I2C_SIM_OP_READ, .ack_type = ack, .len = data_len, .data = data };
+    return data != NULL && data_len > 0 ? add_op(cmd, &op) : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait) {
+    if(port != I2C_NUM_0 || cmd == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(xSemaphoreTake(_bus_lock, ticks_to_wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t start = shim_now_ns();
+    shim_sleep_ns(_cfg.begin_ns);
+    esp_err_t err = run_link(cmd);
+    shim_sleep_ns(_cfg.end_ns);
+
+    _stats.commands++;
+    _stats.busy_ns += shim_now_ns() - start;
+    xSemaphoreGive(_bus_lock);
+    return err;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    for(int gpio = 0; gpio < GPIO_NUM_MAX; gpio++) {
+        if(config->pin_bit_mask & (1ULL << gpio)) {
+            _pins[gpio].intr_type = config->intr_type;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode) {
+    if(gpio < 0 || gpio >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(gpio == _cfg.sda_gpio || gpio == _cfg.scl_gpio) {
+        _pins[gpio].gpio_mode = mode != GPIO_MODE_DISABLE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+    if(gpio < 0 || gpio >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // SCL rising edge while a device holds SDA: it shifts its next bit
+    if(gpio == _cfg.scl_gpio && _pins[gpio].level == 0 && level != 0 && !scl_held()) {
+        _stats.recovery_clocks++;
+        for(i2c_sim_device_t *device = _devices; device != NULL; device = device->next) {
+            if(device->clock != NULL) {
+                device->clock(device);
+            }
+        }
+    }
+    _pins[gpio].level = level != 0;
+    return ESP_OK;
+}
+
+// Open drain bus lines: low when the master or a device pulls them
+int gpio_get_level(gpio_num_t gpio) {
+    if(gpio < 0 || gpio >= GPIO_NUM_MAX) {
+        return 0;
+    }
+    if(gpio == _cfg.sda_gpio) {
+        return _pins[gpio].level && !sda_held();
+    }
+    if(gpio == _cfg.scl_gpio) {
+        return _pins[gpio].level && !scl_held();
+    }
+    return _pins[gpio].level;
+}
+
+esp_err_t gpio_install_isr_service(int flags) {
+    (void)flags;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *args) {
+    if(gpio < 0 || gpio >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _pins[gpio].handler = handler;
+    _pins[gpio].handler_args = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio) {
+    return gpio_isr_handler_add(gpio, NULL, NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
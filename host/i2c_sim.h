@@ -0,0 +1,86 @@
+#ifndef I2C_SIM_H
+#define I2C_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Simulated I2C bus behind the driver/i2c.h and driver/gpio.h shims: the command
+// links built by i2c_driver.c are run byte by byte on the attached devices, each
+// step takes its bus time on the simulated clock (I2C-bus specification timings,
+// at least half a clock period, as set by the ESP32 controller).
+
+// UM10204 table 10, ns: standard mode (up to 100 kHz), then fast mode
+#define I2C_SIM_HD_STA_NS(fast)     ((fast) ? 600 : 4000)   // START hold
+#define I2C_SIM_SU_STA_NS(fast)     ((fast) ? 600 : 4700)   // Repeated START setup
+#define I2C_SIM_SU_STO_NS(fast)     ((fast) ? 600 : 4000)   // STOP setup
+#define I2C_SIM_BUF_NS(fast)        ((fast) ? 1300 : 4700)  // Bus free between STOP and START
+
+#define I2C_SIM_APB_HZ              80000000    // i2c_set_timeout() cycles
+#define I2C_SIM_CMD_SLOTS           15          // ESP32 command registers, an END is the 16th
+
+typedef struct i2c_sim_device i2c_sim_device_t;
+
+// A device on the bus, callbacks from the task running i2c_master_cmd_begin()
+// or i2c_recover(), at the simulated time of the byte.
+struct i2c_sim_device {
+    uint8_t address;
+    // Address byte matched, false for a NACK
+    bool (*start)(i2c_sim_device_t *device, bool read);
+    // Byte written by the master, false for a NACK
+    bool (*write)(i2c_sim_device_t *device, uint8_t data);
+    // Byte sent to the master, ack: the master reads another one
+    uint8_t (*read)(i2c_sim_device_t *device, bool ack);
+    // STOP or repeated START after a transfer with the device
+    void (*stop)(i2c_sim_device_t *device);
+    // Bus lines held low by the device, and a clock pulse given while it holds SDA
+    bool (*holds_sda)(i2c_sim_device_t *device);
+    bool (*holds_scl)(i2c_sim_device_t *device);
+    void (*clock)(i2c_sim_device_t *device);
+    i2c_sim_device_t *next;
+};
+
+typedef struct {
+    int sda_gpio;
+    int scl_gpio;
+    uint32_t freq_hz;           // Until i2c_param_config()
+    uint32_t begin_ns;          // i2c_master_cmd_begin() before the START: bus lock, FIFO, command registers
+    uint32_t end_ns;            // After the STOP: completion interrupt, waiting task woken
+    uint32_t refill_ns;         // SCL held while the ISR refills the command registers
+} i2c_sim_cfg_t;
+
+#define I2C_SIM_CFG_DEFAULT() {     \
+    .sda_gpio = 18,                 \
+    .scl_gpio = 23,                 \
+    .freq_hz = 100000,              \
+    .begin_ns = 15000,              \
+    .end_ns = 10000,                \
+    .refill_ns = 4000,              \
+}
+
+typedef struct {
+    uint32_t commands;          // i2c_master_cmd_begin() calls
+    uint32_t bytes;
+    uint32_t nacks;             // Address or data bytes not acknowledged
+    uint32_t timeouts;          // START impossible, a line held low
+    uint32_t recovery_clocks;   // SCL pulses given as a GPIO
+    int64_t busy_ns;            // Inside i2c_master_cmd_begin()
+} i2c_sim_stats_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2c_sim_init(const i2c_sim_cfg_t *cfg);
+void i2c_sim_attach(i2c_sim_device_t *device);
+void i2c_sim_get_stats(i2c_sim_stats_t *stats);
+uint32_t i2c_sim_get_frequency();
+
+// Level of a board pin driven by a device (expander INT output), edges call the
+// GPIO ISR handler of the pin.
+void i2c_sim_set_pin(gpio_num_t gpio, int level);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // I2C_SIM_H
@@ -0,0 +1,249 @@
+// Virtual MCP23016, see mcp23016_sim.h.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "i2c_sim.h"
+#include "shim.h"
+
+#include "mcp23016_sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static mcp_sim_t *_devices;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint16_t pair(const mcp_sim_t *device, uint8_t register_id) {
+    return device->registers[register_id] | (device->registers[register_id + 1] << 8);
+}
+
+static uint16_t inputs(mcp_sim_t *device) {
+    uint16_t levels = device->pins != NULL ? device->pins(device, device->pins_ctx) : 0;
+    return levels & pair(device, MCP_SIM_IODIR0);
+}
+
+static int64_t sample_period_ns(const mcp_sim_t *device) {
+    return device->registers[MCP_SIM_IOCON0] & MCP_SIM_IOCON_IARES ? MCP_SIM_FAST_SAMPLE_NS : MCP_SIM_SAMPLE_NS;
+}
+
+static void set_int(mcp_sim_t *device, bool active) {
+    device->int_active = active;
+    if(device->int_gpio != GPIO_NUM_NC) {
+        i2c_sim_set_pin(device->int_gpio, active ? 0 : 1);
+    }
+}
+
+// Interrupt logic, on its own clock
+static void sample(void *args) {
+    mcp_sim_t *device = args;
+    uint16_t current = inputs(device);
+
+    device->sample_pending = false;
+    if(current == device->sampled) {
+        return;
+    }
+
+    device->sampled = current;
+    if(device->int_active) {
+        device->stats.lost_changes++;
+        return;
+    }
+
+    uint16_t port = mcp_sim_port(device);
+    device->registers[MCP_SIM_INTCAP0] = port & 0xFF;
+    device->registers[MCP_SIM_INTCAP1] = port >> 8;
+    device->stats.interrupts++;
+    set_int(device, true);
+}
+
+static void schedule_sample(mcp_sim_t *device) {
+    if(device->sample_pending || inputs(device) == device->sampled) {
+        return;
+    }
+
+    int64_t period = sample_period_ns(device);
+    int64_t next = (shim_now_ns() / period + 1) * period;
+    device->sample_pending = true;
+    shim_at(next, sample, device);
+}
+
+static void clear_int(mcp_sim_t *device) {
+    if(device->int_active) {
+        set_int(device, false);
+        schedule_sample(device);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static bool bus_start(i2c_sim_device_t *bus, bool read) {
+    mcp_sim_t *device = (mcp_sim_t *)bus;
+
+    if(device->nack_count > 0) {
+        device->nack_count--;
+        device->stats.nacks++;
+        return false;
+    }
+    if(device->nack_rate > 0 && (double)rand_r(&device->seed) / ((double)RAND_MAX + 1.0) < device->nack_rate) {
+        device->stats.nacks++;
+        return false;
+    }
+
+    device->command_next = !read;
+    device->stats.transfers++;
+    return true;
+}
+
+static bool bus_write(i2c_sim_device_t *bus, uint8_t data) {
+    mcp_sim_t *device = (mcp_sim_t *)bus;
+    uint8_t reg = device->pointer;
+
+    if(device->command_next) {
+        device->command_next = false;
+        if(data >= MCP_SIM_REGISTER_COUNT) {
+            return false;
+        }
+        device->pointer = data;
+        return true;
+    }
+    if(reg >= MCP_SIM_REGISTER_COUNT) {
+        return false;
+    }
+
+    switch(reg) {
+        case MCP_SIM_GP0:
+        case MCP_SIM_GP1:
+            device->registers[reg == MCP_SIM_GP0 ? MCP_SIM_OLAT0 : MCP_SIM_OLAT1] = data;
+            break;
+        case MCP_SIM_INTCAP0:
+        case MCP_SIM_INTCAP1:
+            break;      // Read only
+        case MCP_SIM_IOCON0:
+        case MCP_SIM_IOCON1:
+            // Both addresses are the same register
+            device->registers[MCP_SIM_IOCON0] = data & MCP_SIM_IOCON_IARES;
+            device->registers[MCP_SIM_IOCON1] = data & MCP_SIM_IOCON_IARES;
+            break;
+        default:
+            device->registers[reg] = data;
+            break;
+    }
+    device->pointer = reg ^ 1;
+
+    // Driven pins may be inputs of any device
+    if(reg <= MCP_SIM_OLAT1 || reg == MCP_SIM_IODIR0 || reg == MCP_SIM_IODIR1) {
+        mcp_sim_pins_changed();
+    } else if(reg == MCP_SIM_IPOL0 || reg == MCP_SIM_IPOL1) {
+        schedule_sample(device);
+    }
+    return true;
+}
+
+static uint8_t bus_read(i2c_sim_device_t *bus, bool ack) {
+    mcp_sim_t *device = (mcp_sim_t *)bus;
+    uint8_t reg = device->pointer;
+    uint8_t data;
+    (void)ack;
+
+    switch(reg) {
+        case MCP_SIM_GP0:
+        case MCP_SIM_GP1:
+            data = (mcp_sim_port(device) >> (8 * (reg & 1))) & 0xFF;
+            clear_int(device);
+            break;
+        case MCP_SIM_INTCAP0:
+        case MCP_SIM_INTCAP1:
+            data = device->registers[reg];
+            clear_int(device);
+            break;
+        default:
+            data = device->registers[reg];
+            break;
+    }
+    device->pointer = reg ^ 1;
+    return data;
+}
+
+static void bus_stop(i2c_sim_device_t *bus) {
+    mcp_sim_t *device = (mcp_sim_t *)bus;
+    device->command_next = false;
+}
+
+static bool bus_holds_sda(i2c_sim_device_t *bus) {
+    return ((mcp_sim_t *)bus)->sda_hold_clocks > 0;
+}
+
+static bool bus_holds_scl(i2c_sim_device_t *bus) {
+    return ((mcp_sim_t *)bus)->scl_hold;
+}
+
+static void bus_clock(i2c_sim_device_t *bus) {
+    mcp_sim_t *device = (mcp_sim_t *)bus;
+    if(device->sda_hold_clocks > 0) {
+        device->sda_hold_clocks--;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void mcp_sim_init(mcp_sim_t *device, uint8_t address, gpio_num_t int_gpio, mcp_sim_pins_t pins, void *ctx) {
+    memset(device, 0, sizeof(mcp_sim_t));
+
+    device->bus.address = address;
+    device->bus.start = bus_start;
+    device->bus.write = bus_write;
+    device->bus.read = bus_read;
+    device->bus.stop = bus_stop;
+    device->bus.holds_sda = bus_holds_sda;
+    device->bus.holds_scl = bus_holds_scl;
+    device->bus.clock = bus_clock;
+
+    // Every pin is an input at power on
+    device->registers[MCP_SIM_IODIR0] = 0xFF;
+    device->registers[MCP_SIM_IODIR1] = 0xFF;
+    device->int_gpio = int_gpio;
+    device->pins = pins;
+    device->pins_ctx = ctx;
+    device->sampled = inputs(device);
+    set_int(device, false);
+
+    device->next = _devices;
+    _devices = device;
+    i2c_sim_attach(&device->bus);
+}
+
+void mcp_sim_pins_changed() {
+    for(mcp_sim_t *device = _devices; device != NULL; device = device->next) {
+        schedule_sample(device);
+    }
+}
+
+uint16_t mcp_sim_port(mcp_sim_t *device) {
+    uint16_t iodir = pair(device, MCP_SIM_IODIR0);
+    uint16_t levels = (inputs(device) ^ pair(device, MCP_SIM_IPOL0)) & iodir;
+    return levels | (pair(device, MCP_SIM_OLAT0) & ~iodir);
+}
+
+uint16_t mcp_sim_outputs(const mcp_sim_t *device) {
+    return pair(device, MCP_SIM_OLAT0) & ~pair(device, MCP_SIM_IODIR0);
+}
+
+void mcp_sim_nack(mcp_sim_t *device, uint32_t count) {
+    device->nack_count += count;
+}
+
+void mcp_sim_set_nack_rate(mcp_sim_t *device, double rate, unsigned seed) {
+    device->nack_rate = rate;
+    device->seed = seed;
+}
+
+void mcp_sim_hold_sda(mcp_sim_t *device, uint8_t clocks) {
+    device->sda_hold_clocks = clocks;
+}
+
+void mcp_sim_hold_scl(mcp_sim_t *device, bool hold) {
+    device->scl_hold = hold;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,92 @@
+#ifndef MCP23016_SIM_H
+#define MCP23016_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+
+#include "i2c_sim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Virtual MCP23016 on the simulated bus (DS20090C): the 12 registers, the command
+// byte and the pair toggling, outputs through OLAT, interrupt on change of the
+// inputs sampled every 32 ms or 200 us (IOCON.IARES) with the port captured in
+// INTCAP, INT released by a GP or INTCAP read. Faults: NACKed address bytes,
+// SDA held for a number of clocks, SCL held.
+
+#define MCP_SIM_GP0             0x00
+#define MCP_SIM_GP1             0x01
+#define MCP_SIM_OLAT0           0x02
+#define MCP_SIM_OLAT1           0x03
+#define MCP_SIM_IPOL0           0x04
+#define MCP_SIM_IPOL1           0x05
+#define MCP_SIM_IODIR0          0x06
+#define MCP_SIM_IODIR1          0x07
+#define MCP_SIM_INTCAP0         0x08
+#define MCP_SIM_INTCAP1         0x09
+#define MCP_SIM_IOCON0          0x0A
+#define MCP_SIM_IOCON1          0x0B
+#define MCP_SIM_REGISTER_COUNT  12
+
+#define MCP_SIM_IOCON_IARES     0x01    // Fast interrupt sampling
+#define MCP_SIM_SAMPLE_NS       32000000LL
+#define MCP_SIM_FAST_SAMPLE_NS  200000LL
+
+typedef struct mcp_sim mcp_sim_t;
+
+// Levels on the 16 pins, GP0 in the low byte, from the simulated board
+typedef uint16_t (*mcp_sim_pins_t)(mcp_sim_t *device, void *ctx);
+
+typedef struct {
+    uint32_t transfers;         // Address bytes acknowledged
+    uint32_t nacks;             // Injected
+    uint32_t interrupts;        // INT falling edges
+    uint32_t lost_changes;      // Input changes sampled while INT was still low
+} mcp_sim_stats_t;
+
+struct mcp_sim {
+    i2c_sim_device_t bus;       // First, the device is its bus interface
+    uint8_t registers[MCP_SIM_REGISTER_COUNT];
+    uint8_t pointer;            // Register of the next byte
+    bool command_next;          // First written byte is the command byte
+    gpio_num_t int_gpio;        // GPIO_NUM_NC when not wired
+    bool int_active;
+    uint16_t sampled;           // Inputs at the last interrupt sample
+    bool sample_pending;
+    mcp_sim_pins_t pins;
+    void *pins_ctx;
+
+    uint32_t nack_count;        // Next address bytes NACKed
+    double nack_rate;           // Per address byte
+    unsigned seed;
+    uint8_t sda_hold_clocks;    // SDA low until that many SCL pulses
+    bool scl_hold;
+
+    mcp_sim_stats_t stats;
+    mcp_sim_t *next;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Power on reset values, attached to the bus
+void mcp_sim_init(mcp_sim_t *device, uint8_t address, gpio_num_t int_gpio, mcp_sim_pins_t pins, void *ctx);
+
+// The board changed (outputs of any device, external inputs): every device samples
+// its inputs again for an interrupt.
+void mcp_sim_pins_changed();
+
+// Port value as read in GP, GP0 in the low byte
+uint16_t mcp_sim_port(mcp_sim_t *device);
+// Output pins driven by the device, other bits are 0
+uint16_t mcp_sim_outputs(const mcp_sim_t *device);
+
+void mcp_sim_nack(mcp_sim_t *device, uint32_t count);
+void mcp_sim_set_nack_rate(mcp_sim_t *device, double rate, unsigned seed);
+void mcp_sim_hold_sda(mcp_sim_t *device, uint8_t clocks);
+void mcp_sim_hold_scl(mcp_sim_t *device, bool hold);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // MCP23016_SIM_H
@@ -0,0 +1,99 @@
+#ifndef SHIM_DRIVER_I2C_H
+#define SHIM_DRIVER_I2C_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+// Host shim of the ESP-IDF I2C master driver. Command links are recorded, then
+// i2c_master_cmd_begin() runs them on the simulated bus (i2c_sim.c).
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0           0
+#define I2C_NUM_1           1
+#define I2C_NUM_MAX         2
+
+typedef enum {
+    I2C_MODE_SLAVE,
+    I2C_MODE_MASTER,
+} i2c_mode_t;
+
+typedef enum {
+    I2C_MASTER_WRITE,
+    I2C_MASTER_READ,
+} i2c_rw_t;
+
+typedef enum {
+    I2C_MASTER_ACK,
+    I2C_MASTER_NACK,
+    I2C_MASTER_LAST_NACK,
+} i2c_ack_type_t;
+
+typedef struct {
+    i2c_mode_t mode;
+    int sda_io_num;
+    int scl_io_num;
+    gpio_pullup_t sda_pullup_en;
+    gpio_pullup_t scl_pullup_en;
+    struct {
+        uint32_t clk_speed;
+    } master;
+} i2c_config_t;
+
+typedef enum {
+    I2C_SIM_OP_START,       // START or repeated START
+    I2C_SIM_OP_WRITE,
+    I2C_SIM_OP_READ,
+    I2C_SIM_OP_STOP,
+} i2c_sim_op_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t ack_check;      // Write: a NACK ends the command with ESP_FAIL
+    uint8_t ack_type;       // Read: i2c_ack_type_t
+    uint8_t byte;           // Write of one byte, copied
+    size_t len;
+    uint8_t *data;          // Write: owned by the caller until i2c_master_cmd_begin()
+} i2c_sim_op_t;
+
+typedef struct {
+    i2c_sim_op_t *ops;
+    size_t count;
+    size_t capacity;
+    bool is_static;
+} i2c_sim_link_t;
+
+typedef void *i2c_cmd_handle_t;
+
+// START, 2 writes, repeated START, write and read per register access, and a STOP
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) \
+    (sizeof(i2c_sim_link_t) + ((TRANSACTIONS) * 6 + 2) * sizeof(i2c_sim_op_t))
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config);
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_buf_len, size_t tx_buf_len, int flags);
+esp_err_t i2c_driver_delete(i2c_port_t port);
+esp_err_t i2c_reset_tx_fifo(i2c_port_t port);
+esp_err_t i2c_reset_rx_fifo(i2c_port_t port);
+esp_err_t i2c_filter_enable(i2c_port_t port, uint8_t cycles);
+esp_err_t i2c_filter_disable(i2c_port_t port);
+esp_err_t i2c_set_timeout(i2c_port_t port, int timeout);
+
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd);
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks_to_wait);
+
+#endif // SHIM_DRIVER_I2C_H
@@ -0,0 +1,38 @@
+#ifndef SHIM_ESP_ERR_H
+#define SHIM_ESP_ERR_H
+
+#include <stdint.h>
+
+// Host shim of the ESP-IDF error codes used by src/main
+
+typedef int32_t esp_err_t;
+
+#define ESP_OK                      0
+#define ESP_FAIL                    -1
+
+#define ESP_ERR_NO_MEM              0x101
+#define ESP_ERR_INVALID_ARG         0x102
+#define ESP_ERR_INVALID_STATE       0x103
+#define ESP_ERR_INVALID_SIZE        0x104
+#define ESP_ERR_NOT_FOUND           0x105
+#define ESP_ERR_NOT_SUPPORTED       0x106
+#define ESP_ERR_TIMEOUT             0x107
+#define ESP_ERR_INVALID_RESPONSE    0x108
+
+#define ESP_ERR_NVS_BASE            0x1100
+#define ESP_ERR_NVS_NOT_FOUND       (ESP_ERR_NVS_BASE + 0x02)
+
+const char *esp_err_to_name(esp_err_t code);
+
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) ({                                     \
+    esp_err_t err_rc_ = (x);                                                    \
+    if(err_rc_ != ESP_OK) {                                                     \
+        esp_log_write(ESP_LOG_ERROR, "esp_err", "%s failed: %s (%s:%d)",        \
+            #x, esp_err_to_name(err_rc_), __FILE__, __LINE__);                  \
+    }                                                                           \
+    err_rc_;                                                                    \
+})
+
+#include "esp_log.h"
+
+#endif // SHIM_ESP_ERR_H
@@ -0,0 +1,10 @@
+#ifndef SHIM_ESP_IDF_VERSION_H
+#define SHIM_ESP_IDF_VERSION_H
+
+// The simulated driver has i2c_cmd_link_create_static(), as ESP-IDF 4.4:
+// i2c_driver.c builds its links in the static pool.
+
+#define ESP_IDF_VERSION_VAL(major, minor, patch) (((major) << 16) | ((minor) << 8) | (patch))
+#define ESP_IDF_VERSION     ESP_IDF_VERSION_VAL(4, 4, 0)
+
+#endif // SHIM_ESP_IDF_VERSION_H
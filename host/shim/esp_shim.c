@@ -0,0 +1,225 @@
+// ESP-IDF services of the host shim: error names, log, one shot timers and NVS in memory.
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "shim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TIMER_MAX_COUNT         8
+
+#define NVS_MAX_ENTRIES         8
+#define NVS_MAX_NAME            16
+#define NVS_MAX_BLOB            64
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    int64_t deadline_ns;
+    bool armed;
+    bool used;
+};
+
+typedef struct {
+    char namespace_name[NVS_MAX_NAME];
+    char key[NVS_MAX_NAME];
+    uint8_t blob[NVS_MAX_BLOB];
+    size_t length;
+    bool used;
+} nvs_entry_t;
+
+static esp_log_level_t _log_level = ESP_LOG_WARN;
+
+static struct esp_timer _timers[TIMER_MAX_COUNT];    // Never freed, a deleted timer may still have an event
+
+static nvs_entry_t _entries[NVS_MAX_ENTRIES];
+static const char *_namespaces[NVS_MAX_ENTRIES];   // Index + 1 is the handle
+static int _namespace_count;
+
+///////////////////////////////////////////////////////////////////////////////
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch(code) {
+        case ESP_OK:                    return "ESP_OK";
+        case ESP_FAIL:                  return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:       return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:     return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:      return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:         return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:     return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:           return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:  return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_NVS_NOT_FOUND:     return "ESP_ERR_NVS_NOT_FOUND";
+        default:                        return "UNKNOWN ERROR";
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// The level is the same for every tag
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    (void)tag;
+    _log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    static const char letters[] = "NEWIDV";
+    va_list args;
+
+    if(level > _log_level) {
+        return;
+    }
+
+    fprintf(stderr, "%c (%.3f) %s: ", letters[level], shim_now_ns() / 1e6, tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Events of a stopped or restarted timer find it disarmed or before its deadline
+static void timer_event(void *args) {
+    struct esp_timer *timer = args;
+
+    if(timer->armed && shim_now_ns() >= timer->deadline_ns) {
+        timer->armed = false;
+        timer->args.callback(timer->args.arg);
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    for(int i = 0; i < TIMER_MAX_COUNT; i++) {
+        if(!_timers[i].used) {
+            _timers[i] = (struct esp_timer){ .args = *create_args, .used = true };
+            *out_handle = &_timers[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if(timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->deadline_ns = shim_now_ns() + (int64_t)timeout_us * 1000;
+    timer->armed = true;
+    shim_at(timer->deadline_ns, timer_event, timer);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if(!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if(timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->used = false;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static nvs_entry_t *find_entry(nvs_handle handle, const char *key) {
+    for(int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if(_entries[i].used && strcmp(_entries[i].namespace_name, _namespaces[handle - 1]) == 0
+                && strcmp(_entries[i].key, key) == 0) {
+            return &_entries[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode open_mode, nvs_handle *out_handle) {
+    (void)open_mode;
+
+    if(strlen(name) >= NVS_MAX_NAME) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for(int i = 0; i < _namespace_count; i++) {
+        if(strcmp(_namespaces[i], name) == 0) {
+            *out_handle = i + 1;
+            return ESP_OK;
+        }
+    }
+    if(_namespace_count >= NVS_MAX_ENTRIES) {
+        return ESP_ERR_NO_MEM;
+    }
+    _namespaces[_namespace_count++] = name;
+    *out_handle = _namespace_count;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle handle) {
+    (void)handle;
+}
+
+esp_err_t nvs_get_blob(nvs_handle handle, const char *key, void *out_value, size_t *length) {
+    nvs_entry_t *entry = find_entry(handle, key);
+    if(entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if(out_value != NULL) {
+        if(*length < entry->length) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(out_value, entry->blob, entry->length);
+    }
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle handle, const char *key, const void *value, size_t length) {
+    nvs_entry_t *entry = find_entry(handle, key);
+
+    if(length > NVS_MAX_BLOB || strlen(key) >= NVS_MAX_NAME) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for(int i = 0; entry == NULL && i < NVS_MAX_ENTRIES; i++) {
+        if(!_entries[i].used) {
+            entry = &_entries[i];
+            entry->used = true;
+            strcpy(entry->namespace_name, _namespaces[handle - 1]);
+            strcpy(entry->key, key);
+        }
+    }
+    if(entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memcpy(entry->blob, value, length);
+    entry->length = length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle handle, const char *key) {
+    nvs_entry_t *entry = find_entry(handle, key);
+    if(entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle handle) {
+    (void)handle;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,11 @@
+#ifndef SHIM_ESP_SYSTEM_H
+#define SHIM_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+// Used by the app_tools.h log macros, no heap accounting on the host
+static inline uint32_t esp_get_free_heap_size(void) {
+    return 0;
+}
+
+#endif // SHIM_ESP_SYSTEM_H
@@ -0,0 +1,45 @@
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Host shim of FreeRTOS: tasks are threads of a discrete event simulation. Code runs
+// in zero simulated time, the clock only moves when every task is blocked (delay,
+// queue, semaphore, notification or simulated bus transfer). Priorities and cores
+// are ignored. See freertos_shim.c.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+
+#define portMAX_DELAY           ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS      10      // CONFIG_FREERTOS_HZ=100
+#define portTICK_RATE_MS        portTICK_PERIOD_MS
+#define configMAX_PRIORITIES    25
+
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms) / portTICK_PERIOD_MS)
+
+// Critical sections: one host mutex for every portMUX
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+void shim_enter_critical(portMUX_TYPE *mux);
+void shim_exit_critical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux)         shim_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)          shim_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux)     shim_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      shim_exit_critical(mux)
+#define portYIELD_FROM_ISR()
+
+#endif // SHIM_FREERTOS_H
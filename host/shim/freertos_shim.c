@@ -0,0 +1,606 @@
+// Discrete event FreeRTOS on host threads.
+//
+// Every task is a thread, one of them runs at a time: the highest priority ready
+// task, in the order they got ready, runs until it blocks on the shim (no preemption,
+// code takes no time). When no task is ready, the clock jumps to the next deadline
+// (delay, timeout, shim_at() event) and the tasks due get ready. Any change of a
+// queue, semaphore or notification readies every blocked task, each one checks
+// again what it waits for. Runs are reproducible.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "shim.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef enum {
+    TASK_READY,
+    TASK_RUNNING,
+    TASK_BLOCKED,
+    TASK_EXITED,
+} task_state_t;
+
+struct shim_task {
+    pthread_t thread;
+    pthread_cond_t cond;        // Signaled when the task runs
+    const char *name;
+    TaskFunction_t function;
+    void *params;
+    UBaseType_t priority;
+    task_state_t state;
+    uint64_t ready_order;
+    int64_t wake_ns;            // Deadline while blocked, -1 for none
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+typedef enum {
+    QUEUE_ITEMS,
+    QUEUE_SEMAPHORE,
+    QUEUE_RECURSIVE_MUTEX,
+} queue_kind_t;
+
+struct shim_queue {
+    queue_kind_t kind;
+    size_t length;
+    size_t item_size;
+    size_t count;
+    size_t head;
+    uint8_t *items;
+    struct shim_task *owner;    // Recursive mutex
+    uint32_t depth;
+};
+
+typedef struct {
+    int64_t when_ns;
+    shim_event_t event;
+    void *args;
+} event_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static pthread_mutex_t _mutex;          // Recursive, scheduler, queues and notifications
+static pthread_mutex_t _critical;       // Recursive, every portMUX
+static pthread_once_t _once = PTHREAD_ONCE_INIT;
+
+static struct shim_task _tasks[SHIM_MAX_TASKS];
+static int _task_count;
+static uint64_t _ready_order;
+static int64_t _now_ns;                 // Atomic, also read out of the lock
+
+static event_t _events[SHIM_MAX_EVENTS];    // Sorted by time
+static int _event_count;
+
+static __thread struct shim_task *_self;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void init_once() {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&_mutex, &attr);
+    pthread_mutex_init(&_critical, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static void lock() {
+    pthread_once(&_once, init_once);
+    pthread_mutex_lock(&_mutex);
+}
+
+static void unlock() {
+    pthread_mutex_unlock(&_mutex);
+}
+
+static int64_t now_ns() {
+    return __atomic_load_n(&_now_ns, __ATOMIC_SEQ_CST);
+}
+
+static void make_ready(struct shim_task *task) {
+    task->state = TASK_READY;
+    task->wake_ns = -1;
+    task->ready_order = _ready_order++;
+}
+
+// Under the lock
+static struct shim_task *new_task(const char *name, UBaseType_t priority) {
+    if(_task_count >= SHIM_MAX_TASKS) {
+        return NULL;
+    }
+
+    struct shim_task *task = &_tasks[_task_count++];
+    memset(task, 0, sizeof(struct shim_task));
+    pthread_cond_init(&task->cond, NULL);
+    task->name = name;
+    task->priority = priority;
+    make_ready(task);
+    return task;
+}
+
+// The first thread calling the shim (main) is a running task
+static struct shim_task *self_task() {
+    if(_self == NULL) {
+        lock();
+        _self = new_task("main", 1);
+        if(_self != NULL) {
+            _self->state = TASK_RUNNING;
+        }
+        unlock();
+        if(_self == NULL) {
+            fprintf(stderr, "Too many simulated tasks!\n");
+            exit(3);
+        }
+    }
+    return _self;
+}
+
+static void wake_all() {
+    for(int i = 0; i < _task_count; i++) {
+        if(_tasks[i].state == TASK_BLOCKED) {
+            make_ready(&_tasks[i]);
+        }
+    }
+}
+
+static struct shim_task *next_ready() {
+    struct shim_task *next = NULL;
+
+    for(int i = 0; i < _task_count; i++) {
+        struct shim_task *task = &_tasks[i];
+        if(task->state != TASK_READY) {
+            continue;
+        }
+        if(next == NULL || task->priority > next->priority
+                || (task->priority == next->priority && task->ready_order < next->ready_order)) {
+            next = task;
+        }
+    }
+    return next;
+}
+
+// No task ready: move the clock to the next deadline
+static void advance() {
+    int64_t next = INT64_MAX;
+
+    for(int i = 0; i < _task_count; i++) {
+        if(_tasks[i].state == TASK_BLOCKED && _tasks[i].wake_ns >= 0 && _tasks[i].wake_ns < next) {
+            next = _tasks[i].wake_ns;
+        }
+    }
+    if(_event_count > 0 && _events[0].when_ns < next) {
+        next = _events[0].when_ns;
+    }
+    if(next == INT64_MAX) {
+        fprintf(stderr, "Simulation deadlock at %lldus: every task waits forever!\n", (long long)(now_ns() / 1000));
+        exit(3);
+    }
+    if(next > now_ns()) {
+        __atomic_store_n(&_now_ns, next, __ATOMIC_SEQ_CST);
+    }
+
+    while(_event_count > 0 && _events[0].when_ns <= now_ns()) {
+        event_t event = _events[0];
+        _event_count--;
+        memmove(&_events[0], &_events[1], _event_count * sizeof(event_t));
+        event.event(event.args);
+    }
+
+    for(int i = 0; i < _task_count; i++) {
+        struct shim_task *task = &_tasks[i];
+        if(task->state == TASK_BLOCKED && task->wake_ns >= 0 && task->wake_ns <= now_ns()) {
+            make_ready(task);
+        }
+    }
+}
+
+// Under the lock, the calling task (not running any more) gives the CPU, then waits
+// until it runs again, self is NULL for an exiting task.
+static void schedule(struct shim_task *self) {
+    struct shim_task *next;
+
+    while((next = next_ready()) == NULL) {
+        advance();
+    }
+    next->state = TASK_RUNNING;
+    pthread_cond_signal(&next->cond);
+
+    while(self != NULL && self->state != TASK_RUNNING) {
+        pthread_cond_wait(&self->cond, &_mutex);
+    }
+}
+
+// Under the lock, until readied (deadline or any change)
+static void block(struct shim_task *task, int64_t wake_ns) {
+    task->state = TASK_BLOCKED;
+    task->wake_ns = wake_ns;
+    schedule(task);
+}
+
+// Under the lock
+static void sleep_until(int64_t wake_ns) {
+    struct shim_task *self = self_task();
+    while(now_ns() < wake_ns) {
+        block(self, wake_ns);
+    }
+}
+
+// Under the lock, false on timeout
+static bool wait_for(bool (*ready)(void *), void *args, TickType_t ticks) {
+    struct shim_task *self = self_task();
+    int64_t deadline = ticks == portMAX_DELAY ? -1 : now_ns() + ticks * SHIM_TICK_NS;
+
+    while(!ready(args)) {
+        if(ticks == 0 || (deadline >= 0 && now_ns() >= deadline)) {
+            return false;
+        }
+        block(self, deadline);
+    }
+    return true;
+}
+
+static void *task_entry(void *args) {
+    struct shim_task *task = args;
+    _self = task;
+
+    lock();
+    while(task->state != TASK_RUNNING) {
+        pthread_cond_wait(&task->cond, &_mutex);
+    }
+    unlock();
+
+    task->function(task->params);
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int64_t shim_now_ns(void) {
+    return now_ns();
+}
+
+void shim_run_ns(int64_t ns) {
+    __atomic_add_fetch(&_now_ns, ns, __ATOMIC_SEQ_CST);
+}
+
+void shim_sleep_ns(int64_t ns) {
+    lock();
+    sleep_until(now_ns() + ns);
+    unlock();
+}
+
+void shim_at(int64_t when_ns, shim_event_t event, void *args) {
+    lock();
+    if(_event_count >= SHIM_MAX_EVENTS) {
+        fprintf(stderr, "Too many simulated events!\n");
+        exit(3);
+    }
+
+    // After the events of the same time, in order
+    int i = _event_count;
+    while(i > 0 && _events[i - 1].when_ns > when_ns) {
+        i--;
+    }
+    memmove(&_events[i + 1], &_events[i], (_event_count - i) * sizeof(event_t));
+    _events[i] = (event_t){ when_ns, event, args };
+    _event_count++;
+    unlock();
+}
+
+int64_t esp_timer_get_time(void) {
+    return __atomic_add_fetch(&_now_ns, SHIM_TIMER_CALL_NS, __ATOMIC_SEQ_CST) / 1000;
+}
+
+void shim_enter_critical(portMUX_TYPE *mux) {
+    (void)mux;
+    pthread_once(&_once, init_once);
+    pthread_mutex_lock(&_critical);
+}
+
+void shim_exit_critical(portMUX_TYPE *mux) {
+    (void)mux;
+    pthread_mutex_unlock(&_critical);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack,
+        void *params, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    (void)stack;
+    (void)core;
+
+    self_task();
+    lock();
+    struct shim_task *task = new_task(name, priority);
+    if(task != NULL) {
+        task->function = function;
+        task->params = params;
+        if(handle != NULL) {
+            *handle = task;
+        }
+        if(pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+            task->state = TASK_EXITED;
+            task = NULL;
+        } else {
+            pthread_detach(task->thread);
+        }
+    }
+    unlock();
+    return task != NULL ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack,
+        void *params, UBaseType_t priority, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(function, name, stack, params, priority, handle, 0);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if(task != NULL && task != _self) {
+        fprintf(stderr, "vTaskDelete() of another task is not simulated!\n");
+        return;
+    }
+
+    struct shim_task *self = self_task();
+    lock();
+    self->state = TASK_EXITED;
+    schedule(NULL);
+    unlock();
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return self_task();
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(now_ns() / SHIM_TICK_NS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if(ticks == 0) {
+        return;
+    }
+
+    lock();
+    sleep_until(((int64_t)xTaskGetTickCount() + ticks) * SHIM_TICK_NS);
+    unlock();
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period) {
+    *previous_wake += period;
+
+    lock();
+    sleep_until((int64_t)*previous_wake * SHIM_TICK_NS);
+    unlock();
+}
+
+static BaseType_t notify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t result = pdPASS;
+
+    lock();
+    switch(action) {
+        case eNoAction:
+            break;
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithoutOverwrite:
+            if(task->notify_pending) {
+                result = pdFAIL;
+                break;
+            }
+            // Fall through
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+    }
+    task->notify_pending = true;
+    wake_all();
+    unlock();
+    return result;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    return notify(task, value, action);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken) {
+    if(woken != NULL) {
+        *woken = pdFALSE;
+    }
+    return notify(task, value, action);
+}
+
+static bool notify_ready(void *args) {
+    return ((struct shim_task *)args)->notify_pending;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks) {
+    struct shim_task *self = self_task();
+    BaseType_t result = pdFALSE;
+
+    lock();
+    if(!self->notify_pending) {
+        self->notify_value &= ~clear_on_entry;
+    }
+    if(wait_for(notify_ready, self, ticks)) {
+        if(value != NULL) {
+            *value = self->notify_value;
+        }
+        self->notify_value &= ~clear_on_exit;
+        self->notify_pending = false;
+        result = pdTRUE;
+    }
+    unlock();
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static QueueHandle_t create_queue(queue_kind_t kind, size_t length, size_t item_size, size_t count) {
+    QueueHandle_t queue = calloc(1, sizeof(struct shim_queue));
+    if(queue == NULL) {
+        return NULL;
+    }
+
+    queue->kind = kind;
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->count = count;
+    if(item_size > 0) {
+        queue->items = calloc(length, item_size);
+        if(queue->items == NULL) {
+            free(queue);
+            return NULL;
+        }
+    }
+    return queue;
+}
+
+static bool not_full(void *args) {
+    QueueHandle_t queue = args;
+    return queue->count < queue->length;
+}
+
+static bool not_empty(void *args) {
+    QueueHandle_t queue = args;
+    return queue->count > 0;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    return create_queue(QUEUE_ITEMS, length, item_size, 0);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if(queue != NULL) {
+        free(queue->items);
+        free(queue);
+    }
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    BaseType_t result = pdFALSE;
+
+    lock();
+    if(wait_for(not_full, queue, ticks)) {
+        if(queue->item_size > 0) {
+            size_t tail = (queue->head + queue->count) % queue->length;
+            memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        }
+        queue->count++;
+        wake_all();
+        result = pdTRUE;
+    }
+    unlock();
+    return result;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *woken) {
+    if(woken != NULL) {
+        *woken = pdFALSE;
+    }
+    return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    BaseType_t result = pdFALSE;
+
+    lock();
+    if(wait_for(not_empty, queue, ticks)) {
+        if(queue->item_size > 0) {
+            memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+            queue->head = (queue->head + 1) % queue->length;
+        }
+        queue->count--;
+        wake_all();
+        result = pdTRUE;
+    }
+    unlock();
+    return result;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    lock();
+    UBaseType_t count = queue->count;
+    unlock();
+    return count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return create_queue(QUEUE_SEMAPHORE, 1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    return create_queue(QUEUE_SEMAPHORE, max, 0, initial);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return create_queue(QUEUE_SEMAPHORE, 1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return create_queue(QUEUE_RECURSIVE_MUTEX, 1, 0, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return xQueueReceive(semaphore, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, NULL, 0);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *woken) {
+    return xQueueSendFromISR(semaphore, NULL, woken);
+}
+
+static bool mutex_free(void *args) {
+    SemaphoreHandle_t mutex = args;
+    return mutex->owner == NULL || mutex->owner == _self;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks) {
+    BaseType_t result = pdFALSE;
+
+    self_task();
+    lock();
+    if(wait_for(mutex_free, mutex, ticks)) {
+        mutex->owner = _self;
+        mutex->depth++;
+        result = pdTRUE;
+    }
+    unlock();
+    return result;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex) {
+    BaseType_t result = pdFALSE;
+
+    lock();
+    if(mutex->owner == _self && mutex->depth > 0) {
+        if(--mutex->depth == 0) {
+            mutex->owner = NULL;
+            wake_all();
+        }
+        result = pdTRUE;
+    }
+    unlock();
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
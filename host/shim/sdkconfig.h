@@ -0,0 +1,6 @@
+#ifndef SHIM_SDKCONFIG_H
+#define SHIM_SDKCONFIG_H
+
+// No menuconfig option used by the simulated modules
+
+#endif // SHIM_SDKCONFIG_H
@@ -0,0 +1,36 @@
+#ifndef SHIM_H
+#define SHIM_H
+
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Simulated clock of the host shim, shared by FreeRTOS, esp_timer and the
+// simulated bus. Times in ns.
+
+#define SHIM_TICK_NS            ((int64_t)portTICK_PERIOD_MS * 1000000)
+#define SHIM_TIMER_CALL_NS      500     // esp_timer_get_time() on the ESP32
+#define SHIM_MAX_TASKS          16
+#define SHIM_MAX_EVENTS         1024
+
+typedef void (*shim_event_t)(void *args);
+
+///////////////////////////////////////////////////////////////////////////////
+
+int64_t shim_now_ns(void);
+
+// The calling task runs for ns, the clock moves at once (no other task runs meanwhile).
+void shim_run_ns(int64_t ns);
+
+// The calling task blocks for ns, the other tasks run meanwhile.
+void shim_sleep_ns(int64_t ns);
+
+// Called once the clock reaches when_ns, while every task is blocked. The event may
+// change the simulated hardware and wake tasks (ISR), it must not block.
+void shim_at(int64_t when_ns, shim_event_t event, void *args);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // SHIM_H
@@ -0,0 +1,316 @@
+// Host test of the debounce engine: debounce.c
+//
+// Synthetic bounce traces (port samples with their time) are replayed as the input
+// task does: each sample is given to dbnc_update(), and the port is sampled again at
+// dbnc_next_deadline() when nothing changes before, as the debounce timer does.
+// Checked for eager and non-eager inputs: one edge per press and per release, the
+// edge timestamp is its first sample, the time the edge is reported, and the
+// deadline given while an edge is pending.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debounce.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define HOOK                    0x0001  // Eager, as phonetastic_app.c
+#define JACK                    0x0002
+#define HOOK_STABLE_US          20000
+#define JACK_STABLE_US          5000
+#define MAX_SAMPLES             8192
+#define MAX_EDGES               1024
+#define RANDOM_CHANGES          400     // Presses and releases of each input
+#define BOUNCE_MAX              6       // Bounces of a press or a release
+#define HOOK_BOUNCE_GAP_MAX_US  1500    // Between two bounces, all within HOOK_STABLE_US
+#define JACK_BOUNCE_GAP_MAX_US  3000    // Between two bounces, under JACK_STABLE_US
+
+typedef struct {
+    int64_t time_us;
+    uint16_t raw;
+} sample_t;
+
+typedef struct {
+    int64_t reported_us;    // dbnc_update() call that gave the edge
+    int64_t timestamp_us;
+    uint16_t input;
+    bool rising;
+} edge_t;
+
+typedef struct {
+    sample_t samples[MAX_SAMPLES];
+    size_t sample_count;
+    edge_t edges[MAX_EDGES];
+    size_t edge_count;
+} trace_t;
+
+static int _failures;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CHECK(cond, ...) do {                   \
+    if(!(cond)) {                               \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        _failures++;                            \
+    }                                           \
+} while(0)
+
+static void init(dbnc_t *dbnc) {
+    dbnc_cfg_t cfg;
+
+    dbnc_cfg_default(&cfg, DBNC_STABLE_US);
+    dbnc_cfg_set_stable_time(&cfg, HOOK, HOOK_STABLE_US);
+    dbnc_cfg_set_stable_time(&cfg, JACK, JACK_STABLE_US);
+    cfg.eager = HOOK;
+    dbnc_init(dbnc, &cfg);
+}
+
+static void add_sample(trace_t *trace, int64_t time_us, uint16_t raw) {
+    if(trace->sample_count < MAX_SAMPLES) {
+        trace->samples[trace->sample_count++] = (sample_t){ time_us, raw };
+    }
+}
+
+static void update(dbnc_t *dbnc, trace_t *trace, uint16_t raw, int64_t now_us) {
+    dbnc_edges_t edges;
+
+    if(!dbnc_update(dbnc, raw, now_us, &edges)) {
+        return;
+    }
+    for(uint16_t m = edges.rising | edges.falling; m != 0; m &= m - 1) {
+        int b = __builtin_ctz(m);
+        if(trace->edge_count < MAX_EDGES) {
+            trace->edges[trace->edge_count++] = (edge_t){
+                now_us, edges.timestamp_us[b], 1u << b, (edges.rising >> b) & 1 };
+        }
+    }
+}
+
+// Deadlines up to until_us, as the debounce timer
+static void poll(dbnc_t *dbnc, trace_t *trace, int64_t until_us) {
+    int64_t deadline;
+
+    while((deadline = dbnc_next_deadline(dbnc)) <= until_us) {
+        update(dbnc, trace, dbnc->raw, deadline);
+    }
+}
+
+static void replay(dbnc_t *dbnc, trace_t *trace) {
+    trace->edge_count = 0;
+    for(size_t i = 0; i < trace->sample_count; i++) {
+        poll(dbnc, trace, trace->samples[i].time_us - 1);
+        update(dbnc, trace, trace->samples[i].raw, trace->samples[i].time_us);
+    }
+    poll(dbnc, trace, INT64_MAX - 1);
+}
+
+static void check_edge(const trace_t *trace, size_t index, uint16_t input, bool rising,
+        int64_t timestamp_us, int64_t reported_us) {
+
+    if(index >= trace->edge_count) {
+        CHECK(false, "Edge %zu missing", index);
+        return;
+    }
+
+    const edge_t *edge = &trace->edges[index];
+    CHECK(edge->input == input && edge->rising == rising, "Edge %zu: input %#x %s, expected %#x %s",
+        index, edge->input, edge->rising ? "rising" : "falling", input, rising ? "rising" : "falling");
+    CHECK(edge->timestamp_us == timestamp_us, "Edge %zu: timestamp %lld, expected %lld",
+        index, (long long)edge->timestamp_us, (long long)timestamp_us);
+    CHECK(edge->reported_us == reported_us, "Edge %zu: reported at %lld, expected %lld",
+        index, (long long)edge->reported_us, (long long)reported_us);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Jack contact: the edge waits for JACK_STABLE_US without a change
+static void test_non_eager() {
+    static trace_t trace;
+    dbnc_t dbnc;
+    dbnc_edges_t edges;
+
+    init(&dbnc);
+    CHECK(dbnc_next_deadline(&dbnc) == INT64_MAX, "Deadline before any sample");
+
+    // Press, bounces until 3000
+    CHECK(!dbnc_update(&dbnc, JACK, 1000, &edges), "Jack press: edge on the first sample");
+    CHECK(dbnc_next_deadline(&dbnc) == 1000 + JACK_STABLE_US, "Jack press: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+    dbnc_update(&dbnc, 0, 1300, &edges);
+    CHECK(dbnc_next_deadline(&dbnc) == INT64_MAX, "Jack bounce back: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+    dbnc_update(&dbnc, JACK, 1700, &edges);
+    dbnc_update(&dbnc, 0, 2500, &edges);
+    dbnc_update(&dbnc, JACK, 3000, &edges);
+    CHECK(dbnc_next_deadline(&dbnc) == 3000 + JACK_STABLE_US, "Jack last bounce: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+    CHECK(!dbnc_update(&dbnc, JACK, 3000 + JACK_STABLE_US - 1, &edges), "Jack press: edge before the deadline");
+    CHECK(dbnc_update(&dbnc, JACK, 3000 + JACK_STABLE_US, &edges) && edges.rising == JACK && edges.falling == 0,
+        "Jack press: no rising edge at the deadline");
+    CHECK(edges.timestamp_us[1] == 1000, "Jack press: timestamp %lld", (long long)edges.timestamp_us[1]);
+    CHECK(edges.state == JACK, "Jack press: state %#x", edges.state);
+    CHECK(dbnc_next_deadline(&dbnc) == INT64_MAX, "Jack pressed: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+
+    // Replayed: press then release, each with bounces
+    init(&dbnc);
+    trace.sample_count = 0;
+    add_sample(&trace, 1000, JACK);
+    add_sample(&trace, 1300, 0);
+    add_sample(&trace, 1700, JACK);
+    add_sample(&trace, 100000, 0);
+    add_sample(&trace, 100200, JACK);
+    add_sample(&trace, 101000, 0);
+    replay(&dbnc, &trace);
+    CHECK(trace.edge_count == 2, "Jack press and release: %zu edges", trace.edge_count);
+    check_edge(&trace, 0, JACK, true, 1000, 1700 + JACK_STABLE_US);
+    check_edge(&trace, 1, JACK, false, 100000, 101000 + JACK_STABLE_US);
+
+    // Glitch shorter than the bounces: no edge at all
+    init(&dbnc);
+    trace.sample_count = 0;
+    add_sample(&trace, 1000, JACK);
+    add_sample(&trace, 1100, 0);
+    replay(&dbnc, &trace);
+    CHECK(trace.edge_count == 0, "Jack glitch: %zu edges", trace.edge_count);
+}
+
+// Hook: the first sample is the edge, then changes are ignored for HOOK_STABLE_US
+static void test_eager() {
+    static trace_t trace;
+    dbnc_t dbnc;
+    dbnc_edges_t edges;
+
+    init(&dbnc);
+    CHECK(dbnc_update(&dbnc, HOOK, 1000, &edges) && edges.rising == HOOK, "Hook lift: no edge on the first sample");
+    CHECK(edges.timestamp_us[0] == 1000, "Hook lift: timestamp %lld", (long long)edges.timestamp_us[0]);
+    CHECK(dbnc_next_deadline(&dbnc) == INT64_MAX, "Hook lifted: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+    CHECK(!dbnc_update(&dbnc, 0, 1300, &edges), "Hook bounce: edge");
+    CHECK(dbnc_next_deadline(&dbnc) == 1000 + HOOK_STABLE_US, "Hook bounce: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+    CHECK(!dbnc_update(&dbnc, HOOK, 1700, &edges), "Hook bounce back: edge");
+    CHECK(dbnc_next_deadline(&dbnc) == INT64_MAX, "Hook bounce back: deadline %lld",
+        (long long)dbnc_next_deadline(&dbnc));
+
+    // Hung up after the hold: at once, timestamp of its first sample
+    init(&dbnc);
+    trace.sample_count = 0;
+    add_sample(&trace, 1000, HOOK);
+    add_sample(&trace, 1300, 0);
+    add_sample(&trace, 1700, HOOK);
+    add_sample(&trace, 200000, 0);
+    add_sample(&trace, 200400, HOOK);
+    add_sample(&trace, 200900, 0);
+    replay(&dbnc, &trace);
+    CHECK(trace.edge_count == 2, "Hook lift and hang up: %zu edges", trace.edge_count);
+    check_edge(&trace, 0, HOOK, true, 1000, 1000);
+    check_edge(&trace, 1, HOOK, false, 200000, 200000);
+
+    // Hung up during the hold: reported at its end, timestamp of the first sample away
+    init(&dbnc);
+    trace.sample_count = 0;
+    add_sample(&trace, 1000, HOOK);
+    add_sample(&trace, 1300, 0);
+    add_sample(&trace, 1700, HOOK);
+    add_sample(&trace, 5000, 0);
+    replay(&dbnc, &trace);
+    CHECK(trace.edge_count == 2, "Hook short lift: %zu edges", trace.edge_count);
+    check_edge(&trace, 0, HOOK, true, 1000, 1000);
+    check_edge(&trace, 1, HOOK, false, 1300, 1000 + HOOK_STABLE_US);
+}
+
+static int64_t random_between(int64_t min, int64_t max) {
+    return min + rand() % (max - min + 1);
+}
+
+typedef struct {
+    int64_t time_us;
+    uint16_t input;
+} toggle_t;
+
+static int compare_toggles(const void *a, const void *b) {
+    const toggle_t *x = a;
+    const toggle_t *y = b;
+    return (x->time_us > y->time_us) - (x->time_us < y->time_us);
+}
+
+// Presses and releases of both inputs with random bounces, overlapping in time
+static void test_random_traces() {
+    static const uint16_t inputs[2] = { HOOK, JACK };
+    static const int64_t gap_max_us[2] = { HOOK_BOUNCE_GAP_MAX_US, JACK_BOUNCE_GAP_MAX_US };
+    static const char *names[2] = { "hook", "jack" };
+    static trace_t trace;
+    static toggle_t toggles[MAX_SAMPLES];
+    static int64_t first_us[2][RANDOM_CHANGES];
+    static int64_t last_us[2][RANDOM_CHANGES];
+    size_t toggle_count = 0;
+    dbnc_t dbnc;
+
+    srand(1);
+
+    // Odd toggle count, each change ends on the new level
+    int64_t now = 10000;
+    for(int c = 0; c < RANDOM_CHANGES; c++) {
+        for(int i = 0; i < 2; i++) {
+            int64_t time = now + random_between(0, 500);
+            int count = 1 + 2 * (rand() % (BOUNCE_MAX + 1));
+
+            first_us[i][c] = time;
+            for(int t = 0; t < count && toggle_count < MAX_SAMPLES; t++) {
+                toggles[toggle_count++] = (toggle_t){ time, inputs[i] };
+                last_us[i][c] = time;
+                time += random_between(50, gap_max_us[i]);
+            }
+        }
+        now += 2 * (2 * BOUNCE_MAX * JACK_BOUNCE_GAP_MAX_US + HOOK_STABLE_US) + random_between(0, 10000);
+    }
+
+    qsort(toggles, toggle_count, sizeof(toggle_t), compare_toggles);
+    trace.sample_count = 0;
+    uint16_t raw = 0;
+    for(size_t t = 0; t < toggle_count; t++) {
+        raw ^= toggles[t].input;
+        add_sample(&trace, toggles[t].time_us, raw);
+    }
+
+    init(&dbnc);
+    replay(&dbnc, &trace);
+
+    size_t counts[2] = { 0, 0 };
+    for(size_t e = 0; e < trace.edge_count; e++) {
+        const edge_t *edge = &trace.edges[e];
+        int i = edge->input == HOOK ? 0 : 1;
+        size_t c = counts[i]++;
+
+        if(c >= RANDOM_CHANGES) {
+            CHECK(false, "Random %s: extra edge at %lld", names[i], (long long)edge->reported_us);
+            continue;
+        }
+        int64_t reported = i == 0 ? first_us[i][c] : last_us[i][c] + JACK_STABLE_US;
+        CHECK(edge->rising == (c % 2 == 0), "Random %s change %zu: wrong direction", names[i], c);
+        CHECK(edge->timestamp_us == first_us[i][c], "Random %s change %zu: timestamp %lld, expected %lld",
+            names[i], c, (long long)edge->timestamp_us, (long long)first_us[i][c]);
+        CHECK(edge->reported_us == reported, "Random %s change %zu: reported at %lld, expected %lld",
+            names[i], c, (long long)edge->reported_us, (long long)reported);
+    }
+    CHECK(counts[0] == RANDOM_CHANGES && counts[1] == RANDOM_CHANGES,
+        "Random traces: %zu hook and %zu jack edges, expected %i each", counts[0], counts[1], RANDOM_CHANGES);
+    printf("Random traces: %zu samples, %zu edges\n", trace.sample_count, trace.edge_count);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    test_non_eager();
+    test_eager();
+    test_random_traces();
+
+    printf("Debounce: %i failures\n", _failures);
+    return _failures > 0 ? 1 : 0;
+}
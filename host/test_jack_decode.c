@@ -0,0 +1,271 @@
+// Host test of the jack matrix decode: jack_decode.c
+//
+// Contact patterns are plugged on a simulated diodeless board: a driven column
+// reaches every line connected to it, directly or through other plugged contacts.
+// The GP pairs read on each expander are built from that, with the pins that are
+// not lines set to noise, then decoded column by column as jack_matrix.c does.
+// Maps spread the columns and the lines over several expanders. Checked: the map
+// validation (reserved pins such as the hook switch included) and plan, the decoded bitmaps, and that every phantom contact of a
+// rectangle is flagged by jkmx_find_ghosts().
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jack_decode.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define RANDOM_PATTERNS         20000
+#define NOISE                   0xA5A5  // Pins that are not lines, must not be decoded
+
+// 16x16 board: columns 0..7 on GP1 of 0x20, 8..15 on GP0 of 0x22,
+// lines 0..7 on GP0 of 0x21 and 8..15 on GP1 of 0x23
+static void build_wide_map(jkmx_map_t *map) {
+    memset(map, 0, sizeof(jkmx_map_t));
+    map->column_count = JKMX_MAX_COLUMNS;
+    map->line_count = JKMX_MAX_LINES;
+
+    for(int i = 0; i < 8; i++) {
+        map->columns[i] = (jkmx_pin_t)JKMX_PIN(0, 1, 7 - i);
+        map->columns[i + 8] = (jkmx_pin_t)JKMX_PIN(2, 0, i);
+        map->lines[i] = (jkmx_pin_t)JKMX_PIN(1, 0, i);
+        map->lines[i + 8] = (jkmx_pin_t)JKMX_PIN(3, 1, i);
+    }
+}
+
+static int _failures;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CHECK(cond, ...) do {                   \
+    if(!(cond)) {                               \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        _failures++;                            \
+    }                                           \
+} while(0)
+
+static void set(jkmx_bitmap_t *bitmap, int column, int line) {
+    bitmap->columns[column] |= 1u << line;
+}
+
+// Lines reached from the driven column through the plugged contacts
+static uint16_t reached_lines(const jkmx_bitmap_t *plugged, int column_count, int driven) {
+    uint32_t columns = 1u << driven;
+    uint16_t lines = 0;
+    bool grown = true;
+
+    while(grown) {
+        grown = false;
+        for(int c = 0; c < column_count; c++) {
+            if(columns & (1u << c)) {
+                uint16_t more = plugged->columns[c] & ~lines;
+                lines |= more;
+                grown |= more != 0;
+            } else if(plugged->columns[c] & lines) {
+                columns |= 1u << c;
+                grown = true;
+            }
+        }
+    }
+    return lines;
+}
+
+// What jack_matrix.c decodes from the simulated board
+static void scan(const jkmx_map_t *map, const jkmx_bitmap_t *plugged, jkmx_bitmap_t *seen) {
+    memset(seen, 0, sizeof(jkmx_bitmap_t));
+
+    for(int c = 0; c < map->column_count; c++) {
+        uint16_t ports[JKMX_MAX_EXPANDERS];
+        uint16_t lines = reached_lines(plugged, map->column_count, c);
+
+        for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+            ports[e] = NOISE;
+        }
+        for(int l = 0; l < map->line_count; l++) {
+            const jkmx_pin_t *pin = &map->lines[l];
+            ports[pin->expander] &= ~(1u << pin->bit);
+            if(lines & (1u << l)) {
+                ports[pin->expander] |= 1u << pin->bit;
+            }
+        }
+        seen->columns[c] = jkmx_decode_lines(map, ports);
+    }
+}
+
+// Seen contacts that are not plugged must all be flagged
+static uint16_t unflagged_phantoms(const jkmx_bitmap_t *plugged, const jkmx_bitmap_t *seen,
+        const jkmx_bitmap_t *ghosts, int column_count, int *column) {
+
+    for(int c = 0; c < column_count; c++) {
+        uint16_t phantoms = seen->columns[c] & ~plugged->columns[c] & ~ghosts->columns[c];
+        if(phantoms != 0) {
+            *column = c;
+            return phantoms;
+        }
+    }
+    return 0;
+}
+
+static bool has_ghosts(const jkmx_bitmap_t *ghosts) {
+    for(int c = 0; c < JKMX_MAX_COLUMNS; c++) {
+        if(ghosts->columns[c] != 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void test_map() {
+    jkmx_map_t map = JKMX_MAP_DEFAULT();
+    jkmx_plan_t plan;
+
+    CHECK(jkmx_map_check(&map), "Default map rejected");
+    jkmx_map_plan(&map, &plan);
+    CHECK(plan.column_expanders == 0x01 && plan.line_expanders == 0x01, "Default map expanders %#x / %#x",
+        plan.column_expanders, plan.line_expanders);
+    CHECK(plan.iodir[0] == 0x1FFF, "Default map IODIR %#06x", plan.iodir[0]);
+    CHECK(plan.drive[0] == 0x8000 && plan.drive[1] == 0x4000 && plan.drive[2] == 0x2000,
+        "Default map drive %#06x %#06x %#06x", plan.drive[0], plan.drive[1], plan.drive[2]);
+
+    // GP0.0 is the hook switch, no line nor column on it
+    map.lines[0] = (jkmx_pin_t)JKMX_PIN(0, 0, 0);
+    CHECK(!jkmx_map_check(&map), "Line on the hook pin accepted");
+    map = (jkmx_map_t)JKMX_MAP_DEFAULT();
+    map.columns[2] = (jkmx_pin_t)JKMX_PIN(0, 0, 0);
+    CHECK(!jkmx_map_check(&map), "Column on the hook pin accepted");
+
+    build_wide_map(&map);
+    CHECK(jkmx_map_check(&map), "Wide map rejected");
+    jkmx_map_plan(&map, &plan);
+    CHECK(plan.column_expanders == 0x05 && plan.line_expanders == 0x0A, "Wide map expanders %#x / %#x",
+        plan.column_expanders, plan.line_expanders);
+    CHECK(plan.iodir[0] == 0x00FF && plan.iodir[2] == 0xFF00 && plan.iodir[1] == 0xFFFF,
+        "Wide map IODIR %#06x %#06x %#06x", plan.iodir[0], plan.iodir[1], plan.iodir[2]);
+
+    map.lines[3] = map.columns[5];
+    CHECK(!jkmx_map_check(&map), "Pin used twice accepted");
+    build_wide_map(&map);
+    map.columns[0].expander = JKMX_MAX_EXPANDERS;
+    CHECK(!jkmx_map_check(&map), "Expander out of range accepted");
+    build_wide_map(&map);
+    map.line_count = JKMX_MAX_LINES + 1;
+    CHECK(!jkmx_map_check(&map), "Too many lines accepted");
+    build_wide_map(&map);
+    map.reserved[3] = 1u << 15;
+    CHECK(!jkmx_map_check(&map), "Reserved pin accepted");
+}
+
+static void test_patterns() {
+    jkmx_map_t map;
+    jkmx_bitmap_t plugged, seen, ghosts;
+    int column = 0;
+
+    build_wide_map(&map);
+
+    // Nothing plugged
+    memset(&plugged, 0, sizeof(plugged));
+    scan(&map, &plugged, &seen);
+    CHECK(memcmp(&seen, &plugged, sizeof(seen)) == 0, "Empty board: contacts seen");
+
+    // Diagonal, one contact per column and line: no path between columns
+    for(int c = 0; c < JKMX_MAX_COLUMNS; c++) {
+        set(&plugged, c, (c * 5) % JKMX_MAX_LINES);
+    }
+    scan(&map, &plugged, &seen);
+    jkmx_find_ghosts(&seen, map.column_count, &ghosts);
+    CHECK(memcmp(&seen, &plugged, sizeof(seen)) == 0, "Diagonal: decoded bitmap differs");
+    CHECK(!has_ghosts(&ghosts), "Diagonal: ghosts flagged");
+
+    // A full column, lines on both line expanders, and a full line, columns on both column expanders
+    memset(&plugged, 0, sizeof(plugged));
+    plugged.columns[9] = 0xFFFF;
+    scan(&map, &plugged, &seen);
+    CHECK(memcmp(&seen, &plugged, sizeof(seen)) == 0, "Full column: decoded bitmap differs");
+    memset(&plugged, 0, sizeof(plugged));
+    for(int c = 0; c < JKMX_MAX_COLUMNS; c++) {
+        set(&plugged, c, 12);
+    }
+    scan(&map, &plugged, &seen);
+    jkmx_find_ghosts(&seen, map.column_count, &ghosts);
+    CHECK(memcmp(&seen, &plugged, sizeof(seen)) == 0, "Full line: decoded bitmap differs");
+    CHECK(!has_ghosts(&ghosts), "Full line: ghosts flagged");
+
+    // Rectangle across the 4 expanders: C2L3, C2L11 and C10L3 plugged show C10L11
+    memset(&plugged, 0, sizeof(plugged));
+    set(&plugged, 2, 3);
+    set(&plugged, 2, 11);
+    set(&plugged, 10, 3);
+    scan(&map, &plugged, &seen);
+    jkmx_find_ghosts(&seen, map.column_count, &ghosts);
+    CHECK(seen.columns[2] == 0x0808 && seen.columns[10] == 0x0808, "Rectangle: seen %#06x %#06x",
+        seen.columns[2], seen.columns[10]);
+    CHECK(ghosts.columns[2] == 0x0808 && ghosts.columns[10] == 0x0808, "Rectangle: ghosts %#06x %#06x",
+        ghosts.columns[2], ghosts.columns[10]);
+
+    // Chain C0L0, C8L0, C8L15, C15L15: a path over 3 contacts, every corner is reached
+    memset(&plugged, 0, sizeof(plugged));
+    set(&plugged, 0, 0);
+    set(&plugged, 8, 0);
+    set(&plugged, 8, 15);
+    set(&plugged, 15, 15);
+    scan(&map, &plugged, &seen);
+    jkmx_find_ghosts(&seen, map.column_count, &ghosts);
+    CHECK(seen.columns[0] == 0x8001 && seen.columns[8] == 0x8001 && seen.columns[15] == 0x8001,
+        "Chain: seen %#06x %#06x %#06x", seen.columns[0], seen.columns[8], seen.columns[15]);
+    uint16_t phantoms = unflagged_phantoms(&plugged, &seen, &ghosts, map.column_count, &column);
+    CHECK(phantoms == 0, "Chain: C%i phantoms %#06x not flagged", column + 1, phantoms);
+}
+
+// Sparse random boards, as many rectangles as plain patterns
+static void test_random_patterns() {
+    jkmx_map_t map;
+    jkmx_bitmap_t plugged, seen, ghosts;
+    int with_phantoms = 0;
+
+    build_wide_map(&map);
+    srand(1);
+
+    for(int i = 0; i < RANDOM_PATTERNS; i++) {
+        int contacts = 1 + rand() % 8;
+        int column = 0;
+
+        memset(&plugged, 0, sizeof(plugged));
+        for(int n = 0; n < contacts; n++) {
+            set(&plugged, rand() % map.column_count, rand() % map.line_count);
+        }
+        scan(&map, &plugged, &seen);
+        jkmx_find_ghosts(&seen, map.column_count, &ghosts);
+
+        bool exact = memcmp(&seen, &plugged, sizeof(seen)) == 0;
+        with_phantoms += !exact;
+
+        uint16_t phantoms = unflagged_phantoms(&plugged, &seen, &ghosts, map.column_count, &column);
+        CHECK(phantoms == 0, "Random pattern %i: C%i phantoms %#06x not flagged", i, column + 1, phantoms);
+        CHECK(exact || has_ghosts(&ghosts), "Random pattern %i: phantoms without ghosts", i);
+        for(int c = 0; c < map.column_count; c++) {
+            CHECK((seen.columns[c] & plugged.columns[c]) == plugged.columns[c],
+                "Random pattern %i: C%i plugged contact not seen", i, c + 1);
+        }
+    }
+
+    printf("Random patterns: %i, %i with phantom contacts\n", RANDOM_PATTERNS, with_phantoms);
+    CHECK(with_phantoms > 0, "Random patterns: no rectangle tried");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    test_map();
+    test_patterns();
+    test_random_patterns();
+
+    printf("Jack decode: %i failures\n", _failures);
+    return _failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+// Host test of the PCM routing of the channel router element: pcm_router.c
+//
+// Mono and stereo tracks are routed to the left, the right, both or no slot, block
+// by block as channel_router.c does: the source is read in odd sized chunks so that
+// incomplete frames are carried to the next block, and the on/off cadence limits
+// each read to the end of its phase. The first on phase is recorded and replayed by the
+// next ones, or resumed where it stopped without memory for it. The output is compared
+// frame by frame to the expected one, computed from the cadence in frames, so the gaps
+// must be sample exact and every burst must start at the beginning of the track.
+// The in place routing, the cadence accounting and the burst cache are also checked on
+// their own.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pcm_router.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define ROUTER_BUFFER_SIZE      1024    // CHANNEL_ROUTER_BUFFER_SIZE
+#define SAMPLE_RATE             8000
+#define TRACK_FRAMES            5003    // Not a multiple of any chunk or cadence
+#define CADENCE_ON_MS           70
+#define CADENCE_OFF_MS          45
+#define GATED_CYCLES            3       // Replayed bursts checked, the source is no longer read
+
+// Ringbuffer reads are not frame aligned
+static const size_t chunk_sizes[] = { 1, 3, 7, 37, 101, 255, 2 };
+#define CHUNK_COUNT             (sizeof(chunk_sizes) / sizeof(chunk_sizes[0]))
+
+static const pcm_route_t routes[] = { PCM_ROUTE_LEFT, PCM_ROUTE_RIGHT, PCM_ROUTE_BOTH, PCM_ROUTE_NONE };
+static const char *route_names[] = { "left", "right", "both", "none" };
+#define ROUTE_COUNT             (sizeof(routes) / sizeof(routes[0]))
+
+typedef struct {
+    const char *source;             // Decoded track
+    size_t source_len;
+    size_t read_pos;
+    size_t chunk;                   // Next entry of chunk_sizes
+    int channels;
+    pcm_route_t route;
+    int carry;
+    char carry_bytes[PCM_STEREO_FRAME_BYTES];
+    pcm_cadence_t cadence;
+    pcm_burst_t burst;
+    int16_t *out;                   // Stereo frames sent to i2s
+    size_t out_frames;
+    size_t out_max;
+} stream_t;
+
+static int _failures;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CHECK(cond, ...) do {                   \
+    if(!(cond)) {                               \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        _failures++;                            \
+    }                                           \
+} while(0)
+
+// Never 0, a muted slot is told apart from a routed sample
+static int16_t left_sample(size_t frame) {
+    return (int16_t)(1 + frame % 20000);
+}
+
+static int16_t right_sample(size_t frame) {
+    return (int16_t)-(1 + frame % 20000);
+}
+
+static size_t source_read(stream_t *stream, char *buffer, size_t len) {
+    size_t chunk = chunk_sizes[stream->chunk++ % CHUNK_COUNT];
+    size_t left = stream->source_len - stream->read_pos;
+
+    len = len < chunk ? len : chunk;
+    len = len < left ? len : left;
+    memcpy(buffer, stream->source + stream->read_pos, len);
+    stream->read_pos += len;
+    return len;
+}
+
+static void output(stream_t *stream, const char *buffer, uint32_t frame_count) {
+    if(stream->out_frames + frame_count > stream->out_max) {
+        CHECK(false, "Output overflow");
+        return;
+    }
+    memcpy(stream->out + 2 * stream->out_frames, buffer, frame_count * PCM_STEREO_FRAME_BYTES);
+    stream->out_frames += frame_count;
+}
+
+// Same block processing as _router_process() of channel_router.c, the track channels are known
+static int process(stream_t *stream, char *buffer, int in_len) {
+    if(!stream->cadence.on) {
+        uint32_t frame_count = pcmr_cadence_available(&stream->cadence, in_len / PCM_STEREO_FRAME_BYTES);
+        memset(buffer, 0, frame_count * PCM_STEREO_FRAME_BYTES);
+        pcmr_cadence_advance(&stream->cadence, frame_count);
+        output(stream, buffer, frame_count);
+        return frame_count * PCM_STEREO_FRAME_BYTES;
+    }
+
+    int frame_bytes = stream->channels * PCM_SAMPLE_BYTES;
+    if(pcmr_burst_ready(&stream->burst)) {
+        uint32_t frame_count = pcmr_cadence_available(&stream->cadence, in_len / PCM_STEREO_FRAME_BYTES);
+        pcmr_burst_replay(&stream->burst, pcmr_cadence_position(&stream->cadence) * frame_bytes, buffer,
+            frame_count * frame_bytes);
+        if(stream->channels == 1) {
+            pcmr_place_mono((int16_t *)buffer, frame_count, stream->route);
+        } else {
+            pcmr_route_stereo((int16_t *)buffer, frame_count, stream->route);
+        }
+        pcmr_cadence_advance(&stream->cadence, frame_count);
+        output(stream, buffer, frame_count);
+        return frame_count * PCM_STEREO_FRAME_BYTES;
+    }
+
+    int max_in_len = (stream->channels == 2) ? in_len : in_len / 2;
+    max_in_len = pcmr_cadence_available(&stream->cadence, max_in_len / frame_bytes) * frame_bytes;
+
+    memcpy(buffer, stream->carry_bytes, stream->carry);
+    int r_size = source_read(stream, buffer + stream->carry, max_in_len - stream->carry);
+    if(r_size <= 0) {
+        return r_size;
+    }
+
+    int available = stream->carry + r_size;
+    int frame_count = available / frame_bytes;
+    int in_used = frame_count * frame_bytes;
+
+    stream->carry = available - in_used;
+    memcpy(stream->carry_bytes, buffer + in_used, stream->carry);
+    if(pcmr_cadence_enabled(&stream->cadence)) {
+        pcmr_burst_record(&stream->burst, buffer, in_used);
+    }
+
+    if(stream->channels == 1) {
+        pcmr_place_mono((int16_t *)buffer, frame_count, stream->route);
+    } else {
+        pcmr_route_stereo((int16_t *)buffer, frame_count, stream->route);
+    }
+
+    if(frame_count > 0) {
+        output(stream, buffer, frame_count);
+        pcmr_cadence_advance(&stream->cadence, frame_count);
+    }
+    return r_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void test_route_stereo() {
+    int16_t frames[2 * 16];
+
+    for(size_t r = 0; r < ROUTE_COUNT; r++) {
+        for(size_t f = 0; f < 16; f++) {
+            frames[2 * f] = left_sample(f);
+            frames[2 * f + 1] = right_sample(f);
+        }
+        pcmr_route_stereo(frames, 15, routes[r]);
+
+        for(size_t f = 0; f < 15; f++) {
+            int16_t left = (routes[r] & PCM_ROUTE_LEFT) ? left_sample(f) : 0;
+            int16_t right = (routes[r] & PCM_ROUTE_RIGHT) ? right_sample(f) : 0;
+            CHECK(frames[2 * f] == left && frames[2 * f + 1] == right,
+                "Stereo %s: frame %zu is %i/%i, expected %i/%i", route_names[r], f,
+                frames[2 * f], frames[2 * f + 1], left, right);
+        }
+        CHECK(frames[30] == left_sample(15) && frames[31] == right_sample(15),
+            "Stereo %s: frame past the count changed", route_names[r]);
+    }
+}
+
+static void test_place_mono() {
+    int16_t buffer[2 * 16];
+
+    for(size_t r = 0; r < ROUTE_COUNT; r++) {
+        for(size_t s = 0; s < 16; s++) {
+            buffer[s] = left_sample(s);
+        }
+        for(size_t s = 16; s < 32; s++) {
+            buffer[s] = 0x5A5A;
+        }
+        pcmr_place_mono(buffer, 15, routes[r]);
+
+        for(size_t f = 0; f < 15; f++) {
+            int16_t left = (routes[r] & PCM_ROUTE_LEFT) ? left_sample(f) : 0;
+            int16_t right = (routes[r] & PCM_ROUTE_RIGHT) ? left_sample(f) : 0;
+            CHECK(buffer[2 * f] == left && buffer[2 * f + 1] == right,
+                "Mono %s: frame %zu is %i/%i, expected %i/%i", route_names[r], f,
+                buffer[2 * f], buffer[2 * f + 1], left, right);
+        }
+        CHECK(buffer[30] == 0x5A5A && buffer[31] == 0x5A5A, "Mono %s: written past the frames", route_names[r]);
+    }
+}
+
+static void test_cadence() {
+    pcm_cadence_t cadence;
+
+    CHECK(PCM_MS_TO_FRAMES(1500, 44100) == 66150, "1500 ms at 44.1 kHz: %u frames", PCM_MS_TO_FRAMES(1500, 44100));
+    CHECK(PCM_MS_TO_FRAMES(3500, 48000) == 168000, "3500 ms at 48 kHz: %u frames", PCM_MS_TO_FRAMES(3500, 48000));
+
+    // Disabled: always on, nothing limited
+    pcmr_cadence_init(&cadence, 0, 100);
+    CHECK(!pcmr_cadence_enabled(&cadence), "Disabled cadence enabled");
+    pcmr_cadence_advance(&cadence, 1000);
+    CHECK(cadence.on && pcmr_cadence_available(&cadence, 256) == 256, "Disabled cadence: phase changed");
+
+    // Phases end exactly on their frame count, even in several steps
+    pcmr_cadence_init(&cadence, 10, 4);
+    CHECK(cadence.on && pcmr_cadence_available(&cadence, 256) == 10, "On phase: %u available",
+        pcmr_cadence_available(&cadence, 256));
+    pcmr_cadence_advance(&cadence, 7);
+    CHECK(cadence.on && pcmr_cadence_available(&cadence, 256) == 3, "On phase after 7: %u available",
+        pcmr_cadence_available(&cadence, 256));
+    CHECK(pcmr_cadence_available(&cadence, 2) == 2, "On phase: more than asked available");
+    pcmr_cadence_advance(&cadence, 3);
+    CHECK(!cadence.on && pcmr_cadence_available(&cadence, 256) == 4, "Off phase: %s, %u available",
+        cadence.on ? "on" : "off", pcmr_cadence_available(&cadence, 256));
+    pcmr_cadence_advance(&cadence, 100);
+    CHECK(cadence.on && cadence.remaining == 10, "Advance past the off phase: %s, %u remaining",
+        cadence.on ? "on" : "off", cadence.remaining);
+
+    // No gap: the off phase is skipped
+    pcmr_cadence_init(&cadence, 5, 0);
+    pcmr_cadence_advance(&cadence, 5);
+    CHECK(cadence.on && cadence.remaining == 5, "No gap: %s, %u remaining", cadence.on ? "on" : "off",
+        cadence.remaining);
+}
+
+static void test_burst() {
+    char data[8];
+    char frames[12];
+    pcm_burst_t burst;
+
+    pcmr_burst_init(&burst, NULL, sizeof(data));
+    pcmr_burst_record(&burst, "abcd", 4);
+    CHECK(!pcmr_burst_ready(&burst) && burst.recorded == 0, "No cache: ready or recorded");
+
+    pcmr_burst_init(&burst, data, sizeof(data));
+    pcmr_burst_record(&burst, "abcdef", 6);
+    CHECK(!pcmr_burst_ready(&burst), "Partial recording ready");
+    memset(frames, 0x5A, sizeof(frames));
+    pcmr_burst_replay(&burst, 4, frames, 4);
+    CHECK(memcmp(frames, "ef\0\0\x5A", 5) == 0, "Replay past the recording is not silence");
+
+    pcmr_burst_record(&burst, "ghij", 4);
+    CHECK(pcmr_burst_ready(&burst) && burst.recorded == sizeof(data), "Full recording: %s, %zu bytes",
+        pcmr_burst_ready(&burst) ? "ready" : "not ready", burst.recorded);
+    pcmr_burst_replay(&burst, 0, frames, 8);
+    CHECK(memcmp(frames, "abcdefgh", 8) == 0, "Replay of the whole recording differs");
+}
+
+// Route a track through process(), then compare with the cadence replayed frame by frame.
+// A gated stream runs GATED_CYCLES cycles after its first burst, the others the whole track.
+static void check_stream(int channels, pcm_route_t route, const char *route_name, uint32_t on_ms, uint32_t off_ms,
+        bool cache) {
+    uint32_t on_frames = PCM_MS_TO_FRAMES(on_ms, SAMPLE_RATE);
+    uint32_t off_frames = PCM_MS_TO_FRAMES(off_ms, SAMPLE_RATE);
+    size_t source_len = TRACK_FRAMES * channels * PCM_SAMPLE_BYTES;
+    int16_t *source = malloc(source_len);
+    char *burst_data = cache && on_frames > 0 ? malloc(on_frames * channels * PCM_SAMPLE_BYTES) : NULL;
+    size_t gated_frames = (GATED_CYCLES + 1) * (on_frames + off_frames);
+    bool replayed = cache && on_frames > 0;
+    char buffer[ROUTER_BUFFER_SIZE];
+    stream_t stream;
+
+    for(size_t f = 0; f < TRACK_FRAMES; f++) {
+        if(channels == 1) {
+            source[f] = left_sample(f);
+        } else {
+            source[2 * f] = left_sample(f);
+            source[2 * f + 1] = right_sample(f);
+        }
+    }
+
+    memset(&stream, 0, sizeof(stream));
+    stream.source = (const char *)source;
+    stream.source_len = source_len;
+    stream.channels = channels;
+    stream.route = route;
+    stream.out_max = (replayed ? gated_frames : 2 * TRACK_FRAMES + off_frames) + sizeof(buffer) / PCM_STEREO_FRAME_BYTES;
+    stream.out = malloc(stream.out_max * PCM_STEREO_FRAME_BYTES);
+    pcmr_cadence_init(&stream.cadence, on_frames, off_frames);
+    pcmr_burst_init(&stream.burst, burst_data, on_frames * channels * PCM_SAMPLE_BYTES);
+
+    while((!replayed || stream.out_frames < gated_frames) && process(&stream, buffer, sizeof(buffer)) > 0) {
+    }
+
+    if(replayed) {
+        size_t burst_len = on_frames * channels * PCM_SAMPLE_BYTES;
+        CHECK(stream.read_pos - stream.carry == burst_len, "%i channels %s: %zu bytes read, %i carried, %zu expected",
+            channels, route_name, stream.read_pos, stream.carry, burst_len);
+    } else {
+        CHECK(stream.read_pos == source_len && stream.carry == 0, "%i channels %s: %zu bytes read, %i carried",
+            channels, route_name, stream.read_pos, stream.carry);
+    }
+
+    // Expected: the track frames in the on phases, from its start in each replayed one,
+    // silence in the off phases
+    size_t in_frame = 0;
+    size_t out_frame = 0;
+    uint32_t phase = 0;
+    bool on = true;
+    bool same = true;
+
+    while((replayed ? out_frame < gated_frames : in_frame < TRACK_FRAMES) && same) {
+        int16_t left = 0, right = 0;
+
+        if(on) {
+            size_t f = replayed ? phase : in_frame;
+            left = (route & PCM_ROUTE_LEFT) ? left_sample(f) : 0;
+            right = (route & PCM_ROUTE_RIGHT) ? (channels == 1 ? left_sample(f) : right_sample(f)) : 0;
+            in_frame++;
+        }
+
+        same = out_frame < stream.out_frames && stream.out[2 * out_frame] == left
+            && stream.out[2 * out_frame + 1] == right;
+        CHECK(same, "%i channels %s: frame %zu (%s phase) is %i/%i, expected %i/%i", channels, route_name,
+            out_frame, on ? "on" : "off", out_frame < stream.out_frames ? stream.out[2 * out_frame] : 0,
+            out_frame < stream.out_frames ? stream.out[2 * out_frame + 1] : 0, left, right);
+        out_frame++;
+
+        if(on_frames > 0 && ++phase == (on ? on_frames : off_frames)) {
+            phase = 0;
+            on = !on || off_frames == 0;
+        }
+    }
+    CHECK(!same || replayed || out_frame == stream.out_frames, "%i channels %s: %zu frames sent, expected %zu",
+        channels, route_name, stream.out_frames, out_frame);
+
+    free(stream.out);
+    free(burst_data);
+    free(source);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    test_route_stereo();
+    test_place_mono();
+    test_cadence();
+    test_burst();
+
+    for(int channels = 1; channels <= 2; channels++) {
+        for(size_t r = 0; r < ROUTE_COUNT; r++) {
+            check_stream(channels, routes[r], route_names[r], 0, 0, true);
+            check_stream(channels, routes[r], route_names[r], CADENCE_ON_MS, CADENCE_OFF_MS, true);
+        }
+        check_stream(channels, PCM_ROUTE_BOTH, "both without gap", CADENCE_ON_MS, 0, true);
+        check_stream(channels, PCM_ROUTE_BOTH, "both without cache", CADENCE_ON_MS, CADENCE_OFF_MS, false);
+    }
+
+    printf("PCM router: %i failures\n", _failures);
+    return _failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,170 @@
+// Host test of the telephone state machine: phone_fsm.c
+//
+// The whole transition table is walked: every state is known to be on hook or off
+// hook, a hook change is never ignored and moves to a state of the other side, any
+// other event keeps the handset where it is, and the bells only ring on hook.
+// A few scenarios are then replayed event by event, the puzzle solved on and off
+// hook among them, checking the state and the action after each event.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "phone_fsm.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct {
+    phsm_event_t event;
+    phsm_state_t state;             // Expected after the event
+    phsm_action_t action;
+} step_t;
+
+static const bool lifted[PHSM_STATE_COUNT] = {
+    [PHSM_STATE_IDLE]               = false,
+    [PHSM_STATE_RINGING]            = false,
+    [PHSM_STATE_OFF_HOOK]           = true,
+    [PHSM_STATE_IN_CALL]            = true,
+    [PHSM_STATE_HUNG_UP]            = false,
+    [PHSM_STATE_SOLVED_ON_HOOK]     = false,
+    [PHSM_STATE_SOLVED_OFF_HOOK]    = true,
+};
+
+static int _failures;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CHECK(cond, ...) do {                   \
+    if(!(cond)) {                               \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        _failures++;                            \
+    }                                           \
+} while(0)
+
+// One event from the given state, on a fresh machine
+static phsm_action_t dispatch_from(phsm_state_t state, phsm_event_t event, phsm_t *fsm) {
+    phsm_init(fsm);
+    fsm->state = state;
+    return phsm_dispatch(fsm, event);
+}
+
+static void test_names() {
+    for(int s = 0; s < PHSM_STATE_COUNT; s++) {
+        CHECK(strcmp(phsm_state_name(s), "?") != 0, "State %i has no name", s);
+    }
+    for(int e = 0; e < PHSM_EVENT_COUNT; e++) {
+        CHECK(strcmp(phsm_event_name(e), "?") != 0, "Event %i has no name", e);
+    }
+    for(int a = 0; a < PHSM_ACTION_COUNT; a++) {
+        CHECK(strcmp(phsm_action_name(a), "?") != 0, "Action %i has no name", a);
+    }
+    CHECK(strcmp(phsm_state_name(PHSM_STATE_COUNT), "?") == 0, "Name of an unknown state");
+}
+
+static void test_table() {
+    phsm_t fsm;
+
+    for(phsm_state_t s = 0; s < PHSM_STATE_COUNT; s++) {
+        for(phsm_event_t e = 0; e < PHSM_EVENT_COUNT; e++) {
+            phsm_action_t action = dispatch_from(s, e, &fsm);
+            bool handled = fsm.transitions == 1;
+            const char *state_name = phsm_state_name(s);
+            const char *event_name = phsm_event_name(e);
+
+            if(!handled) {
+                CHECK(fsm.state == s && action == PHSM_ACTION_NONE && fsm.ignored == 1,
+                    "%s ignored in %s: moved to %s, %s", event_name, state_name, phsm_state_name(fsm.state),
+                    phsm_action_name(action));
+            }
+
+            if(e == PHSM_EVENT_HOOK_OFF || e == PHSM_EVENT_HOOK_ON) {
+                bool expected = e == PHSM_EVENT_HOOK_OFF;
+                if(lifted[s] != expected) {
+                    CHECK(handled, "%s ignored in %s", event_name, state_name);
+                    CHECK(lifted[fsm.state] == expected, "%s in %s: moved to %s", event_name, state_name,
+                        phsm_state_name(fsm.state));
+                }
+            } else {
+                CHECK(lifted[fsm.state] == lifted[s], "%s in %s: moved to %s, the handset did not move",
+                    event_name, state_name, phsm_state_name(fsm.state));
+            }
+
+            if(action == PHSM_ACTION_RING || action == PHSM_ACTION_SOLVED_RING) {
+                CHECK(!lifted[fsm.state], "%s in %s: %s off hook", event_name, state_name, phsm_action_name(action));
+            }
+        }
+    }
+
+    phsm_init(&fsm);
+    CHECK(phsm_dispatch(&fsm, PHSM_EVENT_COUNT) == PHSM_ACTION_NONE && fsm.state == PHSM_STATE_IDLE
+        && fsm.ignored == 1, "Unknown event not ignored");
+}
+
+static void check_scenario(const char *name, const step_t *steps, size_t count) {
+    phsm_t fsm;
+
+    phsm_init(&fsm);
+    for(size_t i = 0; i < count; i++) {
+        phsm_state_t previous = fsm.state;
+        phsm_action_t action = phsm_dispatch(&fsm, steps[i].event);
+
+        CHECK(fsm.state == steps[i].state && action == steps[i].action,
+            "%s, step %zu: %s in %s gave %s, %s, expected %s, %s", name, i, phsm_event_name(steps[i].event),
+            phsm_state_name(previous), phsm_state_name(fsm.state), phsm_action_name(action),
+            phsm_state_name(steps[i].state), phsm_action_name(steps[i].action));
+        fsm.state = steps[i].state;
+    }
+}
+
+static void test_scenarios() {
+    static const step_t answered[] = {
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_RINGING,         PHSM_ACTION_RING },
+        { PHSM_EVENT_JACK_CHANGED,      PHSM_STATE_RINGING,         PHSM_ACTION_LOG_JACK },
+        { PHSM_EVENT_HOOK_OFF,          PHSM_STATE_IN_CALL,         PHSM_ACTION_ANSWER },
+        { PHSM_EVENT_AUDIO_FINISHED,    PHSM_STATE_OFF_HOOK,        PHSM_ACTION_BUSY_TONE },
+        { PHSM_EVENT_HOOK_ON,           PHSM_STATE_HUNG_UP,         PHSM_ACTION_HANG_UP },
+        { PHSM_EVENT_GUARD_TIMEOUT,     PHSM_STATE_IDLE,            PHSM_ACTION_NONE },
+    };
+    static const step_t unanswered[] = {
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_RINGING,         PHSM_ACTION_RING },
+        { PHSM_EVENT_RING_TIMEOUT,      PHSM_STATE_IDLE,            PHSM_ACTION_STOP_RING },
+        { PHSM_EVENT_HOOK_OFF,          PHSM_STATE_OFF_HOOK,        PHSM_ACTION_DIAL_TONE },
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_OFF_HOOK,        PHSM_ACTION_NONE },
+    };
+    static const step_t solved_on_hook[] = {
+        { PHSM_EVENT_PUZZLE_SOLVED,     PHSM_STATE_SOLVED_ON_HOOK,  PHSM_ACTION_SOLVED_RING },
+        { PHSM_EVENT_HOOK_OFF,          PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_SOLVED_MESSAGE },
+        { PHSM_EVENT_JACK_CHANGED,      PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_LOG_JACK },
+        { PHSM_EVENT_HOOK_ON,           PHSM_STATE_SOLVED_ON_HOOK,  PHSM_ACTION_STOP_SOUND },
+        { PHSM_EVENT_PUZZLE_SOLVED,     PHSM_STATE_SOLVED_ON_HOOK,  PHSM_ACTION_NONE },
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_RINGING,         PHSM_ACTION_RING },
+    };
+    // The game master calls while the solved message plays in the handset
+    static const step_t solved_off_hook[] = {
+        { PHSM_EVENT_HOOK_OFF,          PHSM_STATE_OFF_HOOK,        PHSM_ACTION_DIAL_TONE },
+        { PHSM_EVENT_PUZZLE_SOLVED,     PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_SOLVED_MESSAGE },
+        { PHSM_EVENT_RING_TIMEOUT,      PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_NONE },
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_OFF_HOOK,        PHSM_ACTION_BUSY_TONE },
+        { PHSM_EVENT_HOOK_ON,           PHSM_STATE_HUNG_UP,         PHSM_ACTION_HANG_UP },
+        { PHSM_EVENT_INCOMING_CALL,     PHSM_STATE_RINGING,         PHSM_ACTION_RING },
+    };
+
+    check_scenario("Answered call", answered, sizeof(answered) / sizeof(answered[0]));
+    check_scenario("Unanswered call", unanswered, sizeof(unanswered) / sizeof(unanswered[0]));
+    check_scenario("Solved on hook", solved_on_hook, sizeof(solved_on_hook) / sizeof(solved_on_hook[0]));
+    check_scenario("Solved off hook", solved_off_hook, sizeof(solved_off_hook) / sizeof(solved_off_hook[0]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    test_names();
+    test_table();
+    test_scenarios();
+
+    printf("Phone FSM: %i failures\n", _failures);
+    return _failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// Host test of the telephone tone generator: tone_generator.c --> dsp_sine.c
+//
+// The level of every DTMF pair and of the 440 Hz tone is measured with the Goertzel
+// algorithm at each DTMF frequency and at 440 Hz: the expected frequencies must be
+// at their table level, the others must stay near the leakage floor. The cadence
+// edges of the busy and ringback tones are checked sample exact, rendered in odd
+// chunks so that the cadence crosses the buffer boundaries.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tone_generator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define WINDOW_SAMPLES          (TONE_SAMPLE_RATE / 4)  // 250 ms, 4 Hz resolution
+#define CHUNK_SAMPLES           37                      // Odd, not a divisor of any cadence
+#define LEVEL_SINGLE            0.30    // TONE_LEVEL_SINGLE
+#define LEVEL_DTMF              0.25    // TONE_LEVEL_DTMF
+#define LEVEL_TOLERANCE         0.02
+#define LEVEL_LEAK_MAX          0.03    // Frequencies not in the tone
+
+static const double probe_hz[] = { 440, 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+#define PROBE_COUNT             (sizeof(probe_hz) / sizeof(probe_hz[0]))
+
+// Keypad rows are the low frequency, columns the high one
+static const char keypad[4][4] = {
+    { '1', '2', '3', 'A' },
+    { '4', '5', '6', 'B' },
+    { '7', '8', '9', 'C' },
+    { '*', '0', '#', 'D' },
+};
+static const double row_hz[4] = { 697, 770, 852, 941 };
+static const double column_hz[4] = { 1209, 1336, 1477, 1633 };
+
+static int _failures;
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define CHECK(cond, ...) do {                   \
+    if(!(cond)) {                               \
+        printf("FAIL %s:%i: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__);                    \
+        printf("\n");                           \
+        _failures++;                            \
+    }                                           \
+} while(0)
+
+static void render(tone_id_t tone, int16_t *samples, size_t count) {
+    tone_generator_t gen;
+
+    tone_generator_init(&gen, tone);
+    for(size_t done = 0; done < count; done += CHUNK_SAMPLES) {
+        size_t chunk = count - done < CHUNK_SAMPLES ? count - done : CHUNK_SAMPLES;
+        tone_generator_render(&gen, samples + done, chunk);
+    }
+}
+
+// Amplitude of freq_hz in the samples, 1.0 for a full scale sine
+static double goertzel(const int16_t *samples, size_t count, double freq_hz) {
+    double w = 2.0 * M_PI * freq_hz / TONE_SAMPLE_RATE;
+    double coeff = 2.0 * cos(w);
+    double s1 = 0, s2 = 0;
+
+    for(size_t n = 0; n < count; n++) {
+        double s0 = samples[n] / 32768.0 + coeff * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+
+    double re = s1 - s2 * cos(w);
+    double im = s2 * sin(w);
+    return 2.0 * sqrt(re * re + im * im) / count;
+}
+
+static void check_levels(const char *name, tone_id_t tone, const double *expected_hz, int expected_count, double level) {
+    int16_t samples[WINDOW_SAMPLES];
+
+    render(tone, samples, WINDOW_SAMPLES);
+    for(size_t p = 0; p < PROBE_COUNT; p++) {
+        double amplitude = goertzel(samples, WINDOW_SAMPLES, probe_hz[p]);
+        bool in_tone = false;
+
+        for(int e = 0; e < expected_count; e++) {
+            in_tone |= expected_hz[e] == probe_hz[p];
+        }
+        if(in_tone) {
+            CHECK(fabs(amplitude - level) <= LEVEL_TOLERANCE, "%s: %.0f Hz at %.3f, expected %.3f",
+                name, probe_hz[p], amplitude, level);
+        } else {
+            CHECK(amplitude <= LEVEL_LEAK_MAX, "%s: %.0f Hz at %.3f, expected under %.3f",
+                name, probe_hz[p], amplitude, LEVEL_LEAK_MAX);
+        }
+    }
+}
+
+static bool is_silent(const int16_t *samples, size_t count) {
+    for(size_t n = 0; n < count; n++) {
+        if(samples[n] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Longest run of zero samples, a sine crosses zero on one sample at most
+static size_t longest_silence(const int16_t *samples, size_t count) {
+    size_t longest = 0;
+    size_t run = 0;
+
+    for(size_t n = 0; n < count; n++) {
+        run = samples[n] == 0 ? run + 1 : 0;
+        if(run > longest) {
+            longest = run;
+        }
+    }
+    return longest;
+}
+
+static void check_cadence(const char *name, tone_id_t tone, uint32_t on_ms, uint32_t off_ms, int periods) {
+    size_t on = (size_t)on_ms * TONE_SAMPLE_RATE / 1000;
+    size_t off = (size_t)off_ms * TONE_SAMPLE_RATE / 1000;
+    size_t count = (on + off) * periods;
+    int16_t *samples = malloc(count * sizeof(int16_t));
+
+    render(tone, samples, count);
+    for(int p = 0; p < periods; p++) {
+        const int16_t *start = samples + p * (on + off);
+
+        // Sound up to the last sample of the on phase, silence from the first of the off phase
+        CHECK(longest_silence(start, on) <= 2, "%s period %i: gap in the on phase", name, p);
+        CHECK(!is_silent(start + on - 2, 2), "%s period %i: on phase ends early", name, p);
+        CHECK(is_silent(start + on, off), "%s period %i: sound in the off phase", name, p);
+        CHECK(p == periods - 1 || !is_silent(start + on + off, 2),
+            "%s period %i: next on phase starts late", name, p);
+    }
+    free(samples);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main() {
+    static const double french_hz[] = { 440 };
+    int16_t samples[WINDOW_SAMPLES];
+
+    for(int r = 0; r < 4; r++) {
+        for(int c = 0; c < 4; c++) {
+            char name[] = "DTMF ?";
+            double pair_hz[] = { row_hz[r], column_hz[c] };
+            tone_id_t tone = tone_from_dtmf_key(keypad[r][c]);
+
+            name[5] = keypad[r][c];
+            CHECK(tone != TONE_NONE, "%s: no tone", name);
+            check_levels(name, tone, pair_hz, 2, LEVEL_DTMF);
+        }
+    }
+    CHECK(tone_from_dtmf_key('x') == TONE_NONE, "DTMF x: a tone");
+
+    check_levels("Dial", TONE_DIAL, french_hz, 1, LEVEL_SINGLE);
+    render(TONE_DIAL, samples, WINDOW_SAMPLES);
+    CHECK(longest_silence(samples, WINDOW_SAMPLES) <= 2, "Dial: not continuous");
+
+    check_levels("Busy", TONE_BUSY, french_hz, 1, LEVEL_SINGLE);
+    check_cadence("Busy", TONE_BUSY, 500, 500, 3);
+    check_cadence("Ringback", TONE_RINGBACK, 1500, 3500, 2);
+
+    render(TONE_NONE, samples, WINDOW_SAMPLES);
+    CHECK(is_silent(samples, WINDOW_SAMPLES), "None: not silent");
+
+    printf("Tone generator: %i failures\n", _failures);
+    return _failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+"""Pack the audio assets of an sdcard directory into a single archive.
+
+The ESP32 loads the index of the archive once at boot and plays each asset by id
+with offset reads, without any FATFS path lookup or file open per play.
+Layout (little endian), see src/main/asset_archive.h:
+
+    header   magic "PHPK", u16 version, u16 entry count, u32 data alignment, u32 reserved
+    index    per asset: char name[48], u32 offset, u32 length, u32 audio offset, u32 reserved
+    assets   each one starting on a data alignment (SD sector) boundary
+
+Asset names are the paths relative to the directory, the player finds
+"/sdcard/ringtones/vintage.mp3" as "ringtones/vintage.mp3".
+
+Usage:
+    build_archive.py build/sdcard -o build/sdcard/assets.pak
+    build_archive.py --list build/sdcard/assets.pak
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b"PHPK"
+VERSION = 1
+NAME_SIZE = 48
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<%dsIIII" % NAME_SIZE)
+
+ID3V2_HEADER_SIZE = 10
+ID3V2_FLAG_FOOTER = 0x10
+
+
+def id3v2_size(data):
+    """Bytes before the first audio frame, where a looped asset restarts."""
+    if len(data) < ID3V2_HEADER_SIZE or data[:3] != b"ID3":
+        return 0
+    size = (data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F)
+    size += ID3V2_HEADER_SIZE
+    if data[5] & ID3V2_FLAG_FOOTER:
+        size += ID3V2_HEADER_SIZE
+    return size
+
+
+def find_assets(root, extensions, exclude):
+    assets = []
+    for directory, _, files in os.walk(root):
+        for name in files:
+            path = os.path.join(directory, name)
+            if os.path.splitext(name)[1].lower() not in extensions:
+                continue
+            if exclude and os.path.abspath(path) == os.path.abspath(exclude):
+                continue
+            assets.append(os.path.relpath(path, root).replace(os.sep, "/"))
+    return sorted(assets)
+
+
+def align(value, alignment):
+    return (value + alignment - 1) // alignment * alignment
+
+
+def build(root, output, extensions, alignment):
+    names = find_assets(root, extensions, output)
+    if not names:
+        sys.exit("No asset found in %s" % root)
+    if len(names) > 0xFFFF:
+        sys.exit("Too many assets (%d)" % len(names))
+
+    offset = align(HEADER.size + ENTRY.size * len(names), alignment)
+    entries = []
+    blobs = []
+    for name in names:
+        encoded = name.encode("utf-8")
+        if len(encoded) >= NAME_SIZE:
+            sys.exit("Asset name too long (max %d bytes): %s" % (NAME_SIZE - 1, name))
+        with open(os.path.join(root, name), "rb") as f:
+            data = f.read()
+        entries.append(ENTRY.pack(encoded, offset, len(data), id3v2_size(data), 0))
+        blobs.append((offset, data))
+        offset = align(offset + len(data), alignment)
+
+    with open(output, "wb") as f:
+        f.write(HEADER.pack(MAGIC, VERSION, len(names), alignment, 0))
+        for entry in entries:
+            f.write(entry)
+        for blob_offset, data in blobs:
+            f.write(b"\0" * (blob_offset - f.tell()))
+            f.write(data)
+
+    for asset_id, name in enumerate(names):
+        print("%3d  %s" % (asset_id, name))
+    print("%s: %d assets, %d bytes" % (output, len(names), os.path.getsize(output)))
+
+
+def list_archive(path):
+    with open(path, "rb") as f:
+        magic, version, count, alignment, _ = HEADER.unpack(f.read(HEADER.size))
+        if magic != MAGIC or version != VERSION:
+            sys.exit("%s is not a version %d archive" % (path, VERSION))
+        print("%s: %d assets, aligned on %d bytes" % (path, count, alignment))
+        for asset_id in range(count):
+            name, offset, length, audio_offset, _ = ENTRY.unpack(f.read(ENTRY.size))
+            name = name.rstrip(b"\0").decode("utf-8")
+            print("%3d  %-40s %9d bytes at %9d, audio at +%d" % (asset_id, name, length, offset, audio_offset))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="sdcard directory to pack, or archive with --list")
+    parser.add_argument("-o", "--output", help="archive to write (default SOURCE/assets.pak)")
+    parser.add_argument("--ext", action="append", default=None,
+                        help="file extension to pack, can be repeated (default .mp3)")
+    parser.add_argument("--alignment", type=int, default=512, help="asset alignment in bytes (default 512)")
+    parser.add_argument("--list", action="store_true", help="print the index of an archive")
+    args = parser.parse_args()
+
+    if args.list:
+        list_archive(args.source)
+        return
+
+    if args.alignment <= 0 or args.alignment % 512 != 0:
+        sys.exit("The alignment must be a multiple of the 512 bytes SD sector")
+    extensions = [e if e.startswith(".") else "." + e for e in (args.ext or [".mp3"])]
+    output = args.output or os.path.join(args.source, "assets.pak")
+    build(args.source, output, [e.lower() for e in extensions], args.alignment)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Convert stereo audio assets (one silent channel) into mono MP3 files.
+
+The player places mono samples on the ringer or the handset slot itself, so the
+SD card only has to carry, and the ESP32 only has to decode, the useful channel.
+
+The useful channel is detected from its RMS level, or forced with --channel.
+ffmpeg (with libmp3lame) must be available in the PATH.
+
+Usage:
+    convert_assets.py assets/elevator-song.mp3 -o build/sdcard/callers
+    convert_assets.py --channel left --bitrate 64k ringtones/*.mp3 -o build/sdcard/ringtones
+"""
+
+import argparse
+import array
+import math
+import os
+import subprocess
+import sys
+
+
+def decode_stereo(path):
+    """Decode a file to interleaved signed 16 bits stereo samples."""
+    cmd = ["ffmpeg", "-v", "error", "-i", path, "-f", "s16le", "-acodec", "pcm_s16le", "-ac", "2", "-"]
+    pcm = subprocess.run(cmd, check=True, stdout=subprocess.PIPE).stdout
+    samples = array.array("h")
+    samples.frombytes(pcm[: len(pcm) - len(pcm) % 4])
+    if sys.byteorder != "little":
+        samples.byteswap()
+    return samples
+
+
+def channel_rms(samples):
+    left = samples[0::2]
+    right = samples[1::2]
+    count = max(len(left), 1)
+    rms_left = math.sqrt(sum(s * s for s in left) / count)
+    rms_right = math.sqrt(sum(s * s for s in right) / count)
+    return rms_left, rms_right
+
+
+def detect_channel(path):
+    rms_left, rms_right = channel_rms(decode_stereo(path))
+    channel = "left" if rms_left >= rms_right else "right"
+    print("%s: RMS left=%.1f right=%.1f => %s" % (path, rms_left, rms_right, channel))
+    if min(rms_left, rms_right) > 0.1 * max(rms_left, rms_right):
+        print("%s: WARNING both channels carry sound, use --channel mix to keep both" % path)
+    return channel
+
+
+def encode_mono(src, dst, channel, bitrate, sample_rate):
+    pan = {
+        "left": "pan=mono|c0=FL",
+        "right": "pan=mono|c0=FR",
+        "mix": "pan=mono|c0=0.5*FL+0.5*FR",
+    }[channel]
+    # No tag and no Xing frame, so the file can be looped by the player without a silent frame
+    cmd = ["ffmpeg", "-v", "error", "-y", "-i", src, "-map_metadata", "-1", "-af", pan, "-ac", "1",
+           "-codec:a", "libmp3lame", "-b:a", bitrate, "-id3v2_version", "0", "-write_xing", "0"]
+    if sample_rate:
+        cmd += ["-ar", str(sample_rate)]
+    cmd += [dst]
+    subprocess.run(cmd, check=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert stereo audio assets to mono MP3 files.")
+    parser.add_argument("inputs", nargs="+", help="stereo asset files")
+    parser.add_argument("-o", "--output", required=True, help="output directory")
+    parser.add_argument("--channel", choices=["auto", "left", "right", "mix"], default="auto",
+                        help="channel to keep (default: the loudest one)")
+    parser.add_argument("--bitrate", default="64k", help="MP3 bitrate of the mono file (default: 64k)")
+    parser.add_argument("--sample-rate", type=int, default=None,
+                        help="resample the output (default: keep the input rate)")
+    args = parser.parse_args()
+
+    os.makedirs(args.output, exist_ok=True)
+
+    for src in args.inputs:
+        channel = detect_channel(src) if args.channel == "auto" else args.channel
+        dst = os.path.join(args.output, os.path.splitext(os.path.basename(src))[0] + ".mp3")
+        if os.path.abspath(src) == os.path.abspath(dst):
+            parser.error("%s: output would overwrite the input" % src)
+
+        encode_mono(src, dst, channel, args.bitrate, args.sample_rate)
+        print("%s => %s (%s, %d => %d bytes)" % (src, dst, channel, os.path.getsize(src), os.path.getsize(dst)))
+
+
+if __name__ == "__main__":
+    main()
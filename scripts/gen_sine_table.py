@@ -0,0 +1,31 @@
+#!/usr/bin/env python3
+"""Generate src/main/dsp_sine.c, the Q15 sine table shared by the synthesized audio sources.
+
+Usage:
+    gen_sine_table.py > src/main/dsp_sine.c
+"""
+
+import math
+
+TABLE_SIZE = 1024   # Must match DSP_SINE_TABLE_SIZE in dsp_sine.h
+PER_LINE = 8
+
+
+def main():
+    values = [int(round(32767 * math.sin(2 * math.pi * i / TABLE_SIZE))) for i in range(TABLE_SIZE)]
+
+    print('#include "dsp_sine.h"')
+    print()
+    print("/" * 79)
+    print()
+    print("// Generated by scripts/gen_sine_table.py, do not edit.")
+    print("const int16_t dsp_sine_q15[DSP_SINE_TABLE_SIZE] = {")
+    for i in range(0, TABLE_SIZE, PER_LINE):
+        print("    " + ", ".join("%6d" % v for v in values[i:i + PER_LINE]) + ",")
+    print("};")
+    print()
+    print("/" * 79)
+
+
+if __name__ == "__main__":
+    main()
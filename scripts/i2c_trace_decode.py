@@ -0,0 +1,326 @@
+#!/usr/bin/env python3
+"""Decode an I2C transaction trace of the ESP32 (src/main/i2c_trace.h).
+
+The trace is dumped as text by diag_i2c_trace_dump(), to the console (UART capture,
+log lines around it are ignored) or to /sdcard/i2c_trace.txt. Lines:
+
+    i2ct-header,version,bus_hz,commands,failed commands,records,dropped records
+    i2ct,seq,start_us,end_us,address,register,r|w,flags,index,count,data hex,len,result
+
+A record is a register access, the records of a command (a link run by
+i2c_executeCommand(), index 0..count-1) share its start, end and esp_err_t result.
+Times are the low 32 bits of esp_timer, in microseconds.
+
+The summary gives the bus utilisation, the command durations against their wire time
+at bus_hz, the accesses per device and register, and the failed commands with the
+command before them. The timing diagram has a lane per device, in the terminal or in
+an SVG file. Access times inside a command are estimated from their bit counts.
+
+Usage:
+    i2c_trace_decode.py i2c_trace.txt
+    i2c_trace_decode.py --list --diagram --from 60 --to 80 uart.log
+    i2c_trace_decode.py --svg trace.svg i2c_trace.txt
+"""
+
+import argparse
+import re
+import sys
+
+VERSION = 1
+FLAG_NO_REGISTER = 0x02
+
+ERRORS = {
+    0: "OK",
+    -1: "ESP_FAIL",
+    0x101: "ESP_ERR_NO_MEM",
+    0x102: "ESP_ERR_INVALID_ARG",
+    0x103: "ESP_ERR_INVALID_STATE",
+    0x107: "ESP_ERR_TIMEOUT",
+}
+
+HEADER_RE = re.compile(r"i2ct-header,(\d+),(\d+),(\d+),(\d+),(\d+),(\d+)")
+RECORD_RE = re.compile(r"i2ct,(\d+),(\d+),(\d+),0x([0-9a-f]+),0x([0-9a-f]+),([rw]),(\d+),(\d+),(\d+),([0-9a-f]*),(\d+),(-?\d+)")
+
+WRAP_US = 1 << 32
+
+
+class Access:
+    def __init__(self, match):
+        fields = match.groups()
+        self.seq = int(fields[0])
+        self.start_us = int(fields[1])
+        self.end_us = int(fields[2])
+        self.address = int(fields[3], 16)
+        self.register = int(fields[4], 16)
+        self.read = fields[5] == "r"
+        self.flags = int(fields[6])
+        self.index = int(fields[7])
+        self.count = int(fields[8])
+        self.data = fields[9]
+        self.len = int(fields[10])
+        self.result = int(fields[11])
+
+    def bits(self):
+        """Bits on the wire: (repeated) START, address, register, data."""
+        bits = 1 + 9
+        if not self.flags & FLAG_NO_REGISTER:
+            bits += 9
+        if self.read and not self.flags & FLAG_NO_REGISTER:
+            bits += 1 + 9
+        return bits + 9 * self.len
+
+    def describe(self):
+        register = "" if self.flags & FLAG_NO_REGISTER else "%02x" % self.register
+        data = self.data + ("+" if self.len * 2 > len(self.data) else "")
+        return "0x%02x %s%s=%s" % (self.address, "r" if self.read else "w", register, data)
+
+
+class Command:
+    def __init__(self, first):
+        self.accesses = [first]
+        self.start_us = first.start_us
+        self.end_us = first.end_us
+        self.result = first.result
+        self.count = first.count
+
+    def accepts(self, access):
+        last = self.accesses[-1]
+        return (access.seq == last.seq + 1 and access.index == last.index + 1
+                and access.start_us == last.start_us and access.end_us == last.end_us)
+
+    def duration_us(self):
+        return (self.end_us - self.start_us) % WRAP_US
+
+    def bits(self):
+        return sum(a.bits() for a in self.accesses) + 1
+
+    def access_times(self):
+        """(start, end) of each access, the command duration split by bit counts."""
+        total = sum(a.bits() for a in self.accesses) or 1
+        times = []
+        start = self.start_us
+        for access in self.accesses:
+            end = start + self.duration_us() * access.bits() / total
+            times.append((start, end))
+            start = end
+        return times
+
+
+def error_name(result):
+    return ERRORS.get(result, "0x%x" % result)
+
+
+def parse(lines):
+    header = None
+    accesses = []
+    for line in lines:
+        match = HEADER_RE.search(line)
+        if match:
+            header = [int(v) for v in match.groups()]
+            if header[0] != VERSION:
+                sys.exit("Trace version %d, version %d expected" % (header[0], VERSION))
+            accesses = []   # A new dump
+            continue
+        match = RECORD_RE.search(line)
+        if match:
+            accesses.append(Access(match))
+    if header is None:
+        sys.exit("No i2ct-header line found")
+    return header, accesses
+
+
+def unwrap(accesses):
+    """esp_timer low 32 bits, made monotonic over the trace."""
+    offset = 0
+    previous = None
+    for access in accesses:
+        if previous is not None and access.start_us + offset < previous - WRAP_US // 2:
+            offset += WRAP_US
+        duration = (access.end_us - access.start_us) % WRAP_US
+        access.start_us += offset
+        access.end_us = access.start_us + duration
+        previous = access.start_us
+
+
+def group(accesses):
+    commands = []
+    for access in accesses:
+        if commands and access.index > 0 and commands[-1].accepts(access):
+            commands[-1].accesses.append(access)
+            commands[-1].end_us = access.end_us
+        else:
+            commands.append(Command(access))
+    return commands
+
+
+def percentile(values, ratio):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * ratio))]
+
+
+def print_summary(header, commands, window_ms):
+    _, bus_hz, total_commands, total_errors, total_records, dropped = header
+    records = sum(len(c.accesses) for c in commands)
+    print("Bus %d Hz, %d commands (%d failed), %d records written, %d dropped, %d in the dump"
+          % (bus_hz, total_commands, total_errors, total_records, dropped, records))
+    if not commands:
+        return
+
+    start = commands[0].start_us
+    end = max(c.end_us for c in commands)
+    busy = sum(c.duration_us() for c in commands)
+    span = max(end - start, 1)
+    print("Span %.3fms from %.3fms, bus busy %.1f%%" % (span / 1000.0, start / 1000.0, 100.0 * busy / span))
+
+    # A failed command stops early, the wire time is only known for the others
+    durations = [c.duration_us() for c in commands]
+    succeeded = [c for c in commands if c.result == 0]
+    wire = sum(c.bits() * 1e6 / bus_hz for c in succeeded)
+    print("Command: median %dus, 99%% %dus, worst %dus, wire time %.0f%% of the duration"
+          % (percentile(durations, 0.5), percentile(durations, 0.99), max(durations),
+             100.0 * wire / max(sum(c.duration_us() for c in succeeded), 1)))
+
+    window_us = window_ms * 1000
+    windows = {}
+    for command in commands:
+        for access, (a_start, a_end) in zip(command.accesses, command.access_times()):
+            t = a_start
+            while t < a_end:
+                w = int((t - start) // window_us)
+                w_end = min(a_end, start + (w + 1) * window_us)
+                windows[w] = windows.get(w, 0) + w_end - t
+                t = w_end
+    print("\nBus utilisation per %gms:" % window_ms)
+    for w in range(int(span // window_us) + 1):
+        ratio = min(windows.get(w, 0) / window_us, 1.0)
+        print("  %10.3fms %5.1f%% %s" % ((start + w * window_us) / 1000.0, 100 * ratio, "#" * int(ratio * 50 + 0.5)))
+
+    counts = {}
+    for command in commands:
+        for access in command.accesses:
+            register = None if access.flags & FLAG_NO_REGISTER else access.register
+            key = (access.address, register, access.read)
+            counts[key] = counts.get(key, 0) + 1
+    print("\nAccesses:")
+    for (address, register, read), count in sorted(counts.items(), key=lambda i: (i[0][0], i[0][1] or -1, i[0][2])):
+        print("  0x%02x %-5s %-4s %6d" % (address, "read" if read else "write",
+                                           "--" if register is None else "0x%02x" % register, count))
+
+    failed = [i for i, c in enumerate(commands) if c.result != 0]
+    print("\nFailed commands: %d" % len(failed))
+    for i in failed:
+        if i > 0:
+            print("  before: %s" % format_command(commands[i - 1]))
+        print("  FAILED: %s" % format_command(commands[i]))
+
+
+def format_command(command):
+    accesses = " ".join(a.describe() for a in command.accesses[:6])
+    if command.count > 6:
+        accesses += " ... (%d accesses)" % command.count
+    return "%10.3fms %6dus %-21s %s" % (command.start_us / 1000.0, command.duration_us(),
+                                        error_name(command.result), accesses)
+
+
+def select(commands, start_ms, end_ms):
+    return [c for c in commands
+            if (start_ms is None or c.end_us >= start_ms * 1000) and (end_ms is None or c.start_us <= end_ms * 1000)]
+
+
+def print_diagram(commands, width):
+    """A lane per device, w: write, r: read, X: failed command."""
+    if not commands:
+        return
+    start = commands[0].start_us
+    end = max(c.end_us for c in commands)
+    scale = max(end - start, 1) / float(width)
+    lanes = {}
+    for command in commands:
+        for access, (a_start, a_end) in zip(command.accesses, command.access_times()):
+            lane = lanes.setdefault(access.address, [" "] * width)
+            mark = "X" if command.result != 0 else ("r" if access.read else "w")
+            first = min(int((a_start - start) / scale), width - 1)
+            last = min(int((a_end - start) / scale), width - 1)
+            for column in range(first, last + 1):
+                if lane[column] in " wr":
+                    lane[column] = mark
+    print("\n%.3fms .. %.3fms, %.1fus per column" % (start / 1000.0, end / 1000.0, scale))
+    for address in sorted(lanes):
+        print("  0x%02x |%s|" % (address, "".join(lanes[address])))
+
+
+def write_svg(commands, path, bus_hz):
+    if not commands:
+        sys.exit("No command to draw")
+    start = commands[0].start_us
+    end = max(c.end_us for c in commands)
+    addresses = sorted({a.address for c in commands for a in c.accesses})
+    lane_height = 24
+    left = 60
+    width = 1600
+    scale = (width - left - 10) / float(max(end - start, 1))
+    height = 40 + lane_height * (len(addresses) + 1)
+    colors = {"w": "#4a90d9", "r": "#5cb85c", "X": "#d9534f"}
+
+    def x(t):
+        return left + (t - start) * scale
+
+    with open(path, "w") as f:
+        f.write('<svg xmlns="http://www.w3.org/2000/svg" width="%d" height="%d" font-family="monospace" font-size="11">\n'
+                % (width, height))
+        f.write('<text x="4" y="14">%.3fms .. %.3fms, bus %d Hz</text>\n' % (start / 1000.0, end / 1000.0, bus_hz))
+        bus_y = 24
+        f.write('<text x="4" y="%d">bus</text>\n' % (bus_y + 14))
+        for lane, address in enumerate(addresses):
+            f.write('<text x="4" y="%d">0x%02x</text>\n' % (bus_y + lane_height * (lane + 1) + 14, address))
+        for command in commands:
+            f.write('<rect x="%.2f" y="%d" width="%.2f" height="16" fill="#999"><title>%s</title></rect>\n'
+                    % (x(command.start_us), bus_y, max(command.duration_us() * scale, 0.5),
+                       format_command(command).strip()))
+            for access, (a_start, a_end) in zip(command.accesses, command.access_times()):
+                lane = addresses.index(access.address) + 1
+                kind = "X" if command.result != 0 else ("r" if access.read else "w")
+                f.write('<rect x="%.2f" y="%d" width="%.2f" height="16" fill="%s"><title>%.3fms %s %s</title></rect>\n'
+                        % (x(a_start), bus_y + lane_height * lane, max((a_end - a_start) * scale, 0.5), colors[kind],
+                           a_start / 1000.0, access.describe(), error_name(command.result)))
+        f.write("</svg>\n")
+    print("%s: %d commands, %d devices" % (path, len(commands), len(addresses)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", nargs="?", help="dump file or console capture (default stdin)")
+    parser.add_argument("--list", action="store_true", help="print every command")
+    parser.add_argument("--diagram", action="store_true", help="print a timing diagram, a lane per device")
+    parser.add_argument("--svg", help="write the timing diagram to an SVG file")
+    parser.add_argument("--from", dest="start_ms", type=float, help="diagram and list start (ms)")
+    parser.add_argument("--to", dest="end_ms", type=float, help="diagram and list end (ms)")
+    parser.add_argument("--window", type=float, default=10.0, help="utilisation window in ms (default 10)")
+    parser.add_argument("--width", type=int, default=100, help="diagram columns (default 100)")
+    args = parser.parse_args()
+
+    if args.window <= 0 or args.width <= 0:
+        sys.exit("The window and the width must be positive")
+    if args.trace:
+        with open(args.trace, errors="replace") as f:
+            header, accesses = parse(f)
+    else:
+        header, accesses = parse(sys.stdin)
+
+    unwrap(accesses)
+    commands = group(accesses)
+    print_summary(header, commands, args.window)
+
+    selected = select(commands, args.start_ms, args.end_ms)
+    if args.list:
+        print("\nCommands:")
+        for command in selected:
+            print(format_command(command))
+    if args.diagram:
+        print_diagram(selected, args.width)
+    if args.svg:
+        write_svg(selected, args.svg, header[1])
+
+
+if __name__ == "__main__":
+    main()
@@ -1,15 +1,27 @@
 #include "esp_log.h"
+#include "nvs_flash.h"
 
 #include "phonetastic_app.h"
 
 #include "caller.h"
+#include "asset_archive.h"
+#include "bell_stream.h"
+#include "channel_router.h"
 #include "diag_i2c.h"
 #include "diag_gpio_expander.h"
+#include "diag_player.h"
+#include "expander_int.h"
 #include "gpio_expander.h"
 #include "i2c_driver.h"
+#include "i2c_queue.h"
+#include "jack_matrix.h"
+#include "latency_probe.h"
+#include "phone_events.h"
 #include "play_sdcard_mp3_control_example.h"
 #include "player.h"
 #include "ringer.h"
+#include "sd_reader.h"
+#include "tone_stream.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -19,14 +31,25 @@ static const char *TAG = "app_main";
 
 void log_initialize() {
     esp_log_level_set("*", ESP_LOG_INFO);
+    esp_log_level_set(TAG_ASSET_ARCHIVE, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_BELL_STREAM, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_CALLER, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_CHANNEL_ROUTER, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_DIAG_GPIO_EXPANDER, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_DIAG_I2C, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_DIAG_PLAYER, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_EXPANDER_INT, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_GPIO_EXPANDER, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_I2C_DRIVER, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_I2C_QUEUE, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_JACK_MATRIX, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_LATENCY_PROBE, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_PHONE_EVENTS, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_PHONETASTIC_APP, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_PLAYER, ESP_LOG_VERBOSE);
     esp_log_level_set(TAG_RINGER, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_SD_READER, ESP_LOG_VERBOSE);
+    esp_log_level_set(TAG_TONE_STREAM, ESP_LOG_VERBOSE);
 
     ESP_LOGI(TAG, "=======================================");
     ESP_LOGE(TAG, "ERROR log level is enabled.");
@@ -40,11 +63,25 @@ void log_initialize() {
     ESP_LOGI(TAG, "=======================================");
 }
 
+// Stored settings: I2C bus profile
+void nvs_initialize() {
+    esp_err_t err = nvs_flash_init();
+    if(err == ESP_ERR_NVS_NO_FREE_PAGES) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(err);
+}
+
 void app_main(void) {
     log_initialize();
+    nvs_initialize();
 
     // ESP_ERROR_CHECK(diag_i2c_check());
+    // ESP_ERROR_CHECK(diag_i2c_sweep());
     //ESP_ERROR_CHECK(diag_gpio_expander_check());
+    // ESP_ERROR_CHECK(diag_player_bench_ringer());
+    // ESP_ERROR_CHECK(diag_player_bench_start());
 
     phonetastic_app_init();
 }
@@ -0,0 +1,118 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "app_tools.h"
+
+#include "asset_archive.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_ASSET_ARCHIVE;
+
+_Static_assert(sizeof(asst_header_t) == 16, "Archive header layout");
+_Static_assert(sizeof(asst_entry_t) == 64, "Archive index layout");
+
+static FILE *_file;
+static asst_entry_t *_entries;
+static int _entry_count;
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t asst_initialize(const char *path) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+    asst_header_t header;
+
+    asst_finalize();
+
+    _file = fopen(path, "rb");
+    if(_file == NULL) {
+        ESP_LOGW(TAG, "No archive %s, assets are read from their files", path);
+        err = ESP_ERR_NOT_FOUND;
+        goto end;
+    }
+
+    // No stdio buffer, set before any read: the header and the index are read
+    // in one fread() each, then the assets by offset reads (sd_reader.c)
+    setvbuf(_file, NULL, _IONBF, 0);
+
+    if(fread(&header, sizeof(header), 1, _file) != 1
+        || memcmp(header.magic, ASST_MAGIC, sizeof(header.magic)) != 0
+        || header.version != ASST_VERSION) {
+        ESP_LOGE(TAG, "Fail to read archive header of %s!", path);
+        err = ESP_ERR_INVALID_VERSION;
+        goto end;
+    }
+
+    _entries = calloc(header.entry_count, sizeof(asst_entry_t));
+    if(_entries == NULL && header.entry_count > 0) {
+        ESP_LOGE(TAG, "Fail to allocate archive index!");
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+
+    if(fread(_entries, sizeof(asst_entry_t), header.entry_count, _file) != header.entry_count) {
+        ESP_LOGE(TAG, "Fail to read archive index of %s!", path);
+        goto end;
+    }
+    _entry_count = header.entry_count;
+
+    for(int i = 0; i < _entry_count; i++) {
+        _entries[i].name[ASST_NAME_SIZE - 1] = '\0';
+        ESP_LOGD(TAG, "%2i %-40s %8u bytes at %u", i, _entries[i].name, _entries[i].length, _entries[i].offset);
+    }
+    ESP_LOGI(TAG, "%i assets in %s", _entry_count, path);
+    err = ESP_OK;
+
+    end:
+    if(err != ESP_OK) {
+        asst_finalize();
+    }
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+void asst_finalize() {
+    if(_file != NULL) {
+        fclose(_file);
+        _file = NULL;
+    }
+    free(_entries);
+    _entries = NULL;
+    _entry_count = 0;
+}
+
+int asst_find(const char *name) {
+    if(name == NULL) {
+        return ASST_ID_NONE;
+    }
+
+    if(strncmp(name, ASST_SDCARD_ROOT, strlen(ASST_SDCARD_ROOT)) == 0) {
+        name += strlen(ASST_SDCARD_ROOT);
+    }
+
+    for(int i = 0; i < _entry_count; i++) {
+        if(strcmp(_entries[i].name, name) == 0) {
+            return i;
+        }
+    }
+
+    return ASST_ID_NONE;
+}
+
+const asst_entry_t *asst_get_entry(int id) {
+    if(id < 0 || id >= _entry_count) {
+        return NULL;
+    }
+
+    return &_entries[id];
+}
+
+FILE *asst_get_file() {
+    return _file;
+}
+
+///////////////////////////////////////////////////////////////////////////////
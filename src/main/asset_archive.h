@@ -0,0 +1,57 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "esp_err.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_ASSET_ARCHIVE       "asset_archive"
+
+// Built by scripts/build_archive.py from the sdcard directory
+#define ASST_ARCHIVE_PATH       "/sdcard/assets.pak"
+#define ASST_SDCARD_ROOT        "/sdcard/"
+
+// Archive layout, little endian:
+//   header       asst_header_t
+//   index        entry_count * asst_entry_t
+//   assets       each one starts on a data_alignment boundary (SD sector)
+#define ASST_MAGIC              "PHPK"
+#define ASST_VERSION            1
+#define ASST_NAME_SIZE          48
+#define ASST_ID_NONE            (-1)
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t entry_count;
+    uint32_t data_alignment;
+    uint32_t reserved;
+} asst_header_t;
+
+typedef struct {
+    char name[ASST_NAME_SIZE];      // Path relative to the sdcard root, "ringtones/vintage.mp3"
+    uint32_t offset;                // First byte of the asset in the archive
+    uint32_t length;
+    uint32_t audio_offset;          // First byte after the ID3v2 tag, relative to offset
+    uint32_t reserved;
+} asst_entry_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Open the archive and load its index, once at boot. The archive stays open.
+esp_err_t asst_initialize(const char *path);
+void asst_finalize();
+
+// Asset id of a name or of a path under ASST_SDCARD_ROOT, ASST_ID_NONE if not archived.
+int asst_find(const char *name);
+const asst_entry_t *asst_get_entry(int id);
+
+// Archive file shared by the readers, NULL when no archive is loaded.
+FILE *asst_get_file();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // ASSET_ARCHIVE_H
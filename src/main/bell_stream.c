@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "bell_stream.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_BELL_STREAM;
+
+typedef struct {
+    bell_synth_cfg_t cfg;
+    bell_synth_t synth;
+} bell_stream_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static esp_err_t _bell_open(audio_element_handle_t self) {
+    bell_stream_t *bell = (bell_stream_t *)audio_element_getdata(self);
+    audio_element_info_t info = {0};
+
+    bell_synth_init(&bell->synth, &bell->cfg);
+
+    audio_element_getinfo(self, &info);
+    info.sample_rates = bell->cfg.sample_rate;
+    info.channels = 1;
+    info.bits = 16;
+    audio_element_setinfo(self, &info);
+
+    // Same event as a decoder, the player sets the i2s clock from it
+    audio_element_report_info(self);
+
+    ESP_LOGD(TAG, "Ring at %i Hz, %i strikes/s, on %ims, off %ims",
+        bell->cfg.sample_rate, bell->cfg.strike_rate_hz, bell->cfg.on_ms, bell->cfg.off_ms);
+    return ESP_OK;
+}
+
+static int _bell_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    bell_stream_t *bell = (bell_stream_t *)audio_element_getdata(self);
+
+    int sample_count = in_len / sizeof(int16_t);
+    bell_synth_render(&bell->synth, (int16_t *)in_buffer, sample_count);
+
+    return audio_element_output(self, in_buffer, sample_count * sizeof(int16_t));
+}
+
+static esp_err_t _bell_close(audio_element_handle_t self) {
+    return ESP_OK;
+}
+
+static esp_err_t _bell_destroy(audio_element_handle_t self) {
+    bell_stream_t *bell = (bell_stream_t *)audio_element_getdata(self);
+    audio_free(bell);
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+audio_element_handle_t bell_stream_init(bell_stream_cfg_t *config) {
+    if(!bell_synth_check_cfg(&config->synth)) {
+        ESP_LOGE(TAG, "Strike rate must be in ]0, %i] Hz, cadence positive!", config->synth.sample_rate / 2);
+        return NULL;
+    }
+
+    bell_stream_t *bell = audio_calloc(1, sizeof(bell_stream_t));
+    if(bell == NULL) {
+        ESP_LOGE(TAG, "Fail to allocate bell stream!");
+        return NULL;
+    }
+    bell->cfg = config->synth;
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _bell_open;
+    cfg.close = _bell_close;
+    cfg.process = _bell_process;
+    cfg.destroy = _bell_destroy;
+    cfg.buffer_len = BELL_STREAM_BUFFER_SIZE;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.tag = "bell";
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if(el == NULL) {
+        ESP_LOGE(TAG, "Fail to init bell stream element!");
+        audio_free(bell);
+        return NULL;
+    }
+
+    audio_element_setdata(el, bell);
+
+    return el;
+}
+
+esp_err_t bell_stream_set_cadence(audio_element_handle_t self, int strike_rate_hz, int on_ms, int off_ms) {
+    bell_stream_t *bell = (bell_stream_t *)audio_element_getdata(self);
+    if(bell == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bell_synth_cfg_t cfg = bell->cfg;
+    cfg.strike_rate_hz = strike_rate_hz;
+    cfg.on_ms = on_ms;
+    cfg.off_ms = off_ms;
+    if(!bell_synth_check_cfg(&cfg)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bell->cfg = cfg;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,47 @@
+#ifndef BELL_STREAM_H
+#define BELL_STREAM_H
+
+#include "audio_element.h"
+#include "esp_err.h"
+
+#include "bell_synth.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_BELL_STREAM                 "bell_stream"
+
+#define BELL_STREAM_BUFFER_SIZE         (512)
+#define BELL_STREAM_TASK_STACK          (2 * 1024)
+#define BELL_STREAM_TASK_CORE           (0)
+#define BELL_STREAM_TASK_PRIO           (5)
+#define BELL_STREAM_RINGBUFFER_SIZE     (2 * 1024)
+
+typedef struct {
+    bell_synth_cfg_t synth;     // Bell sound and cadence
+    int out_rb_size;            // Size of output ringbuffer
+    int task_stack;             // Task stack size
+    int task_core;              // Task running in core (0 or 1)
+    int task_prio;              // Task priority (based on freeRTOS priority)
+} bell_stream_cfg_t;
+
+#define BELL_STREAM_CFG_DEFAULT() {                 \
+    .synth          = BELL_SYNTH_CFG_DEFAULT(),     \
+    .out_rb_size    = BELL_STREAM_RINGBUFFER_SIZE,  \
+    .task_stack     = BELL_STREAM_TASK_STACK,       \
+    .task_core      = BELL_STREAM_TASK_CORE,        \
+    .task_prio      = BELL_STREAM_TASK_PRIO,        \
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Source element synthesizing the S63 ringer, mono 16 bits PCM.
+// Rings until the pipeline is stopped, no file and no decoder needed.
+audio_element_handle_t bell_stream_init(bell_stream_cfg_t *config);
+
+// Applied from the next run of the element. ESP_ERR_INVALID_ARG for a strike rate above
+// half the sample rate.
+esp_err_t bell_stream_set_cadence(audio_element_handle_t self, int strike_rate_hz, int on_ms, int off_ms);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // BELL_STREAM_H
@@ -0,0 +1,164 @@
+#include <math.h>
+#include <string.h>
+
+#include "dsp_sine.h"
+
+#include "bell_synth.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define Q15_ONE                 32767
+#define BELL_STRIKE_LEVEL       (Q15_ONE / 2)   // Envelope added by one hammer strike
+
+// Both bells have the same shape, the second one is tuned a bit higher
+static const float bell_fundamental_hz[BELL_COUNT] = { 1100.0f, 1320.0f };
+
+// Inharmonic partials of a small steel bell
+static const float mode_ratio[BELL_MODE_COUNT] = { 1.0f, 2.32f, 4.25f };
+static const float mode_level[BELL_MODE_COUNT] = { 0.28f, 0.16f, 0.08f };
+static const float mode_t60_s[BELL_MODE_COUNT] = { 0.70f, 0.35f, 0.15f };
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t ms_to_samples(int ms, int sample_rate) {
+    return (uint32_t)(((uint64_t)ms * sample_rate) / 1000);
+}
+
+static void update_envelopes(bell_synth_t *bell) {
+    for(int b = 0; b < BELL_COUNT; b++) {
+        for(int m = 0; m < BELL_MODE_COUNT; m++) {
+            bell_mode_t *mode = &bell->modes[b][m];
+            mode->envelope = (mode->envelope * mode->decay) >> 15;
+            mode->gain = (mode->envelope * mode->amplitude) >> 15;
+        }
+    }
+    bell->control_left = BELL_CONTROL_PERIOD;
+}
+
+static void strike(bell_synth_t *bell) {
+    for(int m = 0; m < BELL_MODE_COUNT; m++) {
+        bell_mode_t *mode = &bell->modes[bell->next_bell][m];
+        mode->envelope += BELL_STRIKE_LEVEL;
+        if(mode->envelope > Q15_ONE) {
+            mode->envelope = Q15_ONE;
+        }
+        mode->gain = (mode->envelope * mode->amplitude) >> 15;
+    }
+    bell->next_bell = (bell->next_bell + 1) % BELL_COUNT;
+    bell->next_strike = bell->strike_period;
+}
+
+static void next_cadence_phase(bell_synth_t *bell) {
+    if(bell->off_samples == 0) {
+        // Continuous ring
+        bell->ringing = 1;
+        bell->cadence_left = UINT32_MAX;
+        return;
+    }
+
+    bell->ringing = !bell->ringing;
+    bell->cadence_left = bell->ringing ? bell->on_samples : bell->off_samples;
+    bell->next_strike = 0;
+}
+
+static void render_modes(bell_synth_t *bell, int16_t *samples, uint32_t count) {
+    int32_t acc[BELL_CONTROL_PERIOD] = {0};
+
+    for(int b = 0; b < BELL_COUNT; b++) {
+        for(int m = 0; m < BELL_MODE_COUNT; m++) {
+            bell_mode_t *mode = &bell->modes[b][m];
+
+            if(mode->gain == 0) {
+                mode->phase += mode->phase_inc * count;
+                continue;
+            }
+
+            uint32_t phase = mode->phase;
+            for(uint32_t n = 0; n < count; n++) {
+                acc[n] += (dsp_sine(phase) * mode->gain) >> 15;
+                phase += mode->phase_inc;
+            }
+            mode->phase = phase;
+        }
+    }
+
+    for(uint32_t n = 0; n < count; n++) {
+        samples[n] = dsp_saturate16(acc[n]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool bell_synth_check_cfg(const bell_synth_cfg_t *cfg) {
+    return cfg->sample_rate > 0
+        && cfg->strike_rate_hz > 0 && cfg->strike_rate_hz <= cfg->sample_rate / 2
+        && cfg->on_ms >= 0 && cfg->off_ms >= 0;
+}
+
+void bell_synth_init(bell_synth_t *bell, const bell_synth_cfg_t *cfg) {
+    memset(bell, 0, sizeof(bell_synth_t));
+
+    // Float is only used here, the render path is fixed point
+    for(int b = 0; b < BELL_COUNT; b++) {
+        for(int m = 0; m < BELL_MODE_COUNT; m++) {
+            bell_mode_t *mode = &bell->modes[b][m];
+            float t60_periods = mode_t60_s[m] * cfg->sample_rate / BELL_CONTROL_PERIOD;
+
+            mode->phase_inc = DSP_PHASE_INC(bell_fundamental_hz[b] * mode_ratio[m], cfg->sample_rate);
+            mode->amplitude = (int32_t)(mode_level[m] * Q15_ONE);
+            mode->decay = (int32_t)(powf(0.001f, 1.0f / t60_periods) * Q15_ONE);
+        }
+    }
+
+    bell->strike_period = cfg->sample_rate / (cfg->strike_rate_hz > 0 ? cfg->strike_rate_hz : 1);
+    if(bell->strike_period == 0) {
+        // Strike rate above the sample rate, one strike per sample at most
+        bell->strike_period = 1;
+    }
+    bell->on_samples = ms_to_samples(cfg->on_ms, cfg->sample_rate);
+    bell->off_samples = ms_to_samples(cfg->off_ms, cfg->sample_rate);
+    if(bell->on_samples == 0) {
+        bell->off_samples = 0;
+    }
+
+    bell_synth_restart(bell);
+}
+
+void bell_synth_restart(bell_synth_t *bell) {
+    bell->ringing = 0;
+    next_cadence_phase(bell);
+    bell->next_strike = 0;
+    bell->control_left = 0;
+}
+
+void bell_synth_render(bell_synth_t *bell, int16_t *samples, size_t count) {
+    while(count > 0) {
+        if(bell->control_left == 0) {
+            update_envelopes(bell);
+        }
+        if(bell->cadence_left == 0) {
+            next_cadence_phase(bell);
+        }
+        if(bell->ringing && bell->next_strike == 0) {
+            strike(bell);
+        }
+
+        // Largest chunk without any event inside
+        uint32_t chunk = bell->control_left;
+        if(chunk > count) chunk = count;
+        if(chunk > bell->cadence_left) chunk = bell->cadence_left;
+        if(bell->ringing && chunk > bell->next_strike) chunk = bell->next_strike;
+
+        render_modes(bell, samples, chunk);
+
+        samples += chunk;
+        count -= chunk;
+        bell->control_left -= chunk;
+        bell->cadence_left -= chunk;
+        if(bell->ringing) {
+            bell->next_strike -= chunk;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
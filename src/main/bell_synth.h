@@ -0,0 +1,72 @@
+#ifndef BELL_SYNTH_H
+#define BELL_SYNTH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Procedural S63 ringer: a hammer striking alternately two bells.
+// Each bell is a set of modal oscillators (Q15 sine table) with an exponential decay.
+// Plain C, no ESP-IDF / ADF dependency, the output is mono signed 16 bits.
+
+#define BELL_COUNT              2
+#define BELL_MODE_COUNT         3
+#define BELL_CONTROL_PERIOD     32      // Envelopes are updated every 32 samples
+
+#define BELL_SAMPLE_RATE        22050
+#define BELL_STRIKE_RATE_HZ     50      // Mains driven hammer, 25 strikes per bell per second
+#define BELL_ON_MS              1500
+#define BELL_OFF_MS             3500
+
+typedef struct {
+    int sample_rate;
+    int strike_rate_hz;     // Hammer strikes per second, alternating between both bells, up to sample_rate / 2
+    int on_ms;              // Cadence, the hammer strikes during on_ms then rests during off_ms
+    int off_ms;             // 0 for a continuous ring
+} bell_synth_cfg_t;
+
+#define BELL_SYNTH_CFG_DEFAULT() {                  \
+    .sample_rate        = BELL_SAMPLE_RATE,         \
+    .strike_rate_hz     = BELL_STRIKE_RATE_HZ,      \
+    .on_ms              = BELL_ON_MS,               \
+    .off_ms             = BELL_OFF_MS,              \
+}
+
+typedef struct {
+    uint32_t phase;
+    uint32_t phase_inc;
+    int32_t amplitude;      // Q15, relative level of the mode
+    int32_t envelope;       // Q15
+    int32_t decay;          // Q15 factor applied every control period
+    int32_t gain;           // Q15, amplitude * envelope for the current control period
+} bell_mode_t;
+
+typedef struct {
+    bell_mode_t modes[BELL_COUNT][BELL_MODE_COUNT];
+    uint32_t strike_period;     // Samples between two strikes
+    uint32_t next_strike;       // Samples before the next strike
+    uint32_t on_samples;
+    uint32_t off_samples;
+    uint32_t cadence_left;      // Samples left in the current cadence phase
+    uint8_t ringing;            // Cadence phase, the hammer only strikes while ringing
+    uint8_t next_bell;
+    uint16_t control_left;      // Samples left in the current control period
+} bell_synth_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Rates and durations in range: a strike period of 2 samples at least.
+bool bell_synth_check_cfg(const bell_synth_cfg_t *cfg);
+
+void bell_synth_init(bell_synth_t *bell, const bell_synth_cfg_t *cfg);
+
+// Restart the cadence with a strike, the bells keep ringing out.
+void bell_synth_restart(bell_synth_t *bell);
+
+void bell_synth_render(bell_synth_t *bell, int16_t *samples, size_t count);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // BELL_SYNTH_H
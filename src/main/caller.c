@@ -1,6 +1,7 @@
 #include "esp_log.h"
 
 #include "app_tools.h"
+#include "asset_archive.h"
 #include "player.h"
 
 #include "caller.h"
@@ -9,12 +10,30 @@
 
 static const char *TAG = TAG_CALLER;
 static char *DEFAULT_CALLER_PATH = ELEVATOR_SONG_PATH;
+static char *PUZZLE_SOLVED_CALLER_PATH = PUZZLE_SOLVED_PATH;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void play(char *path) {
+    int asset_id = asst_find(path);
+    if(asset_id != ASST_ID_NONE) {
+        plyr_play_asset(asset_id, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+    } else {
+        plyr_play_right(path);
+    }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void cllr_play() {
     LOGM_FUNC_IN();
-    plyr_play_right(DEFAULT_CALLER_PATH);
+    play(DEFAULT_CALLER_PATH);
+    LOGM_FUNC_OUT();
+}
+
+void cllr_play_solved() {
+    LOGM_FUNC_IN();
+    play(PUZZLE_SOLVED_CALLER_PATH);
     LOGM_FUNC_OUT();
 }
 
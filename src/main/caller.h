@@ -6,10 +6,13 @@
 #define TAG_CALLER              "CALLER"
 #define PHONE_VOLUME            10
 #define ELEVATOR_SONG_PATH      "/sdcard/callers/elevator-song.mp3"
+#define PUZZLE_SOLVED_PATH      "/sdcard/callers/puzzle-solved.mp3"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 void cllr_play();
+// Message of the solved plugboard puzzle, in the handset.
+void cllr_play_solved();
 void cllr_stop();
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,317 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "channel_router.h"
+#include "latency_probe.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_CHANNEL_ROUTER;
+
+#define ROUTER_RELEASED_BIT     (1 << 0)
+
+typedef struct {
+    volatile pcm_route_t route;
+    audio_element_handle_t source;  // Upstream decoder, gives the channel count of the track
+    int channels;                   // Input channels of the current track, 0 until known
+    int carry;                      // Bytes of an incomplete frame kept for the next block
+    char carry_bytes[PCM_STEREO_FRAME_BYTES];
+    volatile int gate_on_ms;        // Gate requested for the next track, 0 to disable
+    volatile int gate_off_ms;
+    pcm_cadence_t gate;             // Open/closed frames of the current track
+    pcm_burst_t burst;              // First opening of the current track, replayed by the next ones
+    volatile bool held;             // Warm standby, nothing is read nor sent to i2s
+    EventGroupHandle_t events;      // ROUTER_RELEASED_BIT wakes up a held router
+    volatile bool first_read;       // No block read yet since open or release
+    volatile int64_t first_output_us;   // First frames sent since open or release, 0 until then
+} channel_router_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void get_input_info(audio_element_handle_t self, channel_router_t *router, audio_element_info_t *info) {
+    // The decoder sets its info before its first output, the one pushed
+    // to this element by the player event loop may arrive later.
+    if(router->source != NULL) {
+        audio_element_getinfo(router->source, info);
+    } else {
+        audio_element_getinfo(self, info);
+    }
+
+    if(info->channels != 1 && info->channels != 2) {
+        ESP_LOGW(TAG, "Unsupported channel count (%i), stereo is assumed", info->channels);
+        info->channels = 2;
+    }
+
+    ESP_LOGD(TAG, "Input channels: %i, sample rate: %i", info->channels, info->sample_rates);
+}
+
+static void free_burst(channel_router_t *router) {
+    if(router->burst.data != NULL) {
+        audio_free(router->burst.data);
+    }
+    pcmr_burst_init(&router->burst, NULL, 0);
+}
+
+static void start_track(audio_element_handle_t self, channel_router_t *router) {
+    audio_element_info_t info = {0};
+    get_input_info(self, router, &info);
+
+    router->channels = info.channels;
+    pcmr_cadence_init(&router->gate,
+        PCM_MS_TO_FRAMES(router->gate_on_ms, info.sample_rates),
+        PCM_MS_TO_FRAMES(router->gate_off_ms, info.sample_rates));
+
+    free_burst(router);
+    if(pcmr_cadence_enabled(&router->gate)) {
+        int size = router->gate.on_frames * router->channels * PCM_SAMPLE_BYTES;
+        char *data = audio_malloc(size);
+        if(data == NULL) {
+            ESP_LOGW(TAG, "Fail to allocate the %i bytes of a burst, each opening resumes the track!", size);
+        }
+        pcmr_burst_init(&router->burst, data, size);
+    }
+}
+
+static int output_silence(audio_element_handle_t self, channel_router_t *router, char *buffer, int len) {
+    // Gate closed: the decoder is not pulled, it just waits on its ringbuffer
+    uint32_t frame_count = pcmr_cadence_available(&router->gate, len / PCM_STEREO_FRAME_BYTES);
+    memset(buffer, 0, frame_count * PCM_STEREO_FRAME_BYTES);
+    pcmr_cadence_advance(&router->gate, frame_count);
+    return audio_element_output(self, buffer, frame_count * PCM_STEREO_FRAME_BYTES);
+}
+
+static int output_burst(audio_element_handle_t self, channel_router_t *router, char *buffer, int len) {
+    // Gate open again: the first opening is replayed from its start, the decoder is not
+    // pulled anymore, its ringbuffer stays full until the track is stopped
+    int frame_bytes = router->channels * PCM_SAMPLE_BYTES;
+    uint32_t frame_count = pcmr_cadence_available(&router->gate, len / PCM_STEREO_FRAME_BYTES);
+
+    pcmr_burst_replay(&router->burst, pcmr_cadence_position(&router->gate) * frame_bytes, buffer,
+        frame_count * frame_bytes);
+    if(router->channels == 1) {
+        pcmr_place_mono((int16_t *)buffer, frame_count, router->route);
+    } else {
+        pcmr_route_stereo((int16_t *)buffer, frame_count, router->route);
+    }
+    pcmr_cadence_advance(&router->gate, frame_count);
+    return audio_element_output(self, buffer, frame_count * PCM_STEREO_FRAME_BYTES);
+}
+
+static esp_err_t _router_open(audio_element_handle_t self) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+
+    router->channels = 0;
+    router->carry = 0;
+    router->first_read = true;
+    router->first_output_us = 0;
+    pcmr_cadence_init(&router->gate, 0, 0);
+    free_burst(router);
+    return ESP_OK;
+}
+
+static esp_err_t _router_close(audio_element_handle_t self) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    router->channels = 0;
+    router->carry = 0;
+    free_burst(router);
+    return ESP_OK;
+}
+
+static esp_err_t _router_destroy(audio_element_handle_t self) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    vEventGroupDelete(router->events);
+    free_burst(router);
+    audio_free(router);
+    return ESP_OK;
+}
+
+static int _router_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+
+    if(router->held) {
+        // Upstream elements fill their ringbuffers then block, the element
+        // task still handles its commands between two waits
+        xEventGroupWaitBits(router->events, ROUTER_RELEASED_BIT, pdFALSE, pdFALSE,
+            CHANNEL_ROUTER_HOLD_POLL_MS / portTICK_PERIOD_MS);
+        if(router->held) {
+            return AEL_IO_TIMEOUT;
+        }
+    }
+
+    if(!router->gate.on) {
+        return output_silence(self, router, in_buffer, in_len);
+    }
+    if(pcmr_burst_ready(&router->burst)) {
+        return output_burst(self, router, in_buffer, in_len);
+    }
+
+    // Mono input is expanded to stereo, only half of the buffer can be read
+    // until the track is known to be stereo
+    int max_in_len = (router->channels == 2) ? in_len : in_len / 2;
+    if(router->channels != 0) {
+        // Do not read past the closing of the gate
+        int frame_bytes = router->channels * PCM_SAMPLE_BYTES;
+        max_in_len = pcmr_cadence_available(&router->gate, max_in_len / frame_bytes) * frame_bytes;
+    }
+
+    // in_buffer is the element own buffer, it is kept between two calls
+    memcpy(in_buffer, router->carry_bytes, router->carry);
+    int r_size = audio_element_input(self, in_buffer + router->carry, max_in_len - router->carry);
+    if(r_size <= 0) {
+        return r_size;
+    }
+
+    if(router->first_read) {
+        router->first_read = false;
+        ltcy_mark(LTCY_STAGE_FIRST_DECODED);
+    }
+
+    if(router->channels == 0) {
+        start_track(self, router);
+    }
+
+    int frame_bytes = router->channels * PCM_SAMPLE_BYTES;
+    int available = router->carry + r_size;
+    int frame_count = available / frame_bytes;
+    int in_used = frame_count * frame_bytes;
+
+    // Keep the incomplete frame, ringbuffer reads are not frame aligned
+    router->carry = available - in_used;
+    memcpy(router->carry_bytes, in_buffer + in_used, router->carry);
+    if(pcmr_cadence_enabled(&router->gate)) {
+        pcmr_burst_record(&router->burst, in_buffer, in_used);
+    }
+
+    if(router->channels == 1) {
+        pcmr_place_mono((int16_t *)in_buffer, frame_count, router->route);
+    } else {
+        pcmr_route_stereo((int16_t *)in_buffer, frame_count, router->route);
+    }
+
+    int w_size = r_size;
+    if(frame_count > 0) {
+        w_size = audio_element_output(self, in_buffer, frame_count * PCM_STEREO_FRAME_BYTES);
+        pcmr_cadence_advance(&router->gate, frame_count);
+
+        if(router->first_output_us == 0) {
+            router->first_output_us = esp_timer_get_time();
+            ltcy_mark(LTCY_STAGE_FIRST_I2S_WRITE);
+        }
+    }
+
+    return w_size;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+audio_element_handle_t channel_router_init(channel_router_cfg_t *config) {
+    channel_router_t *router = audio_calloc(1, sizeof(channel_router_t));
+    if(router == NULL) {
+        ESP_LOGE(TAG, "Fail to allocate channel router!");
+        return NULL;
+    }
+    router->route = config->route;
+    pcmr_cadence_init(&router->gate, 0, 0);
+
+    router->events = xEventGroupCreate();
+    if(router->events == NULL) {
+        ESP_LOGE(TAG, "Fail to create channel router events!");
+        audio_free(router);
+        return NULL;
+    }
+    xEventGroupSetBits(router->events, ROUTER_RELEASED_BIT);
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _router_open;
+    cfg.close = _router_close;
+    cfg.process = _router_process;
+    cfg.destroy = _router_destroy;
+    cfg.buffer_len = CHANNEL_ROUTER_BUFFER_SIZE;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.tag = "router";
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if(el == NULL) {
+        ESP_LOGE(TAG, "Fail to init channel router element!");
+        vEventGroupDelete(router->events);
+        audio_free(router);
+        return NULL;
+    }
+
+    audio_element_setdata(el, router);
+
+    return el;
+}
+
+esp_err_t channel_router_set_route(audio_element_handle_t self, pcm_route_t route) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    if(router == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGD(TAG, "Route: %#02x => %#02x", router->route, route);
+    router->route = route;
+    return ESP_OK;
+}
+
+esp_err_t channel_router_set_source(audio_element_handle_t self, audio_element_handle_t source) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    if(router == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    router->source = source;
+    return ESP_OK;
+}
+
+esp_err_t channel_router_set_gate(audio_element_handle_t self, int on_ms, int off_ms) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    if(router == NULL || on_ms < 0 || off_ms < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    ESP_LOGD(TAG, "Gate: open %ims, closed %ims", on_ms, off_ms);
+    router->gate_on_ms = on_ms;
+    router->gate_off_ms = off_ms;
+    return ESP_OK;
+}
+
+pcm_route_t channel_router_get_route(audio_element_handle_t self) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    return router == NULL ? PCM_ROUTE_NONE : router->route;
+}
+
+esp_err_t channel_router_set_hold(audio_element_handle_t self, bool hold) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    if(router == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if(hold) {
+        xEventGroupClearBits(router->events, ROUTER_RELEASED_BIT);
+        router->held = true;
+    } else {
+        router->first_read = true;
+        router->first_output_us = 0;
+        router->held = false;
+        xEventGroupSetBits(router->events, ROUTER_RELEASED_BIT);
+    }
+    return ESP_OK;
+}
+
+int64_t channel_router_get_first_output_time(audio_element_handle_t self) {
+    channel_router_t *router = (channel_router_t *)audio_element_getdata(self);
+    return router == NULL ? 0 : router->first_output_us;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,68 @@
+#ifndef CHANNEL_ROUTER_H
+#define CHANNEL_ROUTER_H
+
+#include "audio_element.h"
+#include "esp_err.h"
+
+#include "pcm_router.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_CHANNEL_ROUTER              "channel_router"
+
+#define CHANNEL_ROUTER_BUFFER_SIZE      (1024)
+#define CHANNEL_ROUTER_TASK_STACK       (3 * 1024)
+#define CHANNEL_ROUTER_TASK_CORE        (0)
+#define CHANNEL_ROUTER_TASK_PRIO        (5)
+#define CHANNEL_ROUTER_RINGBUFFER_SIZE  (8 * 1024)
+#define CHANNEL_ROUTER_HOLD_POLL_MS     (20)    // Command latency of a held router
+
+typedef struct {
+    pcm_route_t route;      // Initial route
+    int out_rb_size;        // Size of output ringbuffer
+    int task_stack;         // Task stack size
+    int task_core;          // Task running in core (0 or 1)
+    int task_prio;          // Task priority (based on freeRTOS priority)
+} channel_router_cfg_t;
+
+#define DEFAULT_CHANNEL_ROUTER_CONFIG() {               \
+    .route          = PCM_ROUTE_BOTH,                   \
+    .out_rb_size    = CHANNEL_ROUTER_RINGBUFFER_SIZE,   \
+    .task_stack     = CHANNEL_ROUTER_TASK_STACK,        \
+    .task_core      = CHANNEL_ROUTER_TASK_CORE,         \
+    .task_prio      = CHANNEL_ROUTER_TASK_PRIO,         \
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Filter element placed between the decoder and the i2s writer.
+// Decoded PCM is sent to the left, the right or both I2S slots, the output is always stereo.
+// Mono input is placed on the selected slots, stereo input keeps only the selected slots.
+audio_element_handle_t channel_router_init(channel_router_cfg_t *config);
+
+// Change the route without stopping the pipeline, applied from the next PCM block.
+esp_err_t channel_router_set_route(audio_element_handle_t self, pcm_route_t route);
+
+pcm_route_t channel_router_get_route(audio_element_handle_t self);
+
+// Gate applied from the next track: on_ms of the track, then off_ms of silence, counted in frames.
+// The PCM of the first opening is kept (on_ms of the track, mono or stereo as decoded) and
+// replayed by the next ones, so every burst starts at the beginning of the track and the decoder
+// is no longer pulled. Without memory for it, each opening resumes the track where the previous
+// one stopped. on_ms == 0 disables the gate.
+esp_err_t channel_router_set_gate(audio_element_handle_t self, int on_ms, int off_ms);
+
+// Element read to know the channel count of each track, usually the decoder.
+esp_err_t channel_router_set_source(audio_element_handle_t self, audio_element_handle_t source);
+
+// A held router neither reads nor outputs: the pipeline runs, the source is opened and
+// the ringbuffers upstream are filled, then everything waits. Releasing it is the only
+// step left to start the sound.
+esp_err_t channel_router_set_hold(audio_element_handle_t self, bool hold);
+
+// esp_timer time of the first frames sent to i2s since the last open or release, 0 until then.
+int64_t channel_router_get_first_output_time(audio_element_handle_t self);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // CHANNEL_ROUTER_H
@@ -1,3 +1,9 @@
 #
 # Main Makefile. This is basically the same as a component makefile.
 #
+
+# GPIO expander device, MCP23016 by default (see gpio_expander.h)
+#CFLAGS += -DGPIO_EXPANDER_DEVICE=GPIO_EXPANDER_MCP23017
+
+# I2C transaction tracer, built in by default (see i2c_driver.h)
+#CFLAGS += -DI2C_TRACE=0
@@ -0,0 +1,107 @@
+#include <string.h>
+
+#include "debounce.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline int lowest_bit(uint16_t mask) {
+    return __builtin_ctz(mask);
+}
+
+static int64_t deadline(const dbnc_t *dbnc, int bit) {
+    if(dbnc->cfg.eager & (1u << bit)) {
+        return dbnc->hold_us[bit];
+    }
+    return dbnc->changed_us[bit] + dbnc->cfg.stable_us[bit];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void dbnc_cfg_default(dbnc_cfg_t *cfg, uint32_t stable_us) {
+    memset(cfg, 0, sizeof(dbnc_cfg_t));
+    dbnc_cfg_set_stable_time(cfg, 0xFFFF, stable_us);
+}
+
+void dbnc_cfg_set_stable_time(dbnc_cfg_t *cfg, uint16_t mask, uint32_t stable_us) {
+    for(int b = 0; b < DBNC_INPUT_COUNT; b++) {
+        if(mask & (1u << b)) {
+            cfg->stable_us[b] = stable_us;
+        }
+    }
+}
+
+void dbnc_init(dbnc_t *dbnc, const dbnc_cfg_t *cfg) {
+    memset(dbnc, 0, sizeof(dbnc_t));
+    dbnc->cfg = *cfg;
+    dbnc->raw = cfg->initial;
+    dbnc->state = cfg->initial;
+
+    // Stable since ever, the first change starts an edge
+    for(int b = 0; b < DBNC_INPUT_COUNT; b++) {
+        dbnc->changed_us[b] = INT64_MIN / 2;
+        dbnc->first_us[b] = INT64_MIN;
+    }
+}
+
+bool dbnc_update(dbnc_t *dbnc, uint16_t raw, int64_t now_us, dbnc_edges_t *edges) {
+    uint16_t toggled = raw ^ dbnc->raw;
+    uint16_t pending = raw ^ dbnc->state;
+    uint16_t leaving = pending & ~dbnc->pending;
+    uint16_t commit = 0;
+
+    dbnc->raw = raw;
+    dbnc->pending = pending;
+
+    edges->rising = 0;
+    edges->falling = 0;
+
+    // An edge starts on the first change after a stable period, not on its last bounce.
+    // An eager input leaving during its hold starts one too, the last edge is done.
+    for(uint16_t m = leaving; m != 0; m &= m - 1) {
+        int b = lowest_bit(m);
+        if(dbnc->first_us[b] == INT64_MIN || now_us - dbnc->changed_us[b] >= dbnc->cfg.stable_us[b]) {
+            dbnc->first_us[b] = now_us;
+        }
+    }
+    for(uint16_t m = toggled; m != 0; m &= m - 1) {
+        dbnc->changed_us[lowest_bit(m)] = now_us;
+    }
+
+    // Inputs back to their debounced state were bounces, nothing else to do
+    for(uint16_t m = pending; m != 0; m &= m - 1) {
+        int b = lowest_bit(m);
+        if(now_us >= deadline(dbnc, b)) {
+            commit |= 1u << b;
+            edges->timestamp_us[b] = dbnc->first_us[b];
+            dbnc->first_us[b] = INT64_MIN;
+            if(dbnc->cfg.eager & (1u << b)) {
+                dbnc->hold_us[b] = now_us + dbnc->cfg.stable_us[b];
+            }
+        }
+    }
+
+    if(commit != 0) {
+        dbnc->state ^= commit;
+        dbnc->pending &= ~commit;
+        edges->rising = commit & raw;
+        edges->falling = commit & ~raw;
+    }
+    edges->state = dbnc->state;
+
+    return commit != 0;
+}
+
+int64_t dbnc_next_deadline(const dbnc_t *dbnc) {
+    int64_t next = INT64_MAX;
+
+    for(uint16_t m = dbnc->pending; m != 0; m &= m - 1) {
+        int64_t time = deadline(dbnc, lowest_bit(m));
+        if(time < next) {
+            next = time;
+        }
+    }
+
+    return next;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,56 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Debounce and edge detection of a 16 bits port (a GP0/GP1 pair, GP0 in the low byte).
+// The whole port is handled with masks, only the bits changing are looked at one by one.
+// Timestamps are given by the caller (esp_timer_get_time()), no ESP-IDF dependency.
+
+#define DBNC_INPUT_COUNT        16
+#define DBNC_STABLE_US          20000   // Contact bounce of a hook switch or a jack
+
+typedef struct {
+    uint32_t stable_us[DBNC_INPUT_COUNT];   // Per input
+    uint16_t eager;         // Inputs reporting the first edge at once, then ignoring bounces for stable_us
+    uint16_t initial;       // State before the first sample
+} dbnc_cfg_t;
+
+typedef struct {
+    dbnc_cfg_t cfg;
+    uint16_t raw;           // Last sample
+    uint16_t state;         // Debounced
+    uint16_t pending;       // Inputs where the sample differs from the debounced state
+    int64_t changed_us[DBNC_INPUT_COUNT];   // Last sample change
+    int64_t first_us[DBNC_INPUT_COUNT];     // First sample away from the debounced state, INT64_MIN after an edge
+    int64_t hold_us[DBNC_INPUT_COUNT];      // Eager inputs, end of the bounce hold
+} dbnc_t;
+
+typedef struct {
+    uint16_t state;
+    uint16_t rising;
+    uint16_t falling;
+    int64_t timestamp_us[DBNC_INPUT_COUNT]; // First sample of the edge, rising | falling inputs only
+} dbnc_edges_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Every input with the same stable time, none eager.
+void dbnc_cfg_default(dbnc_cfg_t *cfg, uint32_t stable_us);
+void dbnc_cfg_set_stable_time(dbnc_cfg_t *cfg, uint16_t mask, uint32_t stable_us);
+
+void dbnc_init(dbnc_t *dbnc, const dbnc_cfg_t *cfg);
+
+// New sample of the port, true when edges holds at least one edge.
+bool dbnc_update(dbnc_t *dbnc, uint16_t raw, int64_t now_us, dbnc_edges_t *edges);
+
+// Time of the next edge without any new sample change, INT64_MAX when nothing is pending.
+// dbnc_update() must be called again at that time.
+int64_t dbnc_next_deadline(const dbnc_t *dbnc);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // DEBOUNCE_H
@@ -4,12 +4,14 @@
 #include "board.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 #include "esp_peripherals.h"
 #include "periph_button.h"
 
 #include "diag_gpio_expander.h"
 
 #include "app_tools.h"
+#include "debounce.h"
 #include "gpio_expander.h"
 #include "i2c_driver.h"
 
@@ -83,10 +85,31 @@ esp_err_t read_input_polling(TickType_t sleep, uint8_t nbLoop) {
     return err;
 }
 
+#define READ_TIMING_LOOPS       10
+
+void read_timing() {
+    uint8_t data;
+    uint16_t pair;
+
+    int64_t start = esp_timer_get_time();
+    for(int i = 0; i < READ_TIMING_LOOPS; i++) {
+        gpxp_readRegister(GPXP_REGISTER_IN, &data);
+    }
+    int64_t single_us = (esp_timer_get_time() - start) / READ_TIMING_LOOPS;
+
+    start = esp_timer_get_time();
+    for(int i = 0; i < READ_TIMING_LOOPS; i++) {
+        gpxp_readRegisterPair(REGISTER_GP0, &pair);
+    }
+    int64_t pair_us = (esp_timer_get_time() - start) / READ_TIMING_LOOPS;
+
+    ESP_LOGI(TAG, "GP0 read: %lld us, GP0+GP1 read: %lld us (%#04x)", (long long)single_us, (long long)pair_us, pair);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
-static clock_t previousTimeEvent;
-static uint8_t previousGp0value = 0;
+static dbnc_t _inputs;
+static int64_t previousTimeEvent;
 
 static esp_err_t _periph_event_handle(audio_event_iface_msg_t *event, void *context) {
     if((int)event->source_type != PERIPH_ID_BUTTON) {
@@ -96,22 +119,23 @@ static esp_err_t _periph_event_handle(audio_event_iface_msg_t *event, void *cont
     ESP_LOGV(TAG, "BUTTON[%d], event->event_id=%d", (int)event->data, event->cmd);
 
     if((int)event->data == get_input_rec_id() && event->cmd == PERIPH_BUTTON_PRESSED){
+        int64_t now = esp_timer_get_time();
         uint8_t gp0value;
 
         if(gpxp_readRegisterWithRetry(REGISTER_INTCAP0, &gp0value, 5) != ESP_OK) {
             ESP_LOGE(TAG, "Fail to read INTCAP0!");
         } else {
-            if(gp0value == previousGp0value) {
+            dbnc_edges_t edges;
+
+            if(!dbnc_update(&_inputs, gp0value, now, &edges)) {
                 ESP_LOGD(TAG, "No change on GP0!");
             } else {
+                uint16_t changed = edges.rising | edges.falling;
+                int64_t edgeTime = edges.timestamp_us[__builtin_ctz(changed)];
+                double duration = (double)(edgeTime - previousTimeEvent) / 1000000;
+                previousTimeEvent = edgeTime;
 
-                previousGp0value = gp0value;
-
-                clock_t currentTimeEvent = clock();
-                double duration = (double)(currentTimeEvent - previousTimeEvent) / CLOCKS_PER_SEC;
-                previousTimeEvent = currentTimeEvent;
-
-                ESP_LOGI(TAG, "GP0: %#02x (%lf)", gp0value, duration);
+                ESP_LOGI(TAG, "GP0: %#02x, rising %#02x, falling %#02x (%lf)", edges.state, edges.rising, edges.falling, duration);
             }
         }
     }
@@ -124,7 +148,10 @@ void read_input_inter(double duration_s) {
 
     const TickType_t sleep = 100 / portTICK_RATE_MS;
 
-    previousTimeEvent = clock();
+    dbnc_cfg_t dbnc_cfg;
+    dbnc_cfg_default(&dbnc_cfg, DBNC_STABLE_US);
+    dbnc_init(&_inputs, &dbnc_cfg);
+    previousTimeEvent = esp_timer_get_time();
 
     clock_t endTime = clock() + duration_s * CLOCKS_PER_SEC;
     unsigned long previousRemainingTime = -1;
@@ -161,7 +188,7 @@ void read_input_inter(double duration_s) {
 #define     COLUMN_1  0x01
 #define     COLUMN_2  0x02
 #define     COLUMN_3  0x04
-#define     LINE_1  0x01
+#define     LINE_1  0x20    // GP0.5, GP0.0 is the hook switch
 #define     LINE_2  0x02
 #define     LINE_3  0x04
 #define     LINE_4  0x08
@@ -227,6 +254,38 @@ void read_matrix() {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+// IPOL1 only inverts the inputs of GP1, all outputs: no effect on the board
+#define CYCLE_REGISTER          REGISTER_IPOL1
+
+esp_err_t diag_gpio_expander_cycle(uint8_t value, TickType_t timeout) {
+    esp_err_t err = ESP_FAIL;
+    uint8_t data;
+
+    i2c_cmd_handle_t cmd = i2c_createCommand();
+    i2c_writeByte(cmd, (GPIO_EXPANDER_ADDR << 1) | I2C_MASTER_WRITE);
+    i2c_writeByte(cmd, CYCLE_REGISTER);
+    i2c_writeByte(cmd, value);
+    err = i2c_executeCommandWithTimeout(cmd, timeout);
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    cmd = i2c_createCommand();
+    i2c_writeByte(cmd, (GPIO_EXPANDER_ADDR << 1) | I2C_MASTER_WRITE);
+    i2c_writeByte(cmd, CYCLE_REGISTER);
+    i2c_restart(cmd);
+    i2c_writeByte(cmd, (GPIO_EXPANDER_ADDR << 1) | I2C_MASTER_READ);
+    i2c_read(cmd, &data, 1);
+    err = i2c_executeCommandWithTimeout(cmd, timeout);
+
+    if(err == ESP_OK && data != value) {
+        err = ESP_ERR_INVALID_RESPONSE;
+    }
+    return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
 esp_err_t diag_gpio_expander_check(void) {
     LOGM_FUNC_IN();
     esp_err_t err = ESP_FAIL;
@@ -245,6 +304,12 @@ esp_err_t diag_gpio_expander_check(void) {
     err = gpxp_writeRegister(GPXP_REGISTER_OUT, 0xFF);
     ESP_ERROR_CHECK_WITHOUT_ABORT(err);
 
+    gpxp_stats_t stats;
+    gpxp_getStats(&stats);
+    ESP_LOGI(TAG, "Register writes: %u sent, %u elided", stats.writes, stats.elided_writes);
+
+    read_timing();
+
     //err = read_input_polling(500 / portTICK_RATE_MS, 100);
     //read_input_inter(300);
     read_matrix();
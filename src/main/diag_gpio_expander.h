@@ -1,6 +1,9 @@
 #ifndef DIAG_GPIO_EXPANDER_H
 #define DIAG_GPIO_EXPANDER_H
 
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
 #include "esp_err.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -11,6 +14,10 @@
 
 esp_err_t diag_gpio_expander_check(void);
 
+// One write / read back cycle of an expander register on the raw bus, without the
+// bus task retries nor the shadow registers. ESP_ERR_INVALID_RESPONSE on a mismatch.
+esp_err_t diag_gpio_expander_cycle(uint8_t value, TickType_t timeout);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // DIAG_GPIO_EXPANDER_H
\ No newline at end of file
@@ -1,10 +1,16 @@
+#include <stdio.h>
+#include <string.h>
+
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_timer.h"
 
 #include "audio_hal.h"
 #include "board.h"
 
+#include "app_tools.h"
 #include "diag_i2c.h"
+#include "diag_gpio_expander.h"
 #include "gpio_expander.h"
 #include "i2c_driver.h"
 
@@ -78,4 +84,159 @@ esp_err_t diag_i2c_check(void) {
     return err;
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Sweep
+
+#define SWEEP_CYCLES            2000    // Write / read back cycles per profile
+#define SWEEP_MAX_ERRORS        20      // The profile is dropped, no need to go on
+#define SWEEP_TIMEOUT           (50 / portTICK_RATE_MS)
+
+// The ES8388 codec shares the bus: no more than fast mode
+static const uint32_t sweep_freqs[] = { 100000, 200000, 300000, 400000 };
+static const uint8_t sweep_filters[] = { 7, 3, 0 };
+static const int32_t sweep_timeouts[] = { I2C_TIMEOUT_CYCLES_DEFAULT, 8000 };
+
+#define SWEEP_POINTS    (sizeof(sweep_freqs) / sizeof(sweep_freqs[0]) \
+                        * sizeof(sweep_filters) / sizeof(sweep_filters[0]) \
+                        * sizeof(sweep_timeouts) / sizeof(sweep_timeouts[0]))
+
+typedef struct {
+    i2c_profile_t profile;
+    uint32_t cycles;
+    uint32_t errors;        // Bus errors
+    uint32_t mismatches;    // Read back value different from the written one
+    uint32_t mean_us;
+    uint32_t max_us;
+} sweep_point_t;
+
+static sweep_point_t sweep_points[SWEEP_POINTS];
+
+static void sweep_run(sweep_point_t *point) {
+    int64_t total_us = 0;
+
+    i2c_setProfile(&point->profile);
+
+    for(uint32_t i = 0; i < SWEEP_CYCLES; i++) {
+        uint8_t value = (uint8_t)(i ^ 0x55);
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = diag_gpio_expander_cycle(value, SWEEP_TIMEOUT);
+        uint32_t duration_us = (uint32_t)(esp_timer_get_time() - start);
+
+        point->cycles++;
+        total_us += duration_us;
+        if(duration_us > point->max_us) {
+            point->max_us = duration_us;
+        }
+
+        if(err == ESP_ERR_INVALID_RESPONSE) {
+            point->mismatches++;
+        } else if(err != ESP_OK) {
+            point->errors++;
+            i2c_recover();
+        }
+        if(point->errors + point->mismatches > SWEEP_MAX_ERRORS) {
+            break;
+        }
+    }
+
+    point->mean_us = (uint32_t)(total_us / point->cycles);
+    ESP_LOGI(TAG, "%6u Hz, filter %u, timeout %6i: %4u cycles, %3u errors, %3u mismatches, mean %4uus, max %5uus",
+        point->profile.freq_hz, point->profile.filter_cycles, point->profile.timeout_cycles,
+        point->cycles, point->errors, point->mismatches, point->mean_us, point->max_us);
+}
+
+// Highest clock without any error, at the same clock the widest filter and timeout (swept first)
+static sweep_point_t *sweep_best() {
+    sweep_point_t *best = NULL;
+
+    for(int i = 0; i < SWEEP_POINTS; i++) {
+        sweep_point_t *point = &sweep_points[i];
+        if(point->cycles != SWEEP_CYCLES || point->errors != 0 || point->mismatches != 0) {
+            continue;
+        }
+        if(best == NULL || point->profile.freq_hz > best->profile.freq_hz) {
+            best = point;
+        }
+    }
+    return best;
+}
+
+esp_err_t diag_i2c_sweep(void) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+    int count = 0;
+
+    // The bus is installed by the audio board, like in the application
+    audio_board_init();
+    i2c_initialize(false);
+
+    for(int f = 0; f < sizeof(sweep_freqs) / sizeof(sweep_freqs[0]); f++) {
+        for(int g = 0; g < sizeof(sweep_filters) / sizeof(sweep_filters[0]); g++) {
+            for(int t = 0; t < sizeof(sweep_timeouts) / sizeof(sweep_timeouts[0]); t++) {
+                sweep_point_t *point = &sweep_points[count++];
+                memset(point, 0, sizeof(sweep_point_t));
+                point->profile.freq_hz = sweep_freqs[f];
+                point->profile.filter_cycles = sweep_filters[g];
+                point->profile.timeout_cycles = sweep_timeouts[t];
+                sweep_run(point);
+            }
+        }
+    }
+
+    // The register written by the cycles back to its reset value
+    i2c_profile_t profile = I2C_PROFILE_DEFAULT();
+    i2c_setProfile(&profile);
+    diag_gpio_expander_cycle(0x00, SWEEP_TIMEOUT);
+
+    sweep_point_t *best = sweep_best();
+    if(best == NULL) {
+        ESP_LOGE(TAG, "No error free bus profile, default profile kept!");
+        i2c_eraseProfile();
+        goto end;
+    }
+
+    ESP_LOGI(TAG, "Best bus profile: %u Hz, filter %u, timeout %i, mean cycle %uus",
+        best->profile.freq_hz, best->profile.filter_cycles, best->profile.timeout_cycles, best->mean_us);
+
+    err = i2c_saveProfile(&best->profile);
+    if(err == ESP_OK) {
+        err = i2c_setProfile(&best->profile);
+    }
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t diag_i2c_trace_dump(const char *path) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_OK;
+    FILE *out = stdout;
+
+    if(path != NULL) {
+        out = fopen(path, "w");
+        if(out == NULL) {
+            ESP_LOGE(TAG, "Fail to open %s!", path);
+            err = ESP_FAIL;
+            goto end;
+        }
+    }
+
+    size_t count = i2c_dumpTrace(out);
+
+    if(out != stdout) {
+        if(fclose(out) != 0) {
+            ESP_LOGE(TAG, "Fail to write %s!", path);
+            err = ESP_FAIL;
+            goto end;
+        }
+    }
+    ESP_LOGI(TAG, "%u I2C trace records dumped to %s", (unsigned)count, path != NULL ? path : "the console");
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
@@ -11,6 +11,18 @@
 
 esp_err_t diag_i2c_check(void);
 
+// Characterisation of the bus on the board wiring: every clock, glitch filter and timeout
+// setting is checked with expander write / read back cycles. The fastest error free profile
+// is saved in NVS, i2c_initialize() applies it at the next boot.
+esp_err_t diag_i2c_sweep(void);
+
+#define DIAG_I2C_TRACE_PATH "/sdcard/i2c_trace.txt"
+
+// Dump of the I2C transaction trace to a file (DIAG_I2C_TRACE_PATH), or to the console (UART)
+// when path is NULL. Render it with scripts/i2c_trace_decode.py. With stop_after_error set
+// (i2ct_set_cfg()), the trace keeps the records around the first failed command.
+esp_err_t diag_i2c_trace_dump(const char *path);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // DIAG_I2C_H
\ No newline at end of file
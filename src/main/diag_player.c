@@ -0,0 +1,262 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "audio_element.h"
+#include "audio_event_iface.h"
+#include "audio_pipeline.h"
+#include "board.h"
+#include "esp_peripherals.h"
+#include "mp3_decoder.h"
+
+#include "diag_player.h"
+
+#include "app_tools.h"
+#include "bell_synth.h"
+#include "caller.h"
+#include "player.h"
+#include "ringer.h"
+#include "sd_reader.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define BENCH_SECONDS           5
+#define BENCH_BLOCK_SAMPLES     256     // Same block as the bell stream element
+#define BENCH_START_RUNS        5
+#define BENCH_ARM_DELAY_MS      500     // Time given to the armed source to fill the ringbuffers
+#define BENCH_START_TIMEOUT_MS  3000
+
+static const char *TAG = TAG_DIAG_PLAYER;
+
+static int16_t bench_block[BENCH_BLOCK_SAMPLES];
+static int64_t null_sink_bytes;
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Last element of the benchmark pipeline, decoded PCM is only counted
+static int null_sink_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    if(r_size > 0) {
+        null_sink_bytes += r_size;
+    }
+    return r_size;
+}
+
+static audio_element_handle_t create_null_sink() {
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.process = null_sink_process;
+    cfg.buffer_len = 2048;
+    cfg.task_stack = 2 * 1024;
+    cfg.tag = "null";
+    return audio_element_init(&cfg);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// CPU: the loop runs on the calling task, nothing else to wait for
+static int64_t bench_bell_synth() {
+    bell_synth_t synth;
+    bell_synth_cfg_t cfg = BELL_SYNTH_CFG_DEFAULT();
+    cfg.on_ms = RINGTONE_BURST_MS;
+    cfg.off_ms = RINGTONE_SILENCE_MS;
+    cfg.strike_rate_hz = RINGTONE_STRIKE_RATE_HZ;
+    bell_synth_init(&synth, &cfg);
+
+    int64_t start = esp_timer_get_time();
+    for(int i = 0; i < BENCH_SECONDS * cfg.sample_rate; i += BENCH_BLOCK_SAMPLES) {
+        bell_synth_render(&synth, bench_block, BENCH_BLOCK_SAMPLES);
+    }
+    int64_t duration = esp_timer_get_time() - start;
+
+    ESP_LOGI(TAG, "Bell synthesizer: %lld us for %i s of audio", (long long)duration, BENCH_SECONDS);
+    return duration / BENCH_SECONDS;
+}
+
+// Wall time of the reader, decoder and sink tasks, SD waits included. Not a CPU figure:
+// run time stats are disabled in sdkconfig and the tasks may use both cores.
+static int64_t bench_mp3(esp_periph_set_handle_t set) {
+    int64_t cost = -1;
+
+    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
+    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
+    mem_assert(pipeline);
+
+    sd_reader_cfg_t sd_reader_cfg = SD_READER_CFG_DEFAULT();
+    audio_element_handle_t reader = sd_reader_init(&sd_reader_cfg);
+    mp3_decoder_cfg_t mp3_decoder_cfg = DEFAULT_MP3_DECODER_CONFIG();
+    audio_element_handle_t decoder = mp3_decoder_init(&mp3_decoder_cfg);
+    audio_element_handle_t sink = create_null_sink();
+
+    audio_pipeline_register(pipeline, reader,  "file");
+    audio_pipeline_register(pipeline, decoder, "decoder");
+    audio_pipeline_register(pipeline, sink,    "null");
+    audio_pipeline_link(pipeline, (const char *[]){"file", "decoder", "null"}, 3);
+
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    audio_pipeline_set_listener(pipeline, evt);
+
+    audio_element_set_uri(reader, RINGTONE_VINTAGE_PATH);
+    null_sink_bytes = 0;
+
+    int64_t start = esp_timer_get_time();
+    audio_pipeline_run(pipeline);
+
+    while(true) {
+        audio_event_iface_msg_t msg;
+        if(audio_event_iface_listen(evt, &msg, portMAX_DELAY) != ESP_OK) {
+            continue;
+        }
+
+        if(msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
+            && msg.source == (void *) sink
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
+            && audio_element_get_state(sink) == AEL_STATE_FINISHED) {
+            break;
+        }
+
+        if(msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
+            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS
+            && audio_element_get_state((audio_element_handle_t) msg.source) == AEL_STATE_ERROR) {
+            ESP_LOGE(TAG, "Fail to decode %s!", RINGTONE_VINTAGE_PATH);
+            goto end;
+        }
+    }
+
+    int64_t duration = esp_timer_get_time() - start;
+
+    audio_element_info_t info = {0};
+    audio_element_getinfo(decoder, &info);
+    int64_t bytes_per_second = (int64_t)info.sample_rates * info.channels * (info.bits / 8);
+    if(bytes_per_second <= 0 || null_sink_bytes == 0) {
+        ESP_LOGE(TAG, "No audio decoded from %s!", RINGTONE_VINTAGE_PATH);
+        goto end;
+    }
+
+    int64_t audio_ms = null_sink_bytes * 1000 / bytes_per_second;
+    ESP_LOGI(TAG, "SD + MP3 decoder: %lld us for %lld ms of audio (%i Hz, %i ch)",
+        (long long)duration, (long long)audio_ms, info.sample_rates, info.channels);
+    cost = audio_ms > 0 ? duration * 1000 / audio_ms : -1;
+
+    end:
+    audio_pipeline_stop(pipeline);
+    audio_pipeline_wait_for_stop(pipeline);
+    audio_pipeline_terminate(pipeline);
+    audio_pipeline_unregister(pipeline, reader);
+    audio_pipeline_unregister(pipeline, decoder);
+    audio_pipeline_unregister(pipeline, sink);
+    audio_pipeline_remove_listener(pipeline);
+    audio_event_iface_destroy(evt);
+    audio_pipeline_deinit(pipeline);
+    audio_element_deinit(reader);
+    audio_element_deinit(decoder);
+    audio_element_deinit(sink);
+
+    return cost;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+esp_err_t diag_player_bench_ringer(void) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+
+    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
+    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    audio_board_sdcard_init(set, SD_MODE_1_LINE);
+
+    LOGM("before benchmark");
+    int64_t synth_cost = bench_bell_synth();
+    int64_t mp3_cost = bench_mp3(set);
+    LOGM("after benchmark");
+
+    // One second of audio is 1 000 000 us, the CPU cost is also the load in ppm of one core
+    ESP_LOGI(TAG, "Per second of ringer audio: synthesizer %lld us CPU (%.2f%% of one core), "
+        "SD + MP3 pipeline %lld us wall time (CPU not measured)",
+        (long long)synth_cost, synth_cost / 10000.0, (long long)mp3_cost);
+
+    if(mp3_cost >= 0) {
+        err = ESP_OK;
+    }
+
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+static int64_t wait_start_latency() {
+    // The latency is timestamped by the router, polling only has to see it
+    int64_t deadline = esp_timer_get_time() + BENCH_START_TIMEOUT_MS * 1000LL;
+    while(esp_timer_get_time() < deadline) {
+        int64_t latency = plyr_get_start_latency_us();
+        if(latency >= 0) {
+            return latency;
+        }
+        vTaskDelay(1);
+    }
+    return -1;
+}
+
+static void log_start_latency(const char *name, int64_t *latencies, int count) {
+    int64_t sum = 0, max = 0;
+    for(int i = 0; i < count; i++) {
+        sum += latencies[i];
+        if(latencies[i] > max) {
+            max = latencies[i];
+        }
+    }
+    ESP_LOGI(TAG, "%s: avg %lld us, max %lld us over %i starts", name, (long long)(sum / count), (long long)max, count);
+}
+
+esp_err_t diag_player_bench_start(void) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+    int64_t cold[BENCH_START_RUNS];
+    int64_t armed[BENCH_START_RUNS];
+
+    esp_periph_config_t periph_cfg = DEFAULT_ESP_PERIPH_SET_CONFIG();
+    esp_periph_set_handle_t set = esp_periph_set_init(&periph_cfg);
+    audio_board_sdcard_init(set, SD_MODE_1_LINE);
+
+    audio_board_handle_t board = audio_board_init();
+    audio_hal_ctrl_codec(board->audio_hal, AUDIO_HAL_CODEC_MODE_DECODE, AUDIO_HAL_CTRL_START);
+
+    audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
+    audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
+    plyr_initialize(set, board, evt);
+
+    for(int i = 0; i < BENCH_START_RUNS; i++) {
+        // Stop, reset, run, open the file and decode before the first frames
+        plyr_play(ELEVATOR_SONG_PATH, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+        cold[i] = wait_start_latency();
+
+        // Armed ahead, the start only releases the router
+        plyr_arm(ELEVATOR_SONG_PATH, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+        vTaskDelay(BENCH_ARM_DELAY_MS / portTICK_PERIOD_MS);
+        plyr_start();
+        armed[i] = wait_start_latency();
+
+        if(cold[i] < 0 || armed[i] < 0) {
+            ESP_LOGE(TAG, "Fail to start %s!", ELEVATOR_SONG_PATH);
+            goto end;
+        }
+        ESP_LOGD(TAG, "Start %i: cold %lld us, armed %lld us", i, (long long)cold[i], (long long)armed[i]);
+    }
+
+    log_start_latency("Cold start (play)", cold, BENCH_START_RUNS);
+    log_start_latency("Warm start (arm + start)", armed, BENCH_START_RUNS);
+    err = ESP_OK;
+
+    end:
+    plyr_stop();
+    plyr_finalize();
+    audio_event_iface_destroy(evt);
+
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+///////////////////////////////////////////////////////////////////////////////
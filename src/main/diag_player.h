@@ -0,0 +1,20 @@
+#ifndef DIAG_PLAYER_H
+#define DIAG_PLAYER_H
+
+#include "esp_err.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#define TAG_DIAG_PLAYER "diag_player"
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Compare the CPU cost of one second of ringer audio: bell synthesizer vs SD + MP3 decoding.
+esp_err_t diag_player_bench_ringer(void);
+
+// Start latency of the player, cold play vs armed source started by plyr_start().
+esp_err_t diag_player_bench_start(void);
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // DIAG_PLAYER_H
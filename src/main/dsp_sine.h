@@ -0,0 +1,35 @@
+#ifndef DSP_SINE_H
+#define DSP_SINE_H
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Q15 sine table and 32 bits phase accumulator helpers for the synthesized audio sources.
+// No ESP-IDF / ADF dependency.
+
+#define DSP_SINE_TABLE_BITS     10
+#define DSP_SINE_TABLE_SIZE     (1 << DSP_SINE_TABLE_BITS)
+
+// Phase increment of a 32 bits accumulator for a frequency, a constant expression
+// when both arguments are constants.
+#define DSP_PHASE_INC(freq_hz, sample_rate) \
+    ((uint32_t)(((double)(freq_hz) * 4294967296.0) / (double)(sample_rate)))
+
+extern const int16_t dsp_sine_q15[DSP_SINE_TABLE_SIZE];
+
+///////////////////////////////////////////////////////////////////////////////
+
+static inline int16_t dsp_sine(uint32_t phase) {
+    return dsp_sine_q15[phase >> (32 - DSP_SINE_TABLE_BITS)];
+}
+
+static inline int16_t dsp_saturate16(int32_t value) {
+    if(value > INT16_MAX) return INT16_MAX;
+    if(value < INT16_MIN) return INT16_MIN;
+    return (int16_t)value;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // DSP_SINE_H
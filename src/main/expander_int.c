@@ -0,0 +1,176 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_tools.h"
+#include "gpio_expander.h"
+
+#include "expander_int.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define NOTIFY_INTERRUPT        (1 << 0)
+#define NOTIFY_POLL             (1 << 1)
+#define NOTIFY_STOP             (1 << 2)
+
+static const char *TAG = TAG_EXPANDER_INT;
+
+static gpio_num_t _gpio;
+static bool _isr_added;
+static gpxi_handler_t _handler;
+static void *_ctx;
+static TaskHandle_t _task;
+
+// Written in the ISR, read by the input task
+static volatile int64_t _interrupt_us;
+static volatile int64_t _poll_us;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void IRAM_ATTR gpxi_isr(void *args) {
+    BaseType_t woken = pdFALSE;
+
+    _interrupt_us = esp_timer_get_time();
+    xTaskNotifyFromISR(_task, NOTIFY_INTERRUPT, eSetBits, &woken);
+
+    if(woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void tx_inputWorker(void *args) {
+    LOGM_FUNC_IN();
+
+    uint32_t notified = 0;
+    uint16_t port;
+
+    while(!(notified & NOTIFY_STOP)) {
+        xTaskNotifyWait(0, UINT32_MAX, &notified, portMAX_DELAY);
+
+        if(notified & NOTIFY_INTERRUPT) {
+            int64_t interrupt_us = _interrupt_us;
+
+            // INTCAP0 and INTCAP1 in one repeated start transaction, it also releases INT
+            if(gpxp_readRegisterPair(REGISTER_INTCAP0, &port) != ESP_OK) {
+                ESP_LOGE(TAG, "Fail to read INTCAP!");
+            } else {
+                _handler(port, true, interrupt_us, _ctx);
+            }
+        }
+
+        if(notified & NOTIFY_POLL) {
+            if(gpxp_readRegisterPair(REGISTER_GP0, &port) != ESP_OK) {
+                ESP_LOGE(TAG, "Fail to read GP!");
+            } else {
+                _handler(port, false, _poll_us, _ctx);
+            }
+        }
+    }
+
+    LOGM_FUNC_OUT();
+    _task = NULL;
+    vTaskDelete(NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t gpxi_initialize(gpio_num_t gpio, gpxi_handler_t handler, void *ctx) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+
+    if(_task != NULL) {
+        ESP_LOGD(TAG, "Already initialized!");
+        err = ESP_OK;
+        goto end;
+    }
+
+    _gpio = gpio;
+    _handler = handler;
+    _ctx = ctx;
+
+    if(xTaskCreatePinnedToCore(
+        tx_inputWorker,             // Function to implement the task
+        "tx_inputWorker",           // Name of the task
+        GPXI_TASK_STACK,            // Stack size in words
+        NULL,                       // Task input parameter
+        GPXI_TASK_PRIO,             // Priority of the task
+        &_task,                     // Task handle.
+        GPXI_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Fail to create input task!");
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,     // External pull-up, none on GPIO34..39
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    err = gpio_config(&io_conf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to configure INT GPIO %i!", gpio);
+        goto end;
+    }
+
+    // Already installed by the button peripheral, the handler of this pin is replaced
+    err = gpio_install_isr_service(0);
+    if(err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Fail to install GPIO ISR service!");
+        goto end;
+    }
+
+    err = gpio_isr_handler_add(gpio, gpxi_isr, NULL);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to add INT GPIO handler!");
+        goto end;
+    }
+    _isr_added = true;
+
+    // INT may already be low, a first read releases it
+    xTaskNotify(_task, NOTIFY_INTERRUPT, eSetBits);
+
+    ESP_LOGI(TAG, "Expander INT on GPIO %i", gpio);
+
+    end:
+    if(err != ESP_OK) {
+        // Stop the input task and remove the handler, a later call starts over
+        gpxi_finalize();
+    }
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+void gpxi_finalize() {
+    LOGM_FUNC_IN();
+
+    if(_isr_added) {
+        gpio_isr_handler_remove(_gpio);
+        _isr_added = false;
+    }
+
+    if(_task != NULL) {
+        xTaskNotify(_task, NOTIFY_STOP, eSetBits);
+        while(_task != NULL) {
+            vTaskDelay(1);
+        }
+    }
+
+    LOGM_FUNC_OUT();
+}
+
+void gpxi_poll() {
+    if(_task == NULL) {
+        return;
+    }
+
+    _poll_us = esp_timer_get_time();
+    xTaskNotify(_task, NOTIFY_POLL, eSetBits);
+}
+
+///////////////////////////////////////////////////////////////////////////////
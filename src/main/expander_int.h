@@ -0,0 +1,37 @@
+#ifndef EXPANDER_INT_H
+#define EXPANDER_INT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_EXPANDER_INT        "expander_int"
+
+// MCP23016 INT output, active low. Still wired on the REC key pin of the LyraT (GPIO36,
+// input only, external pull-up): move the wire to a free pin to use REC again.
+#define GPXI_INT_GPIO           GPIO_NUM_36
+#define GPXI_TASK_STACK         (3 * 1024)
+#define GPXI_TASK_CORE          (0)
+#define GPXI_TASK_PRIO          (configMAX_PRIORITIES - 3)  // Above the audio elements
+
+// Port sample handler, called from the input task only.
+// interrupt: INTCAP pair read after an INT edge, else GP pair read by gpxi_poll().
+// time_us: esp_timer time of the INT edge or of the poll request.
+typedef void (*gpxi_handler_t)(uint16_t port, bool interrupt, int64_t time_us, void *ctx);
+
+///////////////////////////////////////////////////////////////////////////////
+
+// The GPIO expander must be initialized.
+esp_err_t gpxi_initialize(gpio_num_t gpio, gpxi_handler_t handler, void *ctx);
+void gpxi_finalize();
+
+// Sample the GP pair from the input task, e.g. from a debounce timer.
+void gpxi_poll();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // EXPANDER_INT_H
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
@@ -10,55 +11,169 @@
 #include "app_tools.h"
 #include "gpio_expander.h"
 #include "i2c_driver.h"
+#include "i2c_queue.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static const char *TAG = TAG_GPIO_EXPANDER;
 static bool initialized = false;
-static TickType_t wait_delay = 30 / portTICK_RATE_MS;
+
+#define GPXP_DEVICE_COUNT       (GPIO_EXPANDER_ADDR_MAX - GPIO_EXPANDER_ADDR_MIN + 1)
+
+// Last value written to each register of each expander, a GP write lands in OLAT
+typedef struct {
+    uint8_t registers[GPIO_EXPANDER_REGISTER_COUNT];
+    uint32_t valid;         // One bit per register
+} gpxp_shadow_t;
+
+#define GPXP_SHADOW_BIT(id)     ((uint32_t)1 << (id))
+
+static gpxp_shadow_t shadows[GPXP_DEVICE_COUNT];
+static SemaphoreHandle_t shadow_lock;   // Recursive, held from the cache check to the bus write
+static gpxp_stats_t stats;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static esp_err_t gpxp_readRegister_internal(uint8_t register_id, uint8_t *data) {
-    esp_err_t err = ESP_FAIL;
-    i2c_cmd_handle_t cmd = NULL;
+static gpxp_shadow_t *gpxp_getShadow(uint8_t address) {
+    return &shadows[address - GPIO_EXPANDER_ADDR_MIN];
+}
 
-    // Select register
-    cmd = i2c_createCommand();
-    i2c_writeByte(cmd, GPIO_EXPANDER_ADDR << 1 | WRITE_BIT);
-    i2c_writeByte(cmd, register_id);
-    err = i2c_executeCommand(cmd);
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to select GPIO expander register (%i) ! %s", register_id, esp_err_to_name(err));
-        goto end;
+static uint8_t gpxp_shadowRegister(uint8_t register_id) {
+    if(register_id == REGISTER_GP0 || register_id == REGISTER_GP1) {
+        return register_id - REGISTER_GP0 + REGISTER_OLAT0;
     }
+    return register_id;
+}
 
-    vTaskDelay(wait_delay);
+// Unknown device state after a bus error, the next writes go to the bus
+static void gpxp_invalidateShadow(uint8_t address) {
+    xSemaphoreTakeRecursive(shadow_lock, portMAX_DELAY);
+    gpxp_getShadow(address)->valid = 0;
+    xSemaphoreGiveRecursive(shadow_lock);
+}
 
-    // Send command
-    cmd = i2c_createCommand();
-    i2c_writeByte(cmd, GPIO_EXPANDER_ADDR << 1 | READ_BIT);
-    i2c_readByte(cmd, data);
-    err = i2c_executeCommand(cmd);
+// Register select and read in one transaction with a repeated start, the MCP23016
+// datasheet asks for no delay between register accesses. Reading on, the device
+// goes to the other register of the pair (GP0/GP1, INTCAP0/INTCAP1, ...): the MCP23016
+// alternates between them, the MCP23017 (sequential mode) moves to the next address.
+static esp_err_t gpxp_readRegisters_internal(uint8_t address, uint8_t register_id, uint8_t *data, size_t data_len) {
+    esp_err_t err = i2cq_read(I2CQ_CLIENT_EXPANDER, address, register_id, data, data_len);
     if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to send command to GPIO expander! %s", esp_err_to_name(err));
-        goto end;
+        ESP_LOGE(TAG, "Fail to read GPIO expander register (%#02x:%i)! %s", address, register_id, esp_err_to_name(err));
+        gpxp_invalidateShadow(address);
     }
+    return err;
+}
 
-    vTaskDelay(wait_delay);
+static esp_err_t gpxp_readRegister_internal(uint8_t register_id, uint8_t *data) {
+    return gpxp_readRegisters_internal(GPIO_EXPANDER_ADDR, register_id, data, 1);
+}
 
-    err = ESP_OK;
+// Write through the shadow registers, only the bytes changing the device go to the bus.
+// Writing on also alternates between both registers of the pair.
+static esp_err_t gpxp_writeRegisters_internal(uint8_t address, uint8_t register_id, uint8_t *data, size_t data_len) {
+    esp_err_t err = ESP_OK;
+    gpxp_shadow_t *shadow = gpxp_getShadow(address);
+    size_t first = data_len;
+    size_t last = 0;
+
+    xSemaphoreTakeRecursive(shadow_lock, portMAX_DELAY);
+
+    for(size_t i = 0; i < data_len; i++) {
+        uint8_t shadow_id = gpxp_shadowRegister(register_id ^ (i & 1));
+        if(!(shadow->valid & GPXP_SHADOW_BIT(shadow_id)) || shadow->registers[shadow_id] != data[i]) {
+            if(first == data_len) {
+                first = i;
+            }
+            last = i;
+        }
+    }
+
+    if(first == data_len) {
+        stats.elided_writes++;
+        goto end;
+    }
+
+    err = i2cq_write(I2CQ_CLIENT_EXPANDER, address, register_id ^ (first & 1), &data[first], last - first + 1);
+    stats.writes++;
+
+    for(size_t i = first; i <= last; i++) {
+        uint8_t shadow_id = gpxp_shadowRegister(register_id ^ (i & 1));
+        if(err == ESP_OK) {
+            shadow->registers[shadow_id] = data[i];
+            shadow->valid |= GPXP_SHADOW_BIT(shadow_id);
+        } else {
+            shadow->valid &= ~GPXP_SHADOW_BIT(shadow_id);
+        }
+    }
 
     end:
+    xSemaphoreGiveRecursive(shadow_lock);
     return err;
 }
 
 static esp_err_t gpxp_writeRegister_internal(uint8_t register_id, uint8_t data) {
-    i2c_cmd_handle_t cmd = i2c_createCommand();
-    i2c_writeByte(cmd, (GPIO_EXPANDER_ADDR << 1) | WRITE_BIT);
-    i2c_writeByte(cmd, register_id);
-    i2c_writeByte(cmd, data);
-    return i2c_executeCommand(cmd);
+    return gpxp_writeRegisters_internal(GPIO_EXPANDER_ADDR, register_id, &data, 1);
+}
+
+// Read-modify-write, the current value comes from the shadow register when known
+static esp_err_t gpxp_updateRegister_internal(uint8_t address, uint8_t register_id, uint8_t mask, uint8_t value) {
+    esp_err_t err = ESP_OK;
+    gpxp_shadow_t *shadow = gpxp_getShadow(address);
+    uint8_t shadow_id = gpxp_shadowRegister(register_id);
+    uint8_t current;
+
+    xSemaphoreTakeRecursive(shadow_lock, portMAX_DELAY);
+
+    if(shadow->valid & GPXP_SHADOW_BIT(shadow_id)) {
+        current = shadow->registers[shadow_id];
+    } else {
+        err = gpxp_readRegisters_internal(address, shadow_id, &current, 1);
+        if(err != ESP_OK) {
+            goto end;
+        }
+        shadow->registers[shadow_id] = current;
+        shadow->valid |= GPXP_SHADOW_BIT(shadow_id);
+    }
+
+    current = (current & ~mask) | (value & mask);
+    err = gpxp_writeRegisters_internal(address, register_id, &current, 1);
+
+    end:
+    xSemaphoreGiveRecursive(shadow_lock);
+    return err;
+}
+
+#if GPIO_EXPANDER_DEVICE == GPIO_EXPANDER_MCP23016
+
+// Any input change raises INT
+static void gpxp_configureInterrupt(uint8_t address, uint16_t inputs) {
+    // Fast interrupt sampling, the hook change is seen within 200us
+    uint8_t iocon = IOCON_IARES;
+    gpxp_writeRegisters_internal(address, REGISTER_IOCON0, &iocon, 1);
+}
+
+#elif GPIO_EXPANDER_DEVICE == GPIO_EXPANDER_MCP23017
+
+// Interrupt on change of every input, compared with the previous value, one INT pin
+static void gpxp_configureInterrupt(uint8_t address, uint16_t inputs) {
+    uint8_t iocon = IOCON_MIRROR | IOCON_ODR;
+    uint8_t intcon[2] = { 0x00, 0x00 };
+    uint8_t gpinten[2] = { inputs & 0xFF, inputs >> 8 };
+
+    gpxp_writeRegisters_internal(address, REGISTER_IOCON0, &iocon, 1);
+    gpxp_writeRegisters_internal(address, REGISTER_INTCON0, intcon, sizeof(intcon));
+    gpxp_writeRegisters_internal(address, REGISTER_GPINTEN0, gpinten, sizeof(gpinten));
+}
+
+#endif
+
+static bool gpxp_isValidAddress(uint8_t address) {
+    if(address < GPIO_EXPANDER_ADDR_MIN || address > GPIO_EXPANDER_ADDR_MAX) {
+        ESP_LOGE(TAG, "Invalid GPIO expander address %#02x!", address);
+        return false;
+    }
+    return true;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -74,6 +189,14 @@ esp_err_t gpxp_initialize(bool i2cInstallDriver) {
         goto end;
     }
 
+    if(shadow_lock == NULL) {
+        shadow_lock = xSemaphoreCreateRecursiveMutex();
+        if(shadow_lock == NULL) {
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+    }
+
     // Initialize I2C
     err = i2c_initialize(i2cInstallDriver);
     if(err != ESP_OK) {
@@ -81,19 +204,37 @@ esp_err_t gpxp_initialize(bool i2cInstallDriver) {
         goto end;
     }
 
+#if GPIO_EXPANDER_BUS_FREQ_HZ != I2C_MASTER_FREQ_HZ
+    // A characterised profile (diag_i2c_sweep()) wins
+    if(!i2c_hasStoredProfile()) {
+        err = i2c_setFrequency(GPIO_EXPANDER_BUS_FREQ_HZ);
+        if(err != ESP_OK) {
+            ESP_LOGE(TAG, "Fail to set the I2C bus to %i Hz!", GPIO_EXPANDER_BUS_FREQ_HZ);
+            goto end;
+        }
+    }
+#endif
+    ESP_LOGI(TAG, "%s expanders, I2C bus at %u Hz", GPIO_EXPANDER_NAME, i2c_getFrequency());
+
+    // Every expander transaction goes through the bus task
+    err = i2cq_initialize();
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to i2cq_initialize!");
+        goto end;
+    }
+
     // Ping I2C
     i2c_ping(GPIO_EXPANDER_ADDR);
 
-    // I/O direction registers
-    gpxp_writeRegister_internal(REGISTER_IODIR0, 0xFF);  // IN
-    gpxp_writeRegister_internal(REGISTER_IODIR1, 0x00);  // OUT
+    // I/O direction registers, GP0 IN, GP1 OUT
+    uint8_t iodir[2] = { 0xFF, 0x00 };
+    gpxp_writeRegisters_internal(GPIO_EXPANDER_ADDR, REGISTER_IODIR0, iodir, sizeof(iodir));
 
     // Input polarity registers
-    gpxp_writeRegister_internal(REGISTER_IPOL0, 0x00);
-    gpxp_writeRegister_internal(REGISTER_IPOL1, 0x00);
+    uint8_t ipol[2] = { 0x00, 0x00 };
+    gpxp_writeRegisters_internal(GPIO_EXPANDER_ADDR, REGISTER_IPOL0, ipol, sizeof(ipol));
 
-    // High resolution iterut
-    gpxp_writeRegister_internal(REGISTER_IOCON0, 0X00);
+    gpxp_configureInterrupt(GPIO_EXPANDER_ADDR, iodir[0] | (iodir[1] << 8));
 
     err = ESP_OK;
 
@@ -123,8 +264,6 @@ esp_err_t gpxp_readRegister(uint8_t register_id, uint8_t *data) {
 
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Fail to read register (register ID: %i)! %s", register_id, esp_err_to_name(err));
-        ESP_LOGW(TAG, "Reset I2C buffers!");
-        i2c_reset(I2C_MASTER_NUM);
     }
 
     end:
@@ -158,11 +297,6 @@ esp_err_t gpxp_readRegisterWithRetry(uint8_t registerId, uint8_t *data, uint8_t
         ESP_LOGD(TAG, "RemainingTry: %i, Err: %s", remainingTry, esp_err_to_name(err));
     } while (err != ESP_OK && remainingTry > 0);
 
-    if(err != ESP_OK) {
-        ESP_LOGW(TAG, "Reset I2C buffers!");
-        i2c_reset(I2C_MASTER_NUM);
-    }
-
     end:
     LOGM_FUNC_OUT();
     return err;
@@ -183,8 +317,6 @@ esp_err_t gpxp_writeRegister(uint8_t register_id, uint8_t data) {
 
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Fail to write register (register ID: %i)! %s", register_id, esp_err_to_name(err));
-        ESP_LOGW(TAG, "Reset I2C buffers!");
-        i2c_reset(I2C_MASTER_NUM);
     }
 
     end:
@@ -193,4 +325,165 @@ esp_err_t gpxp_writeRegister(uint8_t register_id, uint8_t data) {
     return err;
 }
 
-///////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+esp_err_t gpxp_readRegisterPair(uint8_t register_id, uint16_t *data) {
+    LOGM_FUNC_IN();
+
+    esp_err_t err = ESP_FAIL;
+    uint8_t pair[2];
+
+    if(!initialized) {
+        ESP_LOGE(TAG, "GPIO expander is not initialized, call gpxp_initialize() before!");
+        err = ESP_FAIL;
+        goto end;
+    }
+
+    // Both registers of the pair are read in the same transaction, so they are captured together
+    err = gpxp_readRegisters_internal(GPIO_EXPANDER_ADDR, register_id & ~0x01, pair, sizeof(pair));
+
+    if(err == ESP_OK) {
+        *data = ((uint16_t)pair[1] << 8) | pair[0];
+    }
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t gpxp_configureDevice(uint8_t address, uint16_t iodir) {
+    LOGM_FUNC_IN();
+
+    esp_err_t err = ESP_FAIL;
+    uint8_t pair[2];
+
+    if(!initialized) {
+        ESP_LOGE(TAG, "GPIO expander is not initialized, call gpxp_initialize() before!");
+        err = ESP_FAIL;
+        goto end;
+    }
+
+    if(!gpxp_isValidAddress(address)) {
+        err = ESP_ERR_INVALID_ARG;
+        goto end;
+    }
+
+    // I/O direction registers
+    pair[0] = iodir & 0xFF;
+    pair[1] = iodir >> 8;
+    err = gpxp_writeRegisters_internal(address, REGISTER_IODIR0, pair, sizeof(pair));
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to configure GPIO expander %#02x! %s", address, esp_err_to_name(err));
+        goto end;
+    }
+
+    // Input polarity registers
+    pair[0] = 0x00;
+    pair[1] = 0x00;
+    err = gpxp_writeRegisters_internal(address, REGISTER_IPOL0, pair, sizeof(pair));
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t gpxp_writeRegisterPairAt(uint8_t address, uint8_t register_id, uint16_t data) {
+    LOGM_FUNC_IN();
+
+    esp_err_t err = ESP_FAIL;
+    uint8_t pair[2] = { data & 0xFF, data >> 8 };
+
+    if(!initialized) {
+        ESP_LOGE(TAG, "GPIO expander is not initialized, call gpxp_initialize() before!");
+        err = ESP_FAIL;
+        goto end;
+    }
+
+    if(!gpxp_isValidAddress(address)) {
+        err = ESP_ERR_INVALID_ARG;
+        goto end;
+    }
+
+    err = gpxp_writeRegisters_internal(address, register_id & ~0x01, pair, sizeof(pair));
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to write register pair (%#02x:%i)! %s", address, register_id, esp_err_to_name(err));
+    }
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t gpxp_readRegisterPairAt(uint8_t address, uint8_t register_id, uint16_t *data) {
+    LOGM_FUNC_IN();
+
+    esp_err_t err = ESP_FAIL;
+    uint8_t pair[2];
+
+    if(!initialized) {
+        ESP_LOGE(TAG, "GPIO expander is not initialized, call gpxp_initialize() before!");
+        err = ESP_FAIL;
+        goto end;
+    }
+
+    if(!gpxp_isValidAddress(address)) {
+        err = ESP_ERR_INVALID_ARG;
+        goto end;
+    }
+
+    err = gpxp_readRegisters_internal(address, register_id & ~0x01, pair, sizeof(pair));
+
+    if(err == ESP_OK) {
+        *data = ((uint16_t)pair[1] << 8) | pair[0];
+    }
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t gpxp_updateRegister(uint8_t register_id, uint8_t mask, uint8_t value) {
+    return gpxp_updateRegisterAt(GPIO_EXPANDER_ADDR, register_id, mask, value);
+}
+
+esp_err_t gpxp_updateRegisterAt(uint8_t address, uint8_t register_id, uint8_t mask, uint8_t value) {
+    LOGM_FUNC_IN();
+
+    esp_err_t err = ESP_FAIL;
+
+    if(!initialized) {
+        ESP_LOGE(TAG, "GPIO expander is not initialized, call gpxp_initialize() before!");
+        err = ESP_FAIL;
+        goto end;
+    }
+
+    if(!gpxp_isValidAddress(address)) {
+        err = ESP_ERR_INVALID_ARG;
+        goto end;
+    }
+
+    err = gpxp_updateRegister_internal(address, register_id, mask, value);
+
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to update register (%#02x:%i)! %s", address, register_id, esp_err_to_name(err));
+    }
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+void gpxp_invalidateCache() {
+    if(shadow_lock == NULL) {
+        return;
+    }
+
+    for(uint8_t address = GPIO_EXPANDER_ADDR_MIN; address <= GPIO_EXPANDER_ADDR_MAX; address++) {
+        gpxp_invalidateShadow(address);
+    }
+}
+
+void gpxp_getStats(gpxp_stats_t *data) {
+    *data = stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -1,6 +1,8 @@
 #ifndef GPIO_EXPANDER_H
 #define GPIO_EXPANDER_H
 
+#include <stdint.h>
+
 #include "esp_err.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -9,6 +11,20 @@
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Expander device of every GPIO expander on the bus, selected at compile time:
+// CFLAGS += -DGPIO_EXPANDER_DEVICE=GPIO_EXPANDER_MCP23017 in component.mk
+#define GPIO_EXPANDER_MCP23016      16
+#define GPIO_EXPANDER_MCP23017      17
+
+#ifndef GPIO_EXPANDER_DEVICE
+#define GPIO_EXPANDER_DEVICE        GPIO_EXPANDER_MCP23016
+#endif
+
+#if GPIO_EXPANDER_DEVICE == GPIO_EXPANDER_MCP23016
+
+#define GPIO_EXPANDER_NAME      "MCP23016"
+#define GPIO_EXPANDER_BUS_FREQ_HZ   100000  // 400 kHz in the datasheet, but only 100 kHz works
+
 #define REGISTER_GP0        0x00    // DATA PORT REGISTER 0
 #define REGISTER_GP1        0x01    // DATA PORT REGISTER 1
 #define REGISTER_OLAT0      0x02    // OUTPUT LATCH REGISTER 0 
@@ -22,12 +38,58 @@
 #define REGISTER_IOCON0     0x0A    // I/O EXPANDER CONTROL REGISTER 0 
 #define REGISTER_IOCON1     0x0B    // I/O EXPANDER CONTROL REGISTER 1
 
+#define IOCON_IARES         0x01    // Inputs sampled every 200us for INT, instead of 32ms
+
+#define GPIO_EXPANDER_REGISTER_COUNT    (REGISTER_IOCON1 + 1)
+
+#elif GPIO_EXPANDER_DEVICE == GPIO_EXPANDER_MCP23017
+
+// Up to 1.7 MHz in the datasheet, but the ESP32 controller has no high speed mode
+// (master code) and the ES8388 codec shares the bus: fast mode
+#define GPIO_EXPANDER_NAME      "MCP23017"
+#define GPIO_EXPANDER_BUS_FREQ_HZ   400000
+
+// IOCON.BANK = 0, both registers of a pair are adjacent, port A first: 0 is A, 1 is B
+#define REGISTER_IODIR0     0x00    // I/O DIRECTION REGISTER A
+#define REGISTER_IODIR1     0x01    // I/O DIRECTION REGISTER B
+#define REGISTER_IPOL0      0x02    // INPUT POLARITY REGISTER A
+#define REGISTER_IPOL1      0x03    // INPUT POLARITY REGISTER B
+#define REGISTER_GPINTEN0   0x04    // INTERRUPT-ON-CHANGE ENABLE REGISTER A
+#define REGISTER_GPINTEN1   0x05    // INTERRUPT-ON-CHANGE ENABLE REGISTER B
+#define REGISTER_DEFVAL0    0x06    // DEFAULT COMPARE REGISTER A
+#define REGISTER_DEFVAL1    0x07    // DEFAULT COMPARE REGISTER B
+#define REGISTER_INTCON0    0x08    // INTERRUPT CONTROL REGISTER A
+#define REGISTER_INTCON1    0x09    // INTERRUPT CONTROL REGISTER B
+#define REGISTER_IOCON0     0x0A    // I/O EXPANDER CONFIGURATION REGISTER
+#define REGISTER_IOCON1     0x0B    // I/O EXPANDER CONFIGURATION REGISTER (same register)
+#define REGISTER_GPPU0      0x0C    // PULL-UP RESISTOR REGISTER A
+#define REGISTER_GPPU1      0x0D    // PULL-UP RESISTOR REGISTER B
+#define REGISTER_INTF0      0x0E    // INTERRUPT FLAG REGISTER A
+#define REGISTER_INTF1      0x0F    // INTERRUPT FLAG REGISTER B
+#define REGISTER_INTCAP0    0x10    // INTERRUPT CAPTURE REGISTER A
+#define REGISTER_INTCAP1    0x11    // INTERRUPT CAPTURE REGISTER B
+#define REGISTER_GP0        0x12    // PORT REGISTER A
+#define REGISTER_GP1        0x13    // PORT REGISTER B
+#define REGISTER_OLAT0      0x14    // OUTPUT LATCH REGISTER A
+#define REGISTER_OLAT1      0x15    // OUTPUT LATCH REGISTER B
+
+#define IOCON_MIRROR        0x40    // INTA and INTB on both pins
+#define IOCON_ODR           0x04    // Open drain INT, pulled up on the board like the MCP23016 one
+
+#define GPIO_EXPANDER_REGISTER_COUNT    (REGISTER_OLAT1 + 1)
+
+#else
+#error "Unknown GPIO_EXPANDER_DEVICE"
+#endif
+
 #define WRITE_BIT       I2C_MASTER_WRITE
 #define READ_BIT        I2C_MASTER_READ
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 #define GPIO_EXPANDER_ADDR  0x20    // I2C GPIO EXPANDER ADDRESS
+#define GPIO_EXPANDER_ADDR_MIN  0x20    // A0..A2 strapped, up to 8 expanders on the bus
+#define GPIO_EXPANDER_ADDR_MAX  0x27
 
 #define GPIO_0_0    0x01
 #define GPIO_0_1    0x02
@@ -51,9 +113,33 @@
 
 esp_err_t gpxp_initialize(bool i2cInstallDriver);
 esp_err_t gpxp_readRegister(uint8_t registerId, uint8_t *data);
+// Each transaction is already retried by the bus task (i2c_retry policy), nbRetry repeats the whole policy.
 esp_err_t gpxp_readRegisterWithRetry10(uint8_t registerId, uint8_t *data);
 esp_err_t gpxp_readRegisterWithRetry(uint8_t registerId, uint8_t *data, uint8_t nbRetry);
 esp_err_t gpxp_writeRegister(uint8_t registerId, uint8_t data);
+// Read both registers of a pair (GP0/GP1, INTCAP0/INTCAP1, ...) in one transaction.
+// Register 0 of the pair is the low byte of data.
+esp_err_t gpxp_readRegisterPair(uint8_t registerId, uint16_t *data);
+
+// Other expanders on the bus (GPIO_EXPANDER_ADDR_MIN..GPIO_EXPANDER_ADDR_MAX), gpxp_initialize() first.
+// iodir: GP0 in the low byte, a bit set for an input.
+esp_err_t gpxp_configureDevice(uint8_t address, uint16_t iodir);
+esp_err_t gpxp_writeRegisterPairAt(uint8_t address, uint8_t registerId, uint16_t data);
+esp_err_t gpxp_readRegisterPairAt(uint8_t address, uint8_t registerId, uint16_t *data);
+
+// Writes go through a shadow copy of the registers: a write leaving the device unchanged
+// is skipped, a pair write only sends the register that changes.
+typedef struct {
+    uint32_t writes;            // Transactions sent
+    uint32_t elided_writes;     // Writes skipped, value already in the device
+} gpxp_stats_t;
+
+// Only the mask bits are changed, the other ones come from the shadow register.
+esp_err_t gpxp_updateRegister(uint8_t registerId, uint8_t mask, uint8_t value);
+esp_err_t gpxp_updateRegisterAt(uint8_t address, uint8_t registerId, uint8_t mask, uint8_t value);
+// After a power cycle of the expanders, the next writes go to the bus.
+void gpxp_invalidateCache();
+void gpxp_getStats(gpxp_stats_t *stats);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
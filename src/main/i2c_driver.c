@@ -2,11 +2,19 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
 #include "driver/i2c.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#if __has_include("esp_idf_version.h")
+#include "esp_idf_version.h"
+#endif
 
 #include "app_tools.h"
 #include "i2c_driver.h"
+#include "i2c_trace.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -14,6 +22,95 @@ static const char *TAG = TAG_I2C_DRIVER;
 
 static TickType_t i2c_timeout = 10000 / portTICK_RATE_MS;
 static bool i2c_initialized = true;
+static i2c_profile_t i2c_profile = I2C_PROFILE_DEFAULT();
+static bool i2c_profile_loaded = false;     // NVS read once
+static bool i2c_profile_stored = false;
+
+#if defined(ESP_IDF_VERSION) && ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+#define I2C_STATIC_LINKS            1
+#else
+// No i2c_cmd_link_create_static(), every link comes from the heap
+#define I2C_STATIC_LINKS            0
+#endif
+
+#if I2C_STATIC_LINKS
+typedef struct {
+    uint8_t buffer[I2C_LINK_RECOMMENDED_SIZE(I2C_COMMAND_TRANSACTIONS)] __attribute__((aligned(4)));
+    i2c_cmd_handle_t cmd;
+    bool used;
+} i2c_command_slot_t;
+
+typedef struct {
+    uint8_t buffer[I2C_LINK_RECOMMENDED_SIZE(I2C_COMMAND_CHAIN_TRANSACTIONS)] __attribute__((aligned(4)));
+    i2c_cmd_handle_t cmd;
+    bool used;
+} i2c_chain_slot_t;
+
+static i2c_command_slot_t _pool[I2C_COMMAND_POOL_SIZE];
+static i2c_chain_slot_t _chain;
+#endif
+
+#if I2C_TRACE
+// Accesses of a command, recorded once it is run
+typedef struct {
+    i2c_cmd_handle_t cmd;
+    i2ct_link_t link;
+} i2c_trace_slot_t;
+
+static i2c_trace_slot_t _traces[I2C_TRACE_LINKS];
+#endif
+
+static portMUX_TYPE _pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static i2c_stats_t _stats;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void get_config(i2c_config_t *conf) {
+    memset(conf, 0, sizeof(i2c_config_t));
+    conf->mode = I2C_MODE_MASTER;
+    conf->scl_io_num = I2C_MASTER_SCL_IO;
+    conf->sda_io_num = I2C_MASTER_SDA_IO;
+    conf->scl_pullup_en = GPIO_PULLUP_DISABLE;     // GPIO expander board have pullup
+    conf->sda_pullup_en = GPIO_PULLUP_DISABLE;     // GPIO expander board have pullup
+    conf->master.clk_speed = i2c_profile.freq_hz;
+}
+
+// Glitch filter and timeout, i2c_param_config() does not set them
+static esp_err_t configure_timings() {
+    esp_err_t err = ESP_OK;
+
+    if(i2c_profile.filter_cycles > 0) {
+        err = i2c_filter_enable(I2C_MASTER_NUM, i2c_profile.filter_cycles);
+    } else {
+        err = i2c_filter_disable(I2C_MASTER_NUM);
+    }
+    if(err == ESP_OK) {
+        err = i2c_set_timeout(I2C_MASTER_NUM, i2c_profile.timeout_cycles);
+    }
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to set I2C timings! %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+// The driver stays installed, only the controller is configured again
+static esp_err_t configure() {
+    i2c_config_t conf;
+    get_config(&conf);
+
+    esp_err_t err = i2c_param_config(I2C_MASTER_NUM, &conf);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to i2c_param_config! %s", esp_err_to_name(err));
+        return err;
+    }
+    return configure_timings();
+}
+
+static void delay_us(uint32_t us) {
+    int64_t until = esp_timer_get_time() + us;
+    while(esp_timer_get_time() < until) {
+    }
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -27,14 +124,8 @@ esp_err_t i2c_initialize(bool installDriver) {
         goto end;
     }
 
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .scl_pullup_en = GPIO_PULLUP_DISABLE,     // GPIO expander board have pullup
-        .sda_pullup_en = GPIO_PULLUP_DISABLE,     // GPIO expander board have pullup
-        .master.clk_speed = I2C_MASTER_FREQ_HZ
-    };
+    i2c_config_t conf;
+    get_config(&conf);
 
     err = i2c_param_config(I2C_MASTER_NUM, &conf);
     if(err != ESP_OK) {
@@ -50,11 +141,28 @@ esp_err_t i2c_initialize(bool installDriver) {
         }
     }
 
+    if(err == ESP_OK) {
+        err = configure_timings();
+    }
+
     end:
     if(err == ESP_OK) {
         i2c_initialized = true;
     }
 
+    // Once at boot, the fastest error free profile found by diag_i2c_sweep()
+    if(err == ESP_OK && !i2c_profile_loaded) {
+        i2c_profile_t profile;
+
+        i2c_profile_loaded = true;
+        if(i2c_loadProfile(&profile) == ESP_OK) {
+            ESP_LOGI(TAG, "Stored bus profile: %u Hz, filter %u, timeout %i",
+                profile.freq_hz, profile.filter_cycles, profile.timeout_cycles);
+            err = i2c_setProfile(&profile);
+            i2c_profile_stored = err == ESP_OK;
+        }
+    }
+
     LOGM_FUNC_OUT();
     return err;
 }
@@ -134,27 +242,334 @@ void i2c_reset(i2c_port_t port) {
     LOGM_FUNC_OUT();
 }
 
+esp_err_t i2c_setProfile(const i2c_profile_t *profile) {
+    LOGM_FUNC_IN();
+
+    i2c_profile = *profile;
+    esp_err_t err = configure();
+
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+void i2c_getProfile(i2c_profile_t *profile) {
+    *profile = i2c_profile;
+}
+
+esp_err_t i2c_setFrequency(uint32_t freq_hz) {
+    i2c_profile_t profile = i2c_profile;
+    profile.freq_hz = freq_hz;
+    return i2c_setProfile(&profile);
+}
+
+uint32_t i2c_getFrequency() {
+    return i2c_profile.freq_hz;
+}
+
+esp_err_t i2c_loadProfile(i2c_profile_t *profile) {
+    LOGM_FUNC_IN();
+    nvs_handle handle;
+    size_t size = sizeof(i2c_profile_t);
+
+    // ESP_ERR_NVS_NOT_FOUND until a profile is saved
+    esp_err_t err = nvs_open(I2C_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if(err != ESP_OK) {
+        goto end;
+    }
+
+    err = nvs_get_blob(handle, I2C_NVS_PROFILE, profile, &size);
+    if(err == ESP_OK && size != sizeof(i2c_profile_t)) {
+        ESP_LOGW(TAG, "Stored bus profile ignored, %u bytes instead of %u!", (unsigned)size, (unsigned)sizeof(i2c_profile_t));
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    nvs_close(handle);
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t i2c_saveProfile(const i2c_profile_t *profile) {
+    LOGM_FUNC_IN();
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(I2C_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to open NVS namespace %s! %s", I2C_NVS_NAMESPACE, esp_err_to_name(err));
+        goto end;
+    }
+
+    err = nvs_set_blob(handle, I2C_NVS_PROFILE, profile, sizeof(i2c_profile_t));
+    if(err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    if(err != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to save bus profile! %s", esp_err_to_name(err));
+    }
+    nvs_close(handle);
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t i2c_eraseProfile() {
+    LOGM_FUNC_IN();
+    nvs_handle handle;
+
+    esp_err_t err = nvs_open(I2C_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if(err != ESP_OK) {
+        goto end;
+    }
+
+    err = nvs_erase_key(handle, I2C_NVS_PROFILE);
+    if(err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+
+    end:
+    LOGM_FUNC_OUT();
+    return err == ESP_ERR_NVS_NOT_FOUND ? ESP_OK : err;
+}
+
+bool i2c_hasStoredProfile() {
+    return i2c_profile_stored;
+}
+
+esp_err_t i2c_recover() {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_OK;
+
+    // The pins are taken from the controller, as open drain GPIOs
+    gpio_set_level(I2C_MASTER_SDA_IO, 1);
+    gpio_set_level(I2C_MASTER_SCL_IO, 1);
+    gpio_set_direction(I2C_MASTER_SDA_IO, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(I2C_MASTER_SCL_IO, GPIO_MODE_INPUT_OUTPUT_OD);
+    delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+    // A device interrupted in the middle of a read still drives SDA for its next bits
+    for(int i = 0; i < I2C_RECOVERY_PULSES && gpio_get_level(I2C_MASTER_SDA_IO) == 0; i++) {
+        gpio_set_level(I2C_MASTER_SCL_IO, 0);
+        delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+        gpio_set_level(I2C_MASTER_SCL_IO, 1);
+        delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    }
+
+    // STOP: SDA rising while SCL is high
+    gpio_set_level(I2C_MASTER_SCL_IO, 0);
+    delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_level(I2C_MASTER_SDA_IO, 0);
+    delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_level(I2C_MASTER_SCL_IO, 1);
+    delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    gpio_set_level(I2C_MASTER_SDA_IO, 1);
+    delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+    if(gpio_get_level(I2C_MASTER_SDA_IO) == 0) {
+        ESP_LOGE(TAG, "SDA still held low after %i clock pulses!", I2C_RECOVERY_PULSES);
+        err = ESP_ERR_INVALID_STATE;
+    }
+
+    // Give the pins back to the controller
+    esp_err_t config_err = configure();
+    if(config_err != ESP_OK) {
+        err = config_err;
+    }
+    i2c_reset(I2C_MASTER_NUM);
+
+    LOGM_FUNC_OUT();
+    return err;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
+static i2c_cmd_handle_t create_link(size_t transactions) {
+    i2c_cmd_handle_t cmd = NULL;
+
+#if I2C_STATIC_LINKS
+    if(transactions <= I2C_COMMAND_TRANSACTIONS) {
+        i2c_command_slot_t *slot = NULL;
+
+        portENTER_CRITICAL(&_pool_lock);
+        for(int i = 0; i < I2C_COMMAND_POOL_SIZE; i++) {
+            if(!_pool[i].used) {
+                slot = &_pool[i];
+                slot->used = true;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_pool_lock);
+
+        if(slot != NULL) {
+            slot->cmd = i2c_cmd_link_create_static(slot->buffer, sizeof(slot->buffer));
+            cmd = slot->cmd;
+        }
+    }
+
+    // Chained batch, or the pool is empty
+    if(cmd == NULL && transactions <= I2C_COMMAND_CHAIN_TRANSACTIONS) {
+        bool claimed = false;
+
+        portENTER_CRITICAL(&_pool_lock);
+        if(!_chain.used) {
+            _chain.used = true;
+            claimed = true;
+        }
+        portEXIT_CRITICAL(&_pool_lock);
+
+        if(claimed) {
+            _chain.cmd = i2c_cmd_link_create_static(_chain.buffer, sizeof(_chain.buffer));
+            cmd = _chain.cmd;
+        }
+    }
+#endif
+
+    portENTER_CRITICAL(&_pool_lock);
+    _stats.commands++;
+    if(cmd == NULL) {
+        _stats.heap_commands++;
+    }
+    portEXIT_CRITICAL(&_pool_lock);
+
+    if(cmd == NULL) {
+        cmd = i2c_cmd_link_create();
+    }
+
+#if I2C_TRACE
+    if(cmd != NULL && i2ct_is_enabled()) {
+        i2c_trace_slot_t *trace = NULL;
+
+        portENTER_CRITICAL(&_pool_lock);
+        for(int i = 0; i < I2C_TRACE_LINKS; i++) {
+            if(_traces[i].cmd == NULL) {
+                trace = &_traces[i];
+                trace->cmd = cmd;
+                break;
+            }
+        }
+        portEXIT_CRITICAL(&_pool_lock);
+
+        if(trace != NULL) {
+            i2ct_link_start(&trace->link);
+        }
+    }
+#endif
+    return cmd;
+}
+
+#if I2C_TRACE
+// Only the task building a command looks for its slot
+static i2ct_link_t *trace_of(i2c_cmd_handle_t cmd) {
+    for(int i = 0; i < I2C_TRACE_LINKS; i++) {
+        if(_traces[i].cmd == cmd) {
+            return &_traces[i].link;
+        }
+    }
+    return NULL;
+}
+#endif
+
+static void delete_link(i2c_cmd_handle_t cmd) {
+#if I2C_TRACE
+    for(int i = 0; i < I2C_TRACE_LINKS; i++) {
+        if(_traces[i].cmd == cmd) {
+            portENTER_CRITICAL(&_pool_lock);
+            _traces[i].cmd = NULL;
+            portEXIT_CRITICAL(&_pool_lock);
+            break;
+        }
+    }
+#endif
+
+#if I2C_STATIC_LINKS
+    for(int i = 0; i < I2C_COMMAND_POOL_SIZE; i++) {
+        if(_pool[i].used && _pool[i].cmd == cmd) {
+            i2c_cmd_link_delete_static(cmd);
+            portENTER_CRITICAL(&_pool_lock);
+            _pool[i].cmd = NULL;
+            _pool[i].used = false;
+            portEXIT_CRITICAL(&_pool_lock);
+            return;
+        }
+    }
+    if(_chain.used && _chain.cmd == cmd) {
+        i2c_cmd_link_delete_static(cmd);
+        portENTER_CRITICAL(&_pool_lock);
+        _chain.cmd = NULL;
+        _chain.used = false;
+        portEXIT_CRITICAL(&_pool_lock);
+        return;
+    }
+#endif
+    i2c_cmd_link_delete(cmd);
+}
+
 i2c_cmd_handle_t i2c_createCommand() {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    return i2c_createCommandFor(1);
+}
+
+i2c_cmd_handle_t i2c_createCommandFor(size_t transactions) {
+    i2c_cmd_handle_t cmd = create_link(transactions);
     i2c_master_start(cmd);
     return cmd;
 }
 
 esp_err_t i2c_writeByte(i2c_cmd_handle_t cmd_handle, uint8_t data) {
-    return i2c_master_write_byte(cmd_handle, data, ACK_VAL);
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd_handle);
+    if(trace != NULL) {
+        i2ct_link_write(trace, &data, 1);
+    }
+#endif
+    return i2c_master_write_byte(cmd_handle, data, ACK_CHECK);
 }
 
 esp_err_t i2c_write(i2c_cmd_handle_t cmd, uint8_t* data, size_t data_len) {
-    return i2c_master_write(cmd, data, data_len, ACK_VAL);
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd);
+    if(trace != NULL) {
+        i2ct_link_write(trace, data, data_len);
+    }
+#endif
+    return i2c_master_write(cmd, data, data_len, ACK_CHECK);
 }
 
 esp_err_t i2c_readByte(i2c_cmd_handle_t cmd, uint8_t* data) {
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd);
+    if(trace != NULL) {
+        i2ct_link_read(trace, data, 1);
+    }
+#endif
     return i2c_master_read_byte(cmd, data, NACK_VAL);
 }
 
+esp_err_t i2c_read(i2c_cmd_handle_t cmd, uint8_t* data, size_t data_len) {
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd);
+    if(trace != NULL) {
+        i2ct_link_read(trace, data, data_len);
+    }
+#endif
+    return i2c_master_read(cmd, data, data_len, I2C_MASTER_LAST_NACK);
+}
+
+esp_err_t i2c_restart(i2c_cmd_handle_t cmd) {
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd);
+    if(trace != NULL) {
+        i2ct_link_restart(trace);
+    }
+#endif
+    return i2c_master_start(cmd);
+}
+
 esp_err_t i2c_executeCommand(i2c_cmd_handle_t cmd) {
+    return i2c_executeCommandWithTimeout(cmd, i2c_timeout);
+}
+
+esp_err_t i2c_executeCommandWithTimeout(i2c_cmd_handle_t cmd, TickType_t timeout) {
     esp_err_t err = ESP_FAIL;
 
     err = i2c_master_stop(cmd);
@@ -163,14 +578,50 @@ esp_err_t i2c_executeCommand(i2c_cmd_handle_t cmd) {
         goto end;
     }
 
-    err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, i2c_timeout);
+#if I2C_TRACE
+    int64_t start_us = esp_timer_get_time();
+#endif
+    err = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, timeout);
+#if I2C_TRACE
+    i2ct_link_t *trace = trace_of(cmd);
+    if(trace != NULL) {
+        i2ct_link_commit(trace, start_us, esp_timer_get_time(), err);
+    }
+#endif
     if(err != ESP_OK) {
         ESP_LOGE(TAG, "Fail to i2c_master_cmd_begin! %s", esp_err_to_name(err));
     }
 
     end:
-    i2c_cmd_link_delete(cmd);
+    delete_link(cmd);
     return err;
 }
 
+void i2c_getStats(i2c_stats_t *stats) {
+    portENTER_CRITICAL(&_pool_lock);
+    *stats = _stats;
+    portEXIT_CRITICAL(&_pool_lock);
+}
+
+size_t i2c_dumpTrace(FILE *out) {
+#if I2C_TRACE
+    return i2ct_dump(out, i2c_profile.freq_hz);
+#else
+    ESP_LOGW(TAG, "Built without I2C_TRACE!");
+    return 0;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t i2c_readRegisters(uint8_t addr, uint8_t register_id, uint8_t* data, size_t data_len) {
+    i2c_cmd_handle_t cmd = i2c_createCommand();
+    i2c_writeByte(cmd, (addr << 1) | I2C_MASTER_WRITE);
+    i2c_writeByte(cmd, register_id);
+    i2c_restart(cmd);
+    i2c_writeByte(cmd, (addr << 1) | I2C_MASTER_READ);
+    i2c_read(cmd, data, data_len);
+    return i2c_executeCommand(cmd);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
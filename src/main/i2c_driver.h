@@ -1,6 +1,8 @@
 #ifndef I2C_DRIVER_H
 #define I2C_DRIVER_H
 
+#include <stdio.h>
+
 #include "driver/i2c.h"
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -12,6 +14,7 @@
 #define I2C_MASTER_FREQ_HZ          100000
 // See MCP23016 datasheet
 // This module look like compatible with I²C speed fast 100kHz / 400kHz, but only 100kHz works!
+// The bus is set to GPIO_EXPANDER_BUS_FREQ_HZ by gpxp_initialize() (MCP23017: 400kHz).
 
 #define I2C_MASTER_NUM              I2C_NUM_0
 
@@ -28,6 +31,30 @@
 #define ACK_VAL                     0
 #define NACK_VAL                    1
 
+// Register accesses are built in static command links (ESP-IDF 4.4 and later),
+// the heap is only used when the pool is empty or the transaction too long.
+// Chained batches (a whole jack matrix scan) have their own link, built by the bus task only.
+#define I2C_COMMAND_POOL_SIZE       2       // Links built at the same time
+#define I2C_COMMAND_TRANSACTIONS    16      // Register accesses in a pooled link
+#define I2C_COMMAND_CHAIN_TRANSACTIONS 64   // Register accesses in the chained batch link
+
+// Register accesses of i2c_executeCommand() recorded by i2c_trace (nanoseconds per access),
+// CFLAGS += -DI2C_TRACE=0 in component.mk to build without it.
+#ifndef I2C_TRACE
+#define I2C_TRACE                   1
+#endif
+#define I2C_TRACE_LINKS             (I2C_COMMAND_POOL_SIZE + 2)     // Commands traced while built at the same time
+
+#define I2C_FILTER_CYCLES_DEFAULT   7       // SCL and SDA glitch filter, APB cycles (0: disabled, 7 max)
+#define I2C_TIMEOUT_CYCLES_DEFAULT  32000   // Hardware timeout, APB cycles (400us)
+
+#define I2C_NVS_NAMESPACE           "i2c"
+#define I2C_NVS_PROFILE             "profile"
+
+#define I2C_RECOVERY_PULSES         9       // Clocks for a device holding SDA to finish its byte
+#define I2C_RECOVERY_HALF_PERIOD_US 5       // 100 kHz
+#define I2C_RECOVERY_US             (2 * (I2C_RECOVERY_PULSES + 2) * I2C_RECOVERY_HALF_PERIOD_US + 100)
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 esp_err_t i2c_initialize(bool installDriver);
@@ -40,18 +67,73 @@ void i2c_scan(i2c_port_t port);
 
 void i2c_reset(i2c_port_t port);
 
+// Bus settings of I2C_MASTER_NUM, taken at once, also after a bus recovery.
+typedef struct {
+    uint32_t freq_hz;
+    uint8_t filter_cycles;
+    int32_t timeout_cycles;
+} i2c_profile_t;
+
+#define I2C_PROFILE_DEFAULT() {                     \
+    .freq_hz = I2C_MASTER_FREQ_HZ,                  \
+    .filter_cycles = I2C_FILTER_CYCLES_DEFAULT,     \
+    .timeout_cycles = I2C_TIMEOUT_CYCLES_DEFAULT,   \
+}
+
+esp_err_t i2c_setProfile(const i2c_profile_t *profile);
+void i2c_getProfile(i2c_profile_t *profile);
+esp_err_t i2c_setFrequency(uint32_t freq_hz);
+uint32_t i2c_getFrequency();
+
+// Profile kept in NVS (nvs_flash_init() first), applied by i2c_initialize() at boot.
+esp_err_t i2c_loadProfile(i2c_profile_t *profile);
+esp_err_t i2c_saveProfile(const i2c_profile_t *profile);
+esp_err_t i2c_eraseProfile();
+// True when i2c_initialize() applied a stored profile.
+bool i2c_hasStoredProfile();
+
+// Bus recovery: SCL pulses until SDA is released, a STOP, then the controller is configured
+// again. ESP_ERR_INVALID_STATE when SDA is still held low.
+esp_err_t i2c_recover();
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 i2c_cmd_handle_t i2c_createCommand();
 
+// For a command chaining several register accesses (repeated START between them).
+i2c_cmd_handle_t i2c_createCommandFor(size_t transactions);
+
 esp_err_t i2c_writeByte(i2c_cmd_handle_t cmd, uint8_t data);
 
 esp_err_t i2c_write(i2c_cmd_handle_t cmd, uint8_t* data, size_t data_len);
 
 esp_err_t i2c_readByte(i2c_cmd_handle_t cmd, uint8_t* data);
 
+// Read data_len bytes, the last one is NACKed.
+esp_err_t i2c_read(i2c_cmd_handle_t cmd, uint8_t* data, size_t data_len);
+
+// Repeated start, the bus is kept between the register select and the read.
+esp_err_t i2c_restart(i2c_cmd_handle_t cmd);
+
 esp_err_t i2c_executeCommand(i2c_cmd_handle_t cmd);
 
+esp_err_t i2c_executeCommandWithTimeout(i2c_cmd_handle_t cmd, TickType_t timeout);
+
+typedef struct {
+    uint32_t commands;          // Command links created
+    uint32_t heap_commands;     // Command links allocated on the heap
+} i2c_stats_t;
+
+void i2c_getStats(i2c_stats_t *stats);
+
+// Trace of the last register accesses (i2c_trace.h), to the console (stdout) or a file.
+size_t i2c_dumpTrace(FILE *out);
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+
+// One transaction: START, addr+W, register, repeated START, addr+R, data_len bytes, STOP.
+esp_err_t i2c_readRegisters(uint8_t addr, uint8_t register_id, uint8_t* data, size_t data_len);
+
 ////////////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // I2C_DRIVER_H
\ No newline at end of file
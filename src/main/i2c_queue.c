@@ -0,0 +1,421 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_tools.h"
+#include "i2c_driver.h"
+
+#include "i2c_queue.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_I2C_QUEUE;
+
+#define NOTIFY_BACKOFF          (1 << 0)
+
+static const char *client_names[I2CQ_CLIENT_COUNT] = { "codec", "expander", "scan" };
+
+static QueueHandle_t _queues[I2CQ_PRIORITY_COUNT];  // i2cq_batch_t *
+static SemaphoreHandle_t _pending;                  // Batches in all queues
+static QueueHandle_t _waiters;      // Free binary semaphores for i2cq_execute()
+static TaskHandle_t _task;
+static esp_timer_handle_t _backoff_timer;          // Notifies the bus task
+
+// Written by the bus task, read under the lock
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+static i2cq_stats_t _stats[I2CQ_CLIENT_COUNT];
+static int64_t _stats_start_us;
+static i2cr_t _retry;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void add_request(i2c_cmd_handle_t cmd, const i2cq_request_t *request) {
+    i2c_writeByte(cmd, (request->address << 1) | I2C_MASTER_WRITE);
+    i2c_writeByte(cmd, request->register_id);
+
+    if(request->op == I2CQ_OP_READ) {
+        i2c_restart(cmd);
+        i2c_writeByte(cmd, (request->address << 1) | I2C_MASTER_READ);
+        i2c_read(cmd, request->data, request->len);
+    } else {
+        i2c_write(cmd, request->data, request->len);
+    }
+}
+
+static esp_err_t run_batch(i2cq_batch_t *batch) {
+    esp_err_t err = ESP_OK;
+    TickType_t timeout = I2CQ_TIMEOUT_MS / portTICK_PERIOD_MS;
+
+    if(batch->run != NULL) {
+        return batch->run(batch->run_args);
+    }
+
+    if(batch->chained) {
+        // No STOP / START gap nor driver call between the requests
+        i2c_cmd_handle_t cmd = i2c_createCommandFor(batch->count);
+        for(size_t i = 0; i < batch->count; i++) {
+            if(i > 0) {
+                i2c_restart(cmd);
+            }
+            add_request(cmd, &batch->requests[i]);
+        }
+        return i2c_executeCommandWithTimeout(cmd, timeout);
+    }
+
+    for(size_t i = 0; i < batch->count; i++) {
+        i2c_cmd_handle_t cmd = i2c_createCommand();
+        add_request(cmd, &batch->requests[i]);
+
+        esp_err_t request_err = i2c_executeCommandWithTimeout(cmd, timeout);
+        if(request_err != ESP_OK && err == ESP_OK) {
+            err = request_err;
+        }
+    }
+
+    return err;
+}
+
+static i2cr_error_t classify(esp_err_t err) {
+    switch(err) {
+        case ESP_FAIL:              return I2CR_ERROR_NACK;
+        case ESP_ERR_TIMEOUT:       return I2CR_ERROR_TIMEOUT;
+        case ESP_ERR_INVALID_STATE: return I2CR_ERROR_BUS;
+        default:                    return I2CR_ERROR_OTHER;
+    }
+}
+
+static void backoff_cb(void *arg) {
+    xTaskNotify(_task, NOTIFY_BACKOFF, eSetBits);
+}
+
+// Sleeps, never spins: the bus task is above the audio tasks on core 0. The timer keeps
+// the backoffs shorter than a tick, the tick delays bound the wait if it fails.
+static void wait_us(uint32_t delay_us) {
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    TickType_t ticks = (delay_us + tick_us - 1) / tick_us;
+
+    if(delay_us == 0) {
+        return;
+    }
+    // Notification of a timer that fired after the previous wait gave up
+    xTaskNotifyWait(0, NOTIFY_BACKOFF, NULL, 0);
+    if(_backoff_timer == NULL || esp_timer_start_once(_backoff_timer, delay_us) != ESP_OK) {
+        vTaskDelay(ticks);
+        return;
+    }
+    if(xTaskNotifyWait(0, NOTIFY_BACKOFF, NULL, ticks + 1) != pdTRUE) {
+        esp_timer_stop(_backoff_timer);
+    }
+}
+
+static esp_err_t run_with_retry(i2cq_batch_t *batch) {
+    esp_err_t err = ESP_OK;
+    i2cr_attempt_t attempt;
+    i2cr_action_t action;
+    uint32_t delay_us = 0;
+
+    i2cr_begin(&_retry, &attempt, esp_timer_get_time());
+    while(true) {
+        err = run_batch(batch);
+        if(err == ESP_OK) {
+            break;
+        }
+
+        portENTER_CRITICAL(&_lock);
+        action = i2cr_failed(&_retry, &attempt, classify(err), esp_timer_get_time(), &delay_us);
+        portEXIT_CRITICAL(&_lock);
+
+        ESP_LOGD(TAG, "Attempt %u of %s batch failed! %s", attempt.attempts, client_names[batch->client], esp_err_to_name(err));
+        if(action == I2CR_ACTION_RECOVER || action == I2CR_ACTION_RECOVER_GIVE_UP) {
+            i2c_recover();
+        } else {
+            i2c_reset(I2C_MASTER_NUM);
+        }
+        if(action == I2CR_ACTION_GIVE_UP || action == I2CR_ACTION_RECOVER_GIVE_UP) {
+            break;
+        }
+
+        wait_us(delay_us);
+        i2cr_retry(&attempt, esp_timer_get_time());
+    }
+
+    portENTER_CRITICAL(&_lock);
+    i2cr_end(&_retry, &attempt, err == ESP_OK, esp_timer_get_time());
+    portEXIT_CRITICAL(&_lock);
+    return err;
+}
+
+static i2cq_batch_t *next_batch() {
+    i2cq_batch_t *batch = NULL;
+
+    xSemaphoreTake(_pending, portMAX_DELAY);
+    for(int p = 0; p < I2CQ_PRIORITY_COUNT; p++) {
+        if(xQueueReceive(_queues[p], &batch, 0) == pdTRUE) {
+            break;
+        }
+    }
+    return batch;
+}
+
+static void update_stats(const i2cq_batch_t *batch, int64_t start_us, int64_t end_us) {
+    i2cq_stats_t *stats = &_stats[batch->client];
+    uint32_t wait_us = (uint32_t)(start_us - batch->submit_us);
+
+    portENTER_CRITICAL(&_lock);
+    stats->batches++;
+    stats->busy_us += end_us - start_us;
+    if(batch->result != ESP_OK) {
+        stats->errors++;
+    }
+    if(wait_us > stats->max_wait_us) {
+        stats->max_wait_us = wait_us;
+    }
+    portEXIT_CRITICAL(&_lock);
+}
+
+static void tx_busWorker(void *args) {
+    while(true) {
+        // Batches are run back to back while a queue is not empty
+        i2cq_batch_t *batch = next_batch();
+        if(batch == NULL) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        batch->result = run_with_retry(batch);
+        update_stats(batch, start_us, esp_timer_get_time());
+
+        // The batch may be released by its callback
+        TaskHandle_t notify_task = batch->notify_task;
+        uint32_t notify_bits = batch->notify_bits;
+
+        if(batch->callback != NULL) {
+            batch->callback(batch);
+        }
+        if(notify_task != NULL) {
+            xTaskNotify(notify_task, notify_bits, eSetBits);
+        }
+    }
+}
+
+static esp_err_t enqueue(i2cq_batch_t *batch, TickType_t wait) {
+    if(batch->client >= I2CQ_CLIENT_COUNT || batch->priority >= I2CQ_PRIORITY_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    batch->submit_us = esp_timer_get_time();
+    if(xQueueSend(_queues[batch->priority], &batch, wait) != pdTRUE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(_pending);
+    return ESP_OK;
+}
+
+static void release_waiter(i2cq_batch_t *batch) {
+    xSemaphoreGive((SemaphoreHandle_t)batch->ctx);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t i2cq_initialize() {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+
+    if(_task != NULL) {
+        ESP_LOGD(TAG, "Already initialized!");
+        err = ESP_OK;
+        goto end;
+    }
+
+    for(int p = 0; p < I2CQ_PRIORITY_COUNT; p++) {
+        _queues[p] = xQueueCreate(I2CQ_QUEUE_SIZE, sizeof(i2cq_batch_t *));
+        if(_queues[p] == NULL) {
+            ESP_LOGE(TAG, "Fail to create I2C queues!");
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+    }
+
+    _pending = xSemaphoreCreateCounting(I2CQ_QUEUE_SIZE * I2CQ_PRIORITY_COUNT, 0);
+    _waiters = xQueueCreate(I2CQ_WAITER_COUNT, sizeof(SemaphoreHandle_t));
+    if(_pending == NULL || _waiters == NULL) {
+        ESP_LOGE(TAG, "Fail to create I2C queues!");
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+    i2cq_reset_stats();
+
+    i2cr_cfg_t retry_cfg = I2CR_CFG_DEFAULT();
+    i2cr_init(&_retry, &retry_cfg);
+    ESP_LOGI(TAG, "Worst transaction under bus faults: %uus",
+        i2cr_worst_case_us(&retry_cfg, I2CQ_TIMEOUT_MS * 1000, I2C_RECOVERY_US));
+
+    for(int i = 0; i < I2CQ_WAITER_COUNT; i++) {
+        SemaphoreHandle_t done = xSemaphoreCreateBinary();
+        if(done == NULL) {
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+        xQueueSend(_waiters, &done, 0);
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = backoff_cb,
+        .name = "i2cq_backoff",
+    };
+    if(esp_timer_create(&timer_args, &_backoff_timer) != ESP_OK) {
+        ESP_LOGW(TAG, "Fail to create the backoff timer, backoffs rounded up to ticks!");
+        _backoff_timer = NULL;
+    }
+
+    if(xTaskCreatePinnedToCore(
+        tx_busWorker,               // Function to implement the task
+        "tx_busWorker",             // Name of the task
+        I2CQ_TASK_STACK,            // Stack size in words
+        NULL,                       // Task input parameter
+        I2CQ_TASK_PRIO,             // Priority of the task
+        &_task,                     // Task handle.
+        I2CQ_TASK_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Fail to create I2C bus task!");
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+
+    err = ESP_OK;
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+bool i2cq_is_initialized() {
+    return _task != NULL;
+}
+
+esp_err_t i2cq_submit(i2cq_batch_t *batch) {
+    if(_task == NULL) {
+        ESP_LOGE(TAG, "I2C queue is not initialized, call i2cq_initialize() before!");
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = enqueue(batch, 0);
+    if(err != ESP_OK) {
+        ESP_LOGW(TAG, "Fail to submit %s batch! %s", client_names[batch->client % I2CQ_CLIENT_COUNT], esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t i2cq_execute(i2cq_batch_t *batch) {
+    SemaphoreHandle_t done;
+
+    if(_task == NULL) {
+        ESP_LOGE(TAG, "I2C queue is not initialized, call i2cq_initialize() before!");
+        return ESP_FAIL;
+    }
+
+    xQueueReceive(_waiters, &done, portMAX_DELAY);
+
+    batch->callback = release_waiter;
+    batch->ctx = done;
+    batch->notify_task = NULL;
+
+    esp_err_t err = enqueue(batch, portMAX_DELAY);
+    if(err == ESP_OK) {
+        xSemaphoreTake(done, portMAX_DELAY);
+        err = batch->result;
+    }
+
+    xQueueSend(_waiters, &done, 0);
+    return err;
+}
+
+esp_err_t i2cq_read(i2cq_client_t client, uint8_t address, uint8_t register_id, uint8_t *data, size_t len) {
+    i2cq_request_t request = {
+        .op = I2CQ_OP_READ,
+        .address = address,
+        .register_id = register_id,
+        .len = len,
+        .data = data,
+    };
+    i2cq_batch_t batch = {
+        .client = client,
+        .priority = I2CQ_PRIORITY_NORMAL,
+        .requests = &request,
+        .count = 1,
+    };
+    return i2cq_execute(&batch);
+}
+
+esp_err_t i2cq_write(i2cq_client_t client, uint8_t address, uint8_t register_id, uint8_t *data, size_t len) {
+    i2cq_request_t request = {
+        .op = I2CQ_OP_WRITE,
+        .address = address,
+        .register_id = register_id,
+        .len = len,
+        .data = data,
+    };
+    i2cq_batch_t batch = {
+        .client = client,
+        .priority = I2CQ_PRIORITY_NORMAL,
+        .requests = &request,
+        .count = 1,
+    };
+    return i2cq_execute(&batch);
+}
+
+void i2cq_get_stats(i2cq_client_t client, i2cq_stats_t *stats) {
+    portENTER_CRITICAL(&_lock);
+    *stats = _stats[client];
+    portEXIT_CRITICAL(&_lock);
+}
+
+void i2cq_set_retry_cfg(const i2cr_cfg_t *cfg) {
+    portENTER_CRITICAL(&_lock);
+    _retry.cfg = *cfg;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void i2cq_get_retry_stats(i2cr_stats_t *stats) {
+    portENTER_CRITICAL(&_lock);
+    *stats = _retry.stats;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void i2cq_log_stats() {
+    int64_t elapsed_us = esp_timer_get_time() - _stats_start_us;
+
+    for(int c = 0; c < I2CQ_CLIENT_COUNT; c++) {
+        i2cq_stats_t stats;
+        i2cq_get_stats(c, &stats);
+
+        ESP_LOGI(TAG, "%-8s %u batches, %u errors, bus %lldus (%.2f%%), max wait %uus",
+            client_names[c], stats.batches, stats.errors, (long long)stats.busy_us,
+            elapsed_us > 0 ? (100.0 * stats.busy_us) / elapsed_us : 0.0, stats.max_wait_us);
+    }
+
+    i2cr_stats_t retry;
+    i2cq_get_retry_stats(&retry);
+    ESP_LOGI(TAG, "Errors: %u NACK, %u timeout, %u bus, %u other", retry.errors[I2CR_ERROR_NACK],
+        retry.errors[I2CR_ERROR_TIMEOUT], retry.errors[I2CR_ERROR_BUS], retry.errors[I2CR_ERROR_OTHER]);
+    ESP_LOGI(TAG, "Retries: %u, recoveries: %u, give ups: %u, worst transaction %uus",
+        retry.retries, retry.recoveries, retry.give_ups, retry.worst_us);
+
+    i2c_stats_t links;
+    i2c_getStats(&links);
+    ESP_LOGI(TAG, "Command links: %u, %u allocated on the heap", links.commands, links.heap_commands);
+}
+
+void i2cq_reset_stats() {
+    portENTER_CRITICAL(&_lock);
+    memset(_stats, 0, sizeof(_stats));
+    _stats_start_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&_lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,114 @@
+#ifndef I2C_QUEUE_H
+#define I2C_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#include "i2c_retry.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_I2C_QUEUE           "i2c_queue"
+
+// A single bus owner task runs every transaction of I2C_MASTER_NUM, callers
+// submit descriptors and are called back or notified when they are done.
+// The ES8388 codec shares the bus, its ADF calls are also run by the bus task.
+
+#define I2CQ_QUEUE_SIZE         16      // Batches waiting for the bus, per priority
+#define I2CQ_WAITER_COUNT       8       // Tasks waiting in i2cq_execute() at the same time
+#define I2CQ_TIMEOUT_MS         50      // One batch on the bus, a 16x16 scan is below 25ms
+#define I2CQ_TASK_STACK         (3 * 1024)
+#define I2CQ_TASK_CORE          (0)
+#define I2CQ_TASK_PRIO          (configMAX_PRIORITIES - 2)
+
+typedef enum {
+    I2CQ_CLIENT_CODEC,      // ES8388 control, volume
+    I2CQ_CLIENT_EXPANDER,   // Register accesses, INTCAP reads
+    I2CQ_CLIENT_SCAN,       // Jack matrix scans
+    I2CQ_CLIENT_COUNT,
+} i2cq_client_t;
+
+// The highest priority batch waiting is run next, a running batch is never interrupted
+typedef enum {
+    I2CQ_PRIORITY_HIGH,     // Codec, before any queued scan
+    I2CQ_PRIORITY_NORMAL,
+    I2CQ_PRIORITY_LOW,      // Background scans
+    I2CQ_PRIORITY_COUNT,
+} i2cq_priority_t;
+
+typedef enum {
+    I2CQ_OP_WRITE,          // START, addr+W, register, data
+    I2CQ_OP_READ,           // START, addr+W, register, repeated START, addr+R, data
+} i2cq_op_t;
+
+typedef struct {
+    uint8_t op;
+    uint8_t address;
+    uint8_t register_id;
+    uint8_t len;
+    uint8_t *data;          // Owned by the caller until the batch is done
+} i2cq_request_t;
+
+typedef struct i2cq_batch i2cq_batch_t;
+
+// Called from the bus task, it must not block.
+typedef void (*i2cq_callback_t)(i2cq_batch_t *batch);
+// Run by the bus task instead of requests, for drivers doing their own transactions (ADF codec).
+typedef esp_err_t (*i2cq_run_t)(void *args);
+
+struct i2cq_batch {
+    uint8_t client;
+    uint8_t priority;
+    i2cq_request_t *requests;
+    size_t count;
+    bool chained;           // One transaction: repeated START between the requests, one STOP
+    i2cq_run_t run;         // Replaces the requests when set
+    void *run_args;
+    i2cq_callback_t callback;
+    void *ctx;
+    TaskHandle_t notify_task;   // Notified with notify_bits when done, NULL for none
+    uint32_t notify_bits;
+    esp_err_t result;       // First error, set before the callback / notification
+    int64_t submit_us;      // Set by the queue
+};
+
+typedef struct {
+    uint32_t batches;
+    uint32_t errors;
+    uint64_t busy_us;       // Bus time
+    uint32_t max_wait_us;   // Longest wait between the submission and the bus
+} i2cq_stats_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Once, I2C must be initialized.
+esp_err_t i2cq_initialize();
+bool i2cq_is_initialized();
+
+// No wait, the batch and its buffers must stay valid until done.
+esp_err_t i2cq_submit(i2cq_batch_t *batch);
+
+// Submit and wait until done, for tasks allowed to wait on the bus.
+esp_err_t i2cq_execute(i2cq_batch_t *batch);
+
+// One register transaction at normal priority, i2cq_execute() shortcuts.
+esp_err_t i2cq_read(i2cq_client_t client, uint8_t address, uint8_t register_id, uint8_t *data, size_t len);
+esp_err_t i2cq_write(i2cq_client_t client, uint8_t address, uint8_t register_id, uint8_t *data, size_t len);
+
+// Failed transactions are retried by the bus task (I2CR_CFG_DEFAULT() policy), taken on the next one.
+void i2cq_set_retry_cfg(const i2cr_cfg_t *cfg);
+void i2cq_get_retry_stats(i2cr_stats_t *stats);
+
+// Bus occupancy per client since the last reset.
+void i2cq_get_stats(i2cq_client_t client, i2cq_stats_t *stats);
+void i2cq_log_stats();
+void i2cq_reset_stats();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // I2C_QUEUE_H
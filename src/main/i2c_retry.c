@@ -0,0 +1,113 @@
+#include <string.h>
+
+#include "i2c_retry.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define STREAK_SHIFT_MAX        4       // Starting backoff up to 16 times the configured one
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t min_u32(uint32_t a, uint32_t b) {
+    return a < b ? a : b;
+}
+
+static uint32_t first_backoff(const i2cr_cfg_t *cfg, uint8_t streak) {
+    uint8_t shift = streak < STREAK_SHIFT_MAX ? streak : STREAK_SHIFT_MAX;
+    return min_u32(cfg->backoff_us << shift, cfg->max_backoff_us);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2cr_init(i2cr_t *retry, const i2cr_cfg_t *cfg) {
+    memset(retry, 0, sizeof(i2cr_t));
+    retry->cfg = *cfg;
+    if(retry->cfg.max_attempts == 0) {
+        retry->cfg.max_attempts = 1;
+    }
+}
+
+void i2cr_begin(i2cr_t *retry, i2cr_attempt_t *attempt, int64_t now_us) {
+    attempt->start_us = now_us;
+    attempt->attempt_us = now_us;
+    attempt->attempts = 0;
+    // The bus failed lately, the device is likely still busy: wait longer at once
+    attempt->backoff_us = first_backoff(&retry->cfg, retry->streak);
+}
+
+i2cr_action_t i2cr_failed(i2cr_t *retry, i2cr_attempt_t *attempt, i2cr_error_t error, int64_t now_us, uint32_t *delay_us) {
+    const i2cr_cfg_t *cfg = &retry->cfg;
+
+    if(error >= I2CR_ERROR_COUNT) {
+        error = I2CR_ERROR_OTHER;
+    }
+    retry->stats.errors[error]++;
+    attempt->attempts++;
+
+    bool stuck = error == I2CR_ERROR_TIMEOUT || error == I2CR_ERROR_BUS;
+    bool recover = stuck || (cfg->recover_after > 0 && attempt->attempts % cfg->recover_after == 0);
+
+    // The next attempt is expected to last as long as this one
+    uint32_t delay = attempt->backoff_us;
+    int64_t end_us = now_us + delay + (now_us - attempt->attempt_us);
+
+    if(attempt->attempts >= cfg->max_attempts || end_us - attempt->start_us > cfg->budget_us) {
+        if(stuck) {
+            retry->stats.recoveries++;
+            return I2CR_ACTION_RECOVER_GIVE_UP;
+        }
+        return I2CR_ACTION_GIVE_UP;
+    }
+
+    attempt->backoff_us = min_u32(delay * 2, cfg->max_backoff_us);
+    *delay_us = delay;
+    retry->stats.retries++;
+
+    if(recover) {
+        retry->stats.recoveries++;
+        return I2CR_ACTION_RECOVER;
+    }
+    return I2CR_ACTION_RETRY;
+}
+
+void i2cr_retry(i2cr_attempt_t *attempt, int64_t now_us) {
+    attempt->attempt_us = now_us;
+}
+
+void i2cr_end(i2cr_t *retry, const i2cr_attempt_t *attempt, bool success, int64_t now_us) {
+    i2cr_stats_t *stats = &retry->stats;
+    uint32_t duration_us = (uint32_t)(now_us - attempt->start_us);
+
+    stats->transactions++;
+    if(!success) {
+        stats->give_ups++;
+    }
+    if(duration_us > stats->worst_us) {
+        stats->worst_us = duration_us;
+    }
+
+    if(success && attempt->attempts == 0) {
+        retry->streak = 0;
+    } else if(retry->streak < UINT8_MAX) {
+        retry->streak++;
+    }
+}
+
+uint32_t i2cr_worst_case_us(const i2cr_cfg_t *cfg, uint32_t attempt_us, uint32_t recovery_us) {
+    uint8_t attempts = cfg->max_attempts > 0 ? cfg->max_attempts : 1;
+    uint32_t backoff_us = first_backoff(cfg, STREAK_SHIFT_MAX);
+    // Each attempt may be followed by a recovery, the last one included
+    uint64_t total_us = attempt_us + recovery_us;
+
+    for(uint8_t i = 1; i < attempts; i++) {
+        total_us += backoff_us + attempt_us + recovery_us;
+        backoff_us = min_u32(backoff_us * 2, cfg->max_backoff_us);
+    }
+
+    // An attempt is only started when it should end within the budget,
+    // the last one may still run longer, with a recovery before and after it
+    uint64_t budget_us = (uint64_t)cfg->budget_us + attempt_us + 2 * recovery_us;
+    return (uint32_t)(total_us < budget_us ? total_us : budget_us);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,88 @@
+#ifndef I2C_RETRY_H
+#define I2C_RETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Retry policy of the I2C bus task: exponential backoff between the attempts of a
+// transaction, bus recovery when the bus looks stuck, and a time budget bounding the
+// latency of a transaction under faults. The starting backoff adapts to the recent
+// failures. Times are given by the caller, no ESP-IDF dependency.
+
+typedef enum {
+    I2CR_ERROR_NACK,        // No acknowledge, device busy or absent (ESP_FAIL)
+    I2CR_ERROR_TIMEOUT,     // Transaction not finished, SCL or SDA held (ESP_ERR_TIMEOUT)
+    I2CR_ERROR_BUS,         // Bus busy, lost arbitration (ESP_ERR_INVALID_STATE)
+    I2CR_ERROR_OTHER,
+    I2CR_ERROR_COUNT,
+} i2cr_error_t;
+
+typedef enum {
+    I2CR_ACTION_RETRY,      // Wait delay_us then run the transaction again
+    I2CR_ACTION_RECOVER,    // Recover the bus, wait delay_us then run it again
+    I2CR_ACTION_GIVE_UP,
+    I2CR_ACTION_RECOVER_GIVE_UP,    // No more attempt, the bus is recovered for the next transactions
+} i2cr_action_t;
+
+typedef struct {
+    uint8_t max_attempts;       // First attempt included
+    uint32_t backoff_us;        // Before the second attempt, doubled for each next one
+    uint32_t max_backoff_us;
+    uint8_t recover_after;      // Failed attempts before a bus recovery, at once for a timeout or a busy bus
+    uint32_t budget_us;         // No attempt started if it would end after the budget
+} i2cr_cfg_t;
+
+#define I2CR_CFG_DEFAULT() {        \
+    .max_attempts = 4,              \
+    .backoff_us = 250,              \
+    .max_backoff_us = 4000,         \
+    .recover_after = 2,             \
+    .budget_us = 15000,             \
+}
+
+typedef struct {
+    uint32_t errors[I2CR_ERROR_COUNT];
+    uint32_t transactions;
+    uint32_t retries;
+    uint32_t recoveries;
+    uint32_t give_ups;
+    uint32_t worst_us;          // Longest transaction, retries included
+} i2cr_stats_t;
+
+typedef struct {
+    i2cr_cfg_t cfg;
+    i2cr_stats_t stats;
+    uint8_t streak;             // Transactions in a row needing a retry
+} i2cr_t;
+
+// One transaction
+typedef struct {
+    int64_t start_us;
+    int64_t attempt_us;         // Start of the current attempt
+    uint8_t attempts;
+    uint32_t backoff_us;        // Next delay
+} i2cr_attempt_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2cr_init(i2cr_t *retry, const i2cr_cfg_t *cfg);
+
+void i2cr_begin(i2cr_t *retry, i2cr_attempt_t *attempt, int64_t now_us);
+
+// After a failed attempt, what to do next. delay_us is set for a retry or a recovery.
+i2cr_action_t i2cr_failed(i2cr_t *retry, i2cr_attempt_t *attempt, i2cr_error_t error, int64_t now_us, uint32_t *delay_us);
+
+// Call before the next attempt, after the delay (and the recovery).
+void i2cr_retry(i2cr_attempt_t *attempt, int64_t now_us);
+
+// After the last attempt, successful or not.
+void i2cr_end(i2cr_t *retry, const i2cr_attempt_t *attempt, bool success, int64_t now_us);
+
+// Longest transaction, for attempts lasting attempt_us at most and recoveries recovery_us.
+uint32_t i2cr_worst_case_us(const i2cr_cfg_t *cfg, uint32_t attempt_us, uint32_t recovery_us);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // I2C_RETRY_H
@@ -0,0 +1,220 @@
+#include <inttypes.h>
+#include <string.h>
+
+#include "i2c_trace.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define RECORD_MASK             (I2CT_RECORD_COUNT - 1)
+
+#if (I2CT_RECORD_COUNT & RECORD_MASK) != 0
+#error "I2CT_RECORD_COUNT must be a power of 2"
+#endif
+
+static i2ct_record_t _records[I2CT_RECORD_COUNT];
+static uint32_t _head;                  // Last sequence number taken
+static uint32_t _stop_seq;              // Last sequence number kept after an error, 0: running
+static i2ct_cfg_t _cfg = I2CT_CFG_DEFAULT();
+static i2ct_stats_t _stats;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void add_count(uint32_t *counter, uint32_t value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+static i2ct_access_t *current_access(i2ct_link_t *link) {
+    if(link->count == 0 || link->count > I2CT_LINK_ACCESSES) {
+        return NULL;
+    }
+    return &link->accesses[link->count - 1];
+}
+
+static i2ct_access_t *add_access(i2ct_link_t *link, uint8_t address, uint8_t flags) {
+    link->count++;
+
+    i2ct_access_t *access = current_access(link);
+    if(access != NULL) {
+        memset(access, 0, sizeof(i2ct_access_t));
+        access->address = address;
+        access->flags = flags;
+    }
+    return access;
+}
+
+static void add_address(i2ct_link_t *link, uint8_t byte) {
+    uint8_t address = byte >> 1;
+
+    if((byte & 0x01) == 0) {
+        add_access(link, address, I2CT_FLAG_NO_REGISTER);
+        return;
+    }
+
+    // Register selected by the write just before the repeated START
+    i2ct_access_t *access = current_access(link);
+    if(access != NULL && access->address == address && access->len == 0
+            && (access->flags & (I2CT_FLAG_READ | I2CT_FLAG_NO_REGISTER)) == 0) {
+        access->flags |= I2CT_FLAG_READ;
+        return;
+    }
+    add_access(link, address, I2CT_FLAG_READ | I2CT_FLAG_NO_REGISTER);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2ct_set_cfg(const i2ct_cfg_t *cfg) {
+    _cfg = *cfg;
+}
+
+void i2ct_get_cfg(i2ct_cfg_t *cfg) {
+    *cfg = _cfg;
+}
+
+bool i2ct_is_enabled() {
+    return _cfg.enabled;
+}
+
+void i2ct_clear() {
+    for(int i = 0; i < I2CT_RECORD_COUNT; i++) {
+        __atomic_store_n(&_records[i].seq, 0, __ATOMIC_RELEASE);
+    }
+    memset(&_stats, 0, sizeof(i2ct_stats_t));
+    __atomic_store_n(&_stop_seq, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&_head, 0, __ATOMIC_RELEASE);
+}
+
+void i2ct_link_start(i2ct_link_t *link) {
+    link->count = 0;
+    link->start = true;
+}
+
+void i2ct_link_restart(i2ct_link_t *link) {
+    link->start = true;
+}
+
+void i2ct_link_write(i2ct_link_t *link, const uint8_t *data, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        if(link->start) {
+            link->start = false;
+            add_address(link, data[i]);
+            continue;
+        }
+
+        i2ct_access_t *access = current_access(link);
+        if(access == NULL) {
+            continue;
+        }
+        if(access->flags & I2CT_FLAG_NO_REGISTER) {
+            access->flags &= ~I2CT_FLAG_NO_REGISTER;
+            access->register_id = data[i];
+            continue;
+        }
+        if(access->len < I2CT_DATA_SIZE) {
+            access->data[access->len] = data[i];
+        }
+        if(access->len < UINT8_MAX) {
+            access->len++;
+        }
+    }
+}
+
+void i2ct_link_read(i2ct_link_t *link, const uint8_t *data, size_t len) {
+    i2ct_access_t *access = current_access(link);
+    if(access != NULL) {
+        access->read = data;
+        access->len = len < UINT8_MAX ? len : UINT8_MAX;
+    }
+}
+
+void i2ct_link_commit(const i2ct_link_t *link, int64_t start_us, int64_t end_us, int result) {
+    uint32_t count = link->count < I2CT_LINK_ACCESSES ? link->count : I2CT_LINK_ACCESSES;
+
+    add_count(&_stats.commands, 1);
+    if(result != 0) {
+        add_count(&_stats.errors, 1);
+    }
+    if(link->count > count) {
+        add_count(&_stats.dropped, link->count - count);
+    }
+
+    uint32_t stop = __atomic_load_n(&_stop_seq, __ATOMIC_ACQUIRE);
+    if(count == 0 || (stop != 0 && __atomic_load_n(&_head, __ATOMIC_RELAXED) >= stop)) {
+        add_count(&_stats.dropped, count);
+        return;
+    }
+
+    // Slots taken at once, the records of a command stay together
+    uint32_t first = __atomic_fetch_add(&_head, count, __ATOMIC_ACQ_REL) + 1;
+
+    for(uint32_t i = 0; i < count; i++) {
+        const i2ct_access_t *access = &link->accesses[i];
+        i2ct_record_t *record = &_records[(first + i) & RECORD_MASK];
+
+        __atomic_store_n(&record->seq, 0, __ATOMIC_RELEASE);
+        record->start_us = (uint32_t)start_us;
+        record->end_us = (uint32_t)end_us;
+        record->result = (int16_t)result;
+        record->address = access->address;
+        record->register_id = access->register_id;
+        record->len = access->len;
+        record->flags = access->flags;
+        record->index = i < UINT8_MAX ? i : UINT8_MAX;
+        record->count = link->count < UINT8_MAX ? link->count : UINT8_MAX;
+        if(access->read != NULL) {
+            memcpy(record->data, access->read, access->len < I2CT_DATA_SIZE ? access->len : I2CT_DATA_SIZE);
+        } else {
+            memcpy(record->data, access->data, I2CT_DATA_SIZE);
+        }
+        __atomic_store_n(&record->seq, first + i, __ATOMIC_RELEASE);
+    }
+    add_count(&_stats.records, count);
+
+    // Trigger: the error and the records after it are kept for the dump
+    if(result != 0 && _cfg.stop_after_error > 0 && stop == 0) {
+        uint32_t last = first + count - 1 + _cfg.stop_after_error;
+        __atomic_compare_exchange_n(&_stop_seq, &stop, last, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+    }
+}
+
+void i2ct_get_stats(i2ct_stats_t *stats) {
+    stats->records = __atomic_load_n(&_stats.records, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&_stats.dropped, __ATOMIC_RELAXED);
+    stats->commands = __atomic_load_n(&_stats.commands, __ATOMIC_RELAXED);
+    stats->errors = __atomic_load_n(&_stats.errors, __ATOMIC_RELAXED);
+}
+
+size_t i2ct_dump(FILE *out, uint32_t bus_hz) {
+    i2ct_stats_t stats;
+    uint32_t last = __atomic_load_n(&_head, __ATOMIC_ACQUIRE);
+    uint32_t first = last > I2CT_RECORD_COUNT ? last - I2CT_RECORD_COUNT + 1 : 1;
+    size_t written = 0;
+
+    i2ct_get_stats(&stats);
+    fprintf(out, "i2ct-header,%d,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+        I2CT_DUMP_VERSION, bus_hz, stats.commands, stats.errors, stats.records, stats.dropped);
+
+    for(uint32_t seq = first; seq <= last && seq != 0; seq++) {
+        const i2ct_record_t *slot = &_records[seq & RECORD_MASK];
+        i2ct_record_t record;
+
+        // Skipped when overwritten or being written during the copy
+        if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq) {
+            continue;
+        }
+        memcpy(&record, slot, sizeof(i2ct_record_t));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq || record.seq != seq) {
+            continue;
+        }
+
+        fprintf(out, "i2ct,%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",0x%02x,0x%02x,%s,%u,%u,%u,",
+            record.seq, record.start_us, record.end_us, record.address, record.register_id,
+            (record.flags & I2CT_FLAG_READ) ? "r" : "w", record.flags, record.index, record.count);
+        for(int i = 0; i < record.len && i < I2CT_DATA_SIZE; i++) {
+            fprintf(out, "%02x", record.data[i]);
+        }
+        fprintf(out, ",%u,%d\n", record.len, record.result);
+        written++;
+    }
+    return written;
+}
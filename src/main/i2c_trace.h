@@ -0,0 +1,100 @@
+#ifndef I2C_TRACE_H
+#define I2C_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Tracer of the I2C register accesses: a record per access of every command run by
+// i2c_executeCommand(), kept in a lock-free ring buffer (an atomic add to take a slot,
+// the sequence number written last). The oldest records are overwritten.
+// The dump is text, one line per record, for the console or a file on the SD card,
+// scripts/i2c_trace_decode.py renders it. Times are given by the caller, no ESP-IDF
+// dependency.
+
+#define I2CT_RECORD_COUNT       256     // Power of 2
+#define I2CT_LINK_ACCESSES      64      // Accesses recorded per command, the next ones are only counted
+#define I2CT_DATA_SIZE          4       // First data bytes recorded per access
+#define I2CT_DUMP_VERSION       1
+
+#define I2CT_FLAG_READ          0x01
+#define I2CT_FLAG_NO_REGISTER   0x02    // Address only (ping, scan)
+
+typedef struct {
+    uint32_t seq;               // 1 for the first record, 0 for an empty slot
+    uint32_t start_us;          // Command on the bus, esp_timer low 32 bits
+    uint32_t end_us;
+    int16_t result;             // esp_err_t of the command
+    uint8_t address;            // 7 bits
+    uint8_t register_id;
+    uint8_t data[I2CT_DATA_SIZE];
+    uint8_t len;                // Data bytes of the access
+    uint8_t flags;              // I2CT_FLAG_*
+    uint8_t index;              // Access in the command
+    uint8_t count;              // Accesses in the command (255 max)
+} i2ct_record_t;
+
+// One access being built
+typedef struct {
+    uint8_t address;
+    uint8_t register_id;
+    uint8_t len;
+    uint8_t flags;
+    uint8_t data[I2CT_DATA_SIZE];   // Written bytes
+    const uint8_t *read;            // Read bytes, copied once the command is run
+} i2ct_access_t;
+
+// Command being built, fed with the bytes of the i2c_driver helpers
+typedef struct {
+    uint16_t count;             // Accesses, also the ones not recorded
+    bool start;                 // (Repeated) START, the next byte is an address
+    i2ct_access_t accesses[I2CT_LINK_ACCESSES];
+} i2ct_link_t;
+
+typedef struct {
+    bool enabled;
+    uint16_t stop_after_error;  // Records kept after a failed command, then the trace stops (0: never stops)
+} i2ct_cfg_t;
+
+#define I2CT_CFG_DEFAULT() {        \
+    .enabled = true,                \
+    .stop_after_error = 0,          \
+}
+
+typedef struct {
+    uint32_t records;           // Written since the last clear
+    uint32_t dropped;           // Not written, trace stopped or command too long
+    uint32_t commands;
+    uint32_t errors;            // Failed commands
+} i2ct_stats_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void i2ct_set_cfg(const i2ct_cfg_t *cfg);
+void i2ct_get_cfg(i2ct_cfg_t *cfg);
+bool i2ct_is_enabled();
+
+// Empty the ring and restart a stopped trace.
+void i2ct_clear();
+
+void i2ct_link_start(i2ct_link_t *link);
+// (Repeated) START
+void i2ct_link_restart(i2ct_link_t *link);
+void i2ct_link_write(i2ct_link_t *link, const uint8_t *data, size_t len);
+// data is read once the command is run (i2ct_link_commit())
+void i2ct_link_read(i2ct_link_t *link, const uint8_t *data, size_t len);
+// The command was run: a record per access
+void i2ct_link_commit(const i2ct_link_t *link, int64_t start_us, int64_t end_us, int result);
+
+void i2ct_get_stats(i2ct_stats_t *stats);
+
+// Header line, then a line per record ("i2ct,..."), oldest first. A record being
+// written is skipped. Returns the records written.
+size_t i2ct_dump(FILE *out, uint32_t bus_hz);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // I2C_TRACE_H
@@ -0,0 +1,154 @@
+#include <string.h>
+
+#include "jack_decode.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Bits on the bus for one byte and its ACK
+#define BYTE_BITS               9
+// START + addr/W + register + 1 or 2 data bytes + STOP
+#define WRITE_BITS(bytes)       (1 + (2 + (bytes)) * BYTE_BITS + 1)
+// START + addr/W + register + repeated START + addr/R + 1 or 2 data bytes + STOP
+#define READ_BITS(bytes)        (1 + 2 * BYTE_BITS + 1 + (1 + (bytes)) * BYTE_BITS + 1)
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int port_bytes(uint8_t ports) {
+    return ports == (JKMX_PORT_GP0 | JKMX_PORT_GP1) ? 2 : 1;
+}
+
+static uint64_t write_bits(const jkmx_plan_t *plan, int expander) {
+    return WRITE_BITS(port_bytes(plan->column_ports[expander]));
+}
+
+// Expander writes of a full scan: the column expanders but the first one released,
+// a column, then the previous column expander is released when the next column is
+// on another one, and the last one at the end
+static uint64_t scan_write_bits(const jkmx_map_t *map, const jkmx_plan_t *plan) {
+    uint64_t bits = 0;
+
+    if(map->column_count == 0) {
+        return 0;
+    }
+
+    for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+        if((plan->column_expanders & (1u << e)) && e != map->columns[0].expander) {
+            bits += write_bits(plan, e);
+        }
+    }
+    for(int c = 0; c < map->column_count; c++) {
+        if(c > 0 && map->columns[c].expander != map->columns[c - 1].expander) {
+            bits += write_bits(plan, map->columns[c - 1].expander);
+        }
+        bits += write_bits(plan, map->columns[c].expander);
+    }
+    return bits + write_bits(plan, map->columns[map->column_count - 1].expander);
+}
+
+// Every line expander is read once per column
+static uint64_t scan_read_bits(const jkmx_map_t *map, const jkmx_plan_t *plan) {
+    uint64_t bits = 0;
+
+    for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+        if(plan->line_expanders & (1u << e)) {
+            bits += READ_BITS(port_bytes(plan->line_ports[e]));
+        }
+    }
+    return bits * map->column_count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+bool jkmx_map_check(const jkmx_map_t *map) {
+    uint16_t used[JKMX_MAX_EXPANDERS];
+
+    if(map->column_count > JKMX_MAX_COLUMNS || map->line_count > JKMX_MAX_LINES) {
+        return false;
+    }
+
+    // A reserved pin counts as already used
+    memcpy(used, map->reserved, sizeof(used));
+
+    for(int i = 0; i < map->column_count + map->line_count; i++) {
+        const jkmx_pin_t *pin = i < map->column_count
+            ? &map->columns[i]
+            : &map->lines[i - map->column_count];
+
+        if(pin->expander >= JKMX_MAX_EXPANDERS || pin->bit >= 16) {
+            return false;
+        }
+        if(used[pin->expander] & (1u << pin->bit)) {
+            return false;
+        }
+        used[pin->expander] |= 1u << pin->bit;
+    }
+
+    return true;
+}
+
+void jkmx_map_plan(const jkmx_map_t *map, jkmx_plan_t *plan) {
+    memset(plan, 0, sizeof(jkmx_plan_t));
+
+    // Every pin not driven as a column stays an input
+    for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+        plan->iodir[e] = 0xFFFF;
+    }
+
+    for(int c = 0; c < map->column_count; c++) {
+        const jkmx_pin_t *pin = &map->columns[c];
+        plan->column_expanders |= 1u << pin->expander;
+        plan->iodir[pin->expander] &= ~(1u << pin->bit);
+        plan->drive[c] = 1u << pin->bit;
+        plan->column_ports[pin->expander] |= pin->bit < 8 ? JKMX_PORT_GP0 : JKMX_PORT_GP1;
+    }
+
+    for(int l = 0; l < map->line_count; l++) {
+        const jkmx_pin_t *pin = &map->lines[l];
+        plan->line_expanders |= 1u << pin->expander;
+        plan->line_ports[pin->expander] |= pin->bit < 8 ? JKMX_PORT_GP0 : JKMX_PORT_GP1;
+    }
+}
+
+uint16_t jkmx_decode_lines(const jkmx_map_t *map, const uint16_t *ports) {
+    uint16_t lines = 0;
+
+    for(int l = 0; l < map->line_count; l++) {
+        const jkmx_pin_t *pin = &map->lines[l];
+        if((ports[pin->expander] >> pin->bit) & 1) {
+            lines |= 1u << l;
+        }
+    }
+
+    return lines;
+}
+
+void jkmx_find_ghosts(const jkmx_bitmap_t *state, int column_count, jkmx_bitmap_t *ghosts) {
+    memset(ghosts, 0, sizeof(jkmx_bitmap_t));
+
+    for(int i = 0; i < column_count; i++) {
+        if(state->columns[i] == 0) {
+            continue;
+        }
+
+        for(int j = i + 1; j < column_count; j++) {
+            uint16_t common = state->columns[i] & state->columns[j];
+
+            // At least 2 shared lines, a full rectangle
+            if(common & (common - 1)) {
+                ghosts->columns[i] |= common;
+                ghosts->columns[j] |= common;
+            }
+        }
+    }
+}
+
+uint32_t jkmx_estimate_scan_us(const jkmx_map_t *map, uint32_t bus_hz) {
+    jkmx_plan_t plan;
+    jkmx_map_plan(map, &plan);
+
+    uint64_t bits = scan_write_bits(map, &plan) + scan_read_bits(map, &plan);
+
+    return (uint32_t)((bits * 1000000) / bus_hz);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,86 @@
+#ifndef JACK_DECODE_H
+#define JACK_DECODE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Jack matrix pin mapping, line decode and ghost detection.
+// Plain C, no ESP-IDF dependency, the scan itself lives in jack_matrix.c.
+
+#define JKMX_MAX_COLUMNS        16
+#define JKMX_MAX_LINES          16
+#define JKMX_MAX_EXPANDERS      8       // Addresses 0x20..0x27
+#define JKMX_EXPANDER_ADDR(i)   (0x20 + (i))
+
+// Pin of an expander, port 0 (GP0) or 1 (GP1), bit 0..7
+#define JKMX_PIN(expander, port, bit)   { (expander), ((port) * 8) + (bit) }
+
+// Ports of an expander carrying columns or lines, only those are written or read
+#define JKMX_PORT_GP0           0x01
+#define JKMX_PORT_GP1           0x02
+
+typedef struct {
+    uint8_t expander;       // Index, JKMX_EXPANDER_ADDR(expander) on the bus
+    uint8_t bit;            // 0..15, GP0 in the low byte
+} jkmx_pin_t;
+
+typedef struct {
+    uint8_t column_count;
+    uint8_t line_count;
+    jkmx_pin_t columns[JKMX_MAX_COLUMNS];   // Driven high one at a time
+    jkmx_pin_t lines[JKMX_MAX_LINES];       // Read while a column is driven
+    uint16_t reserved[JKMX_MAX_EXPANDERS];  // Pins of other inputs (hook switch), never a column nor a line
+} jkmx_map_t;
+
+// Phonetastic plugboard: 3 columns on GP1, 5 lines on GP0 of the expander at 0x20.
+// GP0.0 is the hook switch, line 1 is on GP0.5 so that a driven column never shows on it.
+#define JKMX_MAP_DEFAULT() {                                                    \
+    .column_count   = 3,                                                        \
+    .line_count     = 5,                                                        \
+    .columns        = { JKMX_PIN(0, 1, 7), JKMX_PIN(0, 1, 6), JKMX_PIN(0, 1, 5) }, \
+    .lines          = { JKMX_PIN(0, 0, 5), JKMX_PIN(0, 0, 1), JKMX_PIN(0, 0, 2),   \
+                        JKMX_PIN(0, 0, 3), JKMX_PIN(0, 0, 4) },                 \
+    .reserved       = { [0] = 0x0001 },                                         \
+}
+
+// One bit per contact, bit line of columns[column], set when plugged
+typedef struct {
+    uint16_t columns[JKMX_MAX_COLUMNS];
+} jkmx_bitmap_t;
+
+// Bus accesses derived once from the map
+typedef struct {
+    uint8_t column_expanders;               // Expanders written, one bit per index
+    uint8_t line_expanders;                 // Expanders read for every column
+    uint16_t iodir[JKMX_MAX_EXPANDERS];     // Bit set for an input
+    uint16_t drive[JKMX_MAX_COLUMNS];       // Output pair of the column expander
+    uint8_t column_ports[JKMX_MAX_EXPANDERS];   // JKMX_PORT_x written
+    uint8_t line_ports[JKMX_MAX_EXPANDERS];     // JKMX_PORT_x read
+} jkmx_plan_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Dimensions, expander indexes, no pin used twice nor reserved.
+bool jkmx_map_check(const jkmx_map_t *map);
+
+void jkmx_map_plan(const jkmx_map_t *map, jkmx_plan_t *plan);
+
+// Lines seen while a column is driven, ports are the GP pairs read per expander.
+uint16_t jkmx_decode_lines(const jkmx_map_t *map, const uint16_t *ports);
+
+// Without diodes, 3 corners of a rectangle plugged also show the 4th one: when
+// two columns share 2 lines or more, those contacts are flagged as ambiguous.
+void jkmx_find_ghosts(const jkmx_bitmap_t *state, int column_count, jkmx_bitmap_t *ghosts);
+
+// Bus time of a full scan, software overhead excluded.
+uint32_t jkmx_estimate_scan_us(const jkmx_map_t *map, uint32_t bus_hz);
+
+static inline bool jkmx_bitmap_get(const jkmx_bitmap_t *bitmap, int column, int line) {
+    return (bitmap->columns[column] >> line) & 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // JACK_DECODE_H
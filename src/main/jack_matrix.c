@@ -0,0 +1,372 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_tools.h"
+#include "gpio_expander.h"
+#include "i2c_driver.h"
+#include "i2c_queue.h"
+
+#include "jack_matrix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_JACK_MATRIX;
+
+#define JKMX_MAX_REQUESTS       (JKMX_MAX_EXPANDERS + JKMX_MAX_COLUMNS * (2 + JKMX_MAX_EXPANDERS))
+
+static jkmx_cfg_t _cfg;
+static jkmx_plan_t _plan;
+
+// Scan batch, built once, used by the scan task only
+static i2cq_batch_t _batch;
+static i2cq_request_t _requests[JKMX_MAX_REQUESTS];
+static uint8_t _drive[JKMX_MAX_COLUMNS][2];
+static uint8_t _release[2];
+static uint8_t _ports[JKMX_MAX_COLUMNS][JKMX_MAX_EXPANDERS][2];
+static QueueHandle_t _queue;
+static TaskHandle_t _task;
+static volatile bool _running;
+
+// Written by the scan task only, read by the application under the lock
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+static jkmx_bitmap_t _state;
+static jkmx_bitmap_t _ghosts;
+static int64_t _max_scan_us;
+static uint32_t _overruns;
+static uint32_t _dropped_events;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static esp_err_t release_columns(int expander) {
+    return gpxp_writeRegisterPairAt(JKMX_EXPANDER_ADDR(expander), REGISTER_GP0, 0x0000);
+}
+
+// Only the ports used, a single register when the other port carries no column or line.
+// pair: GP0 byte then GP1 byte.
+static void add_request(uint8_t op, int expander, uint8_t ports, uint8_t *pair) {
+    i2cq_request_t *request = &_requests[_batch.count++];
+    request->op = op;
+    request->address = JKMX_EXPANDER_ADDR(expander);
+
+    if(ports == JKMX_PORT_GP1) {
+        request->register_id = REGISTER_GP1;
+        request->len = 1;
+        request->data = pair + 1;
+    } else {
+        request->register_id = REGISTER_GP0;
+        request->len = ports == JKMX_PORT_GP0 ? 1 : 2;
+        request->data = pair;
+    }
+}
+
+static void add_write(int expander, uint8_t *pair) {
+    add_request(I2CQ_OP_WRITE, expander, _plan.column_ports[expander], pair);
+}
+
+// The whole scan is one chained batch: for each column a write, then a read of every
+// line expander. The repeated START, address and register bytes before a read give
+// the lines time to settle (20 bit times).
+static void build_scan() {
+    int driven = -1;    // Expander holding the driven column
+
+    _batch.client = I2CQ_CLIENT_SCAN;
+    _batch.priority = I2CQ_PRIORITY_LOW;
+    _batch.requests = _requests;
+    _batch.count = 0;
+    _batch.chained = true;
+
+    // The bus task retries a failed batch from its start, another column expander may
+    // still drive a column of the failed attempt
+    for(int e = 0; e < JKMX_MAX_EXPANDERS && _cfg.map.column_count > 0; e++) {
+        if((_plan.column_expanders & (1u << e)) && e != _cfg.map.columns[0].expander) {
+            add_write(e, _release);
+        }
+    }
+
+    for(int c = 0; c < _cfg.map.column_count; c++) {
+        const jkmx_pin_t *column = &_cfg.map.columns[c];
+
+        // Same expander, the next drive value also releases the previous column
+        if(driven >= 0 && driven != column->expander) {
+            add_write(driven, _release);
+        }
+
+        _drive[c][0] = _plan.drive[c] & 0xFF;
+        _drive[c][1] = _plan.drive[c] >> 8;
+        add_write(column->expander, _drive[c]);
+        driven = column->expander;
+
+        for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+            if(_plan.line_expanders & (1u << e)) {
+                add_request(I2CQ_OP_READ, e, _plan.line_ports[e], _ports[c][e]);
+            }
+        }
+    }
+
+    // Columns idle between two scans, as in the expander register shadow
+    if(driven >= 0) {
+        add_write(driven, _release);
+    }
+}
+
+static esp_err_t scan(jkmx_bitmap_t *bitmap, int64_t *timestamp) {
+    esp_err_t err = i2cq_execute(&_batch);
+    *timestamp = esp_timer_get_time();
+
+    if(err != ESP_OK) {
+        // A column may be left driven, it would be seen on every column of the next scan
+        gpxp_invalidateCache();
+        for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+            if(_plan.column_expanders & (1u << e)) {
+                release_columns(e);
+            }
+        }
+        return err;
+    }
+
+    memset(bitmap, 0, sizeof(jkmx_bitmap_t));
+    for(int c = 0; c < _cfg.map.column_count; c++) {
+        uint16_t ports[JKMX_MAX_EXPANDERS];
+        for(int e = 0; e < JKMX_MAX_EXPANDERS; e++) {
+            ports[e] = ((uint16_t)_ports[c][e][1] << 8) | _ports[c][e][0];
+        }
+        bitmap->columns[c] = jkmx_decode_lines(&_cfg.map, ports);
+    }
+
+    return ESP_OK;
+}
+
+static void post_changes(const jkmx_bitmap_t *previous, const jkmx_bitmap_t *previous_ghosts,
+        const jkmx_bitmap_t *current, const jkmx_bitmap_t *current_ghosts, int64_t timestamp) {
+
+    for(int c = 0; c < _cfg.map.column_count; c++) {
+        uint16_t changes = previous->columns[c] ^ current->columns[c];
+
+        for(int l = 0; changes != 0; l++, changes >>= 1) {
+            if((changes & 1) == 0) {
+                continue;
+            }
+
+            bool plugged = jkmx_bitmap_get(current, c, l);
+            jkmx_event_t event = {
+                .column = c,
+                .line = l,
+                .plugged = plugged,
+                .ghost = jkmx_bitmap_get(plugged ? current_ghosts : previous_ghosts, c, l),
+                .timestamp_us = timestamp,
+            };
+            if(xQueueSend(_queue, &event, 0) != pdTRUE) {
+                _dropped_events++;
+                ESP_LOGW(TAG, "Event queue full, %u events dropped", _dropped_events);
+            }
+        }
+    }
+}
+
+static void tx_scanWorker(void *args) {
+    LOGM_FUNC_IN();
+
+    jkmx_bitmap_t current;
+    jkmx_bitmap_t current_ghosts;
+    int64_t timestamp;
+    TickType_t period = _cfg.scan_period_ms / portTICK_PERIOD_MS;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    if(period == 0) {
+        period = 1;
+    }
+
+    while(_running) {
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = scan(&current, &timestamp);
+        int64_t duration = esp_timer_get_time() - start;
+
+        if(err != ESP_OK) {
+            // The state is kept, a failed scan is not an unplug
+            ESP_LOGW(TAG, "Fail to scan the jack matrix! %s", esp_err_to_name(err));
+        } else {
+            jkmx_bitmap_t previous;
+            jkmx_bitmap_t previous_ghosts;
+
+            jkmx_find_ghosts(&current, _cfg.map.column_count, &current_ghosts);
+
+            portENTER_CRITICAL(&_lock);
+            previous = _state;
+            previous_ghosts = _ghosts;
+            _state = current;
+            _ghosts = current_ghosts;
+            if(duration > _max_scan_us) {
+                _max_scan_us = duration;
+            }
+            if(duration > _cfg.scan_budget_us) {
+                _overruns++;
+            }
+            portEXIT_CRITICAL(&_lock);
+
+            if(duration > _cfg.scan_budget_us) {
+                ESP_LOGD(TAG, "Scan over budget: %lldus > %ius", (long long)duration, _cfg.scan_budget_us);
+            }
+
+            post_changes(&previous, &previous_ghosts, &current, &current_ghosts, timestamp);
+        }
+
+        vTaskDelayUntil(&last_wake, period);
+    }
+
+    LOGM_FUNC_OUT();
+    _task = NULL;
+    vTaskDelete(NULL);
+}
+
+static esp_err_t configure_expanders() {
+    esp_err_t err = ESP_OK;
+
+    for(int e = 0; e < JKMX_MAX_EXPANDERS && err == ESP_OK; e++) {
+        if(((_plan.column_expanders | _plan.line_expanders) & (1u << e)) == 0) {
+            continue;
+        }
+
+        err = gpxp_configureDevice(JKMX_EXPANDER_ADDR(e), _plan.iodir[e]);
+        if(err == ESP_OK && (_plan.column_expanders & (1u << e))) {
+            err = release_columns(e);
+        }
+        if(err != ESP_OK) {
+            ESP_LOGE(TAG, "Fail to configure expander %#02x!", JKMX_EXPANDER_ADDR(e));
+        }
+    }
+
+    return err;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t jkmx_initialize(const jkmx_cfg_t *cfg) {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+
+    if(_task != NULL) {
+        ESP_LOGD(TAG, "Already initialized!");
+        err = ESP_OK;
+        goto end;
+    }
+
+    if(!jkmx_map_check(&cfg->map)) {
+        ESP_LOGE(TAG, "Invalid jack matrix map!");
+        err = ESP_ERR_INVALID_ARG;
+        goto end;
+    }
+
+    _cfg = *cfg;
+    jkmx_map_plan(&_cfg.map, &_plan);
+    memset(&_state, 0, sizeof(_state));
+    memset(&_ghosts, 0, sizeof(_ghosts));
+    _max_scan_us = 0;
+    _overruns = 0;
+    _dropped_events = 0;
+
+    uint32_t estimate_us = jkmx_estimate_scan_us(&_cfg.map, i2c_getFrequency());
+    if(estimate_us > (uint32_t)_cfg.scan_budget_us) {
+        ESP_LOGW(TAG, "Estimated scan time %uus is over the budget (%ius)!", estimate_us, _cfg.scan_budget_us);
+    }
+
+    err = configure_expanders();
+    if(err != ESP_OK) {
+        goto end;
+    }
+    build_scan();
+    if(_batch.count > I2C_COMMAND_CHAIN_TRANSACTIONS) {
+        ESP_LOGW(TAG, "Scan of %u accesses, its command link is allocated on the heap!", (unsigned)_batch.count);
+    }
+
+    if(_queue == NULL) {
+        _queue = xQueueCreate(_cfg.queue_size, sizeof(jkmx_event_t));
+        if(_queue == NULL) {
+            ESP_LOGE(TAG, "Fail to create jack matrix event queue!");
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+    }
+
+    _running = true;
+    if(xTaskCreatePinnedToCore(
+        tx_scanWorker,              // Function to implement the task
+        "tx_scanWorker",            // Name of the task
+        _cfg.task_stack,            // Stack size in words
+        NULL,                       // Task input parameter
+        _cfg.task_prio,             // Priority of the task
+        &_task,                     // Task handle.
+        _cfg.task_core) != pdPASS) {
+        ESP_LOGE(TAG, "Fail to create jack matrix scan task!");
+        _running = false;
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+
+    ESP_LOGI(TAG, "Scan %ix%i contacts every %ims, estimated %uus",
+        _cfg.map.column_count, _cfg.map.line_count, _cfg.scan_period_ms, estimate_us);
+    err = ESP_OK;
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+void jkmx_finalize() {
+    LOGM_FUNC_IN();
+
+    // The task ends after its current scan
+    _running = false;
+    while(_task != NULL) {
+        vTaskDelay(_cfg.scan_period_ms / portTICK_PERIOD_MS + 1);
+    }
+
+    LOGM_FUNC_OUT();
+}
+
+QueueHandle_t jkmx_get_event_queue() {
+    return _queue;
+}
+
+void jkmx_get_state(jkmx_bitmap_t *state) {
+    portENTER_CRITICAL(&_lock);
+    *state = _state;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void jkmx_get_ghosts(jkmx_bitmap_t *ghosts) {
+    portENTER_CRITICAL(&_lock);
+    *ghosts = _ghosts;
+    portEXIT_CRITICAL(&_lock);
+}
+
+bool jkmx_is_plugged(int column, int line) {
+    if(column < 0 || column >= _cfg.map.column_count || line < 0 || line >= _cfg.map.line_count) {
+        return false;
+    }
+
+    jkmx_bitmap_t state;
+    jkmx_get_state(&state);
+    return jkmx_bitmap_get(&state, column, line);
+}
+
+int64_t jkmx_get_max_scan_us() {
+    portENTER_CRITICAL(&_lock);
+    int64_t max_scan_us = _max_scan_us;
+    portEXIT_CRITICAL(&_lock);
+    return max_scan_us;
+}
+
+uint32_t jkmx_get_overruns() {
+    portENTER_CRITICAL(&_lock);
+    uint32_t overruns = _overruns;
+    portEXIT_CRITICAL(&_lock);
+    return overruns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
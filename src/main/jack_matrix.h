@@ -0,0 +1,72 @@
+#ifndef JACK_MATRIX_H
+#define JACK_MATRIX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+
+#include "jack_decode.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_JACK_MATRIX         "jack_matrix"
+
+#define JKMX_SCAN_PERIOD_MS     20
+#define JKMX_SCAN_BUDGET_US     15000   // 16x16 board at 100kHz, 2 expanders
+#define JKMX_QUEUE_SIZE         32
+#define JKMX_TASK_STACK         (3 * 1024)
+#define JKMX_TASK_CORE          (0)
+#define JKMX_TASK_PRIO          (3)
+
+typedef struct {
+    jkmx_map_t map;         // Dimensions and pin mapping
+    int scan_period_ms;     // One full scan every period
+    int scan_budget_us;     // A longer scan is counted as an overrun
+    int queue_size;         // Change events waiting for the application
+    int task_stack;
+    int task_core;
+    int task_prio;
+} jkmx_cfg_t;
+
+#define JKMX_CFG_DEFAULT() {                        \
+    .map            = JKMX_MAP_DEFAULT(),           \
+    .scan_period_ms = JKMX_SCAN_PERIOD_MS,          \
+    .scan_budget_us = JKMX_SCAN_BUDGET_US,          \
+    .queue_size     = JKMX_QUEUE_SIZE,              \
+    .task_stack     = JKMX_TASK_STACK,              \
+    .task_core      = JKMX_TASK_CORE,               \
+    .task_prio      = JKMX_TASK_PRIO,               \
+}
+
+typedef struct {
+    uint8_t column;
+    uint8_t line;
+    bool plugged;
+    bool ghost;             // May be a phantom contact, see jkmx_find_ghosts()
+    int64_t timestamp_us;   // esp_timer end time of the scan that saw the change
+} jkmx_event_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Start the background scan, the GPIO expander must be initialized.
+esp_err_t jkmx_initialize(const jkmx_cfg_t *cfg);
+void jkmx_finalize();
+
+// Change events, one jkmx_event_t per contact that changed.
+QueueHandle_t jkmx_get_event_queue();
+
+// State of the last full scan, no bus access.
+void jkmx_get_state(jkmx_bitmap_t *state);
+void jkmx_get_ghosts(jkmx_bitmap_t *ghosts);
+bool jkmx_is_plugged(int column, int line);
+
+// Duration of the slowest scan and scans over the budget since the start.
+int64_t jkmx_get_max_scan_us();
+uint32_t jkmx_get_overruns();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // JACK_MATRIX_H
@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "latency_probe.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_LATENCY_PROBE;
+
+static const char *stage_names[LTCY_STAGE_COUNT] = {
+    "interrupt",
+    "intcap read",
+    "pipeline run",
+    "first decoded",
+    "first i2s write",
+};
+
+// Marks come from the application, the player and the audio element tasks
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int64_t _marks[LTCY_STAGE_COUNT];
+static uint32_t _marked;            // One bit per stage of the current measurement
+static ltcy_histogram_t _histograms[LTCY_STAGE_COUNT];
+
+#define LTCY_ALL_STAGES         ((1 << LTCY_STAGE_COUNT) - 1)
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int bucket_of(uint32_t us) {
+    if(us == 0) {
+        return 0;
+    }
+
+    int bucket = 31 - __builtin_clz(us);
+    return bucket < LTCY_BUCKET_COUNT ? bucket : LTCY_BUCKET_COUNT - 1;
+}
+
+static void add_sample(ltcy_histogram_t *histogram, uint32_t us) {
+    if(histogram->count == 0 || us < histogram->min_us) {
+        histogram->min_us = us;
+    }
+    if(us > histogram->max_us) {
+        histogram->max_us = us;
+    }
+    histogram->count++;
+    histogram->sum_us += us;
+    histogram->buckets[bucket_of(us)]++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ltcy_mark(ltcy_stage_t stage) {
+    ltcy_mark_at(stage, esp_timer_get_time());
+}
+
+void ltcy_mark_at(ltcy_stage_t stage, int64_t now) {
+    if(stage >= LTCY_STAGE_COUNT) {
+        return;
+    }
+
+    uint32_t delays[LTCY_STAGE_COUNT];
+    bool completed = false;
+
+    portENTER_CRITICAL(&_lock);
+    if(stage == LTCY_STAGE_INTERRUPT) {
+        _marks[LTCY_STAGE_INTERRUPT] = now;
+        _marked = 1 << LTCY_STAGE_INTERRUPT;
+    } else if((_marked & (1 << LTCY_STAGE_INTERRUPT)) && !(_marked & (1 << stage))) {
+        _marks[stage] = now;
+        _marked |= 1 << stage;
+
+        if(_marked == LTCY_ALL_STAGES) {
+            for(int s = 0; s < LTCY_STAGE_COUNT; s++) {
+                delays[s] = (uint32_t)(_marks[s] - _marks[LTCY_STAGE_INTERRUPT]);
+                add_sample(&_histograms[s], delays[s]);
+            }
+            _marked = 0;
+            completed = true;
+        }
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if(completed) {
+        ESP_LOGI(TAG, "Off-hook latency: intcap %u us, run %u us, decoded %u us, i2s %u us",
+            delays[LTCY_STAGE_INTCAP_READ],
+            delays[LTCY_STAGE_PIPELINE_RUN],
+            delays[LTCY_STAGE_FIRST_DECODED],
+            delays[LTCY_STAGE_FIRST_I2S_WRITE]);
+    }
+}
+
+void ltcy_cancel() {
+    portENTER_CRITICAL(&_lock);
+    _marked = 0;
+    portEXIT_CRITICAL(&_lock);
+}
+
+esp_err_t ltcy_get_histogram(ltcy_stage_t stage, ltcy_histogram_t *histogram) {
+    if(stage >= LTCY_STAGE_COUNT || histogram == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&_lock);
+    *histogram = _histograms[stage];
+    portEXIT_CRITICAL(&_lock);
+
+    return ESP_OK;
+}
+
+void ltcy_log_histograms() {
+    ltcy_histogram_t histogram;
+
+    for(int s = LTCY_STAGE_INTCAP_READ; s < LTCY_STAGE_COUNT; s++) {
+        ltcy_get_histogram(s, &histogram);
+        if(histogram.count == 0) {
+            ESP_LOGI(TAG, "%s: no measurement", stage_names[s]);
+            continue;
+        }
+
+        ESP_LOGI(TAG, "%s: %u measurements, min %u us, avg %u us, max %u us",
+            stage_names[s], histogram.count, histogram.min_us,
+            (uint32_t)(histogram.sum_us / histogram.count), histogram.max_us);
+
+        for(int b = 0; b < LTCY_BUCKET_COUNT; b++) {
+            if(histogram.buckets[b] != 0) {
+                ESP_LOGI(TAG, "    [%u, %u[ us: %u",
+                    b == 0 ? 0 : (1u << b), 1u << (b + 1), histogram.buckets[b]);
+            }
+        }
+    }
+}
+
+void ltcy_reset() {
+    portENTER_CRITICAL(&_lock);
+    _marked = 0;
+    memset(_histograms, 0, sizeof(_histograms));
+    portEXIT_CRITICAL(&_lock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,52 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_LATENCY_PROBE       "latency_probe"
+
+// Off-hook to first sample latency. A measurement starts at LTCY_STAGE_INTERRUPT,
+// every other stage is timed from it (esp_timer, microseconds) and added to its
+// histogram when the last stage is reached.
+typedef enum {
+    LTCY_STAGE_INTERRUPT = 0,       // Expander INT of the hook switch edge
+    LTCY_STAGE_INTCAP_READ,         // Expander port read (INTCAP, GP when the INT missed the edge)
+    LTCY_STAGE_PIPELINE_RUN,        // Player pipeline running and released to i2s
+    LTCY_STAGE_FIRST_DECODED,       // First PCM block of the source read by the router
+    LTCY_STAGE_FIRST_I2S_WRITE,     // First frames handed to the i2s writer
+    LTCY_STAGE_COUNT,
+} ltcy_stage_t;
+
+// Bucket i counts latencies in [2^i, 2^(i+1)) us, bucket 0 also counts 0 us
+#define LTCY_BUCKET_COUNT       24
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t buckets[LTCY_BUCKET_COUNT];
+} ltcy_histogram_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+// LTCY_STAGE_INTERRUPT starts a new measurement, any other stage is only
+// recorded the first time it is reached during the current measurement.
+void ltcy_mark(ltcy_stage_t stage);
+// Same with a time taken earlier, e.g. in an ISR.
+void ltcy_mark_at(ltcy_stage_t stage, int64_t time_us);
+
+// Drop the current measurement, the event was not an off-hook.
+void ltcy_cancel();
+
+esp_err_t ltcy_get_histogram(ltcy_stage_t stage, ltcy_histogram_t *histogram);
+void ltcy_log_histograms();
+void ltcy_reset();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // LATENCY_PROBE_H
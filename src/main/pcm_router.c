@@ -0,0 +1,118 @@
+#include <string.h>
+
+#include "pcm_router.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+void pcmr_route_stereo(int16_t *frames, size_t frame_count, pcm_route_t route) {
+    switch(route) {
+        case PCM_ROUTE_BOTH:
+            break;
+
+        case PCM_ROUTE_LEFT:
+            for(size_t i = 0; i < frame_count; i++) {
+                frames[2 * i + 1] = 0;
+            }
+            break;
+
+        case PCM_ROUTE_RIGHT:
+            for(size_t i = 0; i < frame_count; i++) {
+                frames[2 * i] = 0;
+            }
+            break;
+
+        default:
+            memset(frames, 0, frame_count * PCM_STEREO_FRAME_BYTES);
+            break;
+    }
+}
+
+void pcmr_place_mono(int16_t *buffer, size_t sample_count, pcm_route_t route) {
+    int16_t left_mask = (route & PCM_ROUTE_LEFT) ? -1 : 0;
+    int16_t right_mask = (route & PCM_ROUTE_RIGHT) ? -1 : 0;
+
+    // Walk backward, frame i is written after sample i has been read
+    for(size_t i = sample_count; i > 0; i--) {
+        int16_t sample = buffer[i - 1];
+        buffer[2 * (i - 1)] = sample & left_mask;
+        buffer[2 * (i - 1) + 1] = sample & right_mask;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void pcmr_cadence_init(pcm_cadence_t *cadence, uint32_t on_frames, uint32_t off_frames) {
+    cadence->on_frames = on_frames;
+    cadence->off_frames = off_frames;
+    cadence->remaining = on_frames;
+    cadence->on = true;
+}
+
+bool pcmr_cadence_enabled(const pcm_cadence_t *cadence) {
+    return cadence->on_frames > 0;
+}
+
+uint32_t pcmr_cadence_available(const pcm_cadence_t *cadence, uint32_t max_frames) {
+    if(!pcmr_cadence_enabled(cadence)) {
+        return max_frames;
+    }
+
+    return cadence->remaining < max_frames ? cadence->remaining : max_frames;
+}
+
+void pcmr_cadence_advance(pcm_cadence_t *cadence, uint32_t frames) {
+    if(!pcmr_cadence_enabled(cadence)) {
+        return;
+    }
+
+    cadence->remaining -= frames < cadence->remaining ? frames : cadence->remaining;
+
+    // A phase with no frame (no gap) is skipped
+    while(cadence->remaining == 0) {
+        cadence->on = !cadence->on;
+        cadence->remaining = cadence->on ? cadence->on_frames : cadence->off_frames;
+    }
+}
+
+uint32_t pcmr_cadence_position(const pcm_cadence_t *cadence) {
+    if(!pcmr_cadence_enabled(cadence)) {
+        return 0;
+    }
+
+    return (cadence->on ? cadence->on_frames : cadence->off_frames) - cadence->remaining;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void pcmr_burst_init(pcm_burst_t *burst, char *data, size_t size) {
+    burst->data = data;
+    burst->size = data == NULL ? 0 : size;
+    burst->recorded = 0;
+}
+
+bool pcmr_burst_ready(const pcm_burst_t *burst) {
+    return burst->size > 0 && burst->recorded == burst->size;
+}
+
+void pcmr_burst_record(pcm_burst_t *burst, const char *frames, size_t len) {
+    size_t left = burst->size - burst->recorded;
+
+    if(burst->data == NULL) {
+        return;
+    }
+    len = len < left ? len : left;
+    memcpy(burst->data + burst->recorded, frames, len);
+    burst->recorded += len;
+}
+
+void pcmr_burst_replay(const pcm_burst_t *burst, size_t offset, char *frames, size_t len) {
+    size_t copied = 0;
+
+    if(offset < burst->recorded) {
+        copied = burst->recorded - offset < len ? burst->recorded - offset : len;
+        memcpy(frames, burst->data + offset, copied);
+    }
+    memset(frames + copied, 0, len - copied);
+}
+
+///////////////////////////////////////////////////////////////////////////////
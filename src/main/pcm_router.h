@@ -0,0 +1,83 @@
+#ifndef PCM_ROUTER_H
+#define PCM_ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Plain C PCM helpers used by the channel router element.
+// No ESP-IDF / ADF dependency so they can be built and checked on Linux.
+
+#define PCM_SAMPLE_BYTES        2   // 16 bits signed
+#define PCM_MONO_FRAME_BYTES    (1 * PCM_SAMPLE_BYTES)
+#define PCM_STEREO_FRAME_BYTES  (2 * PCM_SAMPLE_BYTES)
+
+typedef enum {
+    PCM_ROUTE_NONE  = 0x00,     // Both outputs muted
+    PCM_ROUTE_LEFT  = 0x01,     // Ringer speaker
+    PCM_ROUTE_RIGHT = 0x02,     // Handset earpiece
+    PCM_ROUTE_BOTH  = 0x03,
+} pcm_route_t;
+
+// On/off cadence counted in frames, so the gaps are sample accurate.
+typedef struct {
+    uint32_t on_frames;     // 0 when the cadence is disabled
+    uint32_t off_frames;
+    uint32_t remaining;     // Frames left in the current phase
+    bool on;
+} pcm_cadence_t;
+
+// Frames of the first on phase, kept as read (mono or stereo) and routed again on replay.
+// Each following on phase replays them, so every burst starts at the beginning of the track.
+typedef struct {
+    char *data;             // NULL when there is no cache
+    size_t size;            // Bytes of a whole on phase
+    size_t recorded;
+} pcm_burst_t;
+
+#define PCM_MS_TO_FRAMES(ms, sample_rate)   ((uint32_t)(((uint64_t)(ms) * (sample_rate)) / 1000))
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Route interleaved stereo frames in place: the selected slots are kept, the others are silenced.
+void pcmr_route_stereo(int16_t *frames, size_t frame_count, pcm_route_t route);
+
+// Expand mono samples in place to interleaved stereo frames, the sample is put on the selected slots.
+// buffer must be able to hold 2 * sample_count samples.
+void pcmr_place_mono(int16_t *buffer, size_t sample_count, pcm_route_t route);
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Start a cadence with its on phase. on_frames == 0 disables it.
+void pcmr_cadence_init(pcm_cadence_t *cadence, uint32_t on_frames, uint32_t off_frames);
+
+bool pcmr_cadence_enabled(const pcm_cadence_t *cadence);
+
+// Number of frames, at most max_frames, that can be processed before the next phase change.
+uint32_t pcmr_cadence_available(const pcm_cadence_t *cadence, uint32_t max_frames);
+
+// Account processed frames, switch phase when the current one is over.
+void pcmr_cadence_advance(pcm_cadence_t *cadence, uint32_t frames);
+
+// Frames already processed in the current phase.
+uint32_t pcmr_cadence_position(const pcm_cadence_t *cadence);
+
+///////////////////////////////////////////////////////////////////////////////
+
+// data holds size bytes, NULL or size == 0 for no cache: the burst is then never ready.
+void pcmr_burst_init(pcm_burst_t *burst, char *data, size_t size);
+
+// The whole on phase is recorded, the next ones can be replayed.
+bool pcmr_burst_ready(const pcm_burst_t *burst);
+
+// Append frames read in the first on phase, the bytes past size are dropped.
+void pcmr_burst_record(pcm_burst_t *burst, const char *frames, size_t len);
+
+// Copy len bytes of the on phase from offset, the bytes past the recording are silence.
+void pcmr_burst_replay(const pcm_burst_t *burst, size_t offset, char *frames, size_t len);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // PCM_ROUTER_H
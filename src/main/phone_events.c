@@ -0,0 +1,117 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_tools.h"
+#include "phone_events.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_PHONE_EVENTS;
+
+static const uint8_t _priorities[PHSM_EVENT_COUNT] = {
+    [PHSM_EVENT_HOOK_OFF]       = PHEV_PRIORITY_HIGH,
+    [PHSM_EVENT_HOOK_ON]        = PHEV_PRIORITY_HIGH,
+    [PHSM_EVENT_JACK_CHANGED]   = PHEV_PRIORITY_NORMAL,
+    [PHSM_EVENT_PUZZLE_SOLVED]  = PHEV_PRIORITY_NORMAL,
+    [PHSM_EVENT_INCOMING_CALL]  = PHEV_PRIORITY_NORMAL,
+    [PHSM_EVENT_TRACE_KEY]      = PHEV_PRIORITY_NORMAL,
+    [PHSM_EVENT_RING_TIMEOUT]   = PHEV_PRIORITY_LOW,
+    [PHSM_EVENT_GUARD_TIMEOUT]  = PHEV_PRIORITY_LOW,
+    [PHSM_EVENT_AUDIO_FINISHED] = PHEV_PRIORITY_LOW,
+};
+
+static QueueHandle_t _queues[PHEV_PRIORITY_COUNT];  // phev_event_t
+static SemaphoreHandle_t _pending;                  // Events in all queues
+static uint32_t _dropped;
+static portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t phev_initialize() {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
+
+    if(_pending != NULL) {
+        ESP_LOGD(TAG, "Already initialized!");
+        err = ESP_OK;
+        goto end;
+    }
+
+    for(int p = 0; p < PHEV_PRIORITY_COUNT; p++) {
+        _queues[p] = xQueueCreate(PHEV_QUEUE_SIZE, sizeof(phev_event_t));
+        if(_queues[p] == NULL) {
+            ESP_LOGE(TAG, "Fail to create phone event queues!");
+            err = ESP_ERR_NO_MEM;
+            goto end;
+        }
+    }
+
+    _pending = xSemaphoreCreateCounting(PHEV_QUEUE_SIZE * PHEV_PRIORITY_COUNT, 0);
+    if(_pending == NULL) {
+        ESP_LOGE(TAG, "Fail to create phone event queues!");
+        err = ESP_ERR_NO_MEM;
+        goto end;
+    }
+    err = ESP_OK;
+
+    end:
+    LOGM_FUNC_OUT();
+    return err;
+}
+
+esp_err_t phev_post(const phev_event_t *event) {
+    if(event->type >= PHSM_EVENT_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if(_pending == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if(xQueueSend(_queues[_priorities[event->type]], event, 0) != pdTRUE) {
+        portENTER_CRITICAL(&_lock);
+        _dropped++;
+        portEXIT_CRITICAL(&_lock);
+        ESP_LOGW(TAG, "Queue full, %s dropped!", phsm_event_name(event->type));
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(_pending);
+    return ESP_OK;
+}
+
+esp_err_t phev_post_type(phsm_event_t type) {
+    phev_event_t event;
+
+    memset(&event, 0, sizeof(phev_event_t));
+    event.type = type;
+    event.time_us = esp_timer_get_time();
+    return phev_post(&event);
+}
+
+bool phev_receive(phev_event_t *event, TickType_t wait) {
+    if(_pending == NULL || xSemaphoreTake(_pending, wait) != pdTRUE) {
+        return false;
+    }
+
+    for(int p = 0; p < PHEV_PRIORITY_COUNT; p++) {
+        if(xQueueReceive(_queues[p], event, 0) == pdTRUE) {
+            return true;
+        }
+    }
+    return false;
+}
+
+phev_priority_t phev_get_priority(phsm_event_t type) {
+    return type < PHSM_EVENT_COUNT ? _priorities[type] : PHEV_PRIORITY_LOW;
+}
+
+uint32_t phev_get_dropped() {
+    portENTER_CRITICAL(&_lock);
+    uint32_t dropped = _dropped;
+    portEXIT_CRITICAL(&_lock);
+    return dropped;
+}
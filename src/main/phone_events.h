@@ -0,0 +1,56 @@
+#ifndef PHONE_EVENTS_H
+#define PHONE_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#include "phone_fsm.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_PHONE_EVENTS        "phone_events"
+
+// Single event queue of the telephone state machine, fed by the hardware (hook,
+// plugboard, keys), the timers and the audio player. Each event type has a priority,
+// the highest priority event waiting is received first, in order within a priority.
+// Posting never blocks, producers only post.
+
+#define PHEV_QUEUE_SIZE         8       // Events waiting, per priority
+
+typedef enum {
+    PHEV_PRIORITY_HIGH,     // Hook switch
+    PHEV_PRIORITY_NORMAL,   // Plugboard, keys, incoming call
+    PHEV_PRIORITY_LOW,      // Timers, audio
+    PHEV_PRIORITY_COUNT,
+} phev_priority_t;
+
+typedef struct {
+    uint8_t type;           // phsm_event_t
+    uint8_t column;         // PHSM_EVENT_JACK_CHANGED contact
+    uint8_t line;
+    bool plugged;
+    uint32_t timer_seq;     // Timer events: start count of the timer when it fired
+    int64_t time_us;        // When it happened (esp_timer)
+} phev_event_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+esp_err_t phev_initialize();
+
+// No wait, ESP_ERR_TIMEOUT when the queue of its priority is full (the event is dropped).
+esp_err_t phev_post(const phev_event_t *event);
+// Event without data, happening now.
+esp_err_t phev_post_type(phsm_event_t type);
+
+// Highest priority event first, false when none came within wait.
+bool phev_receive(phev_event_t *event, TickType_t wait);
+
+phev_priority_t phev_get_priority(phsm_event_t type);
+uint32_t phev_get_dropped();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // PHONE_EVENTS_H
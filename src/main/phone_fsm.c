@@ -0,0 +1,127 @@
+#include <stddef.h>
+
+#include "phone_fsm.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TO(state, action)       { (state), (action), true }
+
+// Events handled the same way in every state
+#define COMMON_TRANSITIONS(state)                                               \
+    [PHSM_EVENT_JACK_CHANGED]   = TO(state, PHSM_ACTION_LOG_JACK),              \
+    [PHSM_EVENT_TRACE_KEY]      = TO(state, PHSM_ACTION_DUMP_TRACE)
+
+static const phsm_transition_t _table[PHSM_STATE_COUNT][PHSM_EVENT_COUNT] = {
+    [PHSM_STATE_IDLE] = {
+        COMMON_TRANSITIONS(PHSM_STATE_IDLE),
+        [PHSM_EVENT_HOOK_OFF]       = TO(PHSM_STATE_OFF_HOOK, PHSM_ACTION_DIAL_TONE),
+        [PHSM_EVENT_INCOMING_CALL]  = TO(PHSM_STATE_RINGING, PHSM_ACTION_RING),
+        [PHSM_EVENT_PUZZLE_SOLVED]  = TO(PHSM_STATE_SOLVED_ON_HOOK, PHSM_ACTION_SOLVED_RING),
+    },
+    [PHSM_STATE_RINGING] = {
+        COMMON_TRANSITIONS(PHSM_STATE_RINGING),
+        [PHSM_EVENT_HOOK_OFF]       = TO(PHSM_STATE_IN_CALL, PHSM_ACTION_ANSWER),
+        [PHSM_EVENT_RING_TIMEOUT]   = TO(PHSM_STATE_IDLE, PHSM_ACTION_STOP_RING),
+        [PHSM_EVENT_PUZZLE_SOLVED]  = TO(PHSM_STATE_SOLVED_ON_HOOK, PHSM_ACTION_SOLVED_RING),
+    },
+    [PHSM_STATE_OFF_HOOK] = {
+        COMMON_TRANSITIONS(PHSM_STATE_OFF_HOOK),
+        [PHSM_EVENT_HOOK_ON]        = TO(PHSM_STATE_HUNG_UP, PHSM_ACTION_HANG_UP),
+        [PHSM_EVENT_PUZZLE_SOLVED]  = TO(PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_SOLVED_MESSAGE),
+    },
+    [PHSM_STATE_IN_CALL] = {
+        COMMON_TRANSITIONS(PHSM_STATE_IN_CALL),
+        [PHSM_EVENT_HOOK_ON]        = TO(PHSM_STATE_HUNG_UP, PHSM_ACTION_HANG_UP),
+        [PHSM_EVENT_AUDIO_FINISHED] = TO(PHSM_STATE_OFF_HOOK, PHSM_ACTION_BUSY_TONE),
+        [PHSM_EVENT_PUZZLE_SOLVED]  = TO(PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_SOLVED_MESSAGE),
+    },
+    [PHSM_STATE_HUNG_UP] = {
+        COMMON_TRANSITIONS(PHSM_STATE_HUNG_UP),
+        [PHSM_EVENT_HOOK_OFF]       = TO(PHSM_STATE_OFF_HOOK, PHSM_ACTION_DIAL_TONE),
+        [PHSM_EVENT_GUARD_TIMEOUT]  = TO(PHSM_STATE_IDLE, PHSM_ACTION_NONE),
+        [PHSM_EVENT_INCOMING_CALL]  = TO(PHSM_STATE_RINGING, PHSM_ACTION_RING),
+        [PHSM_EVENT_PUZZLE_SOLVED]  = TO(PHSM_STATE_SOLVED_ON_HOOK, PHSM_ACTION_SOLVED_RING),
+    },
+    // Latched: the contacts may change, only a new call starts the game again
+    [PHSM_STATE_SOLVED_ON_HOOK] = {
+        COMMON_TRANSITIONS(PHSM_STATE_SOLVED_ON_HOOK),
+        [PHSM_EVENT_HOOK_OFF]       = TO(PHSM_STATE_SOLVED_OFF_HOOK, PHSM_ACTION_SOLVED_MESSAGE),
+        [PHSM_EVENT_RING_TIMEOUT]   = TO(PHSM_STATE_SOLVED_ON_HOOK, PHSM_ACTION_STOP_SOUND),
+        [PHSM_EVENT_INCOMING_CALL]  = TO(PHSM_STATE_RINGING, PHSM_ACTION_RING),
+    },
+    // A call to the lifted handset finds the line busy, the game starts again
+    [PHSM_STATE_SOLVED_OFF_HOOK] = {
+        COMMON_TRANSITIONS(PHSM_STATE_SOLVED_OFF_HOOK),
+        [PHSM_EVENT_HOOK_ON]        = TO(PHSM_STATE_SOLVED_ON_HOOK, PHSM_ACTION_STOP_SOUND),
+        [PHSM_EVENT_INCOMING_CALL]  = TO(PHSM_STATE_OFF_HOOK, PHSM_ACTION_BUSY_TONE),
+    },
+};
+
+static const char *state_names[PHSM_STATE_COUNT] = {
+    "idle",
+    "ringing",
+    "off hook",
+    "in call",
+    "hung up",
+    "solved on hook",
+    "solved off hook",
+};
+
+static const char *event_names[PHSM_EVENT_COUNT] = {
+    "hook off",
+    "hook on",
+    "jack changed",
+    "puzzle solved",
+    "incoming call",
+    "trace key",
+    "ring timeout",
+    "guard timeout",
+    "audio finished",
+};
+
+static const char *action_names[PHSM_ACTION_COUNT] = {
+    "none",
+    "dial tone",
+    "ring",
+    "stop ring",
+    "answer",
+    "hang up",
+    "busy tone",
+    "solved ring",
+    "solved message",
+    "stop sound",
+    "log jack",
+    "dump trace",
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+void phsm_init(phsm_t *fsm) {
+    fsm->state = PHSM_STATE_IDLE;
+    fsm->transitions = 0;
+    fsm->ignored = 0;
+}
+
+phsm_action_t phsm_dispatch(phsm_t *fsm, phsm_event_t event) {
+    if(event >= PHSM_EVENT_COUNT || !_table[fsm->state][event].handled) {
+        fsm->ignored++;
+        return PHSM_ACTION_NONE;
+    }
+
+    const phsm_transition_t *transition = &_table[fsm->state][event];
+    fsm->state = transition->next;
+    fsm->transitions++;
+    return transition->action;
+}
+
+const char *phsm_state_name(phsm_state_t state) {
+    return state < PHSM_STATE_COUNT ? state_names[state] : "?";
+}
+
+const char *phsm_event_name(phsm_event_t event) {
+    return event < PHSM_EVENT_COUNT ? event_names[event] : "?";
+}
+
+const char *phsm_action_name(phsm_action_t action) {
+    return action < PHSM_ACTION_COUNT ? action_names[action] : "?";
+}
@@ -0,0 +1,80 @@
+#ifndef PHONE_FSM_H
+#define PHONE_FSM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Telephone state machine: one transition table indexed by state and event, the
+// next state and the action to run are found in O(1). An event without an entry
+// is ignored in that state. Actions are run by the caller (phonetastic_app.c).
+// Plain C, no ESP-IDF dependency.
+
+typedef enum {
+    PHSM_STATE_IDLE,            // On hook, silent, dial tone armed
+    PHSM_STATE_RINGING,         // On hook, bells ringing
+    PHSM_STATE_OFF_HOOK,        // Handset lifted, dial or busy tone
+    PHSM_STATE_IN_CALL,         // Handset lifted, caller message
+    PHSM_STATE_HUNG_UP,         // Just hung up, idle after a guard time
+    PHSM_STATE_SOLVED_ON_HOOK,  // Plugboard solution found, until the next call
+    PHSM_STATE_SOLVED_OFF_HOOK, // Same, handset lifted: solved message
+    PHSM_STATE_COUNT,
+} phsm_state_t;
+
+typedef enum {
+    PHSM_EVENT_HOOK_OFF,        // Hardware: hook switch
+    PHSM_EVENT_HOOK_ON,
+    PHSM_EVENT_JACK_CHANGED,    // Hardware: plugboard contact, solution not found
+    PHSM_EVENT_PUZZLE_SOLVED,   // Hardware: plugboard contacts are the solution
+    PHSM_EVENT_INCOMING_CALL,   // Boot, or the game master key
+    PHSM_EVENT_TRACE_KEY,       // I2C trace dump key
+    PHSM_EVENT_RING_TIMEOUT,    // Timer: nobody answered
+    PHSM_EVENT_GUARD_TIMEOUT,   // Timer: end of the hang up guard
+    PHSM_EVENT_AUDIO_FINISHED,  // Audio: end of the file played
+    PHSM_EVENT_COUNT,
+} phsm_event_t;
+
+typedef enum {
+    PHSM_ACTION_NONE,
+    PHSM_ACTION_DIAL_TONE,      // Armed dial tone released, or generated
+    PHSM_ACTION_RING,           // Bells, ring timeout started
+    PHSM_ACTION_STOP_RING,      // Bells stopped, dial tone armed
+    PHSM_ACTION_ANSWER,         // Bells stopped, caller message
+    PHSM_ACTION_HANG_UP,        // Sound stopped, dial tone armed, guard started
+    PHSM_ACTION_BUSY_TONE,
+    PHSM_ACTION_SOLVED_RING,    // Solved on hook: bells, the message when lifted
+    PHSM_ACTION_SOLVED_MESSAGE, // Solved off hook: the message in the handset
+    PHSM_ACTION_STOP_SOUND,
+    PHSM_ACTION_LOG_JACK,
+    PHSM_ACTION_DUMP_TRACE,
+    PHSM_ACTION_COUNT,
+} phsm_action_t;
+
+typedef struct {
+    uint8_t next;               // phsm_state_t
+    uint8_t action;             // phsm_action_t
+    bool handled;               // false: event ignored in this state
+} phsm_transition_t;
+
+typedef struct {
+    phsm_state_t state;
+    uint32_t transitions;       // Handled events
+    uint32_t ignored;
+} phsm_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void phsm_init(phsm_t *fsm);
+
+// Moves to the next state of the event and returns the action to run,
+// PHSM_ACTION_NONE when the event is ignored in the current state.
+phsm_action_t phsm_dispatch(phsm_t *fsm, phsm_event_t event);
+
+const char *phsm_state_name(phsm_state_t state);
+const char *phsm_event_name(phsm_event_t event);
+const char *phsm_action_name(phsm_action_t action);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // PHONE_FSM_H
@@ -1,20 +1,16 @@
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
-#include <time.h>
 
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "freertos/task.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "audio_common.h"
-#include "audio_element.h"
 #include "audio_event_iface.h"
-#include "audio_pipeline.h"
-
-#include "fatfs_stream.h"
-#include "i2s_stream.h"
-#include "mp3_decoder.h"
 
 #include "board.h"
 #include "esp_peripherals.h"
@@ -25,202 +21,256 @@
 #include "periph_touch.h"
 
 #include "app_tools.h"
+#include "asset_archive.h"
+#include "caller.h"
+#include "debounce.h"
+#include "diag_i2c.h"
+#include "expander_int.h"
 #include "gpio_expander.h"
+#include "i2c_queue.h"
+#include "i2c_trace.h"
+#include "jack_matrix.h"
+#include "latency_probe.h"
+#include "phone_events.h"
+#include "phone_fsm.h"
+#include "player.h"
+#include "ringer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#define RINGTONE_VOLUME         10
-#define PHONE_VOLUME            10
-#define RINGTONE_VINTAGE_PATH   "/sdcard/ringtones/vintage.mp3"
-#define ELEVATOR_SONG_PATH      "/sdcard/callers/elevator-song.mp3"
+#define PHONE_SWITCH_INPUT      0       // GP0.0
+#define PHONE_SWITCH            (1 << PHONE_SWITCH_INPUT)
+
+#define I2C_TRACE_KEY           INPUT_KEY_USER_ID_MODE  // Dumps the I2C trace to the SD card
+#define I2C_TRACE_AFTER_ERROR   64      // Records kept after the first failed I2C command
+#define GAME_MASTER_KEY         INPUT_KEY_USER_ID_PLAY  // Incoming call, starts the game again
+
+#define RING_TIMEOUT_MS         60000   // Ringing until answered or this time
+#define HANG_UP_GUARD_MS        1000    // Hung up, idle after this time
 
-#define PHONE_SWITCH            0x01
+// Below the input task, above the audio pipeline
+#define PHONE_TASK_STACK        (4 * 1024)
+#define PHONE_TASK_PRIO         (configMAX_PRIORITIES - 4)
+
+// Plugboard solution on the 3x5 board: C1L1, C2L2 and C3L3, nothing else plugged
+#define PHONE_PUZZLE_SOLUTION   { .columns = { 1 << 0, 1 << 1, 1 << 2 } }
 
 ///////////////////////////////////////////////////////////////////////////////
 
 static const char *TAG = "PHONETASTIC";
 audio_board_handle_t _board;
-audio_pipeline_handle_t _pipeline;
-audio_element_handle_t _i2s_stream_writer, _audio_decoder, _fatfs_stream_reader;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static audio_pipeline_handle_t create_pipeline() {
-    LOGM_FUNC_IN();
-
-    audio_pipeline_cfg_t pipeline_cfg = DEFAULT_AUDIO_PIPELINE_CONFIG();
-    audio_pipeline_handle_t pipeline = audio_pipeline_init(&pipeline_cfg);
-    mem_assert(pipeline);
-
-    LOGM_FUNC_OUT();
-    return pipeline;
+// Telephone state machine, all the events are handled by the phone task in
+// priority order. Producers (input task, key service, jack task, timers, audio
+// task) only post, the actions are run here and are the only ones to block.
+
+typedef struct {
+    esp_timer_handle_t handle;
+    phsm_event_t event;
+    volatile uint32_t seq;      // Changed at each start and stop
+    int64_t deadline_us;        // Phone task only
+} phone_timer_t;
+
+typedef void (*phone_action_t)(const phev_event_t *event);
+
+static phsm_t _fsm;             // Phone task only
+static phone_timer_t _ring_timer = { .event = PHSM_EVENT_RING_TIMEOUT };
+static phone_timer_t _guard_timer = { .event = PHSM_EVENT_GUARD_TIMEOUT };
+static const jkmx_bitmap_t _solution = PHONE_PUZZLE_SOLUTION;
+
+static void phone_timer_cb(void *args) {
+    phone_timer_t *timer = (phone_timer_t *)args;
+    phev_event_t event = {
+        .type = timer->event,
+        .timer_seq = timer->seq,
+        .time_us = esp_timer_get_time(),
+    };
+    phev_post(&event);
 }
 
-static audio_element_handle_t create_fatfs_stream_writer() {
-    LOGM_FUNC_IN();
-
-    fatfs_stream_cfg_t fatfs_reader_cfg = FATFS_STREAM_CFG_DEFAULT();
-    fatfs_reader_cfg.type = AUDIO_STREAM_READER;
-    audio_element_handle_t fatfs_stream_reader = fatfs_stream_init(&fatfs_reader_cfg);
+static void phone_timer_create(phone_timer_t *timer, const char *name) {
+    esp_timer_create_args_t timer_args = {
+        .callback = phone_timer_cb,
+        .arg = timer,
+        .name = name,
+    };
+    if(esp_timer_create(&timer_args, &timer->handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Fail to create the %s timer!", name);
+    }
+}
 
-    LOGM_FUNC_OUT();
-    return fatfs_stream_reader;
+static void phone_timer_start(phone_timer_t *timer, int timeout_ms) {
+    esp_timer_stop(timer->handle);
+    timer->seq++;
+    timer->deadline_us = esp_timer_get_time() + timeout_ms * 1000LL;
+    esp_timer_start_once(timer->handle, timeout_ms * 1000LL);
 }
 
-static audio_element_handle_t create_mp3_decoder() {
-    LOGM_FUNC_IN();
+static void phone_timer_stop(phone_timer_t *timer) {
+    esp_timer_stop(timer->handle);
+    timer->seq++;
+}
 
-    mp3_decoder_cfg_t mp3_decoder_cfg = DEFAULT_MP3_DECODER_CONFIG();
-    audio_element_handle_t audio_decoder = mp3_decoder_init(&mp3_decoder_cfg);
+// Fired before a stop or a restart, already posted
+static bool is_stale(const phev_event_t *event) {
+    const phone_timer_t *timer;
 
-    LOGM_FUNC_OUT();
-    return audio_decoder;
+    if(event->type == PHSM_EVENT_RING_TIMEOUT) {
+        timer = &_ring_timer;
+    } else if(event->type == PHSM_EVENT_GUARD_TIMEOUT) {
+        timer = &_guard_timer;
+    } else {
+        return false;
+    }
+    return event->timer_seq != timer->seq || event->time_us < timer->deadline_us;
 }
 
-static audio_element_handle_t create_i2s_writer() {
-    LOGM_FUNC_IN();
-
-    i2s_stream_cfg_t i2s_writer_cfg = I2S_STREAM_CFG_DEFAULT();
-    i2s_writer_cfg.type = AUDIO_STREAM_WRITER;
-    audio_element_handle_t i2s_stream_writer = i2s_stream_init(&i2s_writer_cfg);
+static void action_none(const phev_event_t *event) {
+}
 
-    LOGM_FUNC_OUT();
-    return i2s_stream_writer;
+static void action_dial_tone(const phev_event_t *event) {
+    if(plyr_get_state() == PLYR_STATE_ARMED) {
+        // Dial tone armed at hang up, only released here
+        plyr_start();
+    } else {
+        // Generated, no SD open nor decoder start before the first sample
+        plyr_play_tone(TONE_DIAL, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+    }
 }
 
-static audio_pipeline_handle_t create_audio_pipeline() {
-    LOGM_FUNC_IN();
+static void action_ring(const phev_event_t *event) {
+    rngr_play();
+    phone_timer_start(&_ring_timer, RING_TIMEOUT_MS);
+}
 
-    audio_pipeline_handle_t pipeline = create_pipeline();
- 
-    _fatfs_stream_reader = create_fatfs_stream_writer();
-    _audio_decoder = create_mp3_decoder();
-    _i2s_stream_writer = create_i2s_writer();
+static void action_stop_ring(const phev_event_t *event) {
+    rngr_stop();
+    plyr_arm_tone(TONE_DIAL, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+}
 
-    ESP_LOGI(TAG, "[3.4.1] Register all elements to audio pipeline");
-    audio_pipeline_register(pipeline, _fatfs_stream_reader,      "file");
-    audio_pipeline_register(pipeline, _audio_decoder,            "decoder");
-    audio_pipeline_register(pipeline, _i2s_stream_writer,        "i2s");
+static void action_answer(const phev_event_t *event) {
+    phone_timer_stop(&_ring_timer);
+    cllr_play();
+}
 
-    ESP_LOGI(TAG, "[3.5.1] Link it together [sdcard]-->fatfs_stream-->audio_decoder-->i2s_stream-->[codec_chip]");
-    audio_pipeline_link(pipeline, (const char *[]){"file", "decoder", "i2s"}, 3);
+static void action_hang_up(const phev_event_t *event) {
+    plyr_arm_tone(TONE_DIAL, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+    phone_timer_start(&_guard_timer, HANG_UP_GUARD_MS);
 
-    LOGM_FUNC_OUT();
-    return pipeline;
+    i2cq_log_stats();
+    ESP_LOGI(TAG, "Phone events: %u transitions, %u ignored, %u dropped",
+        _fsm.transitions, _fsm.ignored, phev_get_dropped());
 }
 
-static void play(char* uri) {
-    LOGM_FUNC_IN();
-    audio_element_set_uri(_fatfs_stream_reader, uri);
-    audio_pipeline_reset_ringbuffer(_pipeline);
-    audio_pipeline_reset_elements(_pipeline);
-    audio_pipeline_change_state(_pipeline, AEL_STATE_INIT);
-    audio_pipeline_run(_pipeline);
-    LOGM_FUNC_OUT();
+static void action_busy_tone(const phev_event_t *event) {
+    plyr_play_tone(TONE_BUSY, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
 }
 
-static void play_ringtone(char* uri) {
-    LOGM_FUNC_IN();
-    audio_hal_set_volume(_board->audio_hal, RINGTONE_VOLUME);
-    play(uri);
-    LOGM_FUNC_OUT();
+static void action_solved_message(const phev_event_t *event) {
+    phone_timer_stop(&_ring_timer);
+    cllr_play_solved();
 }
 
-static void play_phone(char* uri) {
-    LOGM_FUNC_IN();
-    audio_hal_set_volume(_board->audio_hal, PHONE_VOLUME);
-    play(uri);
-    LOGM_FUNC_OUT();
+static void action_stop_sound(const phev_event_t *event) {
+    phone_timer_stop(&_ring_timer);
+    plyr_stop();
 }
 
-static void pause() {
-    LOGM_FUNC_IN();
-    audio_pipeline_pause(_pipeline);
-    LOGM_FUNC_OUT();
+static void action_log_jack(const phev_event_t *event) {
+    ESP_LOGI(TAG, "Jack C%iL%i %s at %lldus",
+        event->column + 1, event->line + 1,
+        event->plugged ? "plugged" : "unplugged",
+        (long long)event->time_us);
 }
 
-static void stop() {
-    LOGM_FUNC_IN();
-    audio_pipeline_stop(_pipeline);
-    LOGM_FUNC_OUT();
+// Trace of the bus up to the first failure, then a new one
+static void action_dump_trace(const phev_event_t *event) {
+    if(diag_i2c_trace_dump(DIAG_I2C_TRACE_PATH) == ESP_OK) {
+        i2ct_clear();
+    }
 }
 
-///////////////////////////////////////////////////////////////////////////////
-
-#define GPXP_REGISTER_IN        REGISTER_GP0
-#define GPXP_REGISTER_OUT       REGISTER_GP1
-
-#define     COLUMN_1  0x80
-#define     COLUMN_2  0x40
-#define     COLUMN_3  0x20
-#define     LINE_1  0x01
-#define     LINE_2  0x02
-#define     LINE_3  0x04
-#define     LINE_4  0x08
-#define     LINE_5  0x10
-
-// Read input matrix once time
-void read_matrix() {
-    uint8_t data;
-    esp_err_t err;
-
-    gpxp_writeRegister(GPXP_REGISTER_OUT, 0x00);
+static const phone_action_t _actions[PHSM_ACTION_COUNT] = {
+    [PHSM_ACTION_NONE]              = action_none,
+    [PHSM_ACTION_DIAL_TONE]         = action_dial_tone,
+    [PHSM_ACTION_RING]              = action_ring,
+    [PHSM_ACTION_STOP_RING]         = action_stop_ring,
+    [PHSM_ACTION_ANSWER]            = action_answer,
+    [PHSM_ACTION_HANG_UP]           = action_hang_up,
+    [PHSM_ACTION_BUSY_TONE]         = action_busy_tone,
+    [PHSM_ACTION_SOLVED_RING]       = action_ring,
+    [PHSM_ACTION_SOLVED_MESSAGE]    = action_solved_message,
+    [PHSM_ACTION_STOP_SOUND]        = action_stop_sound,
+    [PHSM_ACTION_LOG_JACK]          = action_log_jack,
+    [PHSM_ACTION_DUMP_TRACE]        = action_dump_trace,
+};
+
+static void tx_phoneWorker(void *args) {
+    phev_event_t event;
 
-    vTaskDelay(10 / portTICK_RATE_MS);
-    gpxp_writeRegister(GPXP_REGISTER_OUT, COLUMN_1);
-    vTaskDelay(10 / portTICK_RATE_MS);
+    while(true) {
+        if(!phev_receive(&event, portMAX_DELAY)) {
+            continue;
+        }
+        if(is_stale(&event)) {
+            ESP_LOGD(TAG, "Stale %s dropped", phsm_event_name(event.type));
+            continue;
+        }
 
-    err = gpxp_readRegisterWithRetry10(GPXP_REGISTER_IN, &data);
-    ESP_LOGI(TAG, "============");
+        phsm_state_t previous = _fsm.state;
+        uint32_t ignored = _fsm.ignored;
+        phsm_action_t action = phsm_dispatch(&_fsm, event.type);
+        if(_fsm.ignored != ignored) {
+            ESP_LOGD(TAG, "%s ignored in %s", phsm_event_name(event.type), phsm_state_name(previous));
+            continue;
+        }
 
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to read line");
-    } else {
-        ESP_LOGI(TAG, "1: %i %i %i %i %i",
-            ((data & LINE_1) == 0) ? 0 : 1,
-            ((data & LINE_2) == 0) ? 0 : 1,
-            ((data & LINE_3) == 0) ? 0 : 1,
-            ((data & LINE_4) == 0) ? 0 : 1,
-            ((data & LINE_5) == 0) ? 0 : 1);
+        ESP_LOGI(TAG, "%s: %s => %s, %s", phsm_event_name(event.type),
+            phsm_state_name(previous), phsm_state_name(_fsm.state), phsm_action_name(action));
+        _actions[action](&event);
     }
+}
 
-    vTaskDelay(10 / portTICK_RATE_MS);
-    gpxp_writeRegister(GPXP_REGISTER_OUT, COLUMN_2);
-    vTaskDelay(10 / portTICK_RATE_MS);
+static void player_finished_cb(void *ctx) {
+    phev_post_type(PHSM_EVENT_AUDIO_FINISHED);
+}
 
-    err = gpxp_readRegisterWithRetry10(GPXP_REGISTER_IN, &data);
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to read line");
-    } else {
-        ESP_LOGI(TAG, "2: %i %i %i %i %i",
-            ((data & LINE_1) == 0) ? 0 : 1,
-            ((data & LINE_2) == 0) ? 0 : 1,
-            ((data & LINE_3) == 0) ? 0 : 1,
-            ((data & LINE_4) == 0) ? 0 : 1,
-            ((data & LINE_5) == 0) ? 0 : 1);
-    }
+///////////////////////////////////////////////////////////////////////////////
 
-    vTaskDelay(10 / portTICK_RATE_MS);
-    gpxp_writeRegister(GPXP_REGISTER_OUT, COLUMN_3);
-    vTaskDelay(10 / portTICK_RATE_MS);
+// Plugboard changes posted by the jack matrix scan task
+static void tx_jackWorker(void *args) {
+    QueueHandle_t queue = (QueueHandle_t)args;
+    jkmx_event_t event;
+    jkmx_bitmap_t state;
 
-    err = gpxp_readRegisterWithRetry10(GPXP_REGISTER_IN, &data);
-    if(err != ESP_OK) {
-        ESP_LOGE(TAG, "Fail to read line");
-    } else {
-        ESP_LOGI(TAG, "3: %i %i %i %i %i",
-            ((data & LINE_1) == 0) ? 0 : 1,
-            ((data & LINE_2) == 0) ? 0 : 1,
-            ((data & LINE_3) == 0) ? 0 : 1,
-            ((data & LINE_4) == 0) ? 0 : 1,
-            ((data & LINE_5) == 0) ? 0 : 1);
+    while(true) {
+        if(xQueueReceive(queue, &event, portMAX_DELAY) == pdTRUE) {
+            // State of the scan that posted the change, or of a later one
+            jkmx_get_state(&state);
+
+            phev_event_t phone_event = {
+                .type = PHSM_EVENT_JACK_CHANGED,
+                .column = event.column,
+                .line = event.line,
+                .plugged = event.plugged,
+                .time_us = event.timestamp_us,
+            };
+            if(!event.ghost && memcmp(&state, &_solution, sizeof(jkmx_bitmap_t)) == 0) {
+                phone_event.type = PHSM_EVENT_PUZZLE_SOLVED;
+            }
+            phev_post(&phone_event);
+        }
     }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static clock_t previousTimeEvent;
-static uint8_t previousGp0value = 0;
+#define HOOK_STABLE_US          20000   // Eager, the first edge is taken then bounces are ignored
+
+static dbnc_t _inputs;          // Input task only
+static esp_timer_handle_t _debounce_timer;
 
 static void ReadInput(uint8_t currentValue, uint8_t previousValue, uint16_t mask) {
     LOGM_FUNC_IN();
@@ -240,34 +290,54 @@ static void ReadInput(uint8_t currentValue, uint8_t previousValue, uint16_t mask
     LOGM_FUNC_OUT();
 }
 
+// INTCAP pair after an INT edge, or GP pair polled by the debounce timer
+static void process_inputs(uint16_t port, bool interrupt, int64_t now_us, void *ctx) {
+    dbnc_edges_t edges;
+    bool changed = dbnc_update(&_inputs, port, now_us, &edges);
+
+    // Still bouncing, sampled again when it should be stable
+    int64_t deadline = dbnc_next_deadline(&_inputs);
+    if(deadline != INT64_MAX) {
+        esp_timer_stop(_debounce_timer);
+        esp_timer_start_once(_debounce_timer, deadline > now_us ? deadline - now_us : 1);
+    }
+
+    phev_event_t event = {
+        .time_us = edges.timestamp_us[PHONE_SWITCH_INPUT],
+    };
+    // Only the hook switch starts or drops a latency measurement, jack contacts and
+    // bounces leave the one in progress alone
+    if(changed && (edges.rising & PHONE_SWITCH)) {
+        ltcy_mark_at(LTCY_STAGE_INTERRUPT, event.time_us);
+        ltcy_mark(LTCY_STAGE_INTCAP_READ);
+        ESP_LOGI(TAG, "Off hook at %lldus", (long long)event.time_us);
+
+        event.type = PHSM_EVENT_HOOK_OFF;
+        phev_post(&event);
+    } else if(changed && (edges.falling & PHONE_SWITCH)) {
+        ltcy_cancel();
+
+        ESP_LOGI(TAG, "Hung up at %lldus", (long long)event.time_us);
+        event.type = PHSM_EVENT_HOOK_ON;
+        phev_post(&event);
+    }
+}
+
+static void debounce_timer_cb(void *args) {
+    gpxi_poll();
+}
+
 static esp_err_t input_key_service_cb(periph_service_handle_t handle, periph_service_event_t *evt, void *ctx) {
     LOGM_FUNC_IN();
 
+    // The expander has its own interrupt task, board keys are free
     if(evt->type == INPUT_KEY_SERVICE_ACTION_CLICK) {
-        if((int)evt->data == INPUT_KEY_USER_ID_REC) {
-            uint8_t gp0value;
-            if(gpxp_readRegisterWithRetry10(REGISTER_INTCAP0, &gp0value) != ESP_OK) {
-                ESP_LOGE(TAG, "Fail to read INTCAP0!");
-            } else {
-                if(gp0value == previousGp0value) {
-                    ESP_LOGD(TAG, "No change on GP0!");
-                } else if(gp0value == PHONE_SWITCH) {
-                    previousGp0value = gp0value;
-
-                    clock_t currentTimeEvent = clock();
-                    double duration = (double)(currentTimeEvent - previousTimeEvent) / CLOCKS_PER_SEC;
-                    previousTimeEvent = currentTimeEvent;
-
-                    ESP_LOGI(TAG, "GP0: %#02x (%lf)", gp0value, duration);
-
-                    if(gp0value != 0) {
-                        stop();
-                        play_phone(ELEVATOR_SONG_PATH);
-                    }
-                } else {
-                    read_matrix();
-                }
-            }
+        ESP_LOGD(TAG, "Key %i clicked", (int)evt->data);
+
+        if((int)evt->data == I2C_TRACE_KEY) {
+            phev_post_type(PHSM_EVENT_TRACE_KEY);
+        } else if((int)evt->data == GAME_MASTER_KEY) {
+            phev_post_type(PHSM_EVENT_INCOMING_CALL);
         }
     }
 
@@ -285,12 +355,31 @@ void phonetastic_app_init(void) {
 
     audio_board_key_init(set);
     audio_board_sdcard_init(set, SD_MODE_1_LINE);
+    asst_initialize(ASST_ARCHIVE_PATH);
 
     _board = audio_board_init();
     audio_hal_ctrl_codec(_board->audio_hal, AUDIO_HAL_CODEC_MODE_DECODE, AUDIO_HAL_CTRL_START);
 
     //
 
+    dbnc_cfg_t dbnc_cfg;
+    dbnc_cfg_default(&dbnc_cfg, DBNC_STABLE_US);
+    dbnc_cfg_set_stable_time(&dbnc_cfg, PHONE_SWITCH, HOOK_STABLE_US);
+    dbnc_cfg.eager = PHONE_SWITCH;
+    dbnc_init(&_inputs, &dbnc_cfg);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = debounce_timer_cb,
+        .name = "debounce",
+    };
+    esp_timer_create(&timer_args, &_debounce_timer);
+
+    // First, every producer below posts to the phone task
+    phev_initialize();
+    phsm_init(&_fsm);
+    phone_timer_create(&_ring_timer, "ring");
+    phone_timer_create(&_guard_timer, "hang_up_guard");
+
     ESP_LOGI(TAG, "[ 3 ] Create and start input key service");
     input_key_service_info_t input_key_info[] = INPUT_KEY_DEFAULT_INFO();
     input_key_service_cfg_t input_cfg = INPUT_KEY_SERVICE_DEFAULT_CONFIG();
@@ -301,62 +390,34 @@ void phonetastic_app_init(void) {
 
     //
 
+    i2ct_cfg_t trace_cfg = I2CT_CFG_DEFAULT();
+    trace_cfg.stop_after_error = I2C_TRACE_AFTER_ERROR;
+    i2ct_set_cfg(&trace_cfg);
+
     gpxp_initialize(false);
-    gpxp_writeRegister(REGISTER_GP1, 0xFF);
+
+    // The hook switch shares the lines expander, the map must leave its pin alone
+    jkmx_cfg_t jkmx_cfg = JKMX_CFG_DEFAULT();
+    jkmx_cfg.map.reserved[0] |= PHONE_SWITCH;
+    if(jkmx_initialize(&jkmx_cfg) == ESP_OK) {
+        xTaskCreate(tx_jackWorker, "tx_jackWorker", 2 * 1024, jkmx_get_event_queue(), 2, NULL);
+    }
 
     //
 
     audio_event_iface_cfg_t evt_cfg = AUDIO_EVENT_IFACE_DEFAULT_CFG();
     audio_event_iface_handle_t evt = audio_event_iface_init(&evt_cfg);
 
-    _pipeline = create_audio_pipeline();
-    audio_pipeline_set_listener(_pipeline, evt);
+    plyr_initialize(set, _board, evt);
+    plyr_set_finished_callback(player_finished_cb, NULL);
 
     //
 
-    play_ringtone(RINGTONE_VINTAGE_PATH);
+    xTaskCreate(tx_phoneWorker, "tx_phoneWorker", PHONE_TASK_STACK, NULL, PHONE_TASK_PRIO, NULL);
+    phev_post_type(PHSM_EVENT_INCOMING_CALL);
 
-    while(true) {
-        audio_event_iface_msg_t msg;
-        esp_err_t ret = audio_event_iface_listen(evt, &msg, portMAX_DELAY);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "[ * ] Event interface error : %d", ret);
-            continue;
-        }
-
-        if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT) {
-            // Set music info for a new song to be played
-            if (msg.source == (void *) _audio_decoder && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
-                audio_element_info_t music_info = {0};
-                audio_element_getinfo(_audio_decoder, &music_info);
-                ESP_LOGI(TAG, "[ * ] Received music info from mp3 decoder, sample_rates=%d, bits=%d, ch=%d", music_info.sample_rates, music_info.bits, music_info.channels);
-                audio_element_setinfo(_i2s_stream_writer, &music_info);
-                i2s_stream_set_clk(_i2s_stream_writer, music_info.sample_rates, music_info.bits, music_info.channels);
-                continue;
-            }
-        }
-
-        if(msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
-            && msg.source == (void *)_i2s_stream_writer
-            && msg.cmd == AEL_MSG_CMD_REPORT_STATUS) {
-
-            audio_element_state_t el_state;
-            el_state = audio_element_get_state(_i2s_stream_writer);
-            
-            if (el_state == AEL_STATE_FINISHED) {
-                ESP_LOGI(TAG, "Stop playing at the end of file.");
-                LOGMT(TAG, "before terminate pipeline player");
-
-                if(audio_pipeline_terminate(_pipeline) != ESP_OK) {
-                    ESP_LOGE(TAG, "Fail to terminate pipeline player!");
-                } else {
-                    audio_pipeline_reset_ringbuffer(_pipeline);
-                    audio_pipeline_reset_elements(_pipeline);
-                }
-            }
-            continue;
-        }
-    }
+    // Last, the hook switch may already be off hook
+    gpxi_initialize(GPXI_INT_GPIO, process_inputs, NULL);
 
     LOGM_FUNC_OUT();
 }
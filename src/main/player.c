@@ -5,11 +5,18 @@
 #include "board.h"
 #include "esp_log.h"
 #include "esp_audio.h"
-#include "fatfs_stream.h"
+#include "esp_timer.h"
 #include "i2s_stream.h"
 #include "mp3_decoder.h"
 
 #include "app_tools.h"
+#include "asset_archive.h"
+#include "bell_stream.h"
+#include "channel_router.h"
+#include "i2c_queue.h"
+#include "latency_probe.h"
+#include "sd_reader.h"
+#include "tone_stream.h"
 
 #include "player.h"
 
@@ -21,13 +28,24 @@ static esp_periph_set_handle_t _set;
 static audio_board_handle_t _board;
 static audio_event_iface_handle_t _evt;
 
-static audio_pipeline_handle_t _pipeline_left, _pipeline_right;
-static audio_element_handle_t _fatfs_stream_reader_left, _audio_decoder_left, _i2s_stream_writer_left;
-static audio_element_handle_t  _fatfs_stream_reader_right, _audio_decoder_right, _i2s_stream_writer_right;
+static audio_pipeline_handle_t _pipeline;
+static audio_element_handle_t _sd_reader, _audio_decoder, _channel_router, _i2s_stream_writer;
+static audio_element_handle_t _bell_stream, _tone_stream;
 
-static TaskHandle_t audioWorkerHandle;
+typedef enum {
+    SOURCE_FILE,        // [sdcard]-->sd_reader-->audio_decoder-->channel_router-->i2s_stream
+    SOURCE_BELL,        // bell_stream-->channel_router-->i2s_stream
+    SOURCE_TONE,        // tone_stream-->channel_router-->i2s_stream
+} player_source_t;
+
+static player_source_t _source = SOURCE_FILE;
 
-static bool _is_left_channel = false;
+static volatile plyr_state_t _state = PLYR_STATE_IDLE;
+static int64_t _start_request_us;      // Call of the last play or start
+
+static TaskHandle_t audioWorkerHandle;
+static plyr_finished_cb_t _finished_cb;
+static void *_finished_ctx;
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -42,15 +60,14 @@ static audio_pipeline_handle_t create_pipeline() {
     return pipeline;
 }
 
-static audio_element_handle_t create_fatfs_stream_writer() {
+static audio_element_handle_t create_sd_reader() {
     LOGM_FUNC_IN();
 
-    fatfs_stream_cfg_t fatfs_reader_cfg = FATFS_STREAM_CFG_DEFAULT();
-    fatfs_reader_cfg.type = AUDIO_STREAM_READER;
-    audio_element_handle_t fatfs_stream_reader = fatfs_stream_init(&fatfs_reader_cfg);
+    sd_reader_cfg_t sd_reader_cfg = SD_READER_CFG_DEFAULT();
+    audio_element_handle_t sd_reader = sd_reader_init(&sd_reader_cfg);
 
     LOGM_FUNC_OUT();
-    return fatfs_stream_reader;
+    return sd_reader;
 }
 
 static audio_element_handle_t create_mp3_decoder() {
@@ -75,48 +92,100 @@ static audio_element_handle_t create_i2s_writer(i2s_channel_fmt_t channel_format
     return i2s_stream_writer;
 }
 
-static audio_pipeline_handle_t create_left_audio_pipeline() {
+static audio_element_handle_t create_bell_stream() {
     LOGM_FUNC_IN();
 
-    audio_pipeline_handle_t pipeline = create_pipeline();
- 
-    _fatfs_stream_reader_left = create_fatfs_stream_writer();
-    _audio_decoder_left = create_mp3_decoder();
-    _i2s_stream_writer_left = create_i2s_writer(I2S_CHANNEL_FMT_RIGHT_LEFT);
+    bell_stream_cfg_t bell_stream_cfg = BELL_STREAM_CFG_DEFAULT();
+    audio_element_handle_t bell_stream = bell_stream_init(&bell_stream_cfg);
 
-    ESP_LOGI(TAG, "[3.4.1] Register all elements to audio pipeline");
-    audio_pipeline_register(pipeline, _fatfs_stream_reader_left,      "file");
-    audio_pipeline_register(pipeline, _audio_decoder_left,            "decoder");
-    audio_pipeline_register(pipeline, _i2s_stream_writer_left,        "i2s");
+    LOGM_FUNC_OUT();
+    return bell_stream;
+}
 
-    ESP_LOGI(TAG, "[3.5.1] Link it together [sdcard]-->fatfs_stream-->audio_decoder-->i2s_stream-->[codec_chip]");
-    audio_pipeline_link(pipeline, (const char *[]){"file", "decoder", "i2s"}, 3);
+static audio_element_handle_t create_tone_stream() {
+    LOGM_FUNC_IN();
+
+    tone_stream_cfg_t tone_stream_cfg = TONE_STREAM_CFG_DEFAULT();
+    audio_element_handle_t tone_stream = tone_stream_init(&tone_stream_cfg);
 
     LOGM_FUNC_OUT();
-    return pipeline;
+    return tone_stream;
 }
 
-static audio_pipeline_handle_t create_right_audio_pipeline() {
+static audio_element_handle_t create_channel_router() {
+    LOGM_FUNC_IN();
+
+    channel_router_cfg_t channel_router_cfg = DEFAULT_CHANNEL_ROUTER_CONFIG();
+    audio_element_handle_t channel_router = channel_router_init(&channel_router_cfg);
+
+    LOGM_FUNC_OUT();
+    return channel_router;
+}
+
+static audio_pipeline_handle_t create_audio_pipeline() {
     LOGM_FUNC_IN();
 
     audio_pipeline_handle_t pipeline = create_pipeline();
 
-    _fatfs_stream_reader_right = create_fatfs_stream_writer();
-    _audio_decoder_right = create_mp3_decoder();
-    _i2s_stream_writer_right = create_i2s_writer(I2S_CHANNEL_STEREO);
+    _sd_reader = create_sd_reader();
+    _audio_decoder = create_mp3_decoder();
+    _bell_stream = create_bell_stream();
+    _tone_stream = create_tone_stream();
+    _channel_router = create_channel_router();
+    channel_router_set_source(_channel_router, _audio_decoder);
+    _i2s_stream_writer = create_i2s_writer(I2S_CHANNEL_FMT_RIGHT_LEFT);
 
     ESP_LOGI(TAG, "[3.4.1] Register all elements to audio pipeline");
-    audio_pipeline_register(pipeline, _fatfs_stream_reader_right,      "file");
-    audio_pipeline_register(pipeline, _audio_decoder_right,            "decoder");
-    audio_pipeline_register(pipeline, _i2s_stream_writer_right,        "i2s");
+    audio_pipeline_register(pipeline, _sd_reader,               "file");
+    audio_pipeline_register(pipeline, _audio_decoder,           "decoder");
+    audio_pipeline_register(pipeline, _bell_stream,             "bell");
+    audio_pipeline_register(pipeline, _tone_stream,             "tone");
+    audio_pipeline_register(pipeline, _channel_router,          "router");
+    audio_pipeline_register(pipeline, _i2s_stream_writer,       "i2s");
 
-    ESP_LOGI(TAG, "[3.5.1] Link it together [sdcard]-->fatfs_stream-->audio_decoder-->i2s_stream-->[codec_chip]");
-    audio_pipeline_link(pipeline, (const char *[]){"file", "decoder", "i2s"}, 3);
+    ESP_LOGI(TAG, "[3.5.1] Link it together [sdcard]-->sd_reader-->audio_decoder-->channel_router-->i2s_stream-->[codec_chip]");
+    audio_pipeline_link(pipeline, (const char *[]){"file", "decoder", "router", "i2s"}, 4);
+    _source = SOURCE_FILE;
 
     LOGM_FUNC_OUT();
     return pipeline;
 }
 
+// The pipeline must be stopped. Element tasks are kept, only the links change.
+static void select_source(player_source_t source) {
+    LOGM_FUNC_IN();
+
+    if(source == _source) {
+        goto end;
+    }
+
+    audio_pipeline_breakup_elements(_pipeline, NULL);
+
+    switch(source) {
+        case SOURCE_BELL:
+            ESP_LOGI(TAG, "Relink [bell_stream]-->channel_router-->i2s_stream-->[codec_chip]");
+            audio_pipeline_relink(_pipeline, (const char *[]){"bell", "router", "i2s"}, 3);
+            channel_router_set_source(_channel_router, _bell_stream);
+            break;
+        case SOURCE_TONE:
+            ESP_LOGI(TAG, "Relink [tone_stream]-->channel_router-->i2s_stream-->[codec_chip]");
+            audio_pipeline_relink(_pipeline, (const char *[]){"tone", "router", "i2s"}, 3);
+            channel_router_set_source(_channel_router, _tone_stream);
+            break;
+        default:
+            ESP_LOGI(TAG, "Relink [sdcard]-->sd_reader-->audio_decoder-->channel_router-->i2s_stream-->[codec_chip]");
+            audio_pipeline_relink(_pipeline, (const char *[]){"file", "decoder", "router", "i2s"}, 4);
+            channel_router_set_source(_channel_router, _audio_decoder);
+            break;
+    }
+
+    audio_pipeline_set_listener(_pipeline, _evt);
+    _source = source;
+
+    end:
+    LOGM_FUNC_OUT();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void tx_audioWorker(void *args) {
@@ -132,65 +201,40 @@ void tx_audioWorker(void *args) {
 
         // Adjust sample rates
         if (msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
-            && (msg.source == (void *) _audio_decoder_left || msg.source == (void *) _audio_decoder_right)
+            && (msg.source == (void *) _audio_decoder
+                || msg.source == (void *) _bell_stream
+                || msg.source == (void *) _tone_stream)
             && msg.cmd == AEL_MSG_CMD_REPORT_MUSIC_INFO) {
             audio_element_info_t music_info = {0};
+            audio_element_getinfo((audio_element_handle_t) msg.source, &music_info);
 
-            if(msg.source == (void *) _audio_decoder_left) {
-                audio_element_getinfo(_audio_decoder_left, &music_info);
-
-                ESP_LOGI(TAG, "[ * ] Receive music info from mp3 decoder, sample_rates=%d, bits=%d, ch=%d",
-                                    music_info.sample_rates,
-                                    music_info.bits,
-                                    music_info.channels);
-
-                audio_element_setinfo(_i2s_stream_writer_left, &music_info);
-                i2s_stream_set_clk(_i2s_stream_writer_left, music_info.sample_rates , music_info.bits, music_info.channels);
-            } else {
-                audio_element_getinfo(_audio_decoder_right, &music_info);
+            ESP_LOGI(TAG, "[ * ] Receive music info from %s, sample_rates=%d, bits=%d, ch=%d",
+                                audio_element_get_tag((audio_element_handle_t) msg.source),
+                                music_info.sample_rates,
+                                music_info.bits,
+                                music_info.channels);
 
-                ESP_LOGI(TAG, "[ * ] Receive music info from mp3 decoder, sample_rates=%d, bits=%d, ch=%d",
-                                    music_info.sample_rates,
-                                    music_info.bits,
-                                    music_info.channels);
-
-                audio_element_setinfo(_i2s_stream_writer_right, &music_info);
-                i2s_stream_set_clk(_i2s_stream_writer_right, music_info.sample_rates , music_info.bits, music_info.channels);
-            }
+            audio_element_setinfo(_channel_router, &music_info);
 
+            // Mono tracks are expanded by the channel router, i2s is always fed with stereo frames
+            music_info.channels = 2;
+            audio_element_setinfo(_i2s_stream_writer, &music_info);
+            i2s_stream_set_clk(_i2s_stream_writer, music_info.sample_rates , music_info.bits, music_info.channels);
             continue;
         }
 
         // Stop when the last pipeline element (i2s_stream_writer in this case) receives stop event
         if(msg.source_type == AUDIO_ELEMENT_TYPE_ELEMENT
-            && (msg.source == (void *) _i2s_stream_writer_left || msg.source == (void *) _i2s_stream_writer_right)
+            && msg.source == (void *) _i2s_stream_writer
             && msg.cmd == AEL_MSG_CMD_REPORT_STATUS) {
 
-            audio_element_state_t el_state;
-            if(msg.source == (void *) _i2s_stream_writer_left) {
-                el_state = audio_element_get_state(_i2s_stream_writer_left);
-            } else {
-                el_state = audio_element_get_state(_i2s_stream_writer_right);
-            }
-            
+            audio_element_state_t el_state = audio_element_get_state(_i2s_stream_writer);
             if (el_state == AEL_STATE_FINISHED) {
+                // Element tasks are kept parked, the next arm only resets and runs them
                 ESP_LOGI(TAG, "Stop playing at the end of file.");
-                LOGMT(TAG, "before terminate pipeline player");
-
-                if(msg.source == (void *) _i2s_stream_writer_left) {
-                    if(audio_pipeline_terminate(_pipeline_left) != ESP_OK) {
-                        ESP_LOGE(TAG, "Fail to terminate pipeline player!");
-                    } else {
-                        audio_pipeline_reset_ringbuffer(_pipeline_left);
-                        audio_pipeline_reset_elements(_pipeline_left);
-                    }
-                } else {
-                    if(audio_pipeline_terminate(_pipeline_right) != ESP_OK) {
-                        ESP_LOGE(TAG, "Fail to terminate pipeline player!");
-                    } else {
-                        audio_pipeline_reset_ringbuffer(_pipeline_right);
-                        audio_pipeline_reset_elements(_pipeline_right);
-                    }
+                _state = PLYR_STATE_IDLE;
+                if(_finished_cb != NULL) {
+                    _finished_cb(_finished_ctx);
                 }
             }
             continue;
@@ -209,14 +253,10 @@ void plyr_initialize(esp_periph_set_handle_t set, audio_board_handle_t board, au
     _board = board;
     _evt = evt;
 
-    _pipeline_left = create_left_audio_pipeline();
-    _pipeline_right = create_right_audio_pipeline();
-
-    _is_left_channel = true;
+    _pipeline = create_audio_pipeline();
 
     ESP_LOGI(TAG, "[4.1] Listening event from all elements of pipeline");
-    audio_pipeline_set_listener(_pipeline_left, _evt);
-    audio_pipeline_set_listener(_pipeline_right, _evt);
+    audio_pipeline_set_listener(_pipeline, _evt);
 
     ESP_LOGI(TAG, "[4.2] Listening event from peripherals");
     audio_event_iface_set_listener(esp_periph_set_get_event_iface(_set), _evt);
@@ -235,75 +275,237 @@ void plyr_initialize(esp_periph_set_handle_t set, audio_board_handle_t board, au
 
 void plyr_finalize() {
     LOGM_FUNC_IN();
-    vTaskDelete(tx_audioWorker);
-
-    audio_pipeline_stop(_pipeline_left);
-    audio_pipeline_wait_for_stop(_pipeline_left);
-    audio_pipeline_terminate(_pipeline_left);
-    audio_pipeline_stop(_pipeline_right);
-    audio_pipeline_wait_for_stop(_pipeline_right);
-    audio_pipeline_terminate(_pipeline_right);
-
-    audio_pipeline_unregister(_pipeline_left, _fatfs_stream_reader_left);
-    audio_pipeline_unregister(_pipeline_left, _audio_decoder_left);
-    audio_pipeline_unregister(_pipeline_left, _i2s_stream_writer_left);
-    audio_pipeline_unregister(_pipeline_right, _fatfs_stream_reader_right);
-    audio_pipeline_unregister(_pipeline_right, _audio_decoder_right);
-    audio_pipeline_unregister(_pipeline_right, _i2s_stream_writer_right);
-
-    audio_pipeline_remove_listener(_pipeline_left);
-    audio_pipeline_remove_listener(_pipeline_right);
-
-    audio_pipeline_deinit(_pipeline_left);
-    audio_pipeline_deinit(_pipeline_right);
-
-    audio_element_deinit(_fatfs_stream_reader_left);
-    audio_element_deinit(_audio_decoder_left);
-    audio_element_deinit(_i2s_stream_writer_left);
-    audio_element_deinit(_fatfs_stream_reader_right);
-    audio_element_deinit(_audio_decoder_right);
-    audio_element_deinit(_i2s_stream_writer_right);
+    vTaskDelete(audioWorkerHandle);
+
+    audio_pipeline_stop(_pipeline);
+    audio_pipeline_wait_for_stop(_pipeline);
+    audio_pipeline_terminate(_pipeline);
+
+    audio_pipeline_unregister(_pipeline, _sd_reader);
+    audio_pipeline_unregister(_pipeline, _audio_decoder);
+    audio_pipeline_unregister(_pipeline, _bell_stream);
+    audio_pipeline_unregister(_pipeline, _tone_stream);
+    audio_pipeline_unregister(_pipeline, _channel_router);
+    audio_pipeline_unregister(_pipeline, _i2s_stream_writer);
+
+    audio_pipeline_remove_listener(_pipeline);
+
+    audio_pipeline_deinit(_pipeline);
+
+    audio_element_deinit(_sd_reader);
+    audio_element_deinit(_audio_decoder);
+    audio_element_deinit(_bell_stream);
+    audio_element_deinit(_tone_stream);
+    audio_element_deinit(_channel_router);
+    audio_element_deinit(_i2s_stream_writer);
     LOGM_FUNC_OUT();
 }
 
-void plyr_play_left(char* uri) {
+static void stop_and_wait() {
+    // Element tasks are kept alive, only the stream is restarted
+    audio_pipeline_stop(_pipeline);
+    audio_pipeline_wait_for_stop(_pipeline);
+    _state = PLYR_STATE_IDLE;
+}
+
+static esp_err_t set_codec_volume(void *args) {
+    return audio_hal_set_volume(_board->audio_hal, *(int *)args);
+}
+
+// The codec shares the bus with the expanders, the volume goes before any queued scan
+static void set_volume(int volume) {
+    if(!i2cq_is_initialized()) {
+        audio_hal_set_volume(_board->audio_hal, volume);
+        return;
+    }
+
+    i2cq_batch_t batch = {
+        .client = I2CQ_CLIENT_CODEC,
+        .priority = I2CQ_PRIORITY_HIGH,
+        .run = set_codec_volume,
+        .run_args = &volume,
+    };
+    if(i2cq_execute(&batch) != ESP_OK) {
+        ESP_LOGW(TAG, "Fail to set volume %i!", volume);
+    }
+}
+
+// Run the pipeline with the router held: the source is opened and primed,
+// the ringbuffers are filled, and nothing reaches i2s until release().
+static void arm(pcm_route_t output, int volume) {
+    channel_router_set_route(_channel_router, output);
+    channel_router_set_hold(_channel_router, true);
+    set_volume(volume);
+
+    audio_pipeline_reset_ringbuffer(_pipeline);
+    audio_pipeline_reset_elements(_pipeline);
+    audio_pipeline_change_state(_pipeline, AEL_STATE_INIT);
+    audio_pipeline_run(_pipeline);
+    _state = PLYR_STATE_ARMED;
+}
+
+static void release() {
+    channel_router_set_hold(_channel_router, false);
+    ltcy_mark(LTCY_STAGE_PIPELINE_RUN);
+    _state = PLYR_STATE_PLAYING;
+}
+
+static void prepare_file(char* uri, int asset_id, bool loop, int on_ms, int off_ms) {
+    stop_and_wait();
+    select_source(SOURCE_FILE);
+
+    channel_router_set_gate(_channel_router, on_ms, off_ms);
+    sd_reader_set_loop(_sd_reader, loop);
+    sd_reader_set_asset(_sd_reader, asset_id);
+    if(uri != NULL) {
+        audio_element_set_uri(_sd_reader, uri);
+    }
+}
+
+static void prepare_bell(int strike_rate_hz, int on_ms, int off_ms) {
+    stop_and_wait();
+    select_source(SOURCE_BELL);
+
+    // The synthesizer does its own cadence, the bells ring out during the gaps, no gate
+    channel_router_set_gate(_channel_router, 0, 0);
+    if(bell_stream_set_cadence(_bell_stream, strike_rate_hz, on_ms, off_ms) != ESP_OK) {
+        ESP_LOGW(TAG, "Fail to set bell cadence, %i strikes/s, on %ims, off %ims!", strike_rate_hz, on_ms, off_ms);
+    }
+}
+
+static void prepare_tone(tone_id_t tone) {
+    stop_and_wait();
+    select_source(SOURCE_TONE);
+
+    // Busy and ringback cadences are part of the tone table
+    channel_router_set_gate(_channel_router, 0, 0);
+    tone_stream_set_tone(_tone_stream, tone);
+}
+
+static void play(char* uri, int asset_id, pcm_route_t output, int volume, bool loop, int on_ms, int off_ms) {
     LOGM_FUNC_IN();
-    audio_pipeline_stop(_pipeline_right);
-    audio_pipeline_wait_for_stop(_pipeline_right);
-    audio_pipeline_terminate(_pipeline_right);
+    _start_request_us = esp_timer_get_time();
+    prepare_file(uri, asset_id, loop, on_ms, off_ms);
+    arm(output, volume);
+    release();
+    LOGM_FUNC_OUT();
+}
 
-    _is_left_channel = true;
+void plyr_play(char* uri, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    play(uri, ASST_ID_NONE, output, volume, false, 0, 0);
+    LOGM_FUNC_OUT();
+}
 
-    audio_hal_set_volume(_board->audio_hal, RINGTONE_VOLUME);
-    audio_element_set_uri(_fatfs_stream_reader_left, uri);
+void plyr_play_loop(char* uri, pcm_route_t output, int volume, int on_ms, int off_ms) {
+    LOGM_FUNC_IN();
+    play(uri, ASST_ID_NONE, output, volume, true, on_ms, off_ms);
+    LOGM_FUNC_OUT();
+}
 
-    audio_pipeline_reset_ringbuffer(_pipeline_left);
-    audio_pipeline_reset_elements(_pipeline_left);
-    audio_pipeline_run(_pipeline_left);
+void plyr_play_asset(int asset_id, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    play(NULL, asset_id, output, volume, false, 0, 0);
+    LOGM_FUNC_OUT();
+}
+
+void plyr_play_asset_loop(int asset_id, pcm_route_t output, int volume, int on_ms, int off_ms) {
+    LOGM_FUNC_IN();
+    play(NULL, asset_id, output, volume, true, on_ms, off_ms);
+    LOGM_FUNC_OUT();
+}
+
+void plyr_play_bell(pcm_route_t output, int volume, int strike_rate_hz, int on_ms, int off_ms) {
+    LOGM_FUNC_IN();
+    _start_request_us = esp_timer_get_time();
+    prepare_bell(strike_rate_hz, on_ms, off_ms);
+    arm(output, volume);
+    release();
+    LOGM_FUNC_OUT();
+}
+
+void plyr_play_tone(tone_id_t tone, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    _start_request_us = esp_timer_get_time();
+    prepare_tone(tone);
+    arm(output, volume);
+    release();
+    LOGM_FUNC_OUT();
+}
+
+void plyr_play_left(char* uri) {
+    LOGM_FUNC_IN();
+    plyr_play(uri, PLYR_OUTPUT_RINGER, RINGTONE_VOLUME);
     LOGM_FUNC_OUT();
 }
 
 void plyr_play_right(char* uri) {
     LOGM_FUNC_IN();
-    audio_pipeline_stop(_pipeline_left);
-    audio_pipeline_wait_for_stop(_pipeline_left);
-    audio_pipeline_terminate(_pipeline_left);
+    plyr_play(uri, PLYR_OUTPUT_HANDSET, PHONE_VOLUME);
+    LOGM_FUNC_OUT();
+}
+
+void plyr_arm(char* uri, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    prepare_file(uri, ASST_ID_NONE, false, 0, 0);
+    arm(output, volume);
+    LOGM_FUNC_OUT();
+}
+
+void plyr_arm_asset(int asset_id, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    prepare_file(NULL, asset_id, false, 0, 0);
+    arm(output, volume);
+    LOGM_FUNC_OUT();
+}
+
+void plyr_arm_tone(tone_id_t tone, pcm_route_t output, int volume) {
+    LOGM_FUNC_IN();
+    prepare_tone(tone);
+    arm(output, volume);
+    LOGM_FUNC_OUT();
+}
 
-    _is_left_channel = false;
+esp_err_t plyr_start() {
+    LOGM_FUNC_IN();
+    esp_err_t err = ESP_FAIL;
 
-    audio_hal_set_volume(_board->audio_hal, PHONE_VOLUME);
-    audio_element_set_uri(_fatfs_stream_reader_right, uri);
+    if(_state != PLYR_STATE_ARMED) {
+        ESP_LOGE(TAG, "Fail to start, nothing is armed!");
+        goto end;
+    }
+
+    _start_request_us = esp_timer_get_time();
+    release();
+    err = ESP_OK;
 
-    audio_pipeline_reset_ringbuffer(_pipeline_right);
-    audio_pipeline_reset_elements(_pipeline_right);
-    audio_pipeline_run(_pipeline_right);
+    end:
     LOGM_FUNC_OUT();
+    return err;
+}
+
+plyr_state_t plyr_get_state() {
+    return _state;
+}
+
+int64_t plyr_get_start_latency_us() {
+    int64_t first_output_us = channel_router_get_first_output_time(_channel_router);
+    if(first_output_us == 0 || first_output_us < _start_request_us) {
+        return -1;
+    }
+
+    return first_output_us - _start_request_us;
+}
+
+void plyr_set_finished_callback(plyr_finished_cb_t cb, void *ctx) {
+    _finished_ctx = ctx;
+    _finished_cb = cb;
 }
 
 void plyr_stop(){
     LOGM_FUNC_IN();
-    audio_pipeline_stop(_pipeline_left);
-    audio_pipeline_stop(_pipeline_right);
+    audio_pipeline_stop(_pipeline);
+    _state = PLYR_STATE_IDLE;
     LOGM_FUNC_OUT();
 }
 
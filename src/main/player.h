@@ -1,23 +1,64 @@
-#ifndef RINGER_H
+#ifndef PLAYER_H
 #define PLAYER_H
 
+#include "audio_event_iface.h"
 #include "board.h"
+#include "esp_err.h"
 #include "esp_peripherals.h"
 
+#include "pcm_router.h"
+#include "tone_generator.h"
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #define TAG_PLAYER          "player"
 #define RINGTONE_VOLUME     10
 #define PHONE_VOLUME        10
 
+// Audio assets can be mono, the samples are placed on the slot of the selected output.
+#define PLYR_OUTPUT_RINGER  PCM_ROUTE_LEFT      // Ringer speaker
+#define PLYR_OUTPUT_HANDSET PCM_ROUTE_RIGHT     // Handset earpiece
+
+typedef enum {
+    PLYR_STATE_IDLE,        // Pipeline stopped, element tasks parked
+    PLYR_STATE_ARMED,       // Source opened and primed, waiting for plyr_start()
+    PLYR_STATE_PLAYING,
+} plyr_state_t;
+
+// Called by the audio task at the end of a file played once, must not block.
+typedef void (*plyr_finished_cb_t)(void *ctx);
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void plyr_initialize(esp_periph_set_handle_t set, audio_board_handle_t board, audio_event_iface_handle_t evt);
 void plyr_finalize();
+void plyr_play(char* uri, pcm_route_t output, int volume);
+// Play the file in a loop until plyr_stop(), gated: on_ms of sound then off_ms of silence.
+// The file stays open and the pipeline keeps running between two bursts, each burst replays
+// the first on_ms of the file (channel_router_set_gate()). on_ms == 0 for a plain loop.
+void plyr_play_loop(char* uri, pcm_route_t output, int volume, int on_ms, int off_ms);
+// Same as plyr_play() and plyr_play_loop() for an asset of the archive, see asset_archive.h.
+void plyr_play_asset(int asset_id, pcm_route_t output, int volume);
+void plyr_play_asset_loop(int asset_id, pcm_route_t output, int volume, int on_ms, int off_ms);
+// Ring the synthesized S63 bells until plyr_stop(), no SD access and no MP3 decoding.
+void plyr_play_bell(pcm_route_t output, int volume, int strike_rate_hz, int on_ms, int off_ms);
+// Generate a telephone tone until plyr_stop(), started without any SD access.
+void plyr_play_tone(tone_id_t tone, pcm_route_t output, int volume);
 void plyr_play_left(char* uri);
 void plyr_play_right(char* uri);
 void plyr_stop();
 
+// Warm standby: the source is opened and decoded ahead, plyr_start() only releases the sound.
+// Arming stops what is playing. Started sounds are measured by plyr_get_start_latency_us().
+void plyr_arm(char* uri, pcm_route_t output, int volume);
+void plyr_arm_asset(int asset_id, pcm_route_t output, int volume);
+void plyr_arm_tone(tone_id_t tone, pcm_route_t output, int volume);
+esp_err_t plyr_start();
+plyr_state_t plyr_get_state();
+// From the last play or start call to the first frames sent to i2s, -1 if not reached yet.
+int64_t plyr_get_start_latency_us();
+void plyr_set_finished_callback(plyr_finished_cb_t cb, void *ctx);
+
 ///////////////////////////////////////////////////////////////////////////////
 
 #endif // PLAYER_H
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "esp_log.h"
 
 #include "app_tools.h"
+#include "asset_archive.h"
 #include "player.h"
 
 #include "ringer.h"
@@ -14,7 +15,16 @@ static char *RINGTONE_PATH = RINGTONE_VINTAGE_PATH;
 
 void rngr_play() {
     LOGM_FUNC_IN();
-    plyr_play_left(RINGTONE_PATH);
+#if RINGTONE_SYNTHESIZED
+    plyr_play_bell(PLYR_OUTPUT_RINGER, RINGTONE_VOLUME, RINGTONE_STRIKE_RATE_HZ, RINGTONE_BURST_MS, RINGTONE_SILENCE_MS);
+#else
+    int asset_id = asst_find(RINGTONE_PATH);
+    if(asset_id != ASST_ID_NONE) {
+        plyr_play_asset_loop(asset_id, PLYR_OUTPUT_RINGER, RINGTONE_VOLUME, RINGTONE_BURST_MS, RINGTONE_SILENCE_MS);
+    } else {
+        plyr_play_loop(RINGTONE_PATH, PLYR_OUTPUT_RINGER, RINGTONE_VOLUME, RINGTONE_BURST_MS, RINGTONE_SILENCE_MS);
+    }
+#endif
     LOGM_FUNC_OUT();
 }
 
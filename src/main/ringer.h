@@ -7,6 +7,16 @@
 #define RINGTONE_VOLUME         10
 #define RINGTONE_VINTAGE_PATH   "/sdcard/ringtones/vintage.mp3"
 
+// French ring cadence: 1.5s ringing, 3.5s silence
+#define RINGTONE_BURST_MS       1500
+#define RINGTONE_SILENCE_MS     3500
+
+// 1: synthesized bells, 0: RINGTONE_VINTAGE_PATH from the SD card, gated by the cadence
+// (each burst replays the first RINGTONE_BURST_MS of the file). Converted mono at 16 kHz,
+// the replayed burst (48 KB) fits in internal RAM.
+#define RINGTONE_SYNTHESIZED    1
+#define RINGTONE_STRIKE_RATE_HZ 50
+
 ///////////////////////////////////////////////////////////////////////////////
 
 void rngr_play();
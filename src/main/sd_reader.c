@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "asset_archive.h"
+#include "sd_reader.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define ID3V2_HEADER_SIZE       10
+#define ID3V2_FLAG_FOOTER       0x10
+
+static const char *TAG = TAG_SD_READER;
+
+typedef struct {
+    FILE *file;
+    bool archived;          // file is the asset archive, shared and never closed here
+    volatile int asset_id;  // Asset played instead of the uri, ASST_ID_NONE for the uri
+    long base;              // First byte of the stream in the file
+    long end;               // Last byte + 1 of the stream in the file
+    long position;          // Next byte read from the file
+    long audio_offset;      // First byte after the ID3v2 tag, where a loop restarts
+    int read_size;
+    volatile bool loop;
+    uint32_t read_count;    // Transfers of the current file
+    int64_t max_read_us;    // Slowest transfer of the current file
+} sd_reader_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static long get_id3v2_size(FILE *file) {
+    uint8_t header[ID3V2_HEADER_SIZE];
+
+    if(fread(header, 1, ID3V2_HEADER_SIZE, file) != ID3V2_HEADER_SIZE
+        || memcmp(header, "ID3", 3) != 0) {
+        return 0;
+    }
+
+    // Syncsafe integer, 7 bits per byte
+    long size = ((long)(header[6] & 0x7F) << 21)
+        | ((long)(header[7] & 0x7F) << 14)
+        | ((long)(header[8] & 0x7F) << 7)
+        | (long)(header[9] & 0x7F);
+
+    size += ID3V2_HEADER_SIZE;
+    if(header[5] & ID3V2_FLAG_FOOTER) {
+        size += ID3V2_HEADER_SIZE;
+    }
+
+    return size;
+}
+
+static void close_file(sd_reader_t *reader) {
+    if(reader->file != NULL && !reader->archived) {
+        fclose(reader->file);
+    }
+    reader->file = NULL;
+    reader->archived = false;
+}
+
+static esp_err_t open_asset(sd_reader_t *reader, int asset_id) {
+    const asst_entry_t *entry = asst_get_entry(asset_id);
+    if(entry == NULL || asst_get_file() == NULL) {
+        ESP_LOGE(TAG, "No asset %i in the archive!", asset_id);
+        return ESP_FAIL;
+    }
+
+    // Index loaded at boot: no path lookup, no open, the ID3v2 size is known
+    reader->file = asst_get_file();
+    reader->archived = true;
+    reader->base = entry->offset;
+    reader->end = entry->offset + entry->length;
+    reader->audio_offset = entry->offset + entry->audio_offset;
+
+    ESP_LOGD(TAG, "Open asset %i %s, %u bytes at %u", asset_id, entry->name, entry->length, entry->offset);
+    return ESP_OK;
+}
+
+static esp_err_t open_file(sd_reader_t *reader, const char *uri) {
+    reader->file = fopen(uri, "rb");
+    if(reader->file == NULL) {
+        ESP_LOGE(TAG, "Fail to open %s!", uri);
+        return ESP_FAIL;
+    }
+
+    // No stdio buffer, each fread() is one FATFS read of the requested size
+    setvbuf(reader->file, NULL, _IONBF, 0);
+
+    fseek(reader->file, 0, SEEK_END);
+    reader->base = 0;
+    reader->end = ftell(reader->file);
+    fseek(reader->file, 0, SEEK_SET);
+    reader->audio_offset = get_id3v2_size(reader->file);
+
+    ESP_LOGD(TAG, "Open %s, %ld bytes, audio at %ld", uri, reader->end, reader->audio_offset);
+    return ESP_OK;
+}
+
+static esp_err_t _sd_open(audio_element_handle_t self) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+    audio_element_info_t info = {0};
+    esp_err_t err;
+
+    if(reader->file != NULL) {
+        ESP_LOGW(TAG, "Already opened, closed first");
+        close_file(reader);
+    }
+
+    int asset_id = reader->asset_id;
+    if(asset_id != ASST_ID_NONE) {
+        err = open_asset(reader, asset_id);
+    } else {
+        char *uri = audio_element_get_uri(self);
+        if(uri == NULL) {
+            ESP_LOGE(TAG, "No uri to open!");
+            return ESP_FAIL;
+        }
+        err = open_file(reader, uri);
+    }
+
+    if(err != ESP_OK) {
+        return err;
+    }
+
+    audio_element_getinfo(self, &info);
+    audio_element_set_total_bytes(self, reader->end - reader->base);
+    reader->position = reader->base + (long)info.byte_pos;
+    if(fseek(reader->file, reader->position, SEEK_SET) != 0) {
+        ESP_LOGE(TAG, "Fail to seek at %ld!", reader->position);
+        close_file(reader);
+        return ESP_FAIL;
+    }
+    reader->read_count = 0;
+    reader->max_read_us = 0;
+
+    return ESP_OK;
+}
+
+static int read_aligned(sd_reader_t *reader, char *buffer, int len) {
+    // After an open or a loop the position is anywhere, the first read
+    // stops at the next read_size boundary and all the others are aligned
+    int aligned_len = reader->read_size - (int)(reader->position % reader->read_size);
+    if(len > aligned_len) {
+        len = aligned_len;
+    }
+    if(len > reader->end - reader->position) {
+        len = (int)(reader->end - reader->position);
+    }
+    if(len <= 0) {
+        return 0;
+    }
+
+    int64_t start = esp_timer_get_time();
+    int rlen = fread(buffer, 1, len, reader->file);
+    int64_t duration = esp_timer_get_time() - start;
+
+    if(rlen > 0) {
+        reader->position += rlen;
+        reader->read_count++;
+        if(duration > reader->max_read_us) {
+            reader->max_read_us = duration;
+        }
+    }
+
+    return rlen;
+}
+
+static int _sd_read(audio_element_handle_t self, char *buffer, int len, TickType_t ticks_to_wait, void *context) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+
+    int rlen = read_aligned(reader, buffer, len);
+    if(rlen <= 0 && reader->loop) {
+        // Restart without closing the file, the decoder sees a continuous stream
+        ESP_LOGD(TAG, "Loop at %ld", reader->audio_offset);
+        fseek(reader->file, reader->audio_offset, SEEK_SET);
+        reader->position = reader->audio_offset;
+        audio_element_set_byte_pos(self, reader->audio_offset - reader->base);
+        rlen = read_aligned(reader, buffer, len);
+    }
+
+    if(rlen <= 0) {
+        ESP_LOGW(TAG, "No more data, ret: %d", rlen);
+        rlen = 0;
+    } else {
+        audio_element_update_byte_pos(self, rlen);
+    }
+
+    return rlen;
+}
+
+static int _sd_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    int r_size = audio_element_input(self, in_buffer, in_len);
+    int w_size = 0;
+
+    if(r_size > 0) {
+        w_size = audio_element_output(self, in_buffer, r_size);
+    } else {
+        w_size = r_size;
+    }
+
+    return w_size;
+}
+
+static esp_err_t _sd_close(audio_element_handle_t self) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+
+    if(reader->file != NULL) {
+        ESP_LOGD(TAG, "%u reads of %i bytes, slowest %lld us",
+            reader->read_count, reader->read_size, (long long)reader->max_read_us);
+        close_file(reader);
+    }
+
+    if(audio_element_get_state(self) != AEL_STATE_PAUSED) {
+        audio_element_set_byte_pos(self, 0);
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t _sd_destroy(audio_element_handle_t self) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+    audio_free(reader);
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+audio_element_handle_t sd_reader_init(sd_reader_cfg_t *config) {
+    if(config->read_size < SD_READER_SECTOR_SIZE
+        || config->read_size % SD_READER_SECTOR_SIZE != 0
+        || config->read_ahead < 1) {
+        ESP_LOGE(TAG, "Read size must be a multiple of %i bytes, read ahead at least 1!", SD_READER_SECTOR_SIZE);
+        return NULL;
+    }
+
+    sd_reader_t *reader = audio_calloc(1, sizeof(sd_reader_t));
+    if(reader == NULL) {
+        ESP_LOGE(TAG, "Fail to allocate sd reader!");
+        return NULL;
+    }
+    reader->read_size = config->read_size;
+    reader->asset_id = ASST_ID_NONE;
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _sd_open;
+    cfg.close = _sd_close;
+    cfg.process = _sd_process;
+    cfg.destroy = _sd_destroy;
+    cfg.read = _sd_read;
+    cfg.buffer_len = config->read_size;
+    cfg.out_rb_size = config->read_size * config->read_ahead;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.tag = "file";
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if(el == NULL) {
+        ESP_LOGE(TAG, "Fail to init sd reader element!");
+        audio_free(reader);
+        return NULL;
+    }
+
+    audio_element_setdata(el, reader);
+
+    return el;
+}
+
+esp_err_t sd_reader_set_loop(audio_element_handle_t self, bool loop) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+    if(reader == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    reader->loop = loop;
+    return ESP_OK;
+}
+
+esp_err_t sd_reader_set_asset(audio_element_handle_t self, int asset_id) {
+    sd_reader_t *reader = (sd_reader_t *)audio_element_getdata(self);
+    if(reader == NULL || (asset_id != ASST_ID_NONE && asst_get_entry(asset_id) == NULL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    reader->asset_id = asset_id;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,57 @@
+#ifndef SD_READER_H
+#define SD_READER_H
+
+#include <stdbool.h>
+
+#include "audio_element.h"
+#include "esp_err.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_SD_READER               "sd_reader"
+
+#define SD_READER_SECTOR_SIZE       (512)
+#define SD_READER_READ_SIZE         (8 * 1024)  // Up to the card allocation unit when memory allows
+#define SD_READER_READ_AHEAD        (2)         // Double buffering
+#define SD_READER_TASK_STACK        (3 * 1024)
+#define SD_READER_TASK_CORE         (0)
+#define SD_READER_TASK_PRIO         (4)
+
+typedef struct {
+    int read_size;          // Bytes of one SD transfer, a multiple of SD_READER_SECTOR_SIZE
+    int read_ahead;         // Transfers buffered ahead of the decoder, the output ringbuffer size
+    int task_stack;         // Task stack size
+    int task_core;          // Task running in core (0 or 1)
+    int task_prio;          // Task priority (based on freeRTOS priority)
+} sd_reader_cfg_t;
+
+#define SD_READER_CFG_DEFAULT() {                   \
+    .read_size      = SD_READER_READ_SIZE,          \
+    .read_ahead     = SD_READER_READ_AHEAD,         \
+    .task_stack     = SD_READER_TASK_STACK,         \
+    .task_core      = SD_READER_TASK_CORE,          \
+    .task_prio      = SD_READER_TASK_PRIO,          \
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Reader element for files on the SD card (uri is the VFS path, "/sdcard/...").
+// Replace fatfs_stream for the player, and can loop over the file.
+// Reads are unbuffered, read_size long and aligned on read_size in the file, so FATFS
+// transfers whole sectors straight into the element buffer instead of going through
+// its per-file sector cache. A read_size dividing the allocation unit never straddles
+// a cluster. read_ahead transfers are kept ready in the output ringbuffer.
+audio_element_handle_t sd_reader_init(sd_reader_cfg_t *config);
+
+// In loop mode the end of file is never reported: the file is read again
+// from its first audio byte (ID3v2 tag skipped) without being re-opened.
+// Applied immediately, also to the file being read.
+esp_err_t sd_reader_set_loop(audio_element_handle_t self, bool loop);
+
+// Play an asset of the archive (asset_archive.h) by offset reads instead of the uri.
+// ASST_ID_NONE goes back to the uri. Applied from the next open.
+esp_err_t sd_reader_set_asset(audio_element_handle_t self, int asset_id);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // SD_READER_H
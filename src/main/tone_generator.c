@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "dsp_sine.h"
+
+#include "tone_generator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TONE_MS(ms)             ((uint32_t)(((uint64_t)(ms) * TONE_SAMPLE_RATE) / 1000))
+#define TONE_INC(freq_hz)       DSP_PHASE_INC(freq_hz, TONE_SAMPLE_RATE)
+
+#define TONE_LEVEL_SINGLE       9830    // 0.30, about -10 dBFS
+#define TONE_LEVEL_DTMF         8192    // 0.25 per frequency, the pair peaks at 0.5
+
+#define TONE_FRENCH_HZ          440
+
+#define DTMF(low_hz, high_hz)   { { TONE_INC(low_hz), TONE_INC(high_hz) }, TONE_LEVEL_DTMF, UINT32_MAX, 0 }
+
+// Everything is computed by the compiler, nothing is left to do at run time
+static const tone_def_t tone_table[TONE_COUNT] = {
+    [TONE_NONE]         = { { 0, 0 }, 0, UINT32_MAX, 0 },
+    [TONE_DIAL]         = { { TONE_INC(TONE_FRENCH_HZ), 0 }, TONE_LEVEL_SINGLE, UINT32_MAX, 0 },
+    [TONE_BUSY]         = { { TONE_INC(TONE_FRENCH_HZ), 0 }, TONE_LEVEL_SINGLE, TONE_MS(500), TONE_MS(500) },
+    [TONE_RINGBACK]     = { { TONE_INC(TONE_FRENCH_HZ), 0 }, TONE_LEVEL_SINGLE, TONE_MS(1500), TONE_MS(3500) },
+    [TONE_DTMF_1]       = DTMF(697, 1209),
+    [TONE_DTMF_2]       = DTMF(697, 1336),
+    [TONE_DTMF_3]       = DTMF(697, 1477),
+    [TONE_DTMF_A]       = DTMF(697, 1633),
+    [TONE_DTMF_4]       = DTMF(770, 1209),
+    [TONE_DTMF_5]       = DTMF(770, 1336),
+    [TONE_DTMF_6]       = DTMF(770, 1477),
+    [TONE_DTMF_B]       = DTMF(770, 1633),
+    [TONE_DTMF_7]       = DTMF(852, 1209),
+    [TONE_DTMF_8]       = DTMF(852, 1336),
+    [TONE_DTMF_9]       = DTMF(852, 1477),
+    [TONE_DTMF_C]       = DTMF(852, 1633),
+    [TONE_DTMF_STAR]    = DTMF(941, 1209),
+    [TONE_DTMF_0]       = DTMF(941, 1336),
+    [TONE_DTMF_HASH]    = DTMF(941, 1477),
+    [TONE_DTMF_D]       = DTMF(941, 1633),
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void next_cadence_phase(tone_generator_t *gen) {
+    if(gen->def->off_samples == 0) {
+        gen->on = 1;
+        gen->cadence_left = UINT32_MAX;
+        return;
+    }
+
+    gen->on = !gen->on;
+    gen->cadence_left = gen->on ? gen->def->on_samples : gen->def->off_samples;
+}
+
+static void render_tone(tone_generator_t *gen, int16_t *samples, uint32_t count) {
+    const tone_def_t *def = gen->def;
+    uint32_t phase0 = gen->phase[0];
+    uint32_t phase1 = gen->phase[1];
+
+    for(uint32_t n = 0; n < count; n++) {
+        int32_t acc = dsp_sine(phase0) * def->level;
+        if(def->phase_inc[1] != 0) {
+            acc += dsp_sine(phase1) * def->level;
+        }
+        samples[n] = dsp_saturate16(acc >> 15);
+        phase0 += def->phase_inc[0];
+        phase1 += def->phase_inc[1];
+    }
+
+    gen->phase[0] = phase0;
+    gen->phase[1] = phase1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tone_generator_init(tone_generator_t *gen, tone_id_t tone) {
+    memset(gen, 0, sizeof(tone_generator_t));
+
+    if(tone <= TONE_NONE || tone >= TONE_COUNT) {
+        tone = TONE_NONE;
+    }
+
+    gen->def = &tone_table[tone];
+    gen->on = 0;
+    next_cadence_phase(gen);
+}
+
+void tone_generator_render(tone_generator_t *gen, int16_t *samples, size_t count) {
+    while(count > 0) {
+        if(gen->cadence_left == 0) {
+            next_cadence_phase(gen);
+        }
+
+        uint32_t chunk = gen->cadence_left;
+        if(chunk > count) chunk = count;
+
+        if(gen->on && gen->def->level != 0) {
+            render_tone(gen, samples, chunk);
+        } else {
+            memset(samples, 0, chunk * sizeof(int16_t));
+        }
+
+        samples += chunk;
+        count -= chunk;
+        if(gen->cadence_left != UINT32_MAX) {
+            gen->cadence_left -= chunk;
+        }
+    }
+}
+
+tone_id_t tone_from_dtmf_key(char key) {
+    if(key >= '0' && key <= '9') {
+        return TONE_DTMF_0 + (key - '0');
+    }
+    if(key >= 'A' && key <= 'D') {
+        return TONE_DTMF_A + (key - 'A');
+    }
+    if(key == '*') {
+        return TONE_DTMF_STAR;
+    }
+    if(key == '#') {
+        return TONE_DTMF_HASH;
+    }
+    return TONE_NONE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+#ifndef TONE_GENERATOR_H
+#define TONE_GENERATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Telephone signalling tones: French dial tone, busy, ringback and DTMF pairs.
+// Every tone is a constant table entry (phase increments and cadence in samples),
+// rendered from the Q15 sine table. Plain C, no ESP-IDF / ADF dependency,
+// the output is mono signed 16 bits at TONE_SAMPLE_RATE.
+
+#define TONE_SAMPLE_RATE        16000
+#define TONE_FREQ_COUNT         2       // DTMF is a pair, the other tones use one frequency
+
+typedef enum {
+    TONE_NONE = 0,      // Silence
+    TONE_DIAL,          // 440 Hz, continuous
+    TONE_BUSY,          // 440 Hz, 500 ms on, 500 ms off
+    TONE_RINGBACK,      // 440 Hz, 1.5 s on, 3.5 s off
+    TONE_DTMF_0,        // DTMF keys are continuous, the caller decides of the duration
+    TONE_DTMF_1,
+    TONE_DTMF_2,
+    TONE_DTMF_3,
+    TONE_DTMF_4,
+    TONE_DTMF_5,
+    TONE_DTMF_6,
+    TONE_DTMF_7,
+    TONE_DTMF_8,
+    TONE_DTMF_9,
+    TONE_DTMF_STAR,
+    TONE_DTMF_HASH,
+    TONE_DTMF_A,
+    TONE_DTMF_B,
+    TONE_DTMF_C,
+    TONE_DTMF_D,
+    TONE_COUNT,
+} tone_id_t;
+
+typedef struct {
+    uint32_t phase_inc[TONE_FREQ_COUNT];    // 0 for an unused frequency
+    int16_t level;                          // Q15, per frequency
+    uint32_t on_samples;
+    uint32_t off_samples;                   // 0 for a continuous tone
+} tone_def_t;
+
+typedef struct {
+    const tone_def_t *def;
+    uint32_t phase[TONE_FREQ_COUNT];
+    uint32_t cadence_left;      // Samples left in the current cadence phase
+    uint8_t on;
+} tone_generator_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void tone_generator_init(tone_generator_t *gen, tone_id_t tone);
+
+void tone_generator_render(tone_generator_t *gen, int16_t *samples, size_t count);
+
+// TONE_DTMF_x for '0'-'9', '*', '#', 'A'-'D', TONE_NONE for any other key.
+tone_id_t tone_from_dtmf_key(char key);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // TONE_GENERATOR_H
@@ -0,0 +1,103 @@
+#include <string.h>
+
+#include "audio_element.h"
+#include "audio_mem.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#include "tone_stream.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char *TAG = TAG_TONE_STREAM;
+
+typedef struct {
+    tone_id_t tone;
+    tone_generator_t generator;
+} tone_stream_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static esp_err_t _tone_open(audio_element_handle_t self) {
+    tone_stream_t *stream = (tone_stream_t *)audio_element_getdata(self);
+    audio_element_info_t info = {0};
+
+    tone_generator_init(&stream->generator, stream->tone);
+
+    audio_element_getinfo(self, &info);
+    info.sample_rates = TONE_SAMPLE_RATE;
+    info.channels = 1;
+    info.bits = 16;
+    audio_element_setinfo(self, &info);
+
+    // Same event as a decoder, the player sets the i2s clock from it
+    audio_element_report_info(self);
+
+    ESP_LOGD(TAG, "Tone %i at %i Hz", stream->tone, TONE_SAMPLE_RATE);
+    return ESP_OK;
+}
+
+static int _tone_process(audio_element_handle_t self, char *in_buffer, int in_len) {
+    tone_stream_t *stream = (tone_stream_t *)audio_element_getdata(self);
+
+    int sample_count = in_len / sizeof(int16_t);
+    tone_generator_render(&stream->generator, (int16_t *)in_buffer, sample_count);
+
+    return audio_element_output(self, in_buffer, sample_count * sizeof(int16_t));
+}
+
+static esp_err_t _tone_close(audio_element_handle_t self) {
+    return ESP_OK;
+}
+
+static esp_err_t _tone_destroy(audio_element_handle_t self) {
+    tone_stream_t *stream = (tone_stream_t *)audio_element_getdata(self);
+    audio_free(stream);
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+audio_element_handle_t tone_stream_init(tone_stream_cfg_t *config) {
+    tone_stream_t *stream = audio_calloc(1, sizeof(tone_stream_t));
+    if(stream == NULL) {
+        ESP_LOGE(TAG, "Fail to allocate tone stream!");
+        return NULL;
+    }
+    stream->tone = config->tone;
+
+    audio_element_cfg_t cfg = DEFAULT_AUDIO_ELEMENT_CONFIG();
+    cfg.open = _tone_open;
+    cfg.close = _tone_close;
+    cfg.process = _tone_process;
+    cfg.destroy = _tone_destroy;
+    cfg.buffer_len = TONE_STREAM_BUFFER_SIZE;
+    cfg.out_rb_size = config->out_rb_size;
+    cfg.task_stack = config->task_stack;
+    cfg.task_core = config->task_core;
+    cfg.task_prio = config->task_prio;
+    cfg.tag = "tone";
+
+    audio_element_handle_t el = audio_element_init(&cfg);
+    if(el == NULL) {
+        ESP_LOGE(TAG, "Fail to init tone stream element!");
+        audio_free(stream);
+        return NULL;
+    }
+
+    audio_element_setdata(el, stream);
+
+    return el;
+}
+
+esp_err_t tone_stream_set_tone(audio_element_handle_t self, tone_id_t tone) {
+    tone_stream_t *stream = (tone_stream_t *)audio_element_getdata(self);
+    if(stream == NULL || tone < TONE_NONE || tone >= TONE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    stream->tone = tone;
+    return ESP_OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,47 @@
+#ifndef TONE_STREAM_H
+#define TONE_STREAM_H
+
+#include "audio_element.h"
+#include "esp_err.h"
+
+#include "tone_generator.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define TAG_TONE_STREAM                 "tone_stream"
+
+// Small buffers, the first samples reach i2s within a few milliseconds
+#define TONE_STREAM_BUFFER_SIZE         (256)
+#define TONE_STREAM_TASK_STACK          (2 * 1024)
+#define TONE_STREAM_TASK_CORE           (0)
+#define TONE_STREAM_TASK_PRIO           (5)
+#define TONE_STREAM_RINGBUFFER_SIZE     (1024)
+
+typedef struct {
+    tone_id_t tone;             // Tone played from the first run
+    int out_rb_size;            // Size of output ringbuffer
+    int task_stack;             // Task stack size
+    int task_core;              // Task running in core (0 or 1)
+    int task_prio;              // Task priority (based on freeRTOS priority)
+} tone_stream_cfg_t;
+
+#define TONE_STREAM_CFG_DEFAULT() {                 \
+    .tone           = TONE_DIAL,                    \
+    .out_rb_size    = TONE_STREAM_RINGBUFFER_SIZE,  \
+    .task_stack     = TONE_STREAM_TASK_STACK,       \
+    .task_core      = TONE_STREAM_TASK_CORE,        \
+    .task_prio      = TONE_STREAM_TASK_PRIO,        \
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Source element generating telephone tones, mono 16 bits PCM at TONE_SAMPLE_RATE.
+// Plays until the pipeline is stopped, no file and no decoder needed.
+audio_element_handle_t tone_stream_init(tone_stream_cfg_t *config);
+
+// Applied from the next run of the element.
+esp_err_t tone_stream_set_tone(audio_element_handle_t self, tone_id_t tone);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // TONE_STREAM_H